@@ -44,9 +44,18 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(res['transactions'], 200)
         assert_equal(res['height'], 200)
         assert_equal(res['txouts'], 343) # 144*2 + 55
-        assert_equal(res['bytes_serialized'], 14819), # 32*199 + 48*90 + 49*54 + 27*55
         assert_equal(len(res['bestblock']), 64)
-        assert_equal(len(res['hash_serialized']), 64)
+        assert_equal(len(res['muhash']), 64)
+        assert('hash_serialized' not in res)
+
+        # The full scan agrees with the incrementally maintained statistics.
+        res2 = node.gettxoutsetinfo("hash_serialized")
+        assert_equal(res2['total_amount'], res['total_amount'])
+        assert_equal(res2['transactions'], res['transactions'])
+        assert_equal(res2['txouts'], res['txouts'])
+        assert_equal(res2['muhash'], res['muhash'])
+        assert_equal(res2['bytes_serialized'], 14819), # 32*199 + 48*90 + 49*54 + 27*55
+        assert_equal(len(res2['hash_serialized']), 64)
 
 
 if __name__ == '__main__':
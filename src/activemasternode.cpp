@@ -163,8 +163,7 @@ bool CActiveMasternode::SendMasternodePing(std::string& errorMessage)
         // mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
         CMasternodeBroadcast mnb(*pmn);
         uint256 hash = mnb.GetHash();
-        if (mnodeman.mapSeenMasternodeBroadcast.count(hash))
-            mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = mnp;
+        mnodeman.mapSeenMasternodeBroadcast.modify(hash, [&mnp](CMasternodeBroadcast& seen) { seen.lastPing = mnp; });
 
         mnp.Relay();
 
@@ -0,0 +1,209 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKENCODINGS_H
+#define BITCOIN_BLOCKENCODINGS_H
+
+#include "primitives/block.h"
+#include "serialize.h"
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+class CTxMemPool;
+
+/** A getblocktxn message: the indexes of the transactions of a compact block the sender is missing */
+class BlockTransactionsRequest
+{
+public:
+    uint256 blockhash;
+    std::vector<uint16_t> indexes;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << blockhash;
+        // Indexes are sent as the difference to the previous index plus one
+        WriteCompactSize(s, indexes.size());
+        for (size_t i = 0; i < indexes.size(); i++) {
+            uint64_t index = indexes[i] - (i == 0 ? 0 : (indexes[i - 1] + 1));
+            WriteCompactSize(s, index);
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        s >> blockhash;
+        uint64_t indexes_size = ReadCompactSize(s);
+        size_t i = 0;
+        // Grow the vector gradually so that a bogus size does not allocate memory up front
+        while (indexes.size() < indexes_size) {
+            indexes.resize(std::min((uint64_t)(1000 + indexes.size()), indexes_size));
+            for (; i < indexes.size(); i++) {
+                uint64_t index = ReadCompactSize(s);
+                if (index > std::numeric_limits<uint16_t>::max())
+                    throw std::ios_base::failure("index overflowed 16 bits");
+                indexes[i] = index;
+            }
+        }
+
+        uint16_t offset = 0;
+        for (size_t j = 0; j < indexes.size(); j++) {
+            if (uint64_t(indexes[j]) + uint64_t(offset) > std::numeric_limits<uint16_t>::max())
+                throw std::ios_base::failure("indexes overflowed 16 bits");
+            indexes[j] = indexes[j] + offset;
+            offset = indexes[j] + 1;
+        }
+    }
+};
+
+/** A blocktxn message: the transactions requested by a getblocktxn message */
+class BlockTransactions
+{
+public:
+    uint256 blockhash;
+    std::vector<CTransaction> txn;
+
+    BlockTransactions() {}
+    explicit BlockTransactions(const BlockTransactionsRequest& req) : blockhash(req.blockhash), txn(req.indexes.size()) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(blockhash);
+        READWRITE(txn);
+    }
+};
+
+/** A transaction sent in full within a compact block */
+struct PrefilledTransaction {
+    //! Difference to the previous prefilled index when serialized, the
+    //! position in the block once a compact block is decoded
+    uint16_t index;
+    CTransaction tx;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, index);
+        s << tx;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        uint64_t idx = ReadCompactSize(s);
+        if (idx > std::numeric_limits<uint16_t>::max())
+            throw std::ios_base::failure("index overflowed 16 bits");
+        index = idx;
+        s >> tx;
+    }
+};
+
+typedef enum ReadStatus_t {
+    READ_STATUS_OK,
+    READ_STATUS_INVALID, //!< Invalid object, peer is sending bogus data
+    READ_STATUS_FAILED,  //!< Failed to process object, request the full block instead
+} ReadStatus;
+
+/**
+ * A cmpctblock message (BIP 152): a block header followed by 6-byte short IDs
+ * of its transactions, keyed per block so that collisions cannot be forced
+ * across the network, and the transactions the receiver is unlikely to have
+ * (the coinbase).
+ */
+class CBlockHeaderAndShortTxIDs
+{
+private:
+    mutable uint64_t shorttxidk0, shorttxidk1;
+    uint64_t nonce;
+
+    void FillShortTxIDSelector() const;
+
+    friend class PartiallyDownloadedBlock;
+
+    static const int SHORTTXIDS_LENGTH = 6;
+
+protected:
+    std::vector<uint64_t> shorttxids;
+    std::vector<PrefilledTransaction> prefilledtxn;
+
+public:
+    CBlockHeader header;
+
+    // Dummy for deserialization
+    CBlockHeaderAndShortTxIDs() {}
+
+    explicit CBlockHeaderAndShortTxIDs(const CBlock& block);
+
+    uint64_t GetShortID(const uint256& txhash) const;
+
+    size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        static_assert(SHORTTXIDS_LENGTH == 6, "shorttxids serialization assumes 6-byte shorttxids");
+        s << header << nonce;
+        WriteCompactSize(s, shorttxids.size());
+        for (size_t i = 0; i < shorttxids.size(); i++) {
+            uint32_t lsb = shorttxids[i] & 0xffffffff;
+            uint16_t msb = (shorttxids[i] >> 32) & 0xffff;
+            s << lsb << msb;
+        }
+        s << prefilledtxn;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        s >> header >> nonce;
+        uint64_t shorttxids_size = ReadCompactSize(s);
+        size_t i = 0;
+        while (shorttxids.size() < shorttxids_size) {
+            shorttxids.resize(std::min((uint64_t)(1000 + shorttxids.size()), shorttxids_size));
+            for (; i < shorttxids.size(); i++) {
+                uint32_t lsb = 0;
+                uint16_t msb = 0;
+                s >> lsb >> msb;
+                shorttxids[i] = (uint64_t(msb) << 32) | uint64_t(lsb);
+            }
+        }
+        s >> prefilledtxn;
+        FillShortTxIDSelector();
+    }
+};
+
+/**
+ * A block being reconstructed from a compact block, the transactions in our
+ * mempool and those requested from the sending peer.
+ */
+class PartiallyDownloadedBlock
+{
+protected:
+    std::vector<std::shared_ptr<const CTransaction>> txn_available;
+    size_t prefilled_count = 0, mempool_count = 0;
+    CTxMemPool* pool;
+
+public:
+    CBlockHeader header;
+
+    explicit PartiallyDownloadedBlock(CTxMemPool* poolIn) : pool(poolIn) {}
+
+    ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock);
+    bool IsTxAvailable(size_t index) const;
+    /**
+     * Assemble the block from the available transactions and vtx_missing, in
+     * the order the missing indexes were requested. Returns
+     * READ_STATUS_FAILED if the result does not match the merkle root, which
+     * happens on short ID collisions.
+     */
+    ReadStatus FillBlock(CBlock& block, const std::vector<CTransaction>& vtx_missing);
+};
+
+#endif // BITCOIN_BLOCKENCODINGS_H
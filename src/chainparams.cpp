@@ -129,6 +129,9 @@ public:
         consensus.nZawyLWMA3AveragingWindow = 60;
         // The best chain should have at least this much work.
         consensus.nMinimumChainWork = uint256S("000000000000000000000000000000000000000000000000000000e45718e6cb");
+
+        // By default assume that the signatures and proofs in ancestors of this block are valid.
+        consensus.defaultAssumeValid = uint256S("0x0000069659ac059efe3b80d7cad523551d3060e97305ad6143d88aa16fddf041"); // 3257060
         /**
          * The message start string should be awesome! Ⓢ❤
          */
@@ -552,6 +555,9 @@ public:
 
         // The best chain should have at least this much work.
         consensus.nMinimumChainWork = uint256S("0x000000000000000000000000000000000000000000000000000000000000000d");
+
+        // By default assume that the signatures and proofs in ancestors of this block are valid.
+        consensus.defaultAssumeValid = uint256();
         pchMessageStart[0] = 0xfa;
         pchMessageStart[1] = 0x1a;
         pchMessageStart[2] = 0xf9;
@@ -692,6 +698,9 @@ public:
         consensus.nMinimumChainWork = uint256S("0x00");
         consensus.nProposalEstablishmentTime = 60 * 5; // at least 5 min old to make it into a budget
 
+        // By default assume that the signatures and proofs in ancestors of this block are valid.
+        consensus.defaultAssumeValid = uint256();
+
         pchMessageStart[0] = 0xaa;
         pchMessageStart[1] = 0xe8;
         pchMessageStart[2] = 0x3f;
@@ -5,11 +5,14 @@
 #include "coins.h"
 
 #include "memusage.h"
+#include "primitives/block.h"
 #include "random.h"
+#include "streams.h"
 #include "version.h"
 #include "policy/fees.h"
 
 #include <assert.h>
+#include <map>
 
 #include <tracing.h>
 
@@ -897,6 +900,14 @@ bool CCoinsViewCache::Flush() {
     return fOk;
 }
 
+void CCoinsViewCache::Reset() {
+    assert(cacheCoins.empty() && cacheSproutAnchors.empty() && cacheSaplingAnchors.empty() &&
+           cacheSproutNullifiers.empty() && cacheSaplingNullifiers.empty() && historyCacheMap.empty());
+    hashBlock.SetNull();
+    hashSproutAnchor.SetNull();
+    hashSaplingAnchor.SetNull();
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
@@ -1048,3 +1059,90 @@ CCoinsModifier::~CCoinsModifier()
         cache.cachedCoinsUsage += it->second.coins.DynamicMemoryUsage();
     }
 }
+
+void ApplyCoinHash(MuHash3072& muhash, const uint256& txid, uint32_t n, int nHeight, bool fCoinBase, const CTxOut& out)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << txid;
+    ss << n;
+    ss << (uint32_t)(nHeight * 2 + (fCoinBase ? 1 : 0));
+    ss << out;
+    muhash.Insert((const unsigned char*)ss.data(), ss.size());
+}
+
+void CCoinsStats::ApplyBlock(const CBlock& block, int nBlockHeight, const CCoinsViewCache& view, bool fDisconnect)
+{
+    MuHash3072 added;
+    MuHash3072 removed;
+    int64_t nTxDelta = 0;
+    int64_t nTxOutDelta = 0;
+    CAmount nAmountDelta = 0;
+
+    // Every transaction touched by the block: whether it had unspent outputs
+    // before the block, and its outputs as they evolve through the block.
+    std::map<uint256, std::pair<bool, CCoins>> mapTouched;
+
+    for (const CTransaction& tx : block.vtx) {
+        if (!tx.IsCoinBase()) {
+            for (const CTxIn& txin : tx.vin) {
+                auto it = mapTouched.find(txin.prevout.hash);
+                if (it == mapTouched.end()) {
+                    const CCoins* coins = view.AccessCoins(txin.prevout.hash);
+                    if (!coins)
+                        continue;
+                    it = mapTouched.insert(std::make_pair(txin.prevout.hash, std::make_pair(!coins->IsPruned(), *coins))).first;
+                }
+                CCoins& coins = it->second.second;
+                if (!coins.IsAvailable(txin.prevout.n))
+                    continue;
+                const CTxOut& out = coins.vout[txin.prevout.n];
+                ApplyCoinHash(removed, txin.prevout.hash, txin.prevout.n, coins.nHeight, coins.fCoinBase, out);
+                nTxOutDelta--;
+                nAmountDelta -= out.nValue;
+                coins.Spend(txin.prevout.n);
+            }
+        }
+
+        // Unspendable outputs are never added to the UTXO set.
+        CCoins coins(tx, nBlockHeight);
+        for (unsigned int i = 0; i < coins.vout.size(); i++) {
+            const CTxOut& out = coins.vout[i];
+            if (out.IsNull())
+                continue;
+            ApplyCoinHash(added, tx.GetHash(), i, nBlockHeight, coins.fCoinBase, out);
+            nTxOutDelta++;
+            nAmountDelta += out.nValue;
+        }
+        mapTouched[tx.GetHash()] = std::make_pair(false, coins);
+    }
+
+    for (const auto& entry : mapTouched) {
+        nTxDelta += (entry.second.second.IsPruned() ? 0 : 1) - (entry.second.first ? 1 : 0);
+    }
+
+    if (fDisconnect) {
+        muhash *= removed;
+        muhash /= added;
+        nTransactions -= nTxDelta;
+        nTransactionOutputs -= nTxOutDelta;
+        nTotalAmount -= nAmountDelta;
+        hashBlock = block.hashPrevBlock;
+        nHeight = nBlockHeight - 1;
+    } else {
+        muhash *= added;
+        muhash /= removed;
+        nTransactions += nTxDelta;
+        nTransactionOutputs += nTxOutDelta;
+        nTotalAmount += nAmountDelta;
+        hashBlock = block.GetHash();
+        nHeight = nBlockHeight;
+    }
+}
+
+uint256 CCoinsStats::GetMuHash() const
+{
+    MuHash3072 tmp = muhash;
+    uint256 hash;
+    tmp.Finalize(hash.begin());
+    return hash;
+}
@@ -8,6 +8,7 @@
 
 #include "compressor.h"
 #include "core_memusage.h"
+#include "crypto/muhash.h"
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
@@ -325,6 +326,12 @@ typedef boost::unordered_map<uint256, CAnchorsSaplingCacheEntry, SaltedTxidHashe
 typedef boost::unordered_map<uint256, CNullifiersCacheEntry, SaltedTxidHasher> CNullifiersMap;
 typedef boost::unordered_map<uint32_t, HistoryCache> CHistoryCacheMap;
 
+class CBlock;
+class CCoinsViewCache;
+
+/** Add an unspent output to a UTXO set hash. */
+void ApplyCoinHash(MuHash3072& muhash, const uint256& txid, uint32_t n, int nHeight, bool fCoinBase, const CTxOut& out);
+
 struct CCoinsStats
 {
     int nHeight;
@@ -334,8 +341,38 @@ struct CCoinsStats
     uint64_t nSerializedSize;
     uint256 hashSerialized;
     CAmount nTotalAmount;
+    MuHash3072 muhash;
 
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
+
+    /**
+     * Update nHeight, hashBlock, nTransactions, nTransactionOutputs,
+     * nTotalAmount and muhash for connecting block at height nBlockHeight,
+     * or for disconnecting it if fDisconnect is set. view must reflect the
+     * UTXO set as it was before the block was connected.
+     * nSerializedSize and hashSerialized are only computed by a full scan.
+     */
+    void ApplyBlock(const CBlock& block, int nBlockHeight, const CCoinsViewCache& view, bool fDisconnect);
+
+    //! Finalized hash of the UTXO set
+    uint256 GetMuHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nHeight);
+        READWRITE(hashBlock);
+        READWRITE(nTransactions);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nTotalAmount);
+        unsigned char muhashBytes[MuHash3072::SERIALIZED_SIZE];
+        if (!ser_action.ForRead())
+            muhash.ToBytes(muhashBytes);
+        READWRITE(FLATDATA(muhashBytes));
+        if (ser_action.ForRead())
+            muhash.FromBytes(muhashBytes);
+    }
 };
 
 
@@ -555,6 +592,13 @@ public:
      */
     bool Flush();
 
+    /**
+     * Forget the cached best block and anchors so that they are read again
+     * from the base view, e.g. after its contents were replaced wholesale.
+     * The cache must not hold unflushed changes.
+     */
+    void Reset();
+
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
@@ -177,6 +177,8 @@ struct Params {
     int validEHparameterList(EHparameters* ehparams, unsigned int blocktime) const;
 
     uint256 nMinimumChainWork;
+    /** Default for -assumevalid: scripts and shielded proofs of its ancestors are not verified */
+    uint256 defaultAssumeValid;
 
     /** Parameters for LWMA3 **/
     int64_t nZawyLWMA3AveragingWindow; // N
@@ -0,0 +1,88 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A 3072-bit number, reduced modulo the prime 2^3072 - 1103717. */
+class Num3072
+{
+public:
+    static constexpr size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static constexpr int LIMBS = 48;
+    static constexpr int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static constexpr int LIMBS = 96;
+    static constexpr int LIMB_SIZE = 32;
+#endif
+    limb_t limbs[LIMBS];
+
+    Num3072() { SetToOne(); }
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    void Divide(const Num3072& a);
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+    Num3072 GetInverse() const;
+};
+
+/**
+ * A hash of a set of byte strings that can be updated incrementally.
+ *
+ * Every element is hashed to a number modulo a 3072-bit prime. The set
+ * hash is the product of the numbers of all elements that are in the set,
+ * so inserting and removing elements in any order gives the same result.
+ * Insertions and removals are tracked as a separate numerator and
+ * denominator so that the (expensive) modular inverse is only computed
+ * once, when the hash is finalized.
+ *
+ * See https://cseweb.ucsd.edu/~mihir/papers/inchash.pdf for the
+ * construction and its security.
+ */
+class MuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+    static Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    static constexpr size_t SERIALIZED_SIZE = 2 * Num3072::BYTE_SIZE;
+
+    /** Hash of the empty set. */
+    MuHash3072() {}
+
+    /** Hash of a set containing a single element. */
+    MuHash3072(const unsigned char* data, size_t len);
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    /** Set union / difference with another set hash. */
+    MuHash3072& operator*=(const MuHash3072& mul);
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    /** Reduce the state to a 32-byte hash. The state is normalized, but still represents the same set. */
+    void Finalize(unsigned char out[32]);
+
+    void ToBytes(unsigned char (&out)[SERIALIZED_SIZE]) const;
+    void FromBytes(const unsigned char (&in)[SERIALIZED_SIZE]);
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-256. */
 class CSHA256
@@ -30,4 +31,20 @@ private:
     void FinalizeNoPadding(unsigned char hash[OUTPUT_SIZE], bool enforce_compression);
 };
 
+/**
+ * Autodetect the best available SHA256 implementation (SHA-NI, and the SSE4.1
+ * and AVX2 multi-way double-SHA256 code) and check it against the generic one.
+ * Must be called before other threads start hashing. Returns a description of
+ * the implementations in use.
+ */
+std::string SHA256AutoDetect();
+
+/**
+ * Compute multiple double-SHA256's of 64-byte blobs.
+ * output:  pointer to a blocks*32 byte output buffer
+ * input:   pointer to a blocks*64 byte input buffer
+ * blocks:  the number of hashes to compute.
+ */
+void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
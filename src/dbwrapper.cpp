@@ -16,13 +16,13 @@
 
 #include <boost/scoped_ptr.hpp>
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(const CDBWrapperOptions& dbOptions)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    options.block_cache = leveldb::NewLRUCache(dbOptions.nBlockCacheSize);
+    options.write_buffer_size = dbOptions.nWriteBufferSize;
+    options.filter_policy = dbOptions.nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(dbOptions.nBloomBits) : NULL;
+    options.compression = dbOptions.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     options.max_open_files = 64;
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -33,13 +33,18 @@ static leveldb::Options GetOptions(size_t nCacheSize)
 }
 
 CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe)
+    : CDBWrapper(path, CDBWrapperOptions(nCacheSize), fMemory, fWipe)
+{
+}
+
+CDBWrapper::CDBWrapper(const boost::filesystem::path& path, const CDBWrapperOptions& dbOptions, bool fMemory, bool fWipe)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(dbOptions);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -84,6 +89,30 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+size_t CDBWrapper::MovePrefixTo(CDBWrapper& dest, char chPrefix)
+{
+    static const size_t MOVE_BATCH_SIZE = 16 << 20;
+
+    size_t nMoved = 0;
+    boost::scoped_ptr<leveldb::Iterator> piter(pdb->NewIterator(iteroptions));
+    piter->Seek(leveldb::Slice(&chPrefix, 1));
+    while (piter->Valid() && piter->key().size() > 0 && piter->key()[0] == chPrefix) {
+        leveldb::WriteBatch copy, erase;
+        size_t nBytes = 0;
+        for (; piter->Valid() && piter->key().size() > 0 && piter->key()[0] == chPrefix && nBytes < MOVE_BATCH_SIZE; piter->Next()) {
+            copy.Put(piter->key(), piter->value());
+            erase.Delete(piter->key());
+            nBytes += piter->key().size() + piter->value().size();
+            nMoved++;
+        }
+        dbwrapper_private::HandleError(piter->status());
+        dbwrapper_private::HandleError(dest.pdb->Write(dest.syncoptions, &copy));
+        dbwrapper_private::HandleError(pdb->Write(syncoptions, &erase));
+    }
+    dbwrapper_private::HandleError(piter->status());
+    return nMoved;
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
@@ -27,6 +27,21 @@ public:
 
 class CDBWrapper;
 
+/** LevelDB tuning for a single CDBWrapper instance. */
+struct CDBWrapperOptions {
+    //! size of the LRU block cache
+    size_t nBlockCacheSize;
+    //! size of a memtable; up to two may be held in memory simultaneously
+    size_t nWriteBufferSize;
+    //! bits per key of the bloom filter, 0 disables the filter
+    int nBloomBits;
+    //! compress blocks with Snappy (only effective if LevelDB was built with Snappy)
+    bool fCompression;
+
+    /** Split a total memory budget the way the chain state and block index databases do. */
+    explicit CDBWrapperOptions(size_t nCacheSize) : nBlockCacheSize(nCacheSize / 2), nWriteBufferSize(nCacheSize / 4), nBloomBits(10), fCompression(false) {}
+};
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private
@@ -69,6 +84,14 @@ public:
         batch.Put(slKey, slValue);
     }
 
+    //! Write a key and value that are already serialized.
+    void WriteRaw(const std::vector<unsigned char>& key, const std::vector<unsigned char>& value)
+    {
+        leveldb::Slice slKey((const char*)key.data(), key.size());
+        leveldb::Slice slValue((const char*)value.data(), value.size());
+        batch.Put(slKey, slValue);
+    }
+
     template <typename K>
     void Erase(const K& key)
     {
@@ -131,6 +154,13 @@ public:
         return piter->key().size();
     }
 
+    //! Serialized key of the current entry.
+    std::vector<unsigned char> GetRawKey()
+    {
+        leveldb::Slice slKey = piter->key();
+        return std::vector<unsigned char>(slKey.data(), slKey.data() + slKey.size());
+    }
+
     template <typename V>
     bool GetValue(V& value)
     {
@@ -148,6 +178,13 @@ public:
     {
         return piter->value().size();
     }
+
+    //! Serialized value of the current entry.
+    std::vector<unsigned char> GetRawValue()
+    {
+        leveldb::Slice slValue = piter->value();
+        return std::vector<unsigned char>(slValue.data(), slValue.data() + slValue.size());
+    }
 };
 
 class CDBWrapper
@@ -182,6 +219,7 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      */
     CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CDBWrapper(const boost::filesystem::path& path, const CDBWrapperOptions& dbOptions, bool fMemory = false, bool fWipe = false);
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -267,6 +305,14 @@ public:
      * Return true if the database managed by this class contains no entries.
      */
     bool IsEmpty();
+
+    /**
+     * Move every entry whose key starts with the byte chPrefix into dest.
+     * Entries are synced to dest before they are erased here, so an
+     * interrupted move is simply completed by calling this again.
+     * Returns the number of entries moved.
+     */
+    size_t MovePrefixTo(CDBWrapper& dest, char chPrefix);
 };
 
 #endif // BITCOIN_DBWRAPPER_H
@@ -1,4 +1,5 @@
 #include "crypto/common.h"
+#include "crypto/sha256.h"
 #include "key.h"
 #include "pubkey.h"
 #include "util.h"
@@ -20,6 +21,7 @@ ZCJoinSplit* params;
 int main(int argc, char** argv)
 {
     assert(sodium_init() != -1);
+    SHA256AutoDetect();
     ECC_Start();
 
     fs::path sapling_spend = ZC_GetParamsDir() / "sapling-spend.params";
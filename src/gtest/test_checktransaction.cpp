@@ -3,6 +3,7 @@
 
 #include "main.h"
 #include "primitives/transaction.h"
+#include "proofcache.h"
 #include "consensus/validation.h"
 #include "transaction_builder.h"
 #include "utiltest.h"
@@ -534,6 +535,33 @@ TEST(ChecktransactionTests, BadTxnsInvalidJoinsplitSignature) {
     ContextualCheckTransaction(tx, state, chainparams, 0, true, [](const Consensus::Params&) { return false; });
 }
 
+TEST(ChecktransactionTests, ProofCacheSkipsShieldedChecks) {
+    SelectParams(CBaseChainParams::REGTEST);
+    auto chainparams = Params();
+    auto consensusBranchId = CurrentEpochBranchId(0, chainparams.GetConsensus());
+
+    CMutableTransaction mtx = GetValidTransaction();
+    mtx.joinSplitSig.bytes[0] += 1;
+    CTransaction tx(mtx);
+
+    // An entry for another branch ID does not match.
+    ProofCacheAdd(tx.GetHash(), consensusBranchId + 1);
+    EXPECT_FALSE(ProofCacheContains(tx.GetHash(), consensusBranchId, false));
+    MockCValidationState state;
+    EXPECT_CALL(state, DoS(100, false, REJECT_INVALID, "bad-txns-invalid-joinsplit-signature", false)).Times(1);
+    EXPECT_FALSE(ContextualCheckTransaction(tx, state, chainparams, 0, true, [](const Consensus::Params&) { return false; }));
+
+    // Once cached, the shielded signatures and proofs are not checked again.
+    ProofCacheAdd(tx.GetHash(), consensusBranchId);
+    EXPECT_TRUE(ProofCacheContains(tx.GetHash(), consensusBranchId, false));
+    MockCValidationState state2;
+    EXPECT_CALL(state2, DoS(testing::_, testing::_, testing::_, testing::_, testing::_)).Times(0);
+    EXPECT_TRUE(ContextualCheckTransaction(tx, state2, chainparams, 0, true, [](const Consensus::Params&) { return false; }));
+
+    // Erasing lookups still report the entry until it is overwritten.
+    EXPECT_TRUE(ProofCacheContains(tx.GetHash(), consensusBranchId, true));
+}
+
 TEST(ChecktransactionTests, JoinsplitSignatureDetectsOldBranchId) {
     SelectParams(CBaseChainParams::REGTEST);
     UpdateNetworkUpgradeParameters(Consensus::UPGRADE_OVERWINTER, 1);
@@ -149,6 +149,51 @@ TEST(TransactionBuilder, SaplingToSapling) {
     RegtestDeactivateSapling();
 }
 
+// Several spends and outputs are proven concurrently, each with a value
+// commitment randomness picked up front for the binding signature.
+TEST(TransactionBuilder, SeveralSaplingSpendsAndOutputs) {
+    auto consensusParams = RegtestActivateSapling();
+
+    auto sk = libzcash::SaplingSpendingKey::random();
+    auto expsk = sk.expanded_spending_key();
+    auto fvk = sk.full_viewing_key();
+    auto pa = sk.default_address();
+
+    // Put all the notes in one tree, as spends must share an anchor
+    const size_t nSpends = 4;
+    SaplingMerkleTree tree;
+    std::vector<libzcash::SaplingNote> notes;
+    std::vector<SaplingWitness> witnesses;
+    for (size_t i = 0; i < nSpends; i++) {
+        libzcash::SaplingNote note(pa, 10000 * (i + 1), libzcash::Zip212Enabled::BeforeZip212);
+        uint256 cm = note.cmu().value();
+        for (SaplingWitness& witness : witnesses)
+            witness.append(cm);
+        tree.append(cm);
+        witnesses.push_back(tree.witness());
+        notes.push_back(note);
+    }
+
+    // 0.001 z-ZEC in, 0.0006 z-ZEC out, default fee, 0.0003 z-ZEC change
+    auto builder = TransactionBuilder(consensusParams, 2);
+    for (size_t i = 0; i < nSpends; i++)
+        builder.AddSaplingSpend(expsk, notes[i], tree.root(), witnesses[i]);
+    for (size_t i = 0; i < 3; i++)
+        builder.AddSaplingOutput(fvk.ovk, pa, 20000, {});
+    auto tx = builder.Build().GetTxOrThrow();
+
+    EXPECT_EQ(tx.vShieldedSpend.size(), nSpends);
+    EXPECT_EQ(tx.vShieldedOutput.size(), 4);
+    EXPECT_EQ(tx.valueBalance, 10000);
+
+    CValidationState state;
+    EXPECT_TRUE(ContextualCheckTransaction(tx, state, Params(), 3, true));
+    EXPECT_EQ(state.GetRejectReason(), "");
+
+    // Revert to default
+    RegtestDeactivateSapling();
+}
+
 TEST(TransactionBuilder, SaplingToSprout) {
     auto consensusParams = RegtestActivateSapling();
 
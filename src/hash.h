@@ -167,6 +167,31 @@ public:
     }
 };
 
+/** Passes written data on to another stream while computing its 256-bit hash. */
+template <typename Target>
+class CHashedTargetWriter : public CHashWriter
+{
+private:
+    Target* target;
+
+public:
+    explicit CHashedTargetWriter(Target* targetIn) : CHashWriter(targetIn->GetType(), targetIn->GetVersion()), target(targetIn) {}
+
+    void write(const char* pch, size_t size)
+    {
+        target->write(pch, size);
+        CHashWriter::write(pch, size);
+    }
+
+    template <typename T>
+    CHashedTargetWriter<Target>& operator<<(const T& obj)
+    {
+        // Serialize to this stream
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+};
+
 
 /** A writer stream (for serialization) that computes a 256-bit BLAKE2b hash. */
 class CBLAKE2bWriter
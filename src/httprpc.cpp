@@ -4,6 +4,7 @@
 #include "httpserver.h"
 #include "key_io.h"
 #include "random.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "sync.h"
@@ -88,6 +89,53 @@ static bool RPCAuthorized(const std::string& strAuth)
     return TimingResistantEqual(strUserPass, strRPCUserColonPass);
 }
 
+/** Execute a singleton request through the streamed form of its method, if it
+ * has one. The reply stays a plain one while it fits in a single chunk and
+ * switches to chunked transfer encoding once the writer first flushes.
+ * Returns false, without replying, if the method is not streamable.
+ */
+static bool JSONRPCExecStreamed(HTTPRequest* req, const JSONRequest& jreq)
+{
+    bool fReplyStarted = false;
+    JSONStreamWriter writer([req, &fReplyStarted](const std::string& strChunk) {
+        if (!fReplyStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartReply(HTTP_OK);
+            fReplyStarted = true;
+        }
+        req->WriteReplyChunk(strChunk);
+    });
+    try {
+        writer.BeginObject();
+        writer.Key("result");
+        if (!tableRPC.executeStreamed(jreq.strMethod, jreq.params, writer))
+            return false;
+        writer.KeyValue("error", NullUniValue);
+        writer.KeyValue("id", jreq.id);
+        writer.EndObject();
+        if (writer.Started())
+            req->WriteReplyChunk(writer.ReleaseBuffer() + "\n");
+    } catch (...) {
+        // Errors raised before anything was sent get a regular error reply
+        if (!writer.Started())
+            throw;
+        // The status line is out already, so all that is left is cutting the
+        // body short: the client sees invalid JSON rather than a partial result.
+        // This is also how a client that stops reading is let go.
+        LogPrintf("%s: %s failed while streaming its reply, reply truncated\n", __func__, jreq.strMethod);
+        req->EndReply();
+        return true;
+    }
+
+    if (!writer.Started()) {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, writer.ReleaseBuffer() + "\n");
+    } else {
+        req->EndReply();
+    }
+    return true;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string&)
 {
     // JSONRPC handles only POST
@@ -128,6 +176,9 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string&)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            if (JSONRPCExecStreamed(req, jreq))
+                return true;
+
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
             // Send reply
@@ -135,7 +186,7 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string&)
 
             // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
+            strReply = JSONRPCExecBatch(valRequest.get_array(), QueueHTTPWork, HTTPWorkerThreads());
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
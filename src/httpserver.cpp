@@ -57,6 +57,22 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item queued by a request handler with QueueHTTPWork */
+class HTTPFunctionWorkItem : public HTTPClosure
+{
+public:
+    HTTPFunctionWorkItem(const std::function<void()>& func) : func(func)
+    {
+    }
+    void operator()()
+    {
+        func();
+    }
+
+private:
+    std::function<void()> func;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -180,6 +196,8 @@ struct evhttp* eventHTTP = 0;
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
 static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Seconds a chunked reply waits for the client to read before it is abandoned
+static int64_t nReplyTimeout = DEFAULT_HTTP_SERVER_TIMEOUT;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -414,7 +432,8 @@ bool InitHTTPServer()
         return false;
     }
 
-    evhttp_set_timeout(http, GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT));
+    nReplyTimeout = GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT);
+    evhttp_set_timeout(http, nReplyTimeout);
     evhttp_set_max_body_size(http, MAX_SIZE);
     evhttp_set_gencb(http, http_request_cb, NULL);
 
@@ -440,7 +459,7 @@ boost::thread threadHTTP;
 bool StartHTTPServer()
 {
     LogPrint("http", "Starting HTTP server\n");
-    int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+    int rpcThreads = HTTPWorkerThreads();
     LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
     threadHTTP = boost::thread(boost::bind(&ThreadHTTP, eventBase, eventHTTP));
 
@@ -506,6 +525,22 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+bool QueueHTTPWork(const std::function<void()>& func)
+{
+    if (!workQueue)
+        return false;
+    std::unique_ptr<HTTPFunctionWorkItem> item(new HTTPFunctionWorkItem(func));
+    if (!workQueue->Enqueue(item.get()))
+        return false;
+    item.release(); /* queue took ownership */
+    return true;
+}
+
+int HTTPWorkerThreads()
+{
+    return std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -532,12 +567,16 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (replyStarted && !replySent) {
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -602,6 +641,113 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/** Flow control of a chunked reply. The worker thread counts the bytes it
+ * queues, the event loop the bytes it hands to the connection and, once the
+ * connection's output buffer has drained, the bytes sent.
+ */
+struct HTTPReplyFlow {
+    CWaitableCriticalSection cs;
+    CConditionVariable cond;
+    size_t nQueued;
+    size_t nSent;
+    bool fClosed;
+    //! Only touched by the event loop
+    size_t nHandedOver;
+
+    HTTPReplyFlow() : nQueued(0), nSent(0), fClosed(false), nHandedOver(0) {}
+
+    void Sent(size_t nTotal, bool fClosedIn)
+    {
+        boost::lock_guard<boost::mutex> lock(cs);
+        nSent = nTotal;
+        fClosed = fClosed || fClosedIn;
+        cond.notify_all();
+    }
+};
+
+static void HTTPReplyChunkSent(struct evhttp_connection*, void* arg)
+{
+    HTTPReplyFlow* flow = static_cast<HTTPReplyFlow*>(arg);
+    flow->Sent(flow->nHandedOver, false);
+}
+
+static void HTTPSendReplyChunk(struct evhttp_request* req, struct evbuffer* evb, std::shared_ptr<HTTPReplyFlow> flow)
+{
+    if (evhttp_request_get_connection(req) == NULL) {
+        // The client went away, nothing will be sent any more
+        flow->Sent(flow->nHandedOver, true);
+    } else {
+        flow->nHandedOver += evbuffer_get_length(evb);
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        // The callback replaces that of the previous chunk and runs once the
+        // connection's output buffer is empty, so everything handed over is sent
+        evhttp_send_reply_chunk_with_cb(req, evb, HTTPReplyChunkSent, flow.get());
+#else
+        evhttp_send_reply_chunk(req, evb);
+        flow->Sent(flow->nHandedOver, false);
+#endif
+    }
+    evbuffer_free(evb);
+}
+
+static void HTTPSendReplyEnd(struct evhttp_request* req, std::shared_ptr<HTTPReplyFlow> flow)
+{
+    // Replaces the callback of the last chunk, after which flow can go
+    evhttp_send_reply_end(req);
+}
+
+/** Chunked replies go through the same event mechanism as WriteReply. The
+ * events of one request are activated in order from a single worker thread,
+ * and libevent runs active events in activation order, so chunks cannot be
+ * reordered.
+ */
+void HTTPRequest::StartReply(int nStatus)
+{
+    assert(!replySent && !replyStarted && req);
+    replyFlow = std::make_shared<HTTPReplyFlow>();
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+                                  boost::bind(evhttp_send_reply_start, req, nStatus, (const char*)NULL));
+    ev->trigger(0);
+    replyStarted = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(replyStarted && !replySent && req);
+    AssertNoLocksHeld();
+    if (strChunk.empty())
+        return;
+
+    {
+        // Wait for the client to read, unless nothing is queued at all
+        boost::unique_lock<boost::mutex> lock(replyFlow->cs);
+        boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(nReplyTimeout);
+        while (!replyFlow->fClosed && replyFlow->nQueued > replyFlow->nSent &&
+               replyFlow->nQueued - replyFlow->nSent + strChunk.size() > HTTP_REPLY_MAX_PENDING) {
+            if (!replyFlow->cond.timed_wait(lock, deadline))
+                throw std::runtime_error("HTTP client stopped reading the reply");
+        }
+        if (replyFlow->fClosed)
+            throw std::runtime_error("HTTP client disconnected");
+        replyFlow->nQueued += strChunk.size();
+    }
+
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(HTTPSendReplyChunk, req, evb, replyFlow));
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndReply()
+{
+    assert(replyStarted && !replySent && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(HTTPSendReplyEnd, req, replyFlow));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -8,17 +8,22 @@
 #include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
+#include <functional>
+#include <memory>
 #include <stdint.h>
 #include <string>
 
 static const int DEFAULT_HTTP_THREADS = 4;
 static const int DEFAULT_HTTP_WORKQUEUE = 16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT = 30;
+//! Most bytes of a chunked reply queued for a client before WriteReplyChunk waits for them to be sent
+static const size_t HTTP_REPLY_MAX_PENDING = 256 * 1024;
 
 struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPReplyFlow;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -49,6 +54,13 @@ void UnregisterHTTPHandler(const std::string& prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+/** Run func on one of the HTTP worker threads, to let a request handler
+ * spread its work. Returns false if the work queue is full.
+ */
+bool QueueHTTPWork(const std::function<void()>& func);
+/** Number of HTTP worker threads */
+int HTTPWorkerThreads();
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -56,10 +68,13 @@ class HTTPRequest
 {
 private:
     struct evhttp_request* req;
+    //! Bytes of a chunked reply queued and sent, shared with the event loop
+    std::shared_ptr<HTTPReplyFlow> replyFlow;
 
     // For test access
 protected:
     bool replySent;
+    bool replyStarted;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -115,6 +130,29 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     virtual void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for bodies that are produced while they are
+     * being sent. Send the body with WriteReplyChunk and finish with EndReply.
+     *
+     * @note Call instead of WriteReply, after any WriteHeader calls.
+     */
+    virtual void StartReply(int nStatus);
+    /**
+     * Queue strChunk as the next part of a reply started with StartReply.
+     *
+     * @note Waits while more than HTTP_REPLY_MAX_PENDING bytes are queued for
+     * the client, and throws std::runtime_error if the client does not read
+     * them within -rpcservertimeout seconds or has disconnected. Must not be
+     * called with any lock held, as that would stall the lock's other users.
+     */
+    virtual void WriteReplyChunk(const std::string& strChunk);
+    /**
+     * Finish a reply started with StartReply.
+     *
+     * @note Like WriteReply, this gives the request back to the main thread.
+     */
+    virtual void EndReply();
 };
 
 /** Event handler closure.
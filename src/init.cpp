@@ -15,6 +15,7 @@
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
 #include "crypto/common.h"
+#include "crypto/sha256.h"
 #include "experimental_features.h"
 #include "httprpc.h"
 #include "httpserver.h"
@@ -26,19 +27,24 @@
 #include "main.h"
 #include "masternode-budget.h"
 #include "masternode-payments.h"
+#include "masternode-seendb.h"
 #include "masternodeconfig.h"
 #include "masternodeman.h"
 #include "messagesigner.h"
 #include "metrics.h"
 #include "miner.h"
 #include "net.h"
+#include "proofcache.h"
 #include "rpc/register.h"
 #include "rpc/server.h"
 #include "scheduler.h"
+#include "snapshot.h"
+#include "script/sigcache.h"
 #include "script/standard.h"
 #include "spork.h"
 #include "sporkdb.h"
 #include "torcontrol.h"
+#include "txcache.h"
 #include "txdb.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -172,7 +178,6 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB* pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher* pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -248,6 +253,8 @@ void Shutdown()
         pblocktree = NULL;
         delete pSporkDB;
         pSporkDB = NULL;
+        delete pMasternodeSeenDB;
+        pMasternodeSeenDB = NULL;
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -354,6 +361,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script and shielded proof verification (0 to verify all, default: %s, testnet: %s)"),
+        Params(CBaseChainParams::MAIN).GetConsensus().defaultAssumeValid.GetHex(), Params(CBaseChainParams::TESTNET).GetConsensus().defaultAssumeValid.GetHex()));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the chain state cache to disk on a background thread instead of blocking validation (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 288));
     strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3));
@@ -367,6 +377,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-exportdir=<dir>", _("Specify directory to be used when exporting data"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-loadsnapshot=<file>,<hash>", _("Load the UTXO snapshot <file> written by dumptxoutset, whose snapshot_hash must be <hash>, once the block headers reach its block; no blocks are downloaded before. Only for a node that has not connected any block after genesis"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-mempooltxinputlimit=<n>", _("[DEPRECATED FROM OVERWINTER] Set the maximum number of transparent inputs in a transaction that the mempool will accept (default: 0 = no limit applied)"));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
@@ -387,6 +398,12 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-indexcompression", strprintf(_("Compress the index databases in indexes/ with Snappy, if LevelDB was built with Snappy support (default: %u)"), DEFAULT_DB_COMPRESSION));
+    strUsage += HelpMessageOpt("-addressindexcache=<n>", _("Set the address index database cache size in megabytes (default: a share of -dbcache)"));
+    strUsage += HelpMessageOpt("-spentindexcache=<n>", _("Set the spent index database cache size in megabytes (default: a share of -dbcache)"));
+    strUsage += HelpMessageOpt("-timestampindexcache=<n>", _("Set the timestamp index database cache size in megabytes (default: a share of -dbcache)"));
+    strUsage += HelpMessageOpt("-txindexcache=<n>", _("Set the transaction index database cache size in megabytes (default: a share of -dbcache)"));
+    strUsage += HelpMessageOpt("-txlookupcache=<n>", strprintf(_("Keep up to <n> megabytes of transactions read from disk by getrawtransaction and other lookups in memory (0 to disable, default: %u)"), DEFAULT_TX_LOOKUP_CACHE));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -503,7 +520,9 @@ std::string HelpMessage(HelpMessageMode mode)
     if (showDebug) {
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", 15));
         strUsage += HelpMessageOpt("-relaypriority", strprintf("Require high priority for relaying free or low-fee transactions (default: %u)", 0));
-        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> entries (default: %u)", 50000));
+        strUsage += HelpMessageOpt("-maxsigcachemb=<n>", strprintf("Limit size of signature cache to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", "Deprecated: limit signature cache to <n> entries, used only if -maxsigcachemb is not set");
+        strUsage += HelpMessageOpt("-maxproofcachesize=<n>", strprintf("Limit size of the cache of verified shielded transactions to <n> MiB (default: %u)", DEFAULT_MAX_PROOF_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying (default: %s)"),
@@ -1044,6 +1063,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", true);
 
+    hashAssumeValid = uint256S(GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
+
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (nScriptCheckThreads <= 0)
@@ -1215,6 +1236,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         return false;
     }
 
+    // Select the fastest SHA256 implementation before any other thread hashes
+    std::string sha256_algo = SHA256AutoDetect();
+
     // Initialize elliptic curve code
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1256,14 +1280,23 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 #ifdef ENABLE_WALLET
     LogPrintf("Using BerkeleyDB version %s\n", DbEnv::version(0, 0, 0));
 #endif
+    LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
     if (!fLogTimestamps)
         LogPrintf("Startup time: %s\n", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()));
     LogPrintf("Default data directory %s\n", GetDefaultDataDir().string());
     LogPrintf("Using data directory %s\n", strDataDir);
     LogPrintf("Using config file %s\n", GetConfigFile(GetArg("-conf", BITCOIN_CONF_FILENAME)).string());
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
+    if (!hashAssumeValid.IsNull())
+        LogPrintf("Assuming ancestors of block %s have valid signatures and proofs.\n", hashAssumeValid.GetHex());
+    else
+        LogPrintf("Validating signatures and proofs for all blocks.\n");
     std::ostringstream strErrors;
 
+    InitSignatureCache();
+    InitProofCache();
+    txLookupCache.SetMaxUsage(std::min(std::max((int64_t)0, GetArg("-txlookupcache", DEFAULT_TX_LOOKUP_CACHE)), MAX_TX_LOOKUP_CACHE) << 20);
+
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++)
@@ -1534,24 +1567,48 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nTotalCache = (GetArg("-dbcache", nDefaultDbCache) << 20);
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greated than nMaxDbcache
-    int64_t nBlockTreeDBCache = nTotalCache / 8;
-    if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", false))
-        nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
-
-    if (GetBoolArg("-insightexplorer", false)) {
-        if (!GetBoolArg("-txindex", false)) {
-            return InitError(_("-insightexplorer requires -txindex."));
-        }
-        // increase cache if additional indices are needed
-        nBlockTreeDBCache = nTotalCache * 3 / 4;
-    }
-
-    nTotalCache -= nBlockTreeDBCache;
+    int64_t nBlockTreeDBCache = std::min(nTotalCache / 8, nMaxBlockTreeDBCache << 20); // the indexes below have their own databases
+
+    bool fInsightExplorerCache = GetBoolArg("-insightexplorer", false);
+    if (fInsightExplorerCache && !GetBoolArg("-txindex", false)) {
+        return InitError(_("-insightexplorer requires -txindex."));
+    }
+
+    // Each optional index gets its own database and cache budget, so that
+    // index writes and compactions do not evict the block index.
+    auto GetIndexCache = [nTotalCache](const std::string& strArg, int64_t nDefault) -> size_t {
+        // a quarter of -dbcache at most, unless the default share is larger
+        int64_t nCache = GetArg(strArg, nDefault >> 20) << 20;
+        return std::max(std::min(nCache, std::max(nDefault, nTotalCache / 4)), (int64_t)1 << 18);
+    };
+    CBlockTreeIndexOptions indexOptions;
+    indexOptions.fCompression = GetBoolArg("-indexcompression", DEFAULT_DB_COMPRESSION);
+    if (GetBoolArg("-txindex", false))
+        indexOptions.nTxIndexCache = GetIndexCache("-txindexcache", nTotalCache / 8);
+    // the address index is always maintained for masternode collateral checks
+    indexOptions.nAddressIndexCache = GetIndexCache("-addressindexcache", fInsightExplorerCache ? nTotalCache * 5 / 16 : nTotalCache / 16);
+    if (fInsightExplorerCache) {
+        indexOptions.nSpentIndexCache = GetIndexCache("-spentindexcache", nTotalCache * 3 / 16);
+        indexOptions.nTimestampIndexCache = GetIndexCache("-timestampindexcache", nTotalCache / 16);
+    }
+    int64_t nIndexCache = indexOptions.nTxIndexCache + indexOptions.nAddressIndexCache + indexOptions.nSpentIndexCache + indexOptions.nTimestampIndexCache;
+    if (nBlockTreeDBCache + nIndexCache > nTotalCache * 7 / 8) {
+        return InitError(_("The index database cache sizes leave too little of -dbcache for the chain state."));
+    }
+
+    nTotalCache -= nBlockTreeDBCache + nIndexCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache;                                                   // the rest goes to in-memory cache
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (indexOptions.nTxIndexCache)
+        LogPrintf("* Using %.1fMiB for transaction index database\n", indexOptions.nTxIndexCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for address index database\n", indexOptions.nAddressIndexCache * (1.0 / 1024 / 1024));
+    if (indexOptions.nSpentIndexCache)
+        LogPrintf("* Using %.1fMiB for spent index database\n", indexOptions.nSpentIndexCache * (1.0 / 1024 / 1024));
+    if (indexOptions.nTimestampIndexCache)
+        LogPrintf("* Using %.1fMiB for timestamp index database\n", indexOptions.nTimestampIndexCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
 
@@ -1575,8 +1632,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 delete pSporkDB;
 
                 pSporkDB = new CSporkDB(0, false, false);
-                pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
+                pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex, indexOptions);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex);
+                pcoinsdbview->SetBackgroundFlush(GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH));
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
 
@@ -1776,6 +1834,15 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    // likewise if the chain state was loaded from a UTXO snapshot
+    {
+        LOCK(cs_main);
+        if (HaveUTXOSnapshot()) {
+            LogPrintf("Unsetting NODE_NETWORK, blocks below the UTXO snapshot are not stored\n");
+            nLocalServices &= ~NODE_NETWORK;
+        }
+    }
+
     // ********************************************************* Step 10: import blocks
 
     if (mapArgs.count("-blocknotify"))
@@ -1790,6 +1857,28 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (!ActivateBestChain(state, chainparams))
         strErrors << "Failed to connect best block";
 
+    // -loadsnapshot= holds off block download until the snapshot is loaded
+    if (mapArgs.count("-loadsnapshot")) {
+        std::string strSnapshot = GetArg("-loadsnapshot", "");
+        size_t nSep = strSnapshot.rfind(',');
+        if (nSep == std::string::npos || strSnapshot.size() - nSep - 1 != 64 || !IsHex(strSnapshot.substr(nSep + 1)))
+            return InitError(strprintf(_("Invalid -loadsnapshot=<file>,<hash>: '%s'"), strSnapshot));
+        boost::filesystem::path pathSnapshot = boost::filesystem::absolute(strSnapshot.substr(0, nSep), GetDataDir());
+        uint256 hashSnapshot = uint256S(strSnapshot.substr(nSep + 1));
+
+        LOCK(cs_main);
+        if (HaveUTXOSnapshot()) {
+            LogPrintf("The chain state was loaded from a UTXO snapshot already, ignoring -loadsnapshot\n");
+        } else if (fReindex || mapArgs.count("-loadblock") || chainActive.Height() > 0) {
+            return InitError(_("-loadsnapshot can only be used on a node that has not connected any block after genesis, and not with -reindex or -loadblock"));
+        } else if (fTxIndex || fSpentIndex || fTimestampIndex) {
+            return InitError(_("The transaction, spent and timestamp indexes cannot be built from a UTXO snapshot"));
+        } else {
+            fAwaitingSnapshot = true;
+            threadGroup.create_thread(boost::bind(&ThreadLoadUTXOSnapshot, pathSnapshot, hashSnapshot));
+        }
+    }
+
     std::vector<boost::filesystem::path> vImportFiles;
     if (mapArgs.count("-loadblock")) {
         for (const std::string& strFile : mapMultiArgs["-loadblock"])
@@ -1807,6 +1896,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     uiInterface.InitMessage(_("Loading masternode cache..."));
 
+    // Loaded first, so the masternode list is cleaned up along with them
+    pMasternodeSeenDB = new CMasternodeSeenDB(0, false, false);
+    bool fSeenLoaded = mnodeman.LoadSeen(*pMasternodeSeenDB);
+    if (!fSeenLoaded)
+        LogPrintf("Error reading the seen masternode messages, starting without them\n");
+
     CMasternodeDB mndb;
     CMasternodeDB::ReadResult readResult = mndb.Read(mnodeman);
     if (readResult == CMasternodeDB::FileError)
@@ -1819,6 +1914,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             LogPrintf("file format is unknown or invalid, please fix it manually\n");
     }
 
+    // The seen broadcasts and pings only go with the masternode list they were stored with.
+    // Clearing them also drops them from the database on the next write.
+    if (!fSeenLoaded || readResult != CMasternodeDB::Ok) {
+        mnodeman.mapSeenMasternodeBroadcast.clear();
+        mnodeman.mapSeenMasternodePing.clear();
+    }
+
     uiInterface.InitMessage(_("Loading budget cache..."));
 
     CBudgetDB budgetdb;
@@ -1838,6 +1940,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             LogPrintf("file format is unknown or invalid, please fix it manually\n");
     }
 
+    // The votes are loaded after the proposals and budgets they belong to
+    if (!budget.LoadVotes(*pMasternodeSeenDB))
+        LogPrintf("Error reading the budget votes, starting without them\n");
+
     // flag our cached items so we send them to our peers
     budget.ResetSync();
     budget.ClearSeen();
@@ -1845,6 +1951,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     uiInterface.InitMessage(_("Loading masternode payment cache..."));
 
+    // Loaded first, so they are cleared along with mnpayments.dat if it cannot be read
+    if (!masternodePayments.LoadWinners(*pMasternodeSeenDB))
+        LogPrintf("Error reading the masternode winners, starting without them\n");
+
     CMasternodePaymentDB mnpayments;
     CMasternodePaymentDB::ReadResult readResult3 = mnpayments.Read(masternodePayments);
 
@@ -12,11 +12,13 @@
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockencodings.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
 #include "consensus/upgrades.h"
 #include "consensus/validation.h"
+#include "core_memusage.h"
 #include "deprecation.h"
 #include "experimental_features.h"
 #include "init.h"
@@ -30,11 +32,14 @@
 #include "metrics.h"
 #include "net.h"
 #include "pow.h"
+#include "proofcache.h"
 #include "reverse_iterator.h"
+#include "snapshot.h"
 #include "spork.h"
 #include "sporkdb.h"
 #include "swifttx.h"
 #include "txdb.h"
+#include "txcache.h"
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "undo.h"
@@ -47,7 +52,12 @@
 
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <tuple>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -82,6 +92,8 @@ int nScriptCheckThreads = 0;
 bool fExperimentalMode = false;
 bool fImporting = false;
 bool fReindex = false;
+bool fLoadingSnapshot = false;
+bool fAwaitingSnapshot = false;
 bool fTxIndex = false;
 bool fAddressIndex = true; // enable address index by default to support mn collateral check faster
 bool fTimestampIndex = false;
@@ -91,6 +103,7 @@ bool fPruneMode = false;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = true;
+uint256 hashAssumeValid;
 bool fCoinbaseEnforcedProtectionEnabled = true;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
@@ -105,6 +118,7 @@ unsigned int expiryDelta = DEFAULT_TX_EXPIRY_DELTA;
 CFeeRate minRelayTxFee = CFeeRate(DEFAULT_MIN_RELAY_TX_FEE);
 
 CTxMemPool mempool(::minRelayTxFee);
+CTxLookupCache txLookupCache(DEFAULT_TX_LOOKUP_CACHE << 20);
 
 struct COrphanTx {
     CTransaction tx;
@@ -273,12 +287,20 @@ struct QueuedBlock {
     int64_t nTime;           //! Time of "getdata" request in microseconds.
     bool fValidatedHeaders;  //! Whether this block has validated headers at the time of request.
     int64_t nTimeDisconnect; //! The timeout for this block request (for disconnecting a slow peer)
+    std::shared_ptr<PartiallyDownloadedBlock> partialBlock; //! Optional, set while reconstructing a compact block.
+    bool fRedundantRequested; //! Whether it was also requested from a faster peer.
 };
 map<uint256, pair<NodeId, list<QueuedBlock>::iterator>> mapBlocksInFlight;
 
 /** Number of blocks in flight with validated headers. */
 int nQueuedValidatedHeaders = 0;
 
+/** Compact block protocol version we support (BIP 152, version 1) */
+static const uint64_t CMPCTBLOCKS_VERSION = 1;
+
+/** Peers we asked to announce new blocks with cmpctblock. Requires cs_main. */
+std::list<NodeId> lNodesAnnouncingHeaderAndIDs;
+
 /** Number of preferable block download peers. */
 int nPreferredDownload = 0;
 
@@ -337,6 +359,14 @@ struct CNodeState {
     int nBlocksInFlightValidHeaders;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! Moving average of the time this peer takes to deliver a requested block (in microseconds), or 0.
+    int64_t nAvgBlockDeliveryTime;
+    //! When this peer last delivered a requested block (in microseconds), or 0.
+    int64_t nLastBlockDelivery;
+    //! Whether this peer wants new blocks announced with cmpctblock instead of inv.
+    bool fPreferHeaderAndIDs;
+    //! Whether this peer can send us compact blocks.
+    bool fProvidesHeaderAndIDs;
 
     CNodeState()
     {
@@ -351,6 +381,10 @@ struct CNodeState {
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
         fPreferredDownload = false;
+        nAvgBlockDeliveryTime = 0;
+        nLastBlockDelivery = 0;
+        fPreferHeaderAndIDs = false;
+        fProvidesHeaderAndIDs = false;
     }
 };
 
@@ -412,17 +446,43 @@ void FinalizeNode(NodeId nodeid)
         mapBlocksInFlight.erase(entry.hash);
     EraseOrphansFor(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
+    lNodesAnnouncingHeaderAndIDs.remove(nodeid);
 
     mapNodeState.erase(nodeid);
 }
 
+// Whether nodeid is among the count peers that deliver blocks fastest.
 // Requires cs_main.
-// Returns a bool indicating whether we requested this block.
-bool MarkBlockAsReceived(const uint256& hash)
+bool IsFastBlockDownloadPeer(NodeId nodeid, unsigned int count)
+{
+    const CNodeState* state = State(nodeid);
+    if (state == NULL || state->nAvgBlockDeliveryTime == 0)
+        return false;
+    unsigned int nFaster = 0;
+    for (const auto& entry : mapNodeState) {
+        if (entry.first != nodeid && entry.second.nAvgBlockDeliveryTime != 0 &&
+            entry.second.nAvgBlockDeliveryTime < state->nAvgBlockDeliveryTime && ++nFaster >= count)
+            return false;
+    }
+    return true;
+}
+
+// Requires cs_main.
+// Returns a bool indicating whether we requested this block. If nodeFrom is
+// the peer we requested it from, its delivery time is measured.
+bool MarkBlockAsReceived(const uint256& hash, NodeId nodeFrom = -1)
 {
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator>>::iterator itInFlight = mapBlocksInFlight.find(hash);
     if (itInFlight != mapBlocksInFlight.end()) {
         CNodeState* state = State(itInFlight->second.first);
+        if (itInFlight->second.first == nodeFrom) {
+            // With several blocks in flight, the time since the previous
+            // delivery rather than since the request reflects the rate.
+            int64_t nNow = GetTimeMicros();
+            state->nAvgBlockDeliveryTime = UpdateBlockDeliveryTime(state->nAvgBlockDeliveryTime,
+                                                                   nNow - std::max(itInFlight->second.second->nTime, state->nLastBlockDelivery));
+            state->nLastBlockDelivery = nNow;
+        }
         nQueuedValidatedHeaders -= itInFlight->second.second->fValidatedHeaders;
         state->nBlocksInFlightValidHeaders -= itInFlight->second.second->fValidatedHeaders;
         state->vBlocksInFlight.erase(itInFlight->second.second);
@@ -435,21 +495,73 @@ bool MarkBlockAsReceived(const uint256& hash)
 }
 
 // Requires cs_main.
-void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Params& consensusParams, CBlockIndex* pindex = NULL)
+// Returns false if the block was already in flight from this peer. If pit is
+// given, the entry gets a PartiallyDownloadedBlock and *pit is set to it.
+bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Params& consensusParams, CBlockIndex* pindex = NULL, list<QueuedBlock>::iterator** pit = NULL)
 {
     CNodeState* state = State(nodeid);
     assert(state != NULL);
 
+    // Short-circuit most stuff in case it is from the same node
+    map<uint256, pair<NodeId, list<QueuedBlock>::iterator>>::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == nodeid) {
+        if (pit)
+            *pit = &itInFlight->second.second;
+        return false;
+    }
+
     // Make sure it's not listed somewhere already.
     MarkBlockAsReceived(hash);
 
     int64_t nNow = GetTimeMicros();
-    QueuedBlock newentry = {hash, pindex, nNow, pindex != NULL, GetBlockTimeout(nNow, nQueuedValidatedHeaders, consensusParams)};
+    QueuedBlock newentry = {hash, pindex, nNow, pindex != NULL, GetBlockTimeout(nNow, nQueuedValidatedHeaders, consensusParams),
+                            pit ? std::make_shared<PartiallyDownloadedBlock>(&mempool) : std::shared_ptr<PartiallyDownloadedBlock>(), false};
     nQueuedValidatedHeaders += newentry.fValidatedHeaders;
     list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), newentry);
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += newentry.fValidatedHeaders;
-    mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
+    itInFlight = mapBlocksInFlight.insert(std::make_pair(hash, std::make_pair(nodeid, it))).first;
+    if (pit)
+        *pit = &itInFlight->second.second;
+    return true;
+}
+
+/** Whether our tip is recent enough to fetch announced blocks directly. Requires cs_main. */
+bool CanDirectFetch(const Consensus::Params& consensusParams)
+{
+    return chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - consensusParams.nPowTargetSpacing * 20;
+}
+
+/**
+ * Ask pfrom to announce new blocks with cmpctblock (BIP 152 high-bandwidth
+ * mode) after it gave us a new tip. At most three peers are kept in this mode;
+ * the one that has gone longest without giving us a block is switched back.
+ * Requires cs_main.
+ */
+void MaybeSetPeerAsAnnouncingHeaderAndIDs(const CNodeState* nodestate, CNode* pfrom)
+{
+    if (!nodestate->fProvidesHeaderAndIDs)
+        return;
+    for (std::list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
+        if (*it == pfrom->GetId()) {
+            lNodesAnnouncingHeaderAndIDs.erase(it);
+            lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+            return;
+        }
+    }
+    if (lNodesAnnouncingHeaderAndIDs.size() >= 3) {
+        NodeId nodeStop = lNodesAnnouncingHeaderAndIDs.front();
+        lNodesAnnouncingHeaderAndIDs.pop_front();
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            if (pnode->GetId() == nodeStop) {
+                pnode->PushMessage("sendcmpct", false, CMPCTBLOCKS_VERSION);
+                break;
+            }
+        }
+    }
+    pfrom->PushMessage("sendcmpct", true, CMPCTBLOCKS_VERSION);
+    lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
 }
 
 /** Check whether the last unknown block a peer advertized is not yet known. */
@@ -508,8 +620,9 @@ CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb)
 }
 
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
- *  at most count entries. */
-void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBlockIndex*>& vBlocks, NodeId& nodeStaller)
+ *  at most count entries. If the download window keeps us from fetching anything, nodeStaller and
+ *  pindexStaller are set to the peer and the first block holding it back. */
+void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBlockIndex*>& vBlocks, NodeId& nodeStaller, CBlockIndex*& pindexStaller)
 {
     if (count == 0)
         return;
@@ -546,6 +659,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
     int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    CBlockIndex* pindexWaitingFor = NULL;
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed) successors of pindexWalk (towards
         // pindexBestKnownBlock) into vToFetch. We fetch 128, because CBlockIndex::GetAncestor may be as expensive
@@ -577,6 +691,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
                         // We aren't able to fetch anything, but we would be if the download window was one larger.
                         nodeStaller = waitingfor;
+                        pindexStaller = pindexWaitingFor;
                     }
                     return;
                 }
@@ -587,6 +702,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
                 waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                pindexWaitingFor = pindex;
             }
         }
     }
@@ -607,9 +723,35 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats)
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlocksInTransitLimit = GetBlocksInTransitLimit(state->nAvgBlockDeliveryTime);
+    stats.nBlockDeliveryTime = state->nAvgBlockDeliveryTime;
     return true;
 }
 
+int64_t UpdateBlockDeliveryTime(int64_t nAvgBlockDeliveryTime, int64_t nDeliveryTime)
+{
+    nDeliveryTime = std::max<int64_t>(nDeliveryTime, 1);
+    if (nAvgBlockDeliveryTime == 0)
+        return nDeliveryTime;
+    return (nAvgBlockDeliveryTime * 7 + nDeliveryTime) / 8;
+}
+
+int GetBlocksInTransitLimit(int64_t nAvgBlockDeliveryTime)
+{
+    if (nAvgBlockDeliveryTime == 0)
+        return DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER;
+    // Enough to cover BLOCK_DOWNLOAD_QUEUE_TIME seconds of the measured delivery rate
+    int64_t nLimit = 1000000 * (int64_t)BLOCK_DOWNLOAD_QUEUE_TIME / nAvgBlockDeliveryTime;
+    return std::max<int64_t>(MIN_BLOCKS_IN_TRANSIT_PER_PEER, std::min<int64_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER, nLimit));
+}
+
+bool ShouldReassignBlock(int64_t nInFlight, int64_t nAvgBlockDeliveryTime, int64_t nStallerAvgBlockDeliveryTime)
+{
+    if (nAvgBlockDeliveryTime == 0 || nInFlight <= (int64_t)BLOCK_REASSIGN_FACTOR * nAvgBlockDeliveryTime)
+        return false;
+    return nStallerAvgBlockDeliveryTime == 0 || nStallerAvgBlockDeliveryTime > nAvgBlockDeliveryTime;
+}
+
 void RegisterNodeSignals(CNodeSignals& nodeSignals)
 {
     nodeSignals.GetHeight.connect(&GetHeight);
@@ -656,10 +798,18 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
     return chain.Genesis();
 }
 
+CCoinsViewDB* pcoinsdbview = NULL;
 CCoinsViewCache* pcoinsTip = NULL;
 CBlockTreeDB* pblocktree = NULL;
 CSporkDB* pSporkDB = NULL;
 
+/** Statistics of the UTXO set at pcoinsTip, maintained by ConnectTip and DisconnectTip (protected by cs_main) */
+static CCoinsStats utxoStats;
+static bool fUTXOStatsValid = false;
+
+/** Block the chain state was loaded at from a UTXO snapshot, if any; no block data exists at or below it (protected by cs_main) */
+static CBlockIndex* pindexSnapshotBase = NULL;
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // mapOrphanTransactions
@@ -964,6 +1114,8 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& in
  * 2. ProcessNewBlock calls AcceptBlock, which calls CheckBlock (which calls CheckTransaction)
  *    and ContextualCheckBlock (which calls this function).
  * 3. The isInitBlockDownload argument is only to assist with testing.
+ * 4. fCheckProofs is false for blocks below the -assumevalid block, whose
+ *    shielded proofs and signatures are not verified.
  */
 bool ContextualCheckTransaction(
     const CTransaction& tx,
@@ -971,7 +1123,8 @@ bool ContextualCheckTransaction(
     const CChainParams& chainparams,
     const int nHeight,
     const int dosLevel,
-    bool (*isInitBlockDownload)(const Consensus::Params&))
+    bool (*isInitBlockDownload)(const Consensus::Params&),
+    bool fCheckProofs)
 {
     auto consensus = chainparams.GetConsensus();
     auto consensusBranchId = CurrentEpochBranchId(nHeight, consensus);
@@ -1094,6 +1247,17 @@ bool ContextualCheckTransaction(
         }
     }
 
+    if (!fCheckProofs) {
+        return true;
+    }
+
+    // The shielded proofs and signatures of a transaction accepted to the
+    // mempool under this branch ID have already been verified.
+    if ((!tx.vjoinsplit.empty() || !tx.vShieldedSpend.empty() || !tx.vShieldedOutput.empty()) &&
+        ProofCacheContains(tx.GetHash(), consensusBranchId, false)) {
+        return true;
+    }
+
     auto prevConsensusBranchId = PrevEpochBranchId(consensusBranchId, consensus);
     uint256 dataToBeSigned;
     uint256 prevDataToBeSigned;
@@ -1524,6 +1688,12 @@ bool AcceptToMemoryPool(const CChainParams& chainparams, CTxMemPool& pool, CVali
         return error("AcceptToMemoryPool: ContextualCheckTransaction failed");
     }
 
+    // Both checks above verified the shielded data; remember it so that it is
+    // not verified again when the transaction is included in a block.
+    if (!tx.vjoinsplit.empty() || !tx.vShieldedSpend.empty() || !tx.vShieldedOutput.empty()) {
+        ProofCacheAdd(tx.GetHash(), consensusBranchId);
+    }
+
     // DoS mitigation: reject transactions expiring soon
     // Note that if a valid transaction belonging to the wallet is in the mempool and the node is shutdown,
     // upon restart, CWalletTx::AcceptToMemoryPool() will be invoked which might result in rejection.
@@ -1740,6 +1910,8 @@ bool AcceptToMemoryPool(const CChainParams& chainparams, CTxMemPool& pool, CVali
 
         // Store transaction in memory
         pool.addUnchecked(hash, entry, !IsInitialBlockDownload(chainparams.GetConsensus()));
+        if (&pool == &mempool)
+            mnodeman.CheckSpentCollaterals(tx);
 
         // Add memory address index
         if (fAddressIndex) {
@@ -2043,6 +2215,9 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
         return true;
     }
 
+    if (txLookupCache.Get(hash, txOut, hashBlock))
+        return true;
+
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
@@ -2060,6 +2235,7 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
             hashBlock = header.GetHash();
             if (txOut.GetHash() != hash)
                 return error("%s: txid mismatch", __func__);
+            txLookupCache.Add(txOut, hashBlock);
             return true;
         }
     }
@@ -2083,6 +2259,7 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
                 if (tx.GetHash() == hash) {
                     txOut = tx;
                     hashBlock = pindexSlow->GetBlockHash();
+                    txLookupCache.Add(txOut, hashBlock);
                     return true;
                 }
             }
@@ -2092,6 +2269,85 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, const Consensus::P
     return false;
 }
 
+void GetTransactions(const std::vector<uint256>& hashes, std::vector<CTransaction>& txOut, std::vector<uint256>& hashBlocks, std::vector<bool>& vFound, const Consensus::Params& consensusParams, bool fAllowSlow)
+{
+    // cs_main is not needed for the indexed reads: the mempool, the lookup
+    // cache and the index database lock themselves, and -txindex rules out
+    // pruning, so block files are not deleted under us. The slow path takes
+    // cs_main for one transaction at a time. A block disconnected while we
+    // read may leave stale index entries behind, so nothing is cached then.
+    const uint64_t nDisconnects = txLookupCache.GetDisconnectCount();
+    txOut.assign(hashes.size(), CTransaction());
+    hashBlocks.assign(hashes.size(), uint256());
+    vFound.assign(hashes.size(), false);
+
+    // Look up the index entries first, then read the transactions in file
+    // order so that each block file is opened once and read front to back.
+    std::vector<std::pair<CDiskTxPos, size_t>> vPos;
+    for (size_t i = 0; i < hashes.size(); i++) {
+        if (mempool.lookup(hashes[i], txOut[i]) || txLookupCache.Get(hashes[i], txOut[i], hashBlocks[i])) {
+            vFound[i] = true;
+            continue;
+        }
+        CDiskTxPos postx;
+        if (fTxIndex && pblocktree->ReadTxIndex(hashes[i], postx))
+            vPos.push_back(std::make_pair(postx, i));
+    }
+    std::sort(vPos.begin(), vPos.end(), [](const std::pair<CDiskTxPos, size_t>& a, const std::pair<CDiskTxPos, size_t>& b) {
+        return std::make_tuple(a.first.nFile, a.first.nPos, a.first.nTxOffset) < std::make_tuple(b.first.nFile, b.first.nPos, b.first.nTxOffset);
+    });
+
+    for (size_t nBegin = 0, nEnd = 0; nBegin < vPos.size(); nBegin = nEnd) {
+        int nFile = vPos[nBegin].first.nFile;
+        while (nEnd < vPos.size() && vPos[nEnd].first.nFile == nFile)
+            nEnd++;
+        CAutoFile file(OpenBlockFile(CDiskBlockPos(nFile, 0), true), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            error("%s: OpenBlockFile failed", __func__);
+            continue;
+        }
+        unsigned int nBlockPos = 0;
+        long nHeaderEnd = -1;
+        uint256 hashHeader;
+        for (size_t n = nBegin; n < nEnd; n++) {
+            const CDiskTxPos& postx = vPos[n].first;
+            size_t i = vPos[n].second;
+            try {
+                if (nHeaderEnd < 0 || postx.nPos != nBlockPos) {
+                    // Transactions of the same block share the header read.
+                    CBlockHeader header;
+                    if (fseek(file.Get(), postx.nPos, SEEK_SET))
+                        throw std::ios_base::failure("seek to block failed");
+                    file >> header;
+                    hashHeader = header.GetHash();
+                    nBlockPos = postx.nPos;
+                    nHeaderEnd = ftell(file.Get());
+                }
+                if (fseek(file.Get(), nHeaderEnd + postx.nTxOffset, SEEK_SET))
+                    throw std::ios_base::failure("seek to transaction failed");
+                file >> txOut[i];
+            } catch (const std::exception& e) {
+                error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                nHeaderEnd = -1;
+                continue;
+            }
+            if (txOut[i].GetHash() != hashes[i]) {
+                error("%s: txid mismatch", __func__);
+                continue;
+            }
+            hashBlocks[i] = hashHeader;
+            vFound[i] = true;
+            txLookupCache.Add(txOut[i], hashHeader, nDisconnects);
+        }
+    }
+
+    // Transactions that are not indexed take the slow path one by one.
+    for (size_t i = 0; i < hashes.size(); i++) {
+        if (!vFound[i] && fAllowSlow)
+            vFound[i] = GetTransaction(hashes[i], txOut[i], consensusParams, hashBlocks[i], fAllowSlow);
+    }
+}
+
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -2965,6 +3221,31 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+bool IsAssumedValid(const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    AssertLockHeld(cs_main);
+
+    if (hashAssumeValid.IsNull() || pindexBestHeader == NULL)
+        return false;
+
+    BlockMap::const_iterator it = mapBlockIndex.find(hashAssumeValid);
+    if (it == mapBlockIndex.end()) {
+        // We haven't seen the assumed valid block yet, so we cannot tell
+        // whether this block is one of its ancestors.
+        return false;
+    }
+
+    // The block must be an ancestor of both the assumed valid block and our
+    // best header, the best header must have at least the minimum chain work,
+    // and the block must be buried under at least two weeks' worth of work.
+    // Together these keep a peer from getting us to skip checks on a fork that
+    // merely claims to lead to the assumed valid block.
+    return it->second->GetAncestor(pindex->nHeight) == pindex &&
+           pindexBestHeader->GetAncestor(pindex->nHeight) == pindex &&
+           pindexBestHeader->nChainWork >= UintToArith256(consensusParams.nMinimumChainWork) &&
+           GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader, consensusParams) > 60 * 60 * 24 * 7 * 2;
+}
+
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
 {
     AssertLockHeld(cs_main);
@@ -2977,12 +3258,18 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             fExpensiveChecks = false;
         }
     }
+    if (fExpensiveChecks && IsAssumedValid(pindex, chainparams.GetConsensus())) {
+        // This block is an ancestor of the -assumevalid block: disable script
+        // and JoinSplit proof checks
+        fExpensiveChecks = false;
+    }
 
     auto verifier = ProofVerifier::Strict();
     auto disabledVerifier = ProofVerifier::Disabled();
 
-    // Check it again to verify JoinSplit proofs, and in case a previous version let a bad block in
-    if (!CheckBlock(block, state, chainparams, fExpensiveChecks ? verifier : disabledVerifier, !fJustCheck, !fJustCheck))
+    // Check it again in case a previous version let a bad block in. JoinSplit
+    // proofs are verified below, unless already verified on mempool acceptance.
+    if (!CheckBlock(block, state, chainparams, disabledVerifier, !fJustCheck, !fJustCheck))
         return false;
 
     // verify that the view's current state corresponds to the previous block
@@ -3068,6 +3355,19 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
+        if (!tx.vjoinsplit.empty() || !tx.vShieldedSpend.empty() || !tx.vShieldedOutput.empty()) {
+            // Once the block is connected the cache entry is no longer needed.
+            bool fProofsCached = ProofCacheContains(txhash, consensusBranchId, !fJustCheck);
+            if (fExpensiveChecks && !fProofsCached) {
+                for (const JSDescription& joinsplit : tx.vjoinsplit) {
+                    if (!verifier.VerifySprout(joinsplit, tx.joinSplitPubKey)) {
+                        return state.DoS(100, error("ConnectBlock(): joinsplit does not verify"),
+                                         REJECT_INVALID, "bad-txns-joinsplit-verification-failed");
+                    }
+                }
+            }
+        }
+
         if (!tx.IsCoinBase()) {
             if (!view.HaveInputs(tx))
                 return state.DoS(100, error("ConnectBlock(): inputs missing/spent"),
@@ -3134,8 +3434,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!tx.IsCoinBase()) {
             nFees += view.GetValueIn(tx) - tx.GetValueOut();
 
+            // A block that is only being checked (e.g. a mining template) must
+            // leave the signature cache intact; a connected block's entries
+            // are no longer needed and are marked for eviction on lookup.
+            bool fCacheResults = fJustCheck;
             std::vector<CScriptCheck> vChecks;
-            if (!ContextualCheckInputs(tx, state, view, fExpensiveChecks, flags, false, txdata[i], chainparams.GetConsensus(), consensusBranchId, nScriptCheckThreads ? &vChecks : NULL))
+            if (!ContextualCheckInputs(tx, state, view, fExpensiveChecks, flags, fCacheResults, txdata[i], chainparams.GetConsensus(), consensusBranchId, nScriptCheckThreads ? &vChecks : NULL))
                 return false;
             control.Add(vChecks);
         }
@@ -3356,7 +3660,8 @@ bool static FlushStateToDisk(
         if (nLastFlush == 0) {
             nLastFlush = nNow;
         }
-        size_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        // A background flush still holds the previous cache until it is written.
+        size_t cacheSize = pcoinsTip->DynamicMemoryUsage() + pcoinsdbview->PendingFlushUsage();
         // The cache is large and close to the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize * (10.0 / 9) > nCoinCacheUsage;
         // The cache is over the limit, we have to write now.
@@ -3392,13 +3697,11 @@ bool static FlushStateToDisk(
                     return AbortNode(state, "Files to write to block index database");
                 }
             }
-            // Finally remove any pruned files
-            if (fFlushForPrune)
-                UnlinkPrunedFiles(setFilesToPrune);
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
-        if (fDoFullFlush) {
+        // While a UTXO snapshot is being loaded the coin database is written directly instead.
+        if (fDoFullFlush && !fLoadingSnapshot) {
             // Typical CCoins structures on disk are around 128 bytes in size.
             // Pushing a new one to the database can cause it to be written
             // twice (once in the log, and once in the tables). This is already
@@ -3407,10 +3710,21 @@ bool static FlushStateToDisk(
             if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
+            if (fUTXOStatsValid)
+                pcoinsdbview->SetUTXOStats(utxoStats);
+            pcoinsdbview->SetFlushUsage(pcoinsTip->DynamicMemoryUsage());
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            // The coin database may finish writing in the background. On shutdown
+            // and before pruning we need the data on disk before returning.
+            if ((mode == FLUSH_STATE_ALWAYS || fFlushForPrune) && !pcoinsdbview->WaitForFlush())
+                return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
         }
+        // Finally remove any pruned files, once the chain state that no longer
+        // needs them is on disk.
+        if (fFlushForPrune)
+            UnlinkPrunedFiles(setFilesToPrune);
         // Don't flush the wallet witness cache (SetBestChain()) here, see #4301
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error while flushing: ") + e.what());
@@ -3424,6 +3738,36 @@ void FlushStateToDisk()
     FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
 }
 
+bool GetUTXOStats(CCoinsStats& stats)
+{
+    {
+        LOCK(cs_main);
+        if (fUTXOStatsValid) {
+            stats = utxoStats;
+            return true;
+        }
+        // Statistics written by an older version or lost in a crash; rebuild
+        // them from the coin database.
+        LogPrintf("%s: computing UTXO set statistics from the coin database...\n", __func__);
+        FlushStateToDisk();
+    }
+
+    // The scan reads a database snapshot, so blocks can be connected meanwhile.
+    CCoinsStats scanned;
+    if (!pcoinsdbview->GetStats(scanned))
+        return false;
+
+    LOCK(cs_main);
+    // The incremental statistics can only continue from the scan if the tip
+    // has not moved; otherwise the next call scans again.
+    if (!fUTXOStatsValid && chainActive.Tip() && chainActive.Tip()->GetBlockHash() == scanned.hashBlock) {
+        utxoStats = scanned;
+        fUTXOStatsValid = true;
+    }
+    stats = scanned;
+    return true;
+}
+
 void PruneAndFlush()
 {
     CValidationState state;
@@ -3468,8 +3812,13 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
         CCoinsViewCache view(pcoinsTip);
         if (!DisconnectBlock(block, state, pindexDelete, view, chainparams))
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
+        // view now holds the UTXO set as it was before the block was connected.
+        if (fUTXOStatsValid)
+            utxoStats.ApplyBlock(block, pindexDelete->nHeight, view, true);
         assert(view.Flush());
     }
+    txLookupCache.EraseBlock(block.vtx);
+    mnodeman.RestoreSpentCollaterals(block.vtx);
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
     uint256 sproutAnchorAfterDisconnect = pcoinsTip->GetBestAnchor(SPROUT);
     uint256 saplingAnchorAfterDisconnect = pcoinsTip->GetBestAnchor(SAPLING);
@@ -3542,6 +3891,17 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
             return error("ConnectTip(): ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
         mapBlockSource.erase(pindexNew->GetBlockHash());
+        mnodeman.CheckSpentCollaterals(pblock->vtx);
+        // pcoinsTip still holds the UTXO set from before the block. The genesis
+        // block's outputs are not added to it (see ConnectBlock).
+        if (fUTXOStatsValid) {
+            if (pindexNew->pprev == NULL) {
+                utxoStats.hashBlock = pindexNew->GetBlockHash();
+                utxoStats.nHeight = pindexNew->nHeight;
+            } else {
+                utxoStats.ApplyBlock(*pblock, pindexNew->nHeight, *pcoinsTip, false);
+            }
+        }
         nTime3 = GetTimeMicros();
         nTimeConnectTotal += nTime3 - nTime2;
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
@@ -3725,6 +4085,43 @@ static void PruneBlockIndexCandidates()
     assert(!setBlockIndexCandidates.empty());
 }
 
+bool ActivateUTXOSnapshot(CBlockIndex* pindexBase, const CSnapshotMetadata& metadata)
+{
+    AssertLockHeld(cs_main);
+    assert(pcoinsTip->GetBestBlock() == pindexBase->GetBlockHash());
+
+    // The base block was never connected here, so fill in what connecting its
+    // history would have computed.
+    pindexBase->nChainTx = metadata.nChainTx;
+    pindexBase->nChainSproutValue = metadata.nChainSproutValue;
+    pindexBase->nChainSaplingValue = metadata.nChainSaplingValue;
+    pindexBase->nCachedBranchId = CurrentEpochBranchId(pindexBase->nHeight, Params().GetConsensus());
+    pindexBase->RaiseValidity(BLOCK_VALID_SCRIPTS);
+    pindexBase->hashFinalSproutRoot = pcoinsTip->GetBestAnchor(SPROUT);
+    setDirtyBlockIndex.insert(pindexBase);
+    pindexSnapshotBase = pindexBase;
+    // Peers cannot get the blocks below the snapshot from us
+    LogPrintf("Unsetting NODE_NETWORK, blocks below the UTXO snapshot are not stored\n");
+    nLocalServices &= ~NODE_NETWORK;
+
+    chainActive.SetTip(pindexBase);
+    setBlockIndexCandidates.insert(pindexBase);
+    PruneBlockIndexCandidates();
+
+    fUTXOStatsValid = pcoinsdbview->ReadUTXOStats(utxoStats) && utxoStats.hashBlock == pindexBase->GetBlockHash();
+
+    if (!pblocktree->WriteSnapshotBase(metadata))
+        return AbortNode("Failed to write the UTXO snapshot base to the block index database");
+    FlushStateToDisk();
+    return true;
+}
+
+bool HaveUTXOSnapshot()
+{
+    AssertLockHeld(cs_main);
+    return pindexSnapshotBase != NULL;
+}
+
 const CBlockIndex* FindBlockAtHeight(int nHeight, const CBlockIndex* pIndex)
 {
     while (pIndex && pIndex->nHeight > nHeight) {
@@ -3894,8 +4291,15 @@ bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams,
 
         bool fInitialDownload;
         int nNewHeight; // ** NOTE: clang compiler will falsly warn about -Wunused-but-set-variable here; this is required // Ky
+        CBlockIndex* pindexOldTip;
+        std::set<NodeId> setCompactPeers;
         {
             LOCK(cs_main);
+            // The chain state is being replaced by a UTXO snapshot.
+            if (fLoadingSnapshot)
+                return true;
+
+            pindexOldTip = chainActive.Tip();
             pindexMostWork = FindMostWorkChain();
 
             // Whether we have anything to do at all.
@@ -3913,6 +4317,14 @@ bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams,
             pindexNewTip = chainActive.Tip();
             fInitialDownload = IsInitialBlockDownload(chainparams.GetConsensus());
             nNewHeight = chainActive.Height();
+
+            // Peers in compact block high-bandwidth mode get a new tip that
+            // directly extends the old one as cmpctblock instead of inv.
+            if (!fInitialDownload && pindexOldTip != NULL && pindexNewTip->pprev == pindexOldTip) {
+                for (const auto& entry : mapNodeState)
+                    if (entry.second.fPreferHeaderAndIDs)
+                        setCompactPeers.insert(entry.first);
+            }
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
 
@@ -3923,11 +4335,36 @@ bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams,
             int nBlockEstimate = 0;
             if (fCheckpointsEnabled)
                 nBlockEstimate = Checkpoints::GetTotalBlocksEstimate(chainParams.Checkpoints());
+            std::unique_ptr<CBlockHeaderAndShortTxIDs> cmpctblock;
+            if (!setCompactPeers.empty()) {
+                if (pblock && pblock->GetHash() == hashNewTip) {
+                    cmpctblock.reset(new CBlockHeaderAndShortTxIDs(*pblock));
+                } else {
+                    CBlock block;
+                    if (ReadBlockFromDisk(block, pindexNewTip, chainparams.GetConsensus()))
+                        cmpctblock.reset(new CBlockHeaderAndShortTxIDs(block));
+                }
+            }
             {
                 LOCK(cs_vNodes);
-                for (CNode* pnode : vNodes)
-                    if (chainActive.Height() > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
-                        pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+                for (CNode* pnode : vNodes) {
+                    if (chainActive.Height() <= (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
+                        continue;
+                    CInv inv(MSG_BLOCK, hashNewTip);
+                    if (cmpctblock && setCompactPeers.count(pnode->GetId())) {
+                        bool fKnown;
+                        {
+                            LOCK(pnode->cs_inventory);
+                            fKnown = pnode->setInventoryKnown.count(inv) > 0;
+                        }
+                        if (!fKnown) {
+                            pnode->PushMessage("cmpctblock", *cmpctblock);
+                            pnode->AddInventoryKnown(inv);
+                        }
+                    } else {
+                        pnode->PushInventory(inv);
+                    }
+                }
             }
             // Notify external listeners about the new tip.
             GetMainSignals().UpdatedBlockTip(pindexNewTip);
@@ -4258,11 +4695,11 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const CChainParams
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, chainparams, fCheckPOW))
+    if (!CheckBlockHeader(block, state, chainparams, fCheckPOW && !block.fChecked))
         return false;
 
     // Check the merkle root.
-    if (fCheckMerkleRoot) {
+    if (fCheckMerkleRoot && !block.fChecked) {
         bool mutated;
         uint256 hashMerkleRoot2 = block.BuildMerkleTree(&mutated);
         if (block.hashMerkleRoot != hashMerkleRoot2)
@@ -4423,14 +4860,14 @@ bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& sta
     return true;
 }
 
-bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex* const pindexPrev)
+bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex* const pindexPrev, bool fCheckProofs)
 {
     const int nHeight = pindexPrev == NULL ? 0 : pindexPrev->nHeight + 1;
 
     // Check that all transactions are finalized
     for (const CTransaction& tx : block.vtx) {
         // Check transaction contextually against consensus rules at block height
-        if (!ContextualCheckTransaction(tx, state, chainparams, nHeight, 100)) {
+        if (!ContextualCheckTransaction(tx, state, chainparams, nHeight, 100, IsInitialBlockDownload, fCheckProofs)) {
             return false; // Failure reason has been set in validation state object
         }
 
@@ -4548,7 +4985,7 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CC
     return true;
 }
 
-bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -4565,7 +5002,7 @@ bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const
         return true;
     }
 
-    if (!CheckBlockHeader(block, state, chainparams))
+    if (!CheckBlockHeader(block, state, chainparams, fCheckPOW))
         return false;
 
     // Get prev block index
@@ -4598,7 +5035,7 @@ bool AcceptBlock(CBlock& block, CValidationState& state, const CChainParams& cha
     CBlockIndex* pindexDummy = NULL;
     CBlockIndex*& pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, state, chainparams, &pindex, !block.fChecked))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -4628,7 +5065,7 @@ bool AcceptBlock(CBlock& block, CValidationState& state, const CChainParams& cha
 
     // See method docstring for why this is always disabled
     auto verifier = ProofVerifier::Disabled();
-    if ((!CheckBlock(block, state, chainparams, verifier)) || !ContextualCheckBlock(block, state, chainparams, pindex->pprev)) {
+    if ((!CheckBlock(block, state, chainparams, verifier)) || !ContextualCheckBlock(block, state, chainparams, pindex->pprev, !IsAssumedValid(pindex, chainparams.GetConsensus()))) {
         if (state.IsInvalid() && !state.CorruptionPossible()) {
             pindex->nStatus |= BLOCK_FAILED_VALID;
             setDirtyBlockIndex.insert(pindex);
@@ -4683,7 +5120,7 @@ bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, C
 
     {
         LOCK(cs_main);
-        bool fRequested = MarkBlockAsReceived(pblock->GetHash());
+        bool fRequested = MarkBlockAsReceived(pblock->GetHash(), pfrom ? pfrom->GetId() : -1);
         fRequested |= fForceProcessing;
         if (!checked) {
             return error("%s: CheckBlock FAILED", __func__);
@@ -4922,6 +5359,13 @@ bool static LoadBlockIndexDB()
     if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, chainparams))
         return false;
 
+    bool fLoadingSnapshot = false;
+    pblocktree->ReadFlag("loadingsnapshot", fLoadingSnapshot);
+    if (fLoadingSnapshot)
+        return error("%s: loading a UTXO snapshot was interrupted, restart with -reindex", __func__);
+    CSnapshotMetadata snapshotBase;
+    bool fSnapshot = pblocktree->ReadSnapshotBase(snapshotBase);
+
     // Calculate nChainWork
     vector<pair<int, CBlockIndex*>> vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
@@ -4982,6 +5426,15 @@ bool static LoadBlockIndexDB()
         } else {
             pindex->nCachedBranchId = SPROUT_BRANCH_ID;
         }
+        // The chain state was loaded from a snapshot at this block; its
+        // history was never downloaded.
+        if (fSnapshot && pindex->GetBlockHash() == snapshotBase.hashBlock) {
+            pindex->nChainTx = snapshotBase.nChainTx;
+            pindex->nChainSproutValue = snapshotBase.nChainSproutValue;
+            pindex->nChainSaplingValue = snapshotBase.nChainSaplingValue;
+            pindex->nCachedBranchId = CurrentEpochBranchId(pindex->nHeight, chainparams.GetConsensus());
+            pindexSnapshotBase = pindex;
+        }
         if (pindex->IsValid(BLOCK_VALID_TRANSACTIONS) && (pindex->nChainTx || pindex->pprev == NULL))
             setBlockIndexCandidates.insert(pindex);
         if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
@@ -5069,6 +5522,17 @@ bool static LoadBlockIndexDB()
         }
     }
 
+    // Load the UTXO set statistics, if they were written together with the chain state.
+    fUTXOStatsValid = false;
+    if (pcoinsTip->GetBestBlock().IsNull()) {
+        utxoStats = CCoinsStats();
+        fUTXOStatsValid = true;
+    } else if (pcoinsdbview->ReadUTXOStats(utxoStats) && utxoStats.hashBlock == pcoinsTip->GetBestBlock()) {
+        fUTXOStatsValid = true;
+    } else {
+        LogPrintf("%s: UTXO set statistics not available, they will be computed by the next gettxoutsetinfo call\n", __func__);
+    }
+
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
@@ -5124,6 +5588,8 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView* coinsview,
         uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
         if (pindex->nHeight < chainActive.Height() - nCheckDepth)
             break;
+        if (pindexSnapshotBase && pindex->nHeight <= pindexSnapshotBase->nHeight)
+            break;
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -5338,6 +5804,7 @@ void UnloadBlockIndex()
     chainActive.SetTip(NULL);
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
+    pindexSnapshotBase = NULL;
     mempool.clear();
     mapOrphanTransactions.clear();
     mapOrphanTransactionsByPrev.clear();
@@ -5429,20 +5896,56 @@ bool InitBlockIndex()
 }
 
 
-bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
+namespace
 {
-    const CChainParams& chainparams = Params();
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+/**
+ * Verify the parts of CheckBlock that need no chain context: the Equihash
+ * solution, proof of work and merkle root. Success is remembered in
+ * block.fChecked so that CheckBlock and AcceptBlockHeader skip them.
+ */
+void PrecheckImportedBlock(const CBlock& block, const Consensus::Params& consensusParams)
+{
+    if (!CheckEquihashSolution(&block, consensusParams) || !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+        return;
+    bool mutated;
+    if (block.BuildMerkleTree(&mutated) != block.hashMerkleRoot || mutated)
+        return;
+    block.fChecked = true;
+}
+} // namespace
 
-    int nLoaded = 0;
+CBlockImportPipeline::CBlockImportPipeline(FILE* fileIn, const CChainParams& chainparamsIn, int nWorkers) : chainparams(chainparamsIn), nBytesQueued(0), fEof(false), fStop(false)
+{
+    threads.emplace_back(&CBlockImportPipeline::ThreadRead, this, fileIn);
+    for (int i = 0; i < nWorkers; i++)
+        threads.emplace_back(&CBlockImportPipeline::ThreadParse, this);
+}
+
+CBlockImportPipeline::~CBlockImportPipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+    }
+    condRead.notify_all();
+    condParse.notify_all();
+    for (std::thread& t : threads)
+        t.join();
+}
+
+void CBlockImportPipeline::ThreadRead(FILE* fileIn)
+{
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE(90000000), MAX_BLOCK_SIZE(90000000) + 8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
         while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                condRead.wait(lock, [this] { return fStop || nBytesQueued < BLOCK_IMPORT_READ_AHEAD; });
+                if (fStop)
+                    break;
+            }
 
             blkdat.SetPos(nRewind);
             nRewind++;         // start one byte further next time, in case of failure
@@ -5451,10 +5954,10 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
             try {
                 // locate a header
                 unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(Params().MessageStart()[0]);
+                blkdat.FindByte(chainparams.MessageStart()[0]);
                 nRewind = blkdat.GetPos() + 1;
                 blkdat >> FLATDATA(buf);
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
                     continue;
                 // read size
                 blkdat >> nSize;
@@ -5465,23 +5968,126 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                 break;
             }
             try {
-                // read block
+                // read block; it is deserialized by a worker
                 uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
+                std::unique_ptr<CDataStream> data(new CDataStream(SER_DISK, CLIENT_VERSION));
+                data->resize(nSize);
+                blkdat.read(data->data(), nSize);
                 nRewind = blkdat.GetPos();
 
+                std::shared_ptr<CImportBlock> record = std::make_shared<CImportBlock>(nBlockPos, std::move(data));
+                {
+                    std::lock_guard<std::mutex> lock(cs);
+                    nBytesQueued += nSize;
+                    queueFile.push_back(record);
+                    queueParse.push_back(record);
+                }
+                condParse.notify_one();
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fEof = true;
+    }
+    condParse.notify_all();
+    condReady.notify_all();
+}
+
+void CBlockImportPipeline::ThreadParse()
+{
+    while (true) {
+        std::shared_ptr<CImportBlock> record;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            condParse.wait(lock, [this] { return fStop || fEof || !queueParse.empty(); });
+            if (fStop || queueParse.empty())
+                return;
+            record = queueParse.front();
+            queueParse.pop_front();
+        }
+
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        try {
+            *record->data >> *pblock;
+            PrecheckImportedBlock(*pblock, chainparams.GetConsensus());
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            pblock.reset();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            record->data.reset();
+            record->pblock = pblock;
+            record->fParsed = true;
+        }
+        condReady.notify_all();
+    }
+}
+
+bool CBlockImportPipeline::Next(std::shared_ptr<CImportBlock>& record)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    while (queueFile.empty() || !queueFile.front()->fParsed) {
+        if (queueFile.empty() && fEof)
+            return false;
+        // Wake up regularly so that the import thread can be interrupted
+        condReady.wait_for(lock, std::chrono::milliseconds(100));
+        lock.unlock();
+        boost::this_thread::interruption_point();
+        lock.lock();
+    }
+    record = queueFile.front();
+    queueFile.pop_front();
+    nBytesQueued -= record->nSize;
+    lock.unlock();
+    condRead.notify_one();
+    return true;
+}
+
+bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
+{
+    const CChainParams& chainparams = Params();
+    // Blocks with unknown parent (only used for reindex), kept in memory up to
+    // BLOCK_IMPORT_ORPHAN_MEMORY and otherwise re-read from their disk position
+    static std::multimap<uint256, std::pair<CDiskBlockPos, std::shared_ptr<CBlock>>> mapBlocksUnknownParent;
+    static size_t nBlocksUnknownParentUsage = 0;
+    int64_t nStart = GetTimeMillis();
+
+    int nLoaded = 0;
+    {
+        int nWorkers = std::max(1, std::min(GetNumCores() - 1, MAX_BLOCK_IMPORT_THREADS));
+        CBlockImportPipeline pipeline(fileIn, chainparams, nWorkers);
+        std::shared_ptr<CImportBlock> record;
+        while (pipeline.Next(record)) {
+            if (!record->pblock)
+                continue;
+            try {
+                std::shared_ptr<CBlock> pblock = record->pblock;
+                CBlock& block = *pblock;
+                if (dbp)
+                    dbp->nPos = record->nPos;
+
                 // detect out of order blocks, and store them for later
                 uint256 hash = block.GetHash();
                 if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
                     LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
                              block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+                    size_t nUsage = RecursiveDynamicUsage(block);
+                    if (nBlocksUnknownParentUsage + nUsage <= BLOCK_IMPORT_ORPHAN_MEMORY) {
+                        nBlocksUnknownParentUsage += nUsage;
+                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, std::make_pair(dbp ? *dbp : CDiskBlockPos(), pblock)));
+                    } else if (dbp) {
+                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, std::make_pair(*dbp, std::shared_ptr<CBlock>())));
+                    }
                     continue;
                 }
 
@@ -5496,36 +6102,40 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                     LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
                 }
 
-                // NotifyHeaderTip(chainparams.GetConsensus());
-
                 // Recursively process earlier encountered successors of this block
                 deque<uint256> queue;
                 queue.push_back(hash);
                 while (!queue.empty()) {
                     uint256 head = queue.front();
                     queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+                    auto range = mapBlocksUnknownParent.equal_range(head);
                     while (range.first != range.second) {
-                        if (ReadBlockFromDisk(block, range.first->second, chainparams.GetConsensus())) {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
+                        CDiskBlockPos posChild = range.first->second.first;
+                        std::shared_ptr<CBlock> pchild = range.first->second.second;
+                        if (pchild) {
+                            nBlocksUnknownParentUsage -= RecursiveDynamicUsage(*pchild);
+                        } else {
+                            pchild = std::make_shared<CBlock>();
+                            if (!ReadBlockFromDisk(*pchild, posChild, chainparams.GetConsensus()))
+                                pchild.reset();
+                        }
+                        if (pchild) {
+                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, pchild->GetHash().ToString(),
                                      head.ToString());
                             LOCK(cs_main);
                             CValidationState dummy;
-                            if (AcceptBlock(block, dummy, chainparams, NULL, true, &(range.first->second))) {
+                            if (AcceptBlock(*pchild, dummy, chainparams, NULL, true, posChild.IsNull() ? NULL : &posChild)) {
                                 nLoaded++;
-                                queue.push_back(block.GetHash());
+                                queue.push_back(pchild->GetHash());
                             }
                         }
                         range.first = mapBlocksUnknownParent.erase(range.first);
-                        // NotifyHeaderTip(chainparams.GetConsensus());
                     }
                 }
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
-    } catch (const std::runtime_error& e) {
-        AbortNode(std::string("System error: ") + e.what());
     }
     if (nLoaded > 0)
         LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
@@ -5576,19 +6186,22 @@ void static CheckBlockIndex()
     CBlockIndex* pindexFirstNotScriptsValid = NULL;      // Oldest ancestor of pindex which does not have BLOCK_VALID_SCRIPTS (regardless of being valid or not).
     while (pindex != NULL) {
         nNodes++;
+        // A UTXO snapshot base and its ancestors have no data and were never
+        // validated here; their descendants build on the snapshot instead.
+        bool fFromSnapshot = pindexSnapshotBase && pindexSnapshotBase->GetAncestor(pindex->nHeight) == pindex;
         if (pindexFirstInvalid == NULL && pindex->nStatus & BLOCK_FAILED_VALID)
             pindexFirstInvalid = pindex;
-        if (pindexFirstMissing == NULL && !(pindex->nStatus & BLOCK_HAVE_DATA))
+        if (pindexFirstMissing == NULL && !fFromSnapshot && !(pindex->nStatus & BLOCK_HAVE_DATA))
             pindexFirstMissing = pindex;
-        if (pindexFirstNeverProcessed == NULL && pindex->nTx == 0)
+        if (pindexFirstNeverProcessed == NULL && !fFromSnapshot && pindex->nTx == 0)
             pindexFirstNeverProcessed = pindex;
         if (pindex->pprev != NULL && pindexFirstNotTreeValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TREE)
             pindexFirstNotTreeValid = pindex;
-        if (pindex->pprev != NULL && pindexFirstNotTransactionsValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS)
+        if (pindex->pprev != NULL && pindexFirstNotTransactionsValid == NULL && !fFromSnapshot && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS)
             pindexFirstNotTransactionsValid = pindex;
-        if (pindex->pprev != NULL && pindexFirstNotChainValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN)
+        if (pindex->pprev != NULL && pindexFirstNotChainValid == NULL && !fFromSnapshot && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN)
             pindexFirstNotChainValid = pindex;
-        if (pindex->pprev != NULL && pindexFirstNotScriptsValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS)
+        if (pindex->pprev != NULL && pindexFirstNotScriptsValid == NULL && !fFromSnapshot && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS)
             pindexFirstNotScriptsValid = pindex;
 
         // Begin: actual consistency checks.
@@ -5612,10 +6225,12 @@ void static CheckBlockIndex()
         }
         if (pindex->nStatus & BLOCK_HAVE_UNDO)
             assert(pindex->nStatus & BLOCK_HAVE_DATA);
-        assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0)); // This is pruning-independent.
-        // All parents having had data (at some point) is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to nChainTx being set.
-        assert((pindexFirstNeverProcessed != NULL) == (pindex->nChainTx == 0)); // nChainTx != 0 is used to signal that all parent blocks have been processed (but may have been pruned).
-        assert((pindexFirstNotTransactionsValid != NULL) == (pindex->nChainTx == 0));
+        if (!fFromSnapshot) {
+            assert(((pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_TRANSACTIONS) == (pindex->nTx > 0)); // This is pruning-independent.
+            // All parents having had data (at some point) is equivalent to all parents being VALID_TRANSACTIONS, which is equivalent to nChainTx being set.
+            assert((pindexFirstNeverProcessed != NULL) == (pindex->nChainTx == 0)); // nChainTx != 0 is used to signal that all parent blocks have been processed (but may have been pruned).
+            assert((pindexFirstNotTransactionsValid != NULL) == (pindex->nChainTx == 0));
+        }
         assert(pindex->nHeight == nHeight);                                               // nHeight must be consistent.
         assert(pindex->pprev == NULL || pindex->nChainWork >= pindex->pprev->nChainWork); // For every block except the genesis block, the chainwork must be larger than the parent's.
         assert(nHeight < 2 || (pindex->pskip && (pindex->pskip->nHeight < nHeight)));     // The pskip pointer must point back for all but the first 2 blocks.
@@ -5837,7 +6452,7 @@ void static ProcessGetData(const Consensus::Params& consensusParams, CNode* pfro
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
                 bool send = false;
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end()) {
@@ -5865,7 +6480,14 @@ void static ProcessGetData(const Consensus::Params& consensusParams, CNode* pfro
                         assert(!"cannot load block from disk");
                     if (inv.type == MSG_BLOCK)
                         pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    else if (inv.type == MSG_CMPCT_BLOCK) {
+                        // Only recent blocks are likely to be reconstructable
+                        // from the peer's mempool; send older ones in full.
+                        if (mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH)
+                            pfrom->PushMessage("cmpctblock", CBlockHeaderAndShortTxIDs(block));
+                        else
+                            pfrom->PushMessage("block", block);
+                    } else // MSG_FILTERED_BLOCK)
                     {
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
@@ -6008,7 +6630,7 @@ void static ProcessGetData(const Consensus::Params& consensusParams, CNode* pfro
                         if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
                             CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                             ss.reserve(1000);
-                            ss << mnodeman.mapSeenMasternodeBroadcast[inv.hash];
+                            ss << mnodeman.mapSeenMasternodeBroadcast.at(inv.hash);
                             pfrom->PushMessage("mnb", ss);
                             pushed = true;
                         }
@@ -6018,7 +6640,7 @@ void static ProcessGetData(const Consensus::Params& consensusParams, CNode* pfro
                         if (mnodeman.mapSeenMasternodePing.count(inv.hash)) {
                             CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                             ss.reserve(1000);
-                            ss << mnodeman.mapSeenMasternodePing[inv.hash];
+                            ss << mnodeman.mapSeenMasternodePing.at(inv.hash);
                             pfrom->PushMessage("mnp", ss);
                             pushed = true;
                         }
@@ -6034,7 +6656,7 @@ void static ProcessGetData(const Consensus::Params& consensusParams, CNode* pfro
             // Track requests for our stuff.
             GetMainSignals().Inventory(inv.hash);
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -6053,6 +6675,61 @@ void static ProcessGetData(const Consensus::Params& consensusParams, CNode* pfro
     }
 }
 
+/**
+ * Complete the compact block pfrom is sending us for resp.blockhash with the
+ * transactions in resp. Falls back to requesting the full block on a short ID
+ * collision. Returns true if block was reconstructed. Requires cs_main.
+ */
+static bool FillCompactBlock(CNode* pfrom, const BlockTransactions& resp, CBlock& block)
+{
+    map<uint256, pair<NodeId, list<QueuedBlock>::iterator>>::iterator it = mapBlocksInFlight.find(resp.blockhash);
+    if (it == mapBlocksInFlight.end() || it->second.first != pfrom->GetId() ||
+        !it->second.second->partialBlock || it->second.second->partialBlock->header.IsNull()) {
+        LogPrint("net", "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
+        return false;
+    }
+
+    ReadStatus status = it->second.second->partialBlock->FillBlock(block, resp.txn);
+    if (status == READ_STATUS_INVALID) {
+        MarkBlockAsReceived(resp.blockhash); // Reset in-flight state in case of whitelist
+        Misbehaving(pfrom->GetId(), 100);
+        LogPrintf("Peer %d sent us invalid compact block/non-matching block transactions\n", pfrom->id);
+        return false;
+    } else if (status == READ_STATUS_FAILED) {
+        // Might have collided, fall back to getdata now
+        vector<CInv> vInv;
+        vInv.push_back(CInv(MSG_BLOCK, resp.blockhash));
+        pfrom->PushMessage("getdata", vInv);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Process a block received from pfrom, either in full or reconstructed from a
+ * compact block, and reward the peer with high-bandwidth compact block
+ * announcements if it gave us our new tip.
+ */
+static void ProcessPeerBlock(const CChainParams& chainparams, CNode* pfrom, const std::string& strCommand, CBlock& block, bool forceProcessing)
+{
+    CInv inv(MSG_BLOCK, block.GetHash());
+    CValidationState state;
+    ProcessNewBlock(state, chainparams, pfrom, &block, forceProcessing, NULL);
+    int nDoS;
+    if (state.IsInvalid(nDoS)) {
+        pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
+                           state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+        if (nDoS > 0) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+    } else {
+        LOCK(cs_main);
+        if (!IsInitialBlockDownload(chainparams.GetConsensus()) && chainActive.Tip()->GetBlockHash() == inv.hash)
+            MaybeSetPeerAsAnnouncingHeaderAndIDs(State(pfrom->GetId()), pfrom);
+    }
+}
+
 bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     LogPrint("net", "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -6203,6 +6880,10 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
             LOCK(cs_main);
             State(pfrom->GetId())->fCurrentlyConnected = true;
         }
+
+        // Tell the peer we can receive compact blocks, but do not ask for
+        // high-bandwidth announcements yet (see MaybeSetPeerAsAnnouncingHeaderAndIDs).
+        pfrom->PushMessage("sendcmpct", false, CMPCTBLOCKS_VERSION);
     }
 
 
@@ -6319,9 +7000,12 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
                     // not a direct successor.
                     pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), inv.hash);
                     CNodeState* nodestate = State(pfrom->GetId());
-                    if (chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - chainparams.GetConsensus().nPowTargetSpacing * 20 &&
-                        nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
-                        vToFetch.push_back(inv);
+                    if (CanDirectFetch(chainparams.GetConsensus()) &&
+                        nodestate->nBlocksInFlight < GetBlocksInTransitLimit(nodestate->nAvgBlockDeliveryTime)) {
+                        if (nodestate->fProvidesHeaderAndIDs)
+                            vToFetch.push_back(CInv(MSG_CMPCT_BLOCK, inv.hash));
+                        else
+                            vToFetch.push_back(inv);
                         // Mark block as in flight already, even though the actual "getdata" message only goes out
                         // later (within the same cs_main lock, though).
                         MarkBlockAsInFlight(pfrom->GetId(), inv.hash, chainparams.GetConsensus());
@@ -6640,23 +7324,193 @@ bool static ProcessMessage(const CChainParams& chainparams, CNode* pfrom, string
 
         pfrom->AddInventoryKnown(inv);
 
-        CValidationState state;
         // Process all blocks from whitelisted peers, even if not requested,
         // unless we're still syncing with the network.
         // Such an unrequested block may still be processed, subject to the
         // conditions in AcceptBlock().
         bool forceProcessing = pfrom->fWhitelisted && !IsInitialBlockDownload(chainparams.GetConsensus());
-        ProcessNewBlock(state, chainparams, pfrom, &block, forceProcessing, NULL);
-        int nDoS;
-        if (state.IsInvalid(nDoS)) {
-            pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
-                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-            if (nDoS > 0) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), nDoS);
+        ProcessPeerBlock(chainparams, pfrom, strCommand, block, forceProcessing);
+    }
+
+
+    else if (strCommand == "sendcmpct") {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        if (nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION) {
+            LOCK(cs_main);
+            State(pfrom->GetId())->fProvidesHeaderAndIDs = true;
+            State(pfrom->GetId())->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+        }
+    }
+
+
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) // Ignore compact blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        CBlock block;
+        bool fBlockReconstructed = false;
+        {
+            LOCK(cs_main);
+
+            if (mapBlockIndex.find(cmpctblock.header.hashPrevBlock) == mapBlockIndex.end()) {
+                // Doesn't connect (or is genesis), request the headers leading up to it instead
+                if (!IsInitialBlockDownload(chainparams.GetConsensus()))
+                    pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), uint256());
+                return true;
+            }
+
+            CBlockIndex* pindex = NULL;
+            CValidationState state;
+            if (!AcceptBlockHeader(cmpctblock.header, state, chainparams, &pindex)) {
+                int nDoS;
+                if (state.IsInvalid(nDoS)) {
+                    if (nDoS > 0)
+                        Misbehaving(pfrom->GetId(), nDoS);
+                    return error("invalid header received via cmpctblock from peer=%d", pfrom->id);
+                }
+            }
+            if (pindex == NULL)
+                return true;
+
+            UpdateBlockAvailability(pfrom->GetId(), pindex->GetBlockHash());
+            pfrom->AddInventoryKnown(CInv(MSG_BLOCK, pindex->GetBlockHash()));
+
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator>>::iterator blockInFlightIt = mapBlocksInFlight.find(pindex->GetBlockHash());
+            bool fAlreadyInFlight = blockInFlightIt != mapBlocksInFlight.end();
+
+            if (pindex->nStatus & BLOCK_HAVE_DATA) // Nothing to do here
+                return true;
+
+            vector<CInv> vGetBlock;
+            vGetBlock.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
+
+            if (pindex->nChainWork <= chainActive.Tip()->nChainWork || // We know something better
+                pindex->nTx != 0) {                                    // We had this block at some point, but pruned it
+                if (fAlreadyInFlight) {
+                    // We requested this block for some reason, but our mempool
+                    // will probably be useless, so just fetch the full block
+                    pfrom->PushMessage("getdata", vGetBlock);
+                }
+                return true;
+            }
+
+            // If we're not close to tip yet, let the parallel block fetch do its work
+            if (!fAlreadyInFlight && !CanDirectFetch(chainparams.GetConsensus()))
+                return true;
+
+            CNodeState* nodestate = State(pfrom->GetId());
+
+            if (pindex->nHeight <= chainActive.Height() + 2) {
+                if ((!fAlreadyInFlight && nodestate->nBlocksInFlight < GetBlocksInTransitLimit(nodestate->nAvgBlockDeliveryTime)) ||
+                    (fAlreadyInFlight && blockInFlightIt->second.first == pfrom->GetId())) {
+                    list<QueuedBlock>::iterator* queuedBlockIt = NULL;
+                    if (!MarkBlockAsInFlight(pfrom->GetId(), pindex->GetBlockHash(), chainparams.GetConsensus(), pindex, &queuedBlockIt)) {
+                        if (!(*queuedBlockIt)->partialBlock) {
+                            (*queuedBlockIt)->partialBlock.reset(new PartiallyDownloadedBlock(&mempool));
+                        } else {
+                            // The block was already in flight using compact blocks from the same peer
+                            LogPrint("net", "Peer %d sent us compact block we were already syncing\n", pfrom->id);
+                            return true;
+                        }
+                    }
+
+                    PartiallyDownloadedBlock& partialBlock = *(*queuedBlockIt)->partialBlock;
+                    ReadStatus status = partialBlock.InitData(cmpctblock);
+                    if (status == READ_STATUS_INVALID) {
+                        MarkBlockAsReceived(pindex->GetBlockHash()); // Reset in-flight state in case of whitelist
+                        Misbehaving(pfrom->GetId(), 100);
+                        return error("invalid compact block received from peer=%d", pfrom->id);
+                    } else if (status == READ_STATUS_FAILED) {
+                        // Duplicate short IDs; the block is in flight now, so just request it
+                        pfrom->PushMessage("getdata", vGetBlock);
+                        return true;
+                    }
+
+                    BlockTransactionsRequest req;
+                    for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                        if (!partialBlock.IsTxAvailable(i))
+                            req.indexes.push_back(i);
+                    }
+                    if (req.indexes.empty()) {
+                        // Every transaction was prefilled or found in our mempool
+                        BlockTransactions txn;
+                        txn.blockhash = pindex->GetBlockHash();
+                        fBlockReconstructed = FillCompactBlock(pfrom, txn, block);
+                    } else {
+                        req.blockhash = pindex->GetBlockHash();
+                        pfrom->PushMessage("getblocktxn", req);
+                    }
+                }
+            } else if (fAlreadyInFlight) {
+                // We requested this block, but it is far into the future, so
+                // our mempool will probably be useless; request it normally.
+                pfrom->PushMessage("getdata", vGetBlock);
+            }
+            // Otherwise the header is accepted and the block will be fetched
+            // by the regular block download logic.
+        }
+
+        if (fBlockReconstructed)
+            ProcessPeerBlock(chainparams, pfrom, strCommand, block, true);
+    }
+
+
+    else if (strCommand == "getblocktxn") {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+
+        BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+        if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return true;
+        }
+
+        if (it->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+            // Too deep to have been announced as a compact block; serve the
+            // full block through the normal getdata path instead, which also
+            // applies its checks against fingerprinting.
+            LogPrint("net", "Peer %d sent us a getblocktxn for a block > %i deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+            pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+            if (pfrom->vRecvGetData.size() == 1)
+                ProcessGetData(chainparams.GetConsensus(), pfrom);
+            return true;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, it->second, chainparams.GetConsensus()))
+            return error("%s: cannot load block %s from disk", __func__, req.blockhash.ToString());
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("peer=%d sent us a getblocktxn with out-of-bounds tx indices", pfrom->id);
             }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        pfrom->PushMessage("blocktxn", resp);
+    }
+
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        bool fBlockReconstructed;
+        {
+            LOCK(cs_main);
+            fBlockReconstructed = FillCompactBlock(pfrom, resp, block);
         }
 
+        if (fBlockReconstructed)
+            ProcessPeerBlock(chainparams, pfrom, strCommand, block, true);
     }
 
 
@@ -7241,16 +8095,35 @@ bool SendMessages(const Consensus::Params& consensusParams, CNode* pto, bool fSe
         // Message: getdata (blocks)
         //
         vector<CInv> vGetData;
-        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload(consensusParams)) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        int nBlocksInTransitLimit = GetBlocksInTransitLimit(state.nAvgBlockDeliveryTime);
+        // Blocks are not requested before a snapshot given with -loadsnapshot is loaded; it can only replace an empty chain.
+        if (!pto->fDisconnect && !pto->fClient && !fAwaitingSnapshot && (fFetch || !IsInitialBlockDownload(consensusParams)) && state.nBlocksInFlight < nBlocksInTransitLimit) {
             vector<CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller);
+            CBlockIndex* pindexStaller = NULL;
+            FindNextBlocksToDownload(pto->GetId(), nBlocksInTransitLimit - state.nBlocksInFlight, vToDownload, staller, pindexStaller);
             for (CBlockIndex* pindex : vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), consensusParams, pindex);
                 LogPrint("net", "Requesting block %s (%d) peer=%d\n", pindex->GetBlockHash().ToString(),
                          pindex->nHeight, pto->id);
             }
+            if (vToDownload.empty() && staller != -1 && pindexStaller != NULL) {
+                // Take over the block holding back the window if we expect
+                // to deliver it well before the peer it was requested from.
+                CNodeState* stallerState = State(staller);
+                const QueuedBlock& queuedBlock = *mapBlocksInFlight[pindexStaller->GetBlockHash()].second;
+                int64_t nInFlight = nNow - queuedBlock.nTime;
+                if (!queuedBlock.partialBlock && ShouldReassignBlock(nInFlight, state.nAvgBlockDeliveryTime, stallerState->nAvgBlockDeliveryTime)) {
+                    LogPrint("net", "Reassigning block %s (%d) from peer=%d to peer=%d\n", pindexStaller->GetBlockHash().ToString(),
+                             pindexStaller->nHeight, staller, pto->id);
+                    // Count the time it has been waiting as a delivery, to shrink the slow peer's window.
+                    stallerState->nAvgBlockDeliveryTime = UpdateBlockDeliveryTime(stallerState->nAvgBlockDeliveryTime, nInFlight);
+                    vGetData.push_back(CInv(MSG_BLOCK, pindexStaller->GetBlockHash()));
+                    MarkBlockAsInFlight(pto->GetId(), pindexStaller->GetBlockHash(), consensusParams, pindexStaller);
+                    staller = -1;
+                }
+            }
             if (state.nBlocksInFlight == 0 && staller != -1) {
                 if (State(staller)->nStallingSince == 0) {
                     State(staller)->nStallingSince = nNow;
@@ -7259,6 +8132,25 @@ bool SendMessages(const Consensus::Params& consensusParams, CNode* pto, bool fSe
             }
         }
 
+        // Near the tip, also ask one of the fastest peers for the next block
+        // if the peer it was requested from is slow to deliver it. Whichever
+        // copy arrives first is used; the other one is ignored.
+        if (!pto->fDisconnect && !pto->fClient && !IsInitialBlockDownload(consensusParams) &&
+            pindexBestHeader != NULL && pindexBestHeader->nHeight > chainActive.Height() && state.pindexBestKnownBlock != NULL) {
+            CBlockIndex* pindexNext = pindexBestHeader->GetAncestor(chainActive.Height() + 1);
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator>>::iterator itInFlight = mapBlocksInFlight.find(pindexNext->GetBlockHash());
+            if (itInFlight != mapBlocksInFlight.end() && itInFlight->second.first != pto->GetId() &&
+                !itInFlight->second.second->fRedundantRequested &&
+                itInFlight->second.second->nTime < nNow - 1000000 * (int64_t)BLOCK_REDUNDANT_REQUEST_TIMEOUT &&
+                state.pindexBestKnownBlock->GetAncestor(pindexNext->nHeight) == pindexNext &&
+                IsFastBlockDownloadPeer(pto->GetId(), BLOCK_REDUNDANT_REQUEST_PEERS)) {
+                LogPrint("net", "Requesting block %s (%d) redundantly from peer=%d, in flight from peer=%d\n", pindexNext->GetBlockHash().ToString(),
+                         pindexNext->nHeight, pto->id, itInFlight->second.first);
+                itInFlight->second.second->fRedundantRequested = true;
+                vGetData.push_back(CInv(MSG_BLOCK, pindexNext->GetBlockHash()));
+            }
+        }
+
         //
         // Message: getdata (non-blocks)
         //
@@ -24,17 +24,23 @@
 #include "script/sigcache.h"
 #include "script/standard.h"
 #include "spentindex.h"
+#include "streams.h"
 #include "sync.h"
 #include "tinyformat.h"
 #include "txmempool.h"
 #include "uint256.h"
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <exception>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -42,10 +48,13 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CCoinsViewDB;
 class CSporkDB;
 class CBloomFilter;
 class CInv;
 class CScriptCheck;
+class CSnapshotMetadata;
+class CTxLookupCache;
 class CValidationInterface;
 class CValidationState;
 
@@ -83,8 +92,30 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer. */
-static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Maximum depth of blocks served as cmpctblock; deeper blocks are sent in full */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** Maximum depth of blocks whose transactions are served with blocktxn; deeper blocks are sent in full */
+static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Maximum number of threads parsing and prechecking blocks during -reindex and -loadblock */
+static const int MAX_BLOCK_IMPORT_THREADS = 8;
+/** Serialized block data read ahead of the connecting thread during -reindex and -loadblock */
+static const size_t BLOCK_IMPORT_READ_AHEAD = 64 * 1024 * 1024;
+/** Memory for out-of-order blocks kept while their parent is missing during -reindex and -loadblock */
+static const size_t BLOCK_IMPORT_ORPHAN_MEMORY = 256 * 1024 * 1024;
+/** Number of blocks that can be requested at any given time from a peer that has not delivered any block yet. */
+static const int DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Bounds on the number of blocks in flight from a single peer, which is sized from its measured delivery rate. */
+static const int MIN_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 64;
+/** Seconds worth of a peer's measured block deliveries we keep requested from it. */
+static const unsigned int BLOCK_DOWNLOAD_QUEUE_TIME = 4;
+/** A block holding back the download window is requested from a faster peer once it has been in flight this many
+ *  times longer than that peer takes to deliver a block. */
+static const unsigned int BLOCK_REASSIGN_FACTOR = 4;
+/** Seconds after which the next block near the tip is also requested from one of the fastest peers. */
+static const unsigned int BLOCK_REDUNDANT_REQUEST_TIMEOUT = 2;
+/** Number of fastest peers that may be asked for a block near the tip that is slow to arrive. */
+static const unsigned int BLOCK_REDUNDANT_REQUEST_PEERS = 2;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -147,6 +178,7 @@ extern unsigned int expiryDelta;
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
 extern CTxMemPool mempool;
+extern CTxLookupCache txLookupCache;
 typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap mapBlockIndex;
 extern uint64_t nLastBlockTx;
@@ -157,11 +189,17 @@ extern CConditionVariable cvBlockChange;
 extern bool fExperimentalMode;
 extern bool fImporting;
 extern bool fReindex;
+/** Set while LoadUTXOSnapshot replaces the chain state: no block is connected and the coins cache is not flushed. Guarded by cs_main. */
+extern bool fLoadingSnapshot;
+/** Set while block download waits for the UTXO snapshot given with -loadsnapshot to be loaded. Guarded by cs_main. */
+extern bool fAwaitingSnapshot;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Block hash whose ancestors we assume to have valid scripts and shielded proofs (-assumevalid) */
+extern uint256 hashAssumeValid;
 
 extern bool fLargeWorkForkFound;
 extern bool fLargeWorkInvalidChainFound;
@@ -236,6 +274,53 @@ FILE* OpenBlockFile(const CDiskBlockPos& pos, bool fReadOnly = false);
 FILE* OpenUndoFile(const CDiskBlockPos& pos, bool fReadOnly = false);
 /** Translation to a filesystem path */
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos& pos, const char* prefix);
+
+/** A block record found in a block file by the import pipeline */
+struct CImportBlock {
+    uint64_t nPos;                     //!< Position of the serialized block in the file
+    size_t nSize;                      //!< Size of the serialized block
+    std::unique_ptr<CDataStream> data; //!< Serialized block, released once parsed
+    std::shared_ptr<CBlock> pblock;    //!< Parsed block, NULL if it could not be deserialized
+    bool fParsed;
+
+    CImportBlock(uint64_t nPosIn, std::unique_ptr<CDataStream> dataIn) : nPos(nPosIn), nSize(dataIn->size()), data(std::move(dataIn)), fParsed(false) {}
+};
+
+/**
+ * Reads a block file for LoadExternalBlockFile. A reader thread scans the file
+ * through a large buffer and queues every block record; worker threads
+ * deserialize and precheck the records, and Next() returns them in file order.
+ * At most BLOCK_IMPORT_READ_AHEAD bytes of blocks are buffered.
+ */
+class CBlockImportPipeline
+{
+private:
+    const CChainParams& chainparams;
+    std::mutex cs;
+    std::condition_variable condRead;
+    std::condition_variable condParse;
+    std::condition_variable condReady;
+    //! Records in file order that Next() has not returned yet
+    std::deque<std::shared_ptr<CImportBlock>> queueFile;
+    //! Records waiting for a worker
+    std::deque<std::shared_ptr<CImportBlock>> queueParse;
+    size_t nBytesQueued;
+    bool fEof;
+    bool fStop;
+    std::vector<std::thread> threads;
+
+    void ThreadRead(FILE* fileIn);
+    void ThreadParse();
+
+public:
+    //! Takes over fileIn and closes it when the file has been read
+    CBlockImportPipeline(FILE* fileIn, const CChainParams& chainparamsIn, int nWorkers);
+    ~CBlockImportPipeline();
+
+    /** Wait for the next block record of the file. Returns false at the end of the file. */
+    bool Next(std::shared_ptr<CImportBlock>& record);
+};
+
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp = NULL);
 /** Initialize a new block tree database + block data on disk */
@@ -261,6 +346,12 @@ bool IsInitialBlockDownload(const Consensus::Params& params);
 std::pair<std::string, int64_t> GetWarnings(const std::string& strFor);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransaction& tx, const Consensus::Params& consensusParams, uint256& hashBlock, bool fAllowSlow = false);
+/**
+ * Look up several transactions like GetTransaction. With -txindex, transactions
+ * that are neither in the mempool nor in the lookup cache are read from the
+ * block files in file position order. vFound[i] is set if hashes[i] was found.
+ */
+void GetTransactions(const std::vector<uint256>& hashes, std::vector<CTransaction>& txOut, std::vector<uint256>& hashBlocks, std::vector<bool>& vFound, const Consensus::Params& consensusParams, bool fAllowSlow = false);
 
 /** Find the best known block, and make it the tip of the block chain */
 bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams, CBlock* pblock = NULL);
@@ -294,10 +385,26 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune);
 CBlockIndex* InsertBlockIndex(uint256 hash);
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats);
+/** Moving average of a peer's block delivery time (in microseconds, 0 if unknown) after it took nDeliveryTime for a block. */
+int64_t UpdateBlockDeliveryTime(int64_t nAvgBlockDeliveryTime, int64_t nDeliveryTime);
+/** Number of blocks to keep in flight from a peer with the given average block delivery time. */
+int GetBlocksInTransitLimit(int64_t nAvgBlockDeliveryTime);
+/** Whether a peer should take over a block that has been in flight for nInFlight microseconds from the peer holding
+ *  back the download window, given both peers' average block delivery times. */
+bool ShouldReassignBlock(int64_t nInFlight, int64_t nAvgBlockDeliveryTime, int64_t nStallerAvgBlockDeliveryTime);
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch);
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
+/** Get the incrementally maintained statistics of the UTXO set at the chain tip. */
+bool GetUTXOStats(CCoinsStats& stats);
+/**
+ * Make pindexBase the active tip after its chain state was written from a
+ * UTXO snapshot described by metadata. The coins cache must be empty.
+ */
+bool ActivateUTXOSnapshot(CBlockIndex* pindexBase, const CSnapshotMetadata& metadata);
+/** Whether the chain state was loaded from a UTXO snapshot, so that no blocks below it are stored. Requires cs_main. */
+bool HaveUTXOSnapshot();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 /** See whether the protocol update is enforced for connected nodes */
@@ -318,6 +425,8 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nBlocksInTransitLimit;
+    int64_t nBlockDeliveryTime;
 };
 
 struct CTimestampIndexIteratorKey {
@@ -752,7 +861,7 @@ bool CheckMnTx(const CTransaction& tx);
 bool CheckBlacklistTx(const CTransaction& tx, int height);
 
 /** Check a transaction contextually against a set of consensus rules */
-bool ContextualCheckTransaction(const CTransaction& tx, CValidationState& state, const CChainParams& chainparams, int nHeight, int dosLevel, bool (*isInitBlockDownload)(const Consensus::Params&) = IsInitialBlockDownload);
+bool ContextualCheckTransaction(const CTransaction& tx, CValidationState& state, const CChainParams& chainparams, int nHeight, int dosLevel, bool (*isInitBlockDownload)(const Consensus::Params&) = IsInitialBlockDownload, bool fCheckProofs = true);
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
@@ -881,7 +990,10 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const CChainParams
 
 /** Context-dependent validity checks */
 bool ContextualCheckBlockHeader(const CBlockHeader& block, const CChainParams& chainparams, CValidationState& state, CBlockIndex* pindexPrev);
-bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexPrev);
+bool ContextualCheckBlock(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexPrev, bool fCheckProofs = true);
+
+/** Whether script and shielded proof checks may be skipped for a block because it is an ancestor of the -assumevalid block */
+bool IsAssumedValid(const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block, with cs_main held) */
 bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
@@ -894,7 +1006,7 @@ bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams,
  * If dbp is non-NULL, the file is known to already reside on disk
  */
 bool AcceptBlock(CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** pindex, bool fRequested, CDiskBlockPos* dbp);
-bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex = NULL);
+bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex = NULL, bool fCheckPOW = true);
 
 
 /**
@@ -929,6 +1041,9 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex);
 /** The currently-connected chain of blocks. */
 extern CChain chainActive;
 
+/** Global variable that points to the coin database (protected by cs_main) */
+extern CCoinsViewDB* pcoinsdbview;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache* pcoinsTip;
 
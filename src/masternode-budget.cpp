@@ -9,6 +9,7 @@
 
 #include "addrman.h"
 #include "masternode-budget.h"
+#include "masternode-seendb.h"
 #include "masternode-sync.h"
 #include "masternode.h"
 #include "masternodeman.h"
@@ -127,22 +128,26 @@ void CBudgetManager::CheckOrphanVotes()
 
 
     std::string strError = "";
-    auto it1 = mapOrphanMasternodeBudgetVotes.begin();
-    while (it1 != mapOrphanMasternodeBudgetVotes.end()) {
-        if (budget.UpdateProposal(((*it1).second), NULL, strError)) {
+    std::vector<uint256> vActivated;
+    for (const auto& it1 : mapOrphanMasternodeBudgetVotes) {
+        if (budget.UpdateProposal(it1.second, NULL, strError)) {
             LogPrint("masternode", "%s: Proposal/Budget is known, activating and removing orphan vote\n", __func__);
-            mapOrphanMasternodeBudgetVotes.erase(it1);
+            vActivated.push_back(it1.first);
         }
-        ++it1;
     }
-    auto it2 = mapOrphanFinalizedBudgetVotes.begin();
-    while (it2 != mapOrphanFinalizedBudgetVotes.end()) {
-        if (budget.UpdateFinalizedBudget(((*it2).second), NULL, strError)) {
+    for (const uint256& hash : vActivated)
+        mapOrphanMasternodeBudgetVotes.erase(hash);
+
+    vActivated.clear();
+    for (const auto& it2 : mapOrphanFinalizedBudgetVotes) {
+        CFinalizedBudgetVote vote = it2.second;
+        if (budget.UpdateFinalizedBudget(vote, NULL, strError)) {
             LogPrint("masternode", "%s: Proposal/Budget is known, activating and removing orphan vote\n", __func__);
-            mapOrphanFinalizedBudgetVotes.erase(it2);
+            vActivated.push_back(it2.first);
         }
-        ++it2;
     }
+    for (const uint256& hash : vActivated)
+        mapOrphanFinalizedBudgetVotes.erase(hash);
     LogPrint("masternode", "CBudgetManager::CheckOrphanVotes - Done\n");
 }
 
@@ -253,10 +258,8 @@ void CBudgetManager::SubmitFinalBudget()
 // CBudgetDB
 //
 
-CBudgetDB::CBudgetDB()
+CBudgetDB::CBudgetDB() : CMasternodeCacheFile("budget.dat", "MasternodeBudget")
 {
-    pathDB = GetDataDir() / "budget.dat";
-    strMagicMessage = "MasternodeBudget";
 }
 
 bool CBudgetDB::Write(const CBudgetManager& objToSave)
@@ -265,27 +268,8 @@ bool CBudgetDB::Write(const CBudgetManager& objToSave)
 
     int64_t nStart = GetTimeMillis();
 
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // masternode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    fileout.fclose();
+    if (!WriteObject(objToSave))
+        return false;
 
     LogPrint("masternode", "Written info to budget.dat  %dms\n", GetTimeMillis() - nStart);
 
@@ -297,66 +281,13 @@ CBudgetDB::ReadResult CBudgetDB::Read(CBudgetManager& objToLoad, bool fDryRun)
     LOCK(objToLoad.cs);
 
     int64_t nStart = GetTimeMillis();
-    // open input file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "rb");
-    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        error("%s : Failed to open file %s", __func__, pathDB.string());
-        return FileError;
-    }
-
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathDB);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return HashReadError;
-    }
-    filein.fclose();
-
-    CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-    if (hashIn != hashTmp) {
-        error("%s : Checksum mismatch, data corrupted", __func__);
-        return IncorrectHash;
-    }
 
+    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+    ReadResult result = ReadStream(ssObj);
+    if (result != Ok)
+        return result;
 
-    unsigned char pchMsgTmp[4];
-    std::string strMagicMessageTmp;
     try {
-        // de-serialize file header (masternode cache file specific magic message) and ..
-        ssObj >> strMagicMessageTmp;
-
-        // ... verify the message matches predefined one
-        if (strMagicMessage != strMagicMessageTmp) {
-            error("%s : Invalid masternode cache magic message", __func__);
-            return IncorrectMagicMessage;
-        }
-
-
-        // de-serialize file header (network specific magic number) and ..
-        ssObj >> FLATDATA(pchMsgTmp);
-
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
-            error("%s : Invalid network magic number", __func__);
-            return IncorrectMagicNumber;
-        }
-
         // de-serialize data into CBudgetManager object
         ssObj >> objToLoad;
     } catch (std::exception& e) {
@@ -382,10 +313,9 @@ void DumpBudgets()
     int64_t nStart = GetTimeMillis();
 
     CBudgetDB budgetdb;
-    CBudgetManager tempBudget;
 
     LogPrint("masternode", "Verifying budget.dat format...\n");
-    CBudgetDB::ReadResult readResult = budgetdb.Read(tempBudget, true);
+    CBudgetDB::ReadResult readResult = budgetdb.Verify();
     // there was an error and it was not an error on file opening => do not proceed
     if (readResult == CBudgetDB::FileError)
         LogPrint("masternode", "Missing budgets file - budget.dat, will try to recreate\n");
@@ -400,6 +330,8 @@ void DumpBudgets()
     }
     LogPrint("masternode", "Writting info to budget.dat...\n");
     budgetdb.Write(budget);
+    if (pMasternodeSeenDB)
+        budget.WriteVoteChanges(*pMasternodeSeenDB);
 
     LogPrint("masternode", "Budget dump finished  %dms\n", GetTimeMillis() - nStart);
 }
@@ -433,6 +365,7 @@ bool CBudgetManager::AddProposal(CBudgetProposal& budgetProposal)
     }
 
     mapProposals.insert(make_pair(budgetProposal.GetHash(), budgetProposal));
+    nBudgetGeneration++;
     LogPrint("masternode", "CBudgetManager::AddProposal - proposal %s added\n", budgetProposal.GetName().c_str());
     return true;
 }
@@ -448,6 +381,8 @@ void CBudgetManager::CheckAndRemove()
         CFinalizedBudget* pfinalizedBudget = &(it.second);
         if (!pfinalizedBudget->UpdateValid(nCurrentHeight)) {
             LogPrint("mnbudget", "%s: Invalid finalized budget: %s\n", __func__, pfinalizedBudget->IsInvalidReason());
+            for (const auto& itVote : pfinalizedBudget->GetVotes())
+                setFinalizedVotesChanged.insert(std::make_pair(it.first, itVote.first));
         } else {
             LogPrint("mnbudget", "%s: Found valid finalized budget: %s %s\n", __func__,
                      pfinalizedBudget->GetName(), pfinalizedBudget->GetFeeTXHash().ToString());
@@ -461,6 +396,8 @@ void CBudgetManager::CheckAndRemove()
         CBudgetProposal* pbudgetProposal = &(it.second);
         if (!pbudgetProposal->UpdateValid(nCurrentHeight)) {
             LogPrint("mnbudget", "%s: Invalid budget proposal - %s\n", __func__, pbudgetProposal->IsInvalidReason());
+            for (const auto& itVote : pbudgetProposal->GetVotes())
+                setProposalVotesChanged.insert(std::make_pair(it.first, itVote.first));
         } else {
             LogPrint("mnbudget", "%s: Found valid budget proposal: %s %s\n", __func__,
                      pbudgetProposal->GetName(), pbudgetProposal->GetFeeTXHash().ToString());
@@ -471,6 +408,7 @@ void CBudgetManager::CheckAndRemove()
     // Remove invalid entries by overwriting complete map
     mapFinalizedBudgets.swap(tmpMapFinalizedBudgets);
     mapProposals.swap(tmpMapProposals);
+    nBudgetGeneration++;
 
     LogPrint("mnbudget", "%s: mapFinalizedBudgets cleanup - size after: %d\n", __func__, mapFinalizedBudgets.size());
     LogPrint("mnbudget", "%s: mapProposals cleanup - size after: %d\n", __func__, mapProposals.size());
@@ -689,8 +627,6 @@ std::vector<CBudgetProposal*> CBudgetManager::GetAllProposals()
 
     std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin();
     while (it != mapProposals.end()) {
-        (*it).second.CleanAndRemove();
-
         CBudgetProposal* pbudgetProposal = &((*it).second);
         vBudgetProposalRet.push_back(pbudgetProposal);
 
@@ -717,13 +653,27 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
 {
     LOCK(cs);
 
+    std::vector<CBudgetProposal*> vBudgetProposalsRet;
+
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    if (pindexPrev == NULL)
+        return vBudgetProposalsRet;
+
+    const int nMnCount = mnodeman.CountEnabled(ActiveProtocol());
+    const uint64_t nListVersion = mnodeman.GetListVersion();
+
+    // invalid votes are dropped by NewBlock() every 14 blocks, so the ranking only
+    // changes with the proposals, their votes, the tip and the masternode list
+    if (nBudgetCacheGeneration == nBudgetGeneration && hashBudgetCacheTip == pindexPrev->GetBlockHash() &&
+        nBudgetCacheListVersion == nListVersion && nBudgetCacheMnCount == nMnCount)
+        return vBudgetCache;
+
     // ------- Sort budgets by Yes Count
 
     std::vector<std::pair<CBudgetProposal*, int>> vBudgetPorposalsSort;
 
     std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin();
     while (it != mapProposals.end()) {
-        (*it).second.CleanAndRemove();
         vBudgetPorposalsSort.push_back(make_pair(&((*it).second), (*it).second.GetYeas() - (*it).second.GetNays()));
         ++it;
     }
@@ -732,12 +682,7 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
 
     // ------- Grab The Budgets In Order
 
-    std::vector<CBudgetProposal*> vBudgetProposalsRet;
-
     CAmount nBudgetAllocated = 0;
-    CBlockIndex* pindexPrev = chainActive.Tip();
-    if (pindexPrev == NULL)
-        return vBudgetProposalsRet;
 
     int nBlockStart = pindexPrev->nHeight - pindexPrev->nHeight % GetBudgetPaymentCycleBlocks() + GetBudgetPaymentCycleBlocks();
     int nBlockEnd = nBlockStart + GetBudgetPaymentCycleBlocks() - 1;
@@ -752,11 +697,11 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
         // prop start/end should be inside this period
         if (pbudgetProposal->IsValid() && pbudgetProposal->GetBlockStart() <= nBlockStart &&
             pbudgetProposal->GetBlockEnd() >= nBlockEnd &&
-            pbudgetProposal->GetYeas() - pbudgetProposal->GetNays() > mnodeman.CountEnabled(ActiveProtocol()) / 10 &&
+            pbudgetProposal->GetYeas() - pbudgetProposal->GetNays() > nMnCount / 10 &&
             pbudgetProposal->IsEstablished()) {
             LogPrint("masternode", "CBudgetManager::GetBudget() -   Check 1 passed: valid=%d | %ld <= %ld | %ld >= %ld | Yeas=%d Nays=%d Count=%d | established=%d\n",
                      pbudgetProposal->IsValid(), pbudgetProposal->GetBlockStart(), nBlockStart, pbudgetProposal->GetBlockEnd(),
-                     nBlockEnd, pbudgetProposal->GetYeas(), pbudgetProposal->GetNays(), mnodeman.CountEnabled(ActiveProtocol()) / 10,
+                     nBlockEnd, pbudgetProposal->GetYeas(), pbudgetProposal->GetNays(), nMnCount / 10,
                      pbudgetProposal->IsEstablished());
 
             if (pbudgetProposal->GetAmount() + nBudgetAllocated <= nTotalBudget) {
@@ -771,13 +716,19 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
         } else {
             LogPrint("masternode", "CBudgetManager::GetBudget() -   Check 1 failed: valid=%d | %ld <= %ld | %ld >= %ld | Yeas=%d Nays=%d Count=%d | established=%d\n",
                      pbudgetProposal->IsValid(), pbudgetProposal->GetBlockStart(), nBlockStart, pbudgetProposal->GetBlockEnd(),
-                     nBlockEnd, pbudgetProposal->GetYeas(), pbudgetProposal->GetNays(), mnodeman.CountEnabled(ActiveProtocol()) / 10,
+                     nBlockEnd, pbudgetProposal->GetYeas(), pbudgetProposal->GetNays(), nMnCount / 10,
                      pbudgetProposal->IsEstablished());
         }
 
         ++it2;
     }
 
+    vBudgetCache = vBudgetProposalsRet;
+    nBudgetCacheGeneration = nBudgetGeneration;
+    hashBudgetCacheTip = pindexPrev->GetBlockHash();
+    nBudgetCacheListVersion = nListVersion;
+    nBudgetCacheMnCount = nMnCount;
+
     return vBudgetProposalsRet;
 }
 
@@ -926,6 +877,7 @@ void CBudgetManager::NewBlock(int height)
     if (!fBudgetNewBlock)
         return;
     SetBestHeight(height);
+    nBudgetGeneration++;
 
     if (masternodeSync.RequestedMasternodeAssets <= MASTERNODE_SYNC_BUDGET)
         return;
@@ -973,7 +925,8 @@ void CBudgetManager::NewBlock(int height)
     LogPrint("masternode", "CBudgetManager::NewBlock - mapProposals cleanup - size: %d\n", mapProposals.size());
     std::map<uint256, CBudgetProposal>::iterator it2 = mapProposals.begin();
     while (it2 != mapProposals.end()) {
-        (*it2).second.CleanAndRemove();
+        if ((*it2).second.CleanAndRemove())
+            nBudgetGeneration++;
         ++it2;
     }
 
@@ -1309,7 +1262,7 @@ bool CBudgetManager::UpdateProposal(const CBudgetVote& vote, CNode* pfrom, std::
                 return false;
 
             LogPrint("masternode", "CBudgetManager::UpdateProposal - Unknown proposal %d, asking for source proposal\n", nProposalHash.ToString());
-            mapOrphanMasternodeBudgetVotes[nProposalHash] = vote;
+            mapOrphanMasternodeBudgetVotes.set(nProposalHash, vote);
 
             if (!askedForSourceProposalOrBudget.count(nProposalHash)) {
                 pfrom->PushMessage("mnvs", nProposalHash);
@@ -1322,7 +1275,12 @@ bool CBudgetManager::UpdateProposal(const CBudgetVote& vote, CNode* pfrom, std::
     }
 
 
-    return mapProposals[nProposalHash].AddOrUpdateVote(vote, strError);
+    if (!mapProposals[nProposalHash].AddOrUpdateVote(vote, strError))
+        return false;
+
+    setProposalVotesChanged.insert(std::make_pair(nProposalHash, vote.GetVin().prevout.GetHash()));
+    nBudgetGeneration++;
+    return true;
 }
 
 bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pfrom, std::string& strError)
@@ -1338,7 +1296,7 @@ bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pf
                 return false;
 
             LogPrint("masternode", "CBudgetManager::UpdateFinalizedBudget - Unknown Finalized Proposal %s, asking for source budget\n", nBudgetHash.ToString());
-            mapOrphanFinalizedBudgetVotes[nBudgetHash] = vote;
+            mapOrphanFinalizedBudgetVotes.set(nBudgetHash, vote);
 
             if (!askedForSourceProposalOrBudget.count(nBudgetHash)) {
                 pfrom->PushMessage("mnvs", nBudgetHash);
@@ -1350,7 +1308,83 @@ bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pf
         return false;
     }
     LogPrint("masternode", "CBudgetManager::UpdateFinalizedBudget - Finalized Proposal %s added\n", nBudgetHash.ToString());
-    return mapFinalizedBudgets[nBudgetHash].AddOrUpdateVote(vote, strError);
+    if (!mapFinalizedBudgets[nBudgetHash].AddOrUpdateVote(vote, strError))
+        return false;
+
+    setFinalizedVotesChanged.insert(std::make_pair(nBudgetHash, vote.GetVin().prevout.GetHash()));
+    return true;
+}
+
+void CBudgetManager::MarkVotesChanged()
+{
+    for (const auto& it : mapProposals) {
+        for (const auto& itVote : it.second.GetVotes())
+            setProposalVotesChanged.insert(std::make_pair(it.first, itVote.first));
+    }
+    for (const auto& it : mapFinalizedBudgets) {
+        for (const auto& itVote : it.second.GetVotes())
+            setFinalizedVotesChanged.insert(std::make_pair(it.first, itVote.first));
+    }
+}
+
+bool CBudgetManager::LoadVotes(CMasternodeSeenDB& db)
+{
+    LOCK(cs);
+    int64_t nStart = GetTimeMillis();
+    size_t nVotes = 0;
+    std::string strError;
+
+    // Votes whose proposal or budget is gone are erased with the next changes
+    typedef std::pair<uint256, uint256> VoteKey;
+    if (!db.LoadEntries<VoteKey, CBudgetVote>(DB_BUDGET_VOTE, [&](const VoteKey& key, const CBudgetVote& vote) {
+            auto it = mapProposals.find(key.first);
+            if (it != mapProposals.end() && it->second.AddOrUpdateVote(vote, strError))
+                nVotes++;
+            else
+                setProposalVotesChanged.insert(key);
+        }))
+        return false;
+    if (!db.LoadEntries<VoteKey, CFinalizedBudgetVote>(DB_FINALIZED_BUDGET_VOTE, [&](const VoteKey& key, const CFinalizedBudgetVote& vote) {
+            auto it = mapFinalizedBudgets.find(key.first);
+            if (it != mapFinalizedBudgets.end() && it->second.AddOrUpdateVote(vote, strError))
+                nVotes++;
+            else
+                setFinalizedVotesChanged.insert(key);
+        }))
+        return false;
+    nBudgetGeneration++;
+
+    LogPrint("masternode", "Loaded %d budget votes  %dms\n", nVotes, GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CBudgetManager::WriteVoteChanges(CMasternodeSeenDB& db)
+{
+    LOCK(cs);
+    int64_t nStart = GetTimeMillis();
+    size_t nChanges = setProposalVotesChanged.size() + setFinalizedVotesChanged.size();
+
+    typedef std::pair<uint256, uint256> VoteKey;
+    if (!db.WriteEntries(DB_BUDGET_VOTE, setProposalVotesChanged, [this](const VoteKey& key) -> const CBudgetVote* {
+            auto it = mapProposals.find(key.first);
+            if (it == mapProposals.end())
+                return NULL;
+            auto itVote = it->second.GetVotes().find(key.second);
+            return itVote != it->second.GetVotes().end() ? &itVote->second : NULL;
+        }) ||
+        !db.WriteEntries(DB_FINALIZED_BUDGET_VOTE, setFinalizedVotesChanged, [this](const VoteKey& key) -> const CFinalizedBudgetVote* {
+            auto it = mapFinalizedBudgets.find(key.first);
+            if (it == mapFinalizedBudgets.end())
+                return NULL;
+            auto itVote = it->second.GetVotes().find(key.second);
+            return itVote != it->second.GetVotes().end() ? &itVote->second : NULL;
+        }))
+        return error("%s : failed to write the budget votes", __func__);
+    setProposalVotesChanged.clear();
+    setFinalizedVotesChanged.clear();
+
+    LogPrint("masternode", "Written %d budget vote changes  %dms\n", nChanges, GetTimeMillis() - nStart);
+    return true;
 }
 
 CBudgetProposal::CBudgetProposal()
@@ -1362,6 +1396,7 @@ CBudgetProposal::CBudgetProposal()
     nTime = 0;
     fValid = true;
     strInvalid = "";
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strURLIn, int nBlockStartIn, int nBlockEndIn, CScript addressIn, CAmount nAmountIn, uint256 nFeeTXHashIn)
@@ -1375,6 +1410,7 @@ CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strU
     nFeeTXHash = nFeeTXHashIn;
     fValid = true;
     strInvalid = "";
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
@@ -1389,6 +1425,24 @@ CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
     nFeeTXHash = other.nFeeTXHash;
     mapVotes = other.mapVotes;
     fValid = true;
+    for (int i = 0; i < 3; i++)
+        nVoteCounts[i] = other.nVoteCounts[i];
+}
+
+void CBudgetProposal::CountVote(const CBudgetVote& vote, int nDelta)
+{
+    const int vd = vote.GetDirection();
+    if (vote.IsValid() && vd >= CBudgetVote::VOTE_ABSTAIN && vd <= CBudgetVote::VOTE_NO)
+        nVoteCounts[vd] += nDelta;
+}
+
+void CBudgetProposal::RecountVotes()
+{
+    LOCK(cs);
+    for (int i = 0; i < 3; i++)
+        nVoteCounts[i] = 0;
+    for (const auto& it : mapVotes)
+        CountVote(it.second, 1);
 }
 
 void CBudgetProposal::SyncVotes(CNode* pfrom, bool fPartial, int& nInvCount) const
@@ -1515,8 +1569,9 @@ bool CBudgetProposal::AddOrUpdateVote(const CBudgetVote& vote, std::string& strE
     const uint256& hash = vote.GetVin().prevout.GetHash();
     const int64_t voteTime = vote.GetTime();
 
-    if (mapVotes.count(hash)) {
-        const int64_t& oldTime = mapVotes[hash].GetTime();
+    std::map<uint256, CBudgetVote>::iterator itOld = mapVotes.find(hash);
+    if (itOld != mapVotes.end()) {
+        const int64_t& oldTime = itOld->second.GetTime();
         if (oldTime > voteTime) {
             strError = strprintf("new vote older than existing vote - %s\n", vote.GetHash().ToString());
             LogPrint("mnbudget", "CBudgetProposal::AddOrUpdateVote - %s\n", strError);
@@ -1536,7 +1591,10 @@ bool CBudgetProposal::AddOrUpdateVote(const CBudgetVote& vote, std::string& strE
         return false;
     }
 
+    if (itOld != mapVotes.end())
+        CountVote(itOld->second, -1);
     mapVotes[hash] = vote;
+    CountVote(vote, 1);
     LogPrint("mnbudget", "CBudgetProposal::AddOrUpdateVote - %s %s\n", strAction.c_str(), vote.GetHash().ToString().c_str());
 
     return true;
@@ -1567,15 +1625,23 @@ void CBudgetProposal::SetSynced(bool synced)
 }
 
 // If masternode voted for a proposal, but is now invalid -- remove the vote
-void CBudgetProposal::CleanAndRemove()
+bool CBudgetProposal::CleanAndRemove()
 {
+    LOCK(cs);
+    bool fChanged = false;
     std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
         CMasternode* pmn = mnodeman.Find((*it).second.GetVin());
-        (*it).second.SetValid(pmn != nullptr);
+        if ((*it).second.IsValid() != (pmn != nullptr)) {
+            CountVote((*it).second, -1);
+            (*it).second.SetValid(pmn != nullptr);
+            CountVote((*it).second, 1);
+            fChanged = true;
+        }
         ++it;
     }
+    return fChanged;
 }
 
 double CBudgetProposal::GetRatio() const
@@ -1592,13 +1658,9 @@ double CBudgetProposal::GetRatio() const
 int CBudgetProposal::GetVoteCount(CBudgetVote::VoteDirection vd) const
 {
     LOCK(cs);
-    int ret = 0;
-    for (const auto& it : mapVotes) {
-        const CBudgetVote& vote = it.second;
-        if (vote.GetDirection() == vd && vote.IsValid())
-            ret++;
-    }
-    return ret;
+    if (vd < CBudgetVote::VOTE_ABSTAIN || vd > CBudgetVote::VOTE_NO)
+        return 0;
+    return nVoteCounts[vd];
 }
 
 int CBudgetProposal::GetBlockStartCycle() const
@@ -2271,7 +2333,9 @@ std::string CBudgetManager::ToString() const
 {
     std::ostringstream info;
 
-    info << "Proposals: " << (int)mapProposals.size() << ", Budgets: " << (int)mapFinalizedBudgets.size() << ", Seen Budgets: " << (int)mapSeenMasternodeBudgetProposals.size() << ", Seen Budget Votes: " << (int)mapSeenMasternodeBudgetVotes.size() << ", Seen Final Budgets: " << (int)mapSeenFinalizedBudgets.size() << ", Seen Final Budget Votes: " << (int)mapSeenFinalizedBudgetVotes.size();
+    info << "Proposals: " << (int)mapProposals.size() << ", Budgets: " << (int)mapFinalizedBudgets.size() << ", Seen Budgets: " << (int)mapSeenMasternodeBudgetProposals.size() << ", Seen Budget Votes: " << (int)mapSeenMasternodeBudgetVotes.size() << ", Seen Final Budgets: " << (int)mapSeenFinalizedBudgets.size() << ", Seen Final Budget Votes: " << (int)mapSeenFinalizedBudgetVotes.size()
+         << ", Orphan Votes: " << (int)(mapOrphanMasternodeBudgetVotes.size() + mapOrphanFinalizedBudgetVotes.size())
+         << ", Seen Votes Memory: " << (mapSeenMasternodeBudgetVotes.DynamicMemoryUsage() + mapSeenFinalizedBudgetVotes.DynamicMemoryUsage()) / 1024 << " KiB";
 
     return info.str();
 }
@@ -11,8 +11,10 @@
 #include "init.h"
 #include "key.h"
 #include "main.h"
+#include "masternode-cachefile.h"
 #include "masternode.h"
 #include "net.h"
+#include "seenmessagemap.h"
 #include "sync.h"
 #include "util.h"
 
@@ -28,6 +30,7 @@ class CFinalizedBudget;
 class CBudgetProposal;
 class CBudgetProposalBroadcast;
 class CTxBudgetPayment;
+class CMasternodeSeenDB;
 
 enum class TrxValidationStatus {
     InValid,       /** Transaction verification failed */
@@ -39,6 +42,10 @@ enum class TrxValidationStatus {
 static const CAmount PROPOSAL_FEE_TX = (50 * COIN);
 static const CAmount BUDGET_FEE_TX = (50 * COIN);
 static const int64_t BUDGET_VOTE_UPDATE_MIN = 60 * 60;
+//! Most budget votes kept in the seen maps, per vote kind
+static const size_t MAX_SEEN_BUDGET_VOTES = 500000;
+//! Most orphan budget votes kept, per vote kind
+static const size_t MAX_ORPHAN_BUDGET_VOTES = 10000;
 static std::map<uint256, int> mapPayment_History;
 
 extern std::vector<CBudgetProposalBroadcast> vecImmatureBudgetProposals;
@@ -182,25 +189,53 @@ public:
     }
 };
 
-/** Save Budget Manager (budget.dat)
+struct BudgetVoteTime {
+    int64_t operator()(const CBudgetVote& vote) const { return vote.GetTime(); }
+    int64_t operator()(const CFinalizedBudgetVote& vote) const { return vote.GetTime(); }
+};
+
+/**
+ * Stands in for the proposal or finalized budget map in the serialization of the
+ * budget manager, whose votes are kept in CMasternodeSeenDB: writes the objects
+ * with an empty vote map. Files written before that still carry the votes.
  */
-class CBudgetDB
+template <typename Map>
+class CBudgetMapWithoutVotes
 {
 private:
-    boost::filesystem::path pathDB;
-    std::string strMagicMessage;
+    Map& map;
 
 public:
-    enum ReadResult {
-        Ok,
-        FileError,
-        HashReadError,
-        IncorrectHash,
-        IncorrectMagicMessage,
-        IncorrectMagicNumber,
-        IncorrectFormat
-    };
+    explicit CBudgetMapWithoutVotes(Map& mapIn) : map(mapIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, map.size());
+        for (const auto& it : map) {
+            ::Serialize(s, it.first);
+            it.second.SerializeWithoutVotes(s);
+        }
+    }
 
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        ::Unserialize(s, map);
+    }
+};
+
+template <typename Map>
+CBudgetMapWithoutVotes<Map> BudgetMapWithoutVotes(Map& map)
+{
+    return CBudgetMapWithoutVotes<Map>(map);
+}
+
+/** Save Budget Manager (budget.dat)
+ */
+class CBudgetDB : public CMasternodeCacheFile
+{
+public:
     CBudgetDB();
     bool Write(const CBudgetManager& objToSave);
     ReadResult Read(CBudgetManager& objToLoad, bool fDryRun = false);
@@ -223,21 +258,46 @@ private:
     map<uint256, CFinalizedBudget> mapFinalizedBudgets;
 
     std::map<uint256, CBudgetProposalBroadcast> mapSeenMasternodeBudgetProposals;
-    std::map<uint256, CBudgetVote> mapSeenMasternodeBudgetVotes;
-    std::map<uint256, CBudgetVote> mapOrphanMasternodeBudgetVotes;
+    seenmessagemap<CBudgetVote, BudgetVoteTime> mapSeenMasternodeBudgetVotes;
+    seenmessagemap<CBudgetVote, BudgetVoteTime> mapOrphanMasternodeBudgetVotes;
     std::map<uint256, CFinalizedBudgetBroadcast> mapSeenFinalizedBudgets;
-    std::map<uint256, CFinalizedBudgetVote> mapSeenFinalizedBudgetVotes;
-    std::map<uint256, CFinalizedBudgetVote> mapOrphanFinalizedBudgetVotes;
+    seenmessagemap<CFinalizedBudgetVote, BudgetVoteTime> mapSeenFinalizedBudgetVotes;
+    seenmessagemap<CFinalizedBudgetVote, BudgetVoteTime> mapOrphanFinalizedBudgetVotes;
+
+    // (proposal or budget hash, masternode collateral hash) of the votes added, replaced
+    // or removed since they were last written to CMasternodeSeenDB
+    std::set<std::pair<uint256, uint256>> setProposalVotesChanged;
+    std::set<std::pair<uint256, uint256>> setFinalizedVotesChanged;
+
+    // record every vote held as changed, so that it is written or erased with the next changes
+    void MarkVotesChanged();
 
     void SetSynced(bool synced);
 
     // Memory Only. Updated in NewBlock (blocks arrive in order)
     std::atomic<int> nBestHeight;
 
+    // bumped whenever a proposal or one of its votes is added or removed, and on every new tip
+    uint64_t nBudgetGeneration;
+    // last GetBudget() result and what it was ranked against; it points into mapProposals,
+    // so anything that reshuffles that map has to bump nBudgetGeneration
+    std::vector<CBudgetProposal*> vBudgetCache;
+    uint64_t nBudgetCacheGeneration;
+    uint256 hashBudgetCacheTip;
+    uint64_t nBudgetCacheListVersion;
+    int nBudgetCacheMnCount;
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
-    CBudgetManager()
+    CBudgetManager() : mapSeenMasternodeBudgetVotes(MAX_SEEN_BUDGET_VOTES),
+                       mapOrphanMasternodeBudgetVotes(MAX_ORPHAN_BUDGET_VOTES),
+                       mapSeenFinalizedBudgetVotes(MAX_SEEN_BUDGET_VOTES),
+                       mapOrphanFinalizedBudgetVotes(MAX_ORPHAN_BUDGET_VOTES),
+                       nBudgetGeneration(1),
+                       nBudgetCacheGeneration(0),
+                       nBudgetCacheListVersion(0),
+                       nBudgetCacheMnCount(0)
     {
         mapProposals.clear();
         mapFinalizedBudgets.clear();
@@ -301,11 +361,17 @@ public:
     void FillBlockPayee(CMutableTransaction& txNew, CScript& payee);
 
     void CheckOrphanVotes();
+    /// Add the votes stored in db to their proposals and finalized budgets
+    bool LoadVotes(CMasternodeSeenDB& db);
+    /// Write the votes added, replaced or removed since the last call to db
+    bool WriteVoteChanges(CMasternodeSeenDB& db);
     void Clear()
     {
         LOCK(cs);
 
         LogPrintf("Budget object cleared\n");
+        nBudgetGeneration++;
+        MarkVotesChanged();
         mapProposals.clear();
         mapFinalizedBudgets.clear();
         mapSeenMasternodeBudgetProposals.clear();
@@ -321,19 +387,9 @@ public:
 
     ADD_SERIALIZE_METHODS;
 
+    // defined below, once proposals and finalized budgets are complete types
     template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action)
-    {
-        READWRITE(mapSeenMasternodeBudgetProposals);
-        READWRITE(mapSeenMasternodeBudgetVotes);
-        READWRITE(mapSeenFinalizedBudgets);
-        READWRITE(mapSeenFinalizedBudgetVotes);
-        READWRITE(mapOrphanMasternodeBudgetVotes);
-        READWRITE(mapOrphanFinalizedBudgetVotes);
-
-        READWRITE(mapProposals);
-        READWRITE(mapFinalizedBudgets);
-    }
+    inline void SerializationOp(Stream& s, Operation ser_action);
 };
 
 
@@ -409,6 +465,8 @@ public:
     int GetBlockEnd() const { return nBlockStart + (int)(vecBudgetPayments.size() - 1); }
     const uint256& GetFeeTXHash() const { return nFeeTXHash; }
     int GetVoteCount() const { return (int)mapVotes.size(); }
+    // votes by masternode collateral hash
+    const std::map<uint256, CFinalizedBudgetVote>& GetVotes() const { return mapVotes; }
     bool IsPaidAlready(uint256 nProposalHash, int nBlockHeight) const;
     TrxValidationStatus IsTransactionValid(const CTransaction& txNew, int nBlockHeight) const;
     bool GetBudgetPaymentByBlock(int64_t nBlockHeight, CTxBudgetPayment& payment) const;
@@ -438,6 +496,23 @@ public:
     // for saving to the serialized db
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        SerializeBudget(s, ser_action);
+
+        READWRITE(mapVotes);
+    }
+
+    // like Serialize, with an empty vote map
+    template <typename Stream>
+    void SerializeWithoutVotes(Stream& s) const
+    {
+        NCONST_PTR(this)->SerializeBudget(s, CSerActionSerialize());
+        WriteCompactSize(s, 0);
+    }
+
+private:
+    template <typename Stream, typename Operation>
+    inline void SerializeBudget(Stream& s, Operation ser_action)
     {
         READWRITE(LIMITED_STRING(strBudgetName, 20));
         READWRITE(nFeeTXHash);
@@ -445,8 +520,6 @@ public:
         READWRITE(nBlockStart);
         READWRITE(vecBudgetPayments);
         READWRITE(fAutoChecked);
-
-        READWRITE(mapVotes);
     }
 };
 
@@ -510,10 +583,17 @@ private:
     bool fValid;
     std::string strInvalid;
 
+    // Number of valid votes per direction, kept in step with mapVotes
+    int nVoteCounts[3];
+
+    void CountVote(const CBudgetVote& vote, int nDelta);
+
 protected:
     std::map<uint256, CBudgetVote> mapVotes;
     std::string strProposalName;
 
+    void RecountVotes();
+
     /*
         json object with name, short-description, long-description, pdf-url and any other info
         This allows the proposal website to stay 100% decentralized
@@ -563,11 +643,14 @@ public:
     int GetYeas() const { return GetVoteCount(CBudgetVote::VOTE_YES); }
     int GetNays() const { return GetVoteCount(CBudgetVote::VOTE_NO); }
     int GetAbstains() const { return GetVoteCount(CBudgetVote::VOTE_ABSTAIN); };
+    // votes by masternode collateral hash
+    const std::map<uint256, CBudgetVote>& GetVotes() const { return mapVotes; }
     CAmount GetAmount() const { return nAmount; }
     void SetAllotted(CAmount nAllotedIn) { nAlloted = nAllotedIn; }
     CAmount GetAllotted() const { return nAlloted; }
 
-    void CleanAndRemove();
+    // returns true if the validity of any vote changed
+    bool CleanAndRemove();
 
     uint256 GetHash() const
     {
@@ -585,6 +668,26 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        SerializeProposal(s, ser_action);
+
+        // for saving to the serialized db
+        READWRITE(mapVotes);
+        if (ser_action.ForRead())
+            RecountVotes();
+    }
+
+    // like Serialize, with an empty vote map
+    template <typename Stream>
+    void SerializeWithoutVotes(Stream& s) const
+    {
+        NCONST_PTR(this)->SerializeProposal(s, CSerActionSerialize());
+        WriteCompactSize(s, 0);
+    }
+
+private:
+    template <typename Stream, typename Operation>
+    inline void SerializeProposal(Stream& s, Operation ser_action)
     {
         // for syncing with other clients
         READWRITE(LIMITED_STRING(strProposalName, 20));
@@ -596,9 +699,6 @@ public:
         READWRITE(*(CScriptBase*)(&address));
         READWRITE(nTime);
         READWRITE(nFeeTXHash);
-
-        // for saving to the serialized db
-        READWRITE(mapVotes);
     }
 };
 
@@ -627,6 +727,8 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        first.RecountVotes();
+        second.RecountVotes();
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
@@ -655,5 +757,24 @@ public:
     }
 };
 
+template <typename Stream, typename Operation>
+inline void CBudgetManager::SerializationOp(Stream& s, Operation ser_action)
+{
+    READWRITE(mapSeenMasternodeBudgetProposals);
+    READWRITE(mapSeenMasternodeBudgetVotes);
+    READWRITE(mapSeenFinalizedBudgets);
+    READWRITE(mapSeenFinalizedBudgetVotes);
+    READWRITE(mapOrphanMasternodeBudgetVotes);
+    READWRITE(mapOrphanFinalizedBudgetVotes);
+
+    // The votes are kept in CMasternodeSeenDB, those of older files move there
+    READWRITE(REF(BudgetMapWithoutVotes(mapProposals)));
+    READWRITE(REF(BudgetMapWithoutVotes(mapFinalizedBudgets)));
+    if (ser_action.ForRead()) {
+        MarkVotesChanged();
+        nBudgetGeneration++;
+    }
+}
+
 
 #endif
@@ -0,0 +1,150 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-cachefile.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+template <typename Stream>
+static CMasternodeCacheFile::ReadResult ReadHeader(Stream& s, const std::string& strMagicMessage)
+{
+    unsigned char pchMsgTmp[4];
+    std::string strMagicMessageTmp;
+    try {
+        // de-serialize file header (cache file specific magic message) and ..
+        s >> strMagicMessageTmp;
+
+        // ... verify the message matches predefined one
+        if (strMagicMessage != strMagicMessageTmp) {
+            error("%s : Invalid masternode cache magic message", __func__);
+            return CMasternodeCacheFile::IncorrectMagicMessage;
+        }
+
+        // de-serialize file header (network specific magic number) and ..
+        s >> FLATDATA(pchMsgTmp);
+
+        // ... verify the network matches ours
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
+            error("%s : Invalid network magic number", __func__);
+            return CMasternodeCacheFile::IncorrectMagicNumber;
+        }
+    } catch (const std::exception& e) {
+        error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        return CMasternodeCacheFile::IncorrectFormat;
+    }
+    return CMasternodeCacheFile::Ok;
+}
+
+CMasternodeCacheFile::CMasternodeCacheFile(const std::string& strFileName, const std::string& strMagicMessageIn)
+    : pathDB(GetDataDir() / strFileName), strMagicMessage(strMagicMessageIn)
+{
+}
+
+bool CMasternodeCacheFile::Commit(CAutoFile& fileout, const boost::filesystem::path& pathTmp) const
+{
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    // replace the existing file, if any, so a crash never leaves a truncated cache behind
+    if (!RenameOver(pathTmp, pathDB)) {
+        boost::filesystem::remove(pathTmp);
+        return error("%s : Rename-into-place failed", __func__);
+    }
+    return true;
+}
+
+CMasternodeCacheFile::ReadResult CMasternodeCacheFile::Verify() const
+{
+    // open input file, and associate with CAutoFile
+    FILE* file = fopen(pathDB.string().c_str(), "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return FileError;
+
+    uint64_t nDataSize = 0;
+    try {
+        uint64_t nFileSize = boost::filesystem::file_size(pathDB);
+        if (nFileSize > sizeof(uint256))
+            nDataSize = nFileSize - sizeof(uint256);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        error("%s : %s", __func__, e.what());
+        return FileError;
+    }
+
+    // hash the data in pieces rather than loading all of it
+    CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+    std::vector<char> vchBuf(std::min<uint64_t>(nDataSize, 1 << 16));
+    uint256 hashIn;
+    try {
+        for (uint64_t nLeft = nDataSize; nLeft > 0;) {
+            size_t nRead = std::min<uint64_t>(nLeft, vchBuf.size());
+            filein.read(vchBuf.data(), nRead);
+            hasher.write(vchBuf.data(), nRead);
+            nLeft -= nRead;
+        }
+        filein >> hashIn;
+    } catch (const std::exception& e) {
+        error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        return HashReadError;
+    }
+
+    if (hashIn != hasher.GetHash()) {
+        error("%s : Checksum mismatch, data corrupted", __func__);
+        return IncorrectHash;
+    }
+
+    if (fseek(filein.Get(), 0, SEEK_SET) != 0) {
+        error("%s : Failed to rewind file %s", __func__, pathDB.string());
+        return FileError;
+    }
+    return ReadHeader(filein, strMagicMessage);
+}
+
+CMasternodeCacheFile::ReadResult CMasternodeCacheFile::ReadStream(CDataStream& ssObj) const
+{
+    // open input file, and associate with CAutoFile
+    FILE* file = fopen(pathDB.string().c_str(), "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        error("%s : Failed to open file %s", __func__, pathDB.string());
+        return FileError;
+    }
+
+    // use file size to size memory buffer
+    uint64_t nDataSize = 0;
+    try {
+        uint64_t nFileSize = boost::filesystem::file_size(pathDB);
+        // Don't try to resize to a negative number if file is small
+        if (nFileSize > sizeof(uint256))
+            nDataSize = nFileSize - sizeof(uint256);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        error("%s : %s", __func__, e.what());
+        return FileError;
+    }
+
+    // read data and checksum straight into the stream's buffer
+    ssObj.clear();
+    ssObj.resize(nDataSize);
+    uint256 hashIn;
+    try {
+        if (nDataSize > 0)
+            filein.read(&ssObj[0], nDataSize);
+        filein >> hashIn;
+    } catch (const std::exception& e) {
+        error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        return HashReadError;
+    }
+    filein.fclose();
+
+    // verify stored checksum matches input data
+    uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
+    if (hashIn != hashTmp) {
+        error("%s : Checksum mismatch, data corrupted", __func__);
+        return IncorrectHash;
+    }
+
+    return ReadHeader(ssObj, strMagicMessage);
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODE_CACHEFILE_H
+#define MASTERNODE_CACHEFILE_H
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "hash.h"
+#include "serialize.h"
+#include "streams.h"
+#include "util.h"
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+/**
+ * On-disk cache of one of the masternode managers (mncache.dat, budget.dat,
+ * mnpayments.dat): a magic message, the network magic number and the
+ * serialized object, followed by the double-SHA256 of all of it.
+ *
+ * Writing streams the object to a temporary file while hashing it, so the
+ * serialized form never has to be held in memory, and then renames it over
+ * the old file. Verify checks an existing file without deserializing it.
+ */
+class CMasternodeCacheFile
+{
+public:
+    enum ReadResult {
+        Ok,
+        FileError,
+        HashReadError,
+        IncorrectHash,
+        IncorrectMagicMessage,
+        IncorrectMagicNumber,
+        IncorrectFormat
+    };
+
+    //! Check the checksum and header of the file, leaving its contents alone
+    ReadResult Verify() const;
+
+protected:
+    boost::filesystem::path pathDB;
+    std::string strMagicMessage;
+
+    CMasternodeCacheFile(const std::string& strFileName, const std::string& strMagicMessageIn);
+
+    template <typename T>
+    bool WriteObject(const T& obj) const
+    {
+        boost::filesystem::path pathTmp = pathDB;
+        pathTmp += ".new";
+
+        FILE* file = fopen(pathTmp.string().c_str(), "wb");
+        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull())
+            return error("%s : Failed to open file %s", __func__, pathTmp.string());
+
+        try {
+            CHashedTargetWriter<CAutoFile> writer(&fileout);
+            writer << strMagicMessage;                   // cache file specific magic message
+            writer << FLATDATA(Params().MessageStart()); // network specific magic number
+            writer << obj;
+            fileout << writer.GetHash();
+        } catch (const std::exception& e) {
+            fileout.fclose();
+            boost::filesystem::remove(pathTmp);
+            return error("%s : Serialize or I/O error - %s", __func__, e.what());
+        }
+        return Commit(fileout, pathTmp);
+    }
+
+    //! Load the file into ssObj and check it, leaving ssObj positioned at the serialized object
+    ReadResult ReadStream(CDataStream& ssObj) const;
+
+private:
+    bool Commit(CAutoFile& fileout, const boost::filesystem::path& pathTmp) const;
+};
+
+#endif // MASTERNODE_CACHEFILE_H
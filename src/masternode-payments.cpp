@@ -7,6 +7,7 @@
 #include "masternode-payments.h"
 #include "addrman.h"
 #include "masternode-budget.h"
+#include "masternode-seendb.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "spork.h"
@@ -28,37 +29,16 @@ CCriticalSection cs_mapMasternodePayeeVotes;
 // CMasternodePaymentDB
 //
 
-CMasternodePaymentDB::CMasternodePaymentDB()
+CMasternodePaymentDB::CMasternodePaymentDB() : CMasternodeCacheFile("mnpayments.dat", "MasternodePayments")
 {
-    pathDB = GetDataDir() / "mnpayments.dat";
-    strMagicMessage = "MasternodePayments";
 }
 
 bool CMasternodePaymentDB::Write(const CMasternodePayments& objToSave)
 {
     int64_t nStart = GetTimeMillis();
 
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // masternode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    fileout.fclose();
+    if (!WriteObject(objToSave))
+        return false;
 
     LogPrint("masternode", "Written info to mnpayments.dat  %dms\n", GetTimeMillis() - nStart);
 
@@ -68,65 +48,13 @@ bool CMasternodePaymentDB::Write(const CMasternodePayments& objToSave)
 CMasternodePaymentDB::ReadResult CMasternodePaymentDB::Read(CMasternodePayments& objToLoad, bool fDryRun)
 {
     int64_t nStart = GetTimeMillis();
-    // open input file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "rb");
-    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        error("%s : Failed to open file %s", __func__, pathDB.string());
-        return FileError;
-    }
-
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathDB);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return HashReadError;
-    }
-    filein.fclose();
 
-    CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-    if (hashIn != hashTmp) {
-        error("%s : Checksum mismatch, data corrupted", __func__);
-        return IncorrectHash;
-    }
+    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+    ReadResult result = ReadStream(ssObj);
+    if (result != Ok)
+        return result;
 
-    unsigned char pchMsgTmp[4];
-    std::string strMagicMessageTmp;
     try {
-        // de-serialize file header (masternode cache file specific magic message) and ..
-        ssObj >> strMagicMessageTmp;
-
-        // ... verify the message matches predefined one
-        if (strMagicMessage != strMagicMessageTmp) {
-            error("%s : Invalid masternode payement cache magic message", __func__);
-            return IncorrectMagicMessage;
-        }
-
-
-        // de-serialize file header (network specific magic number) and ..
-        ssObj >> FLATDATA(pchMsgTmp);
-
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
-            error("%s : Invalid network magic number", __func__);
-            return IncorrectMagicNumber;
-        }
-
         // de-serialize data into CMasternodePayments object
         ssObj >> objToLoad;
     } catch (std::exception& e) {
@@ -248,10 +176,9 @@ void DumpMasternodePayments()
     int64_t nStart = GetTimeMillis();
 
     CMasternodePaymentDB paymentdb;
-    CMasternodePayments tempPayments;
 
     LogPrint("masternode", "Verifying mnpayments.dat format...\n");
-    CMasternodePaymentDB::ReadResult readResult = paymentdb.Read(tempPayments, true);
+    CMasternodePaymentDB::ReadResult readResult = paymentdb.Verify();
     // there was an error and it was not an error on file opening => do not proceed
     if (readResult == CMasternodePaymentDB::FileError)
         LogPrint("masternode", "Missing budgets file - mnpayments.dat, will try to recreate\n");
@@ -266,6 +193,8 @@ void DumpMasternodePayments()
     }
     LogPrint("masternode", "Writting info to mnpayments.dat...\n");
     paymentdb.Write(masternodePayments);
+    if (pMasternodeSeenDB)
+        masternodePayments.WriteWinnerChanges(*pMasternodeSeenDB);
 
     LogPrint("masternode", "Budget dump finished  %dms\n", GetTimeMillis() - nStart);
 }
@@ -566,7 +495,7 @@ bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 
 // Is this masternode scheduled to get paid soon?
 // -- Only look ahead up to 8 blocks to allow for propagation of the latest 2 winners
-bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
+bool CMasternodePayments::IsScheduled(const CMasternode& mn, int nNotBlockHeight)
 {
     LOCK(cs_mapMasternodeBlocks);
 
@@ -597,6 +526,44 @@ bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
     return false;
 }
 
+void CMasternodePayments::RebuildBlocks()
+{
+    mapMasternodeBlocks.clear();
+    for (const auto& it : mapMasternodePayeeVotes) {
+        const CMasternodePaymentWinner& winner = it.second;
+        if (!mapMasternodeBlocks.count(winner.nBlockHeight))
+            mapMasternodeBlocks[winner.nBlockHeight] = CMasternodeBlockPayees(winner.nBlockHeight);
+        mapMasternodeBlocks[winner.nBlockHeight].AddPayee(winner.payee, 1);
+    }
+}
+
+bool CMasternodePayments::LoadWinners(CMasternodeSeenDB& db)
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
+    int64_t nStart = GetTimeMillis();
+    if (!db.LoadEntries<uint256, CMasternodePaymentWinner>(DB_MASTERNODE_WINNER, [this](const uint256& hash, const CMasternodePaymentWinner& winner) {
+            mapMasternodePayeeVotes.insert(std::make_pair(hash, winner));
+        }))
+        return false;
+    RebuildBlocks();
+    LogPrint("masternode", "Loaded %d masternode winners  %dms\n", mapMasternodePayeeVotes.size(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CMasternodePayments::WriteWinnerChanges(CMasternodeSeenDB& db)
+{
+    LOCK(cs_mapMasternodePayeeVotes);
+    int64_t nStart = GetTimeMillis();
+    if (!db.WriteEntries(DB_MASTERNODE_WINNER, setWinnersChanged, [this](const uint256& hash) -> const CMasternodePaymentWinner* {
+            auto it = mapMasternodePayeeVotes.find(hash);
+            return it != mapMasternodePayeeVotes.end() ? &it->second : NULL;
+        }))
+        return error("%s : failed to write the masternode winners", __func__);
+    LogPrint("masternode", "Written %d masternode winner changes  %dms\n", setWinnersChanged.size(), GetTimeMillis() - nStart);
+    setWinnersChanged.clear();
+    return true;
+}
+
 bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerIn)
 {
     uint256 blockHash = uint256();
@@ -613,6 +580,7 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
         }
 
         mapMasternodePayeeVotes[winnerIn.GetHash()] = winnerIn;
+        setWinnersChanged.insert(winnerIn.GetHash());
 
         if (!mapMasternodeBlocks.count(winnerIn.nBlockHeight)) {
             CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
@@ -745,6 +713,7 @@ void CMasternodePayments::CleanPaymentList()
         if (nHeight - winner.nBlockHeight > nLimit) {
             LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
             masternodeSync.mapSeenSyncMNW.erase((*it).first);
+            setWinnersChanged.insert((*it).first);
             mapMasternodePayeeVotes.erase(it++);
             mapMasternodeBlocks.erase(winner.nBlockHeight);
         } else {
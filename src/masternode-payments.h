@@ -9,6 +9,7 @@
 
 #include "key.h"
 #include "main.h"
+#include "masternode-cachefile.h"
 #include "masternode.h"
 
 
@@ -21,6 +22,7 @@ extern CCriticalSection cs_mapMasternodePayeeVotes;
 class CMasternodePayments;
 class CMasternodePaymentWinner;
 class CMasternodeBlockPayees;
+class CMasternodeSeenDB;
 
 extern CMasternodePayments masternodePayments;
 
@@ -37,23 +39,9 @@ void DumpMasternodePayments();
 
 /** Save Masternode Payment Data (mnpayments.dat)
  */
-class CMasternodePaymentDB
+class CMasternodePaymentDB : public CMasternodeCacheFile
 {
-private:
-    boost::filesystem::path pathDB;
-    std::string strMagicMessage;
-
 public:
-    enum ReadResult {
-        Ok,
-        FileError,
-        HashReadError,
-        IncorrectHash,
-        IncorrectMagicMessage,
-        IncorrectMagicNumber,
-        IncorrectFormat
-    };
-
     CMasternodePaymentDB();
     bool Write(const CMasternodePayments& objToSave);
     ReadResult Read(CMasternodePayments& objToLoad, bool fDryRun = false);
@@ -231,6 +219,12 @@ class CMasternodePayments
 private:
     int nLastBlockHeight;
 
+    // hashes of the winners added or removed since they were last written to CMasternodeSeenDB
+    std::set<uint256> setWinnersChanged;
+
+    // recount mapMasternodeBlocks from the winners
+    void RebuildBlocks();
+
 public:
     std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -245,9 +239,16 @@ public:
     {
         LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
         mapMasternodeBlocks.clear();
+        for (const auto& it : mapMasternodePayeeVotes)
+            setWinnersChanged.insert(it.first);
         mapMasternodePayeeVotes.clear();
     }
 
+    /// Add the winners stored in db
+    bool LoadWinners(CMasternodeSeenDB& db);
+    /// Write the winners added or removed since the last call to db
+    bool WriteWinnerChanges(CMasternodeSeenDB& db);
+
     bool AddWinningMasternode(CMasternodePaymentWinner& winner);
     bool ProcessBlock(int nBlockHeight);
 
@@ -256,7 +257,7 @@ public:
 
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CChainParams& chainparams, const CTransaction& txNew, int nBlockHeight);
-    bool IsScheduled(CMasternode& mn, int nNotBlockHeight);
+    bool IsScheduled(const CMasternode& mn, int nNotBlockHeight);
 
     bool CanVote(const COutPoint outMasternode, int nBlockHeight)
     {
@@ -283,8 +284,17 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
-        READWRITE(mapMasternodePayeeVotes);
+        // The winners are kept in CMasternodeSeenDB, those of older files move there.
+        // The payees per block are still written, but recounted from the winners on load.
+        std::map<uint256, CMasternodePaymentWinner> mapWinnersInFile;
+        READWRITE(mapWinnersInFile);
+        for (const auto& it : mapWinnersInFile) {
+            if (mapMasternodePayeeVotes.insert(it).second)
+                setWinnersChanged.insert(it.first);
+        }
         READWRITE(mapMasternodeBlocks);
+        if (ser_action.ForRead())
+            RebuildBlocks();
     }
 };
 
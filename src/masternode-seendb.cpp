@@ -0,0 +1,9 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-seendb.h"
+
+CMasternodeSeenDB* pMasternodeSeenDB = NULL;
+
+CMasternodeSeenDB::CMasternodeSeenDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "mnseen", nCacheSize, fMemory, fWipe) {}
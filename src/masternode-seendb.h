@@ -0,0 +1,107 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODE_SEENDB_H
+#define MASTERNODE_SEENDB_H
+
+#include "dbwrapper.h"
+#include "uint256.h"
+#include "util.h"
+
+#include <memory>
+#include <utility>
+
+//! Key prefixes of the records kept in CMasternodeSeenDB
+static const char DB_SEEN_MASTERNODE_BROADCAST = 'b';
+static const char DB_SEEN_MASTERNODE_PING = 'p';
+static const char DB_MASTERNODE_WINNER = 'w';
+static const char DB_BUDGET_VOTE = 'v';
+static const char DB_FINALIZED_BUDGET_VOTE = 'f';
+
+//! Most changes written to CMasternodeSeenDB in one batch
+static const size_t MASTERNODE_SEEN_BATCH_SIZE = 10000;
+
+/**
+ * Seen masternode messages, payment winners and budget votes (mnseen/ in the
+ * data directory), keyed on a prefix per kind of record and the record's key in
+ * memory. Only the records added, changed or removed since they were last
+ * written are written, instead of the whole set.
+ */
+class CMasternodeSeenDB : public CDBWrapper
+{
+public:
+    CMasternodeSeenDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CMasternodeSeenDB(const CMasternodeSeenDB&);
+    void operator=(const CMasternodeSeenDB&);
+
+public:
+    //! Write the records of the keys in changes under chType, erasing those find returns NULL for
+    template <typename Changes, typename Find>
+    bool WriteEntries(char chType, const Changes& changes, Find find)
+    {
+        std::unique_ptr<CDBBatch> batch(new CDBBatch(*this));
+        size_t nInBatch = 0;
+        for (const auto& key : changes) {
+            const auto* pvalue = find(key);
+            if (pvalue)
+                batch->Write(std::make_pair(chType, key), *pvalue);
+            else
+                batch->Erase(std::make_pair(chType, key));
+            if (++nInBatch == MASTERNODE_SEEN_BATCH_SIZE) {
+                if (!WriteBatch(*batch))
+                    return false;
+                batch.reset(new CDBBatch(*this));
+                nInBatch = 0;
+            }
+        }
+        return WriteBatch(*batch);
+    }
+
+    //! Write the entries of map added, changed or removed since the last call under chType
+    template <typename Map>
+    bool WriteChanges(char chType, Map& map)
+    {
+        typedef typename Map::mapped_type V;
+        if (!WriteEntries(chType, map.changes(), [&map](const uint256& hash) -> const V* {
+                auto it = map.find(hash);
+                return it != map.end() ? &it->second : NULL;
+            }))
+            return false;
+        map.clear_changes();
+        return true;
+    }
+
+    //! Pass the key and value of each record stored under chType to f
+    template <typename K, typename V, typename F>
+    bool LoadEntries(char chType, F f)
+    {
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        for (pcursor->Seek(std::make_pair(chType, K())); pcursor->Valid(); pcursor->Next()) {
+            std::pair<char, K> key;
+            if (!pcursor->GetKey(key) || key.first != chType)
+                break;
+            V value;
+            if (!pcursor->GetValue(value))
+                return error("%s : failed to read a record of kind '%c'", __func__, chType);
+            f(key.second, value);
+        }
+        return true;
+    }
+
+    //! Add the entries stored under chType to map
+    template <typename Map>
+    bool Load(char chType, Map& map)
+    {
+        typedef typename Map::mapped_type V;
+        return LoadEntries<uint256, V>(chType, [&map](const uint256& hash, const V& value) {
+            map.load(std::make_pair(hash, value));
+        });
+    }
+};
+
+extern CMasternodeSeenDB* pMasternodeSeenDB;
+
+#endif // MASTERNODE_SEENDB_H
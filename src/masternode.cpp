@@ -108,6 +108,7 @@ CMasternode::CMasternode(const CMasternode& other) : CSignedMessage(other)
     nScanningErrorCount = other.nScanningErrorCount;
     nLastScanningErrorBlockHeight = other.nLastScanningErrorBlockHeight;
     lastTimeChecked = 0;
+    nCheckedCollateral = other.nCheckedCollateral;
     nMessVersion = other.nMessVersion;
 }
 
@@ -219,33 +220,49 @@ void CMasternode::Check(bool forceCheck)
     }
 
     if (!unitTest) {
-        CValidationState state;
-        CMutableTransaction tx = CMutableTransaction();
-        CScript dummyScript;
-        dummyScript << ToByteVector(pubKeyCollateralAddress) << OP_CHECKSIG;
-
-        CTxOut vout = CTxOut(Params().GetMasternodeCollateral(chainActive.Height() + 1) * COIN - (CAmount)(0.01 * COIN), dummyScript);
-        if (NetworkUpgradeActive(chainActive.Height() + 1, Params().GetConsensus(), Consensus::UPGRADE_MORAG)) {
-            CAmount testingAmount = Params().GetMasternodeCollateral(chainActive.Height() + 1) * COIN - (CAmount)(0.01 * COIN);
-            vout = CTxOut(testingAmount, dummyScript);
+        // Spends of the collateral are picked up by CMasternodeMan::CheckSpentCollaterals as blocks and
+        // transactions come in. The coin itself is only looked up once, and again when the collateral changes.
+        if (mnodeman.IsCollateralSpent(vin.prevout)) {
+            activeState = MASTERNODE_VIN_SPENT;
+            return;
         }
-        tx.vin.push_back(vin);
-        tx.vout.push_back(vout);
-        {
+
+        CAmount nRequired = Params().GetMasternodeCollateral(chainActive.Height() + 1) * COIN;
+        if (nCheckedCollateral != nRequired) {
             TRY_LOCK(cs_main, lockMain);
             if (!lockMain)
                 return;
 
-            if (!AcceptableInputs(mempool, state, CTransaction(tx), false, NULL)) {
+            if (!IsCollateralAvailable(nRequired)) {
                 activeState = MASTERNODE_VIN_SPENT;
                 return;
             }
+            nCheckedCollateral = nRequired;
         }
     }
 
     activeState = MASTERNODE_ENABLED; // OK
 }
 
+bool CMasternode::IsCollateralAvailable(CAmount nRequired)
+{
+    AssertLockHeld(cs_main);
+
+    if (!ValidOutPoint(vin.prevout, chainActive.Height()))
+        return false;
+
+    CCoins coins;
+    if (!pcoinsTip->GetCoins(vin.prevout.hash, coins) || !coins.IsAvailable(vin.prevout.n))
+        return false;
+
+    // accept coins up to 0.01 short of the required collateral
+    if (coins.vout[vin.prevout.n].nValue < nRequired - (CAmount)(0.01 * COIN))
+        return false;
+
+    LOCK(mempool.cs);
+    return !mempool.mapNextTx.count(vin.prevout);
+}
+
 int64_t CMasternode::SecondsSincePayment()
 {
     CScript pubkeyScript;
@@ -837,9 +854,7 @@ bool CMasternodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled, bool fChec
             // mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
             CMasternodeBroadcast mnb(*pmn);
             uint256 hash = mnb.GetHash();
-            if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
-                mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = *this;
-            }
+            mnodeman.mapSeenMasternodeBroadcast.modify(hash, [this](CMasternodeBroadcast& seen) { seen.lastPing = *this; });
 
             pmn->Check(true);
             if (!pmn->IsEnabled())
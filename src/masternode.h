@@ -119,7 +119,10 @@ private:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
     int64_t lastTimeChecked;
-    bool fCollateralSpent{false};
+    // collateral amount the coin was last looked up against, 0 if never
+    CAmount nCheckedCollateral{0};
+
+    bool IsCollateralAvailable(CAmount nRequired);
 
 public:
     enum state {
@@ -181,6 +184,7 @@ public:
         swap(first.nLastDsq, second.nLastDsq);
         swap(first.nScanningErrorCount, second.nScanningErrorCount);
         swap(first.nLastScanningErrorBlockHeight, second.nLastScanningErrorBlockHeight);
+        swap(first.nCheckedCollateral, second.nCheckedCollateral);
     }
 
     CMasternode& operator=(CMasternode from)
@@ -244,8 +248,6 @@ public:
     int GetExpirationTime();
     int GetRemovalTime();
 
-    void SetSpent() { fCollateralSpent = true; }
-
     void Disable()
     {
         LOCK(cs);
@@ -253,7 +255,7 @@ public:
         lastPing = CMasternodePing();
     }
 
-    bool IsEnabled()
+    bool IsEnabled() const
     {
         return activeState == MASTERNODE_ENABLED;
     }
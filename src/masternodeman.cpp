@@ -9,7 +9,9 @@
 #include "addrman.h"
 #include "consensus/validation.h"
 #include "key_io.h"
+#include "masternode-budget.h"
 #include "masternode-payments.h"
+#include "masternode-seendb.h"
 #include "masternode-sync.h"
 #include "masternode.h"
 #include "messagesigner.h"
@@ -42,50 +44,20 @@ struct CompareScoreTxIn {
     }
 };
 
-struct CompareScoreMN {
-    bool operator()(const pair<int64_t, CMasternode>& t1,
-                    const pair<int64_t, CMasternode>& t2) const
-    {
-        return t1.first < t2.first;
-    }
-};
-
 //
 // CMasternodeDB
 //
 
-CMasternodeDB::CMasternodeDB()
+CMasternodeDB::CMasternodeDB() : CMasternodeCacheFile("mncache.dat", "MasternodeCache")
 {
-    pathMN = GetDataDir() / "mncache.dat";
-    strMagicMessage = "MasternodeCache";
 }
 
 bool CMasternodeDB::Write(const CMasternodeMan& mnodemanToSave)
 {
     int64_t nStart = GetTimeMillis();
 
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssMasternodes(SER_DISK, CLIENT_VERSION);
-    ssMasternodes << strMagicMessage;                   // masternode cache file specific magic message
-    ssMasternodes << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssMasternodes << mnodemanToSave;
-    uint256 hash = Hash(ssMasternodes.begin(), ssMasternodes.end());
-    ssMasternodes << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathMN.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathMN.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssMasternodes;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    //    FileCommit(fileout);
-    fileout.fclose();
+    if (!WriteObject(mnodemanToSave))
+        return false;
 
     LogPrint("masternode", "Written info to mncache.dat  %dms\n", GetTimeMillis() - nStart);
     LogPrint("masternode", "  %s\n", mnodemanToSave.ToString());
@@ -96,64 +68,13 @@ bool CMasternodeDB::Write(const CMasternodeMan& mnodemanToSave)
 CMasternodeDB::ReadResult CMasternodeDB::Read(CMasternodeMan& mnodemanToLoad, bool fDryRun)
 {
     int64_t nStart = GetTimeMillis();
-    // open input file, and associate with CAutoFile
-    FILE* file = fopen(pathMN.string().c_str(), "rb");
-    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        error("%s : Failed to open file %s", __func__, pathMN.string());
-        return FileError;
-    }
-
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathMN);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return HashReadError;
-    }
-    filein.fclose();
-
-    CDataStream ssMasternodes(vchData, SER_DISK, CLIENT_VERSION);
 
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssMasternodes.begin(), ssMasternodes.end());
-    if (hashIn != hashTmp) {
-        error("%s : Checksum mismatch, data corrupted", __func__);
-        return IncorrectHash;
-    }
+    CDataStream ssMasternodes(SER_DISK, CLIENT_VERSION);
+    ReadResult result = ReadStream(ssMasternodes);
+    if (result != Ok)
+        return result;
 
-    unsigned char pchMsgTmp[4];
-    std::string strMagicMessageTmp;
     try {
-        // de-serialize file header (masternode cache file specific magic message) and ..
-
-        ssMasternodes >> strMagicMessageTmp;
-
-        // ... verify the message matches predefined one
-        if (strMagicMessage != strMagicMessageTmp) {
-            error("%s : Invalid masternode cache magic message", __func__);
-            return IncorrectMagicMessage;
-        }
-
-        // de-serialize file header (network specific magic number) and ..
-        ssMasternodes >> FLATDATA(pchMsgTmp);
-
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
-            error("%s : Invalid network magic number", __func__);
-            return IncorrectMagicNumber;
-        }
         // de-serialize data into CMasternodeMan object
         ssMasternodes >> mnodemanToLoad;
     } catch (std::exception& e) {
@@ -179,10 +100,9 @@ void DumpMasternodes()
     int64_t nStart = GetTimeMillis();
 
     CMasternodeDB mndb;
-    CMasternodeMan tempMnodeman;
 
     LogPrint("masternode", "Verifying mncache.dat format...\n");
-    CMasternodeDB::ReadResult readResult = mndb.Read(tempMnodeman, true);
+    CMasternodeDB::ReadResult readResult = mndb.Verify();
     // there was an error and it was not an error on file opening => do not proceed
     if (readResult == CMasternodeDB::FileError)
         LogPrint("masternode", "Missing masternode cache file - mncache.dat, will try to recreate\n");
@@ -197,15 +117,46 @@ void DumpMasternodes()
     }
     LogPrint("masternode", "Writting info to mncache.dat...\n");
     mndb.Write(mnodeman);
+    if (pMasternodeSeenDB)
+        mnodeman.WriteSeenChanges(*pMasternodeSeenDB);
 
     LogPrint("masternode", "Masternode dump finished  %dms\n", GetTimeMillis() - nStart);
 }
 
-CMasternodeMan::CMasternodeMan()
+CMasternodeMan::CMasternodeMan() : mapSeenMasternodeBroadcast(MAX_SEEN_MASTERNODE_BROADCASTS),
+                                   mapSeenMasternodePing(MAX_SEEN_MASTERNODE_PINGS),
+                                   nListVersion(0),
+                                   snapshot(std::make_shared<const std::vector<CMasternode>>()),
+                                   nSnapshotVersion(0),
+                                   nSnapshotTime(0)
 {
     nDsqCount = 0;
 }
 
+bool CMasternodeMan::LoadSeen(CMasternodeSeenDB& db)
+{
+    LOCK(cs);
+    int64_t nStart = GetTimeMillis();
+    if (!db.Load(DB_SEEN_MASTERNODE_BROADCAST, mapSeenMasternodeBroadcast) ||
+        !db.Load(DB_SEEN_MASTERNODE_PING, mapSeenMasternodePing))
+        return false;
+    LogPrint("masternode", "Loaded %d seen broadcasts and %d seen pings  %dms\n",
+             mapSeenMasternodeBroadcast.size(), mapSeenMasternodePing.size(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CMasternodeMan::WriteSeenChanges(CMasternodeSeenDB& db)
+{
+    LOCK(cs);
+    int64_t nStart = GetTimeMillis();
+    size_t nChanges = mapSeenMasternodeBroadcast.changes().size() + mapSeenMasternodePing.changes().size();
+    if (!db.WriteChanges(DB_SEEN_MASTERNODE_BROADCAST, mapSeenMasternodeBroadcast) ||
+        !db.WriteChanges(DB_SEEN_MASTERNODE_PING, mapSeenMasternodePing))
+        return error("%s : failed to write the seen masternode messages", __func__);
+    LogPrint("masternode", "Written %d seen message changes  %dms\n", nChanges, GetTimeMillis() - nStart);
+    return true;
+}
+
 bool CMasternodeMan::Add(CMasternode& mn)
 {
     LOCK(cs);
@@ -217,6 +168,8 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        IndexCollateral(mn.vin.prevout);
+        nListVersion++;
         return true;
     }
 
@@ -240,20 +193,56 @@ void CMasternodeMan::AskForMN(CNode* pnode, const CTxIn& vin)
     mWeAskedForMasternodeListEntry[vin.prevout] = askAgain;
 }
 
+void CMasternodeMan::IndexCollateral(const COutPoint& outpoint)
+{
+    LOCK(cs_collaterals);
+    mapCollaterals[outpoint] = false;
+}
+
+void CMasternodeMan::UnindexCollateral(const COutPoint& outpoint)
+{
+    LOCK(cs_collaterals);
+    mapCollaterals.erase(outpoint);
+}
+
 void CMasternodeMan::CheckSpentCollaterals(const std::vector<CTransaction>& vtx)
 {
-    LOCK(cs);
-    for (const auto& tx : vtx) {
-        for (const auto& in : tx.vin) {
-            for (CMasternode& mn : vMasternodes) {
-                if (mn.vin == in) {
-                    mn.SetSpent();
-                }
-            }
+    for (const CTransaction& tx : vtx)
+        CheckSpentCollaterals(tx);
+}
+
+void CMasternodeMan::CheckSpentCollaterals(const CTransaction& tx)
+{
+    LOCK(cs_collaterals);
+    for (const CTxIn& in : tx.vin) {
+        auto it = mapCollaterals.find(in.prevout);
+        if (it != mapCollaterals.end() && !it->second) {
+            LogPrint("masternode", "CMasternodeMan: Collateral %s spent by %s\n", in.prevout.ToStringShort(), tx.GetHash().ToString());
+            it->second = true;
+            nListVersion++;
+        }
+    }
+}
+
+void CMasternodeMan::RestoreSpentCollaterals(const std::vector<CTransaction>& vtx)
+{
+    LOCK(cs_collaterals);
+    for (const CTransaction& tx : vtx) {
+        for (const CTxIn& in : tx.vin) {
+            auto it = mapCollaterals.find(in.prevout);
+            if (it != mapCollaterals.end())
+                it->second = false;
         }
     }
 }
 
+bool CMasternodeMan::IsCollateralSpent(const COutPoint& outpoint) const
+{
+    LOCK(cs_collaterals);
+    auto it = mapCollaterals.find(outpoint);
+    return it != mapCollaterals.end() && it->second;
+}
+
 void CMasternodeMan::Check()
 {
     LOCK(cs);
@@ -283,15 +272,11 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             // erase all of the broadcasts we've seen from this vin
             //  -- if we missed a few pings and the node was removed, this will allow is to get it back without them
             //     sending a brand new mnb
-            std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-            while (it3 != mapSeenMasternodeBroadcast.end()) {
-                if ((*it3).second.vin == (*it).vin) {
-                    masternodeSync.mapSeenSyncMNB.erase((*it3).first);
-                    it3 = mapSeenMasternodeBroadcast.erase(it3);
-                } else {
-                    ++it3;
-                }
-            }
+            std::vector<uint256> vErased;
+            const CTxIn& vin = (*it).vin;
+            mapSeenMasternodeBroadcast.erase_if([&vin](const CMasternodeBroadcast& mnb) { return mnb.vin == vin; }, &vErased);
+            for (const uint256& hash : vErased)
+                masternodeSync.mapSeenSyncMNB.erase(hash);
 
             // allow us to ask for this masternode again if we see another ping
             std::map<COutPoint, int64_t>::iterator it2 = mWeAskedForMasternodeListEntry.begin();
@@ -303,7 +288,9 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
                 }
             }
 
+            UnindexCollateral((*it).vin.prevout);
             it = vMasternodes.erase(it);
+            nListVersion++;
         } else {
             ++it;
         }
@@ -341,31 +328,27 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     }
 
     // remove expired mapSeenMasternodeBroadcast
-    std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-    while (it3 != mapSeenMasternodeBroadcast.end()) {
-        if ((*it3).second.lastPing.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
-            masternodeSync.mapSeenSyncMNB.erase((*it3).second.GetHash());
-            it3 = mapSeenMasternodeBroadcast.erase(it3);
-        } else {
-            ++it3;
-        }
-    }
+    std::vector<uint256> vExpired;
+    mapSeenMasternodeBroadcast.erase_older_than(GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2), &vExpired);
+    for (const uint256& hash : vExpired)
+        masternodeSync.mapSeenSyncMNB.erase(hash);
 
     // remove expired mapSeenMasternodePing
-    std::map<uint256, CMasternodePing>::iterator it4 = mapSeenMasternodePing.begin();
-    while (it4 != mapSeenMasternodePing.end()) {
-        if ((*it4).second.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
-            it4 = mapSeenMasternodePing.erase(it4);
-        } else {
-            ++it4;
-        }
-    }
+    mapSeenMasternodePing.erase_older_than(GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2));
+
+    // every entry was just checked
+    PublishSnapshot();
 }
 
 void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    nListVersion++;
+    {
+        LOCK(cs_collaterals);
+        mapCollaterals.clear();
+    }
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -384,7 +367,8 @@ int CMasternodeMan::stable_size()
     }
     int64_t nMasternode_Age = 0;
 
-    for (CMasternode& mn : vMasternodes) {
+    Snapshot vSnapshot = GetSnapshot();
+    for (const CMasternode& mn : *vSnapshot) {
         if (mn.protocolVersion < nMinProtocol) {
             continue; // Skip obsolete versions
         }
@@ -424,8 +408,8 @@ void CMasternodeMan::CountNetworks(int protocolVersion, int& ipv4, int& ipv6, in
 {
     protocolVersion = protocolVersion == -1 ? masternodePayments.GetMinMasternodePaymentsProto() : protocolVersion;
 
-    for (CMasternode& mn : vMasternodes) {
-        mn.Check();
+    Snapshot vSnapshot = GetSnapshot();
+    for (const CMasternode& mn : *vSnapshot) {
         std::string strHost;
         int port;
         SplitHostPort(mn.addr.ToString(), port, strHost);
@@ -461,7 +445,8 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
         }
     }
 
-    pnode->PushMessage("dseg", CTxIn());
+    // the trailing flag asks for the list in "mnblist" batches, older peers ignore it and announce every entry
+    pnode->PushMessage("dseg", CTxIn(), true);
     int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
     mWeAskedForMasternodeList[pnode->addr] = askAgain;
 }
@@ -513,6 +498,32 @@ CMasternode* CMasternodeMan::Find(const CAddress& addr)
     return NULL;
 }
 
+// Whether mn, as of its last Check(), is in the payment queue for nBlockHeight
+static bool IsQueuedForPayment(const CMasternode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount)
+{
+    if (!mn.IsEnabled())
+        return false;
+
+    // //check protocol version
+    if (mn.protocolVersion < masternodePayments.GetMinMasternodePaymentsProto())
+        return false;
+
+    // it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
+    if (masternodePayments.IsScheduled(mn, nBlockHeight))
+        return false;
+
+    // it's too new, wait for a cycle
+    if (fFilterSigTime && mn.sigTime + (nMnCount * 2.6 * 60) > GetAdjustedTime())
+        return false;
+
+    // make sure it has as many confirmations as there are masternodes
+    CTxIn vin = mn.vin;
+    if (GetInputAge(vin) < nMnCount)
+        return false;
+
+    return true;
+}
+
 //
 // Deterministically select the oldest/best masternode to pay on the network
 //
@@ -530,23 +541,7 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     int nMnCount = CountEnabled();
     for (CMasternode& mn : vMasternodes) {
         mn.Check();
-        if (!mn.IsEnabled())
-            continue;
-
-        // //check protocol version
-        if (mn.protocolVersion < masternodePayments.GetMinMasternodePaymentsProto())
-            continue;
-
-        // it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if (masternodePayments.IsScheduled(mn, nBlockHeight))
-            continue;
-
-        // it's too new, wait for a cycle
-        if (fFilterSigTime && mn.sigTime + (nMnCount * 2.6 * 60) > GetAdjustedTime())
-            continue;
-
-        // make sure it has as many confirmations as there are masternodes
-        if (GetInputAge(mn.vin) < nMnCount)
+        if (!IsQueuedForPayment(mn, nBlockHeight, fFilterSigTime, nMnCount))
             continue;
 
         vecMasternodeLastPaid.push_back(make_pair(mn.SecondsSincePayment(), mn.vin));
@@ -585,6 +580,34 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     return pBestMasternode;
 }
 
+int CMasternodeMan::CountInQueueForPayment(int nBlockHeight)
+{
+    const int nMinProtocol = masternodePayments.GetMinMasternodePaymentsProto();
+
+    Snapshot vSnapshot = GetSnapshot();
+    int nMnCount = 0;
+    for (const CMasternode& mn : *vSnapshot) {
+        if (mn.IsEnabled() && mn.protocolVersion >= nMinProtocol)
+            nMnCount++;
+    }
+
+    int nCount = 0;
+    for (const CMasternode& mn : *vSnapshot) {
+        if (IsQueuedForPayment(mn, nBlockHeight, true, nMnCount))
+            nCount++;
+    }
+
+    // same fallback as GetNextMasternodeInQueueForPayment while the network is upgrading
+    if (nCount < nMnCount / 3) {
+        nCount = 0;
+        for (const CMasternode& mn : *vSnapshot) {
+            if (IsQueuedForPayment(mn, nBlockHeight, false, nMnCount))
+                nCount++;
+        }
+    }
+    return nCount;
+}
+
 CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight, int minProtocol)
 {
     int64_t score = 0;
@@ -666,34 +689,36 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
 
 std::vector<pair<int, CMasternode>> CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
 {
-    std::vector<pair<int64_t, CMasternode>> vecMasternodeScores;
+    std::vector<pair<int64_t, const CMasternode*>> vecMasternodeScores;
     std::vector<pair<int, CMasternode>> vecMasternodeRanks;
 
+    // rank a snapshot, so message processing can go on meanwhile
+    Snapshot vSnapshot = GetSnapshot();
 
     // scan for winner
-    for (CMasternode& mn : vMasternodes) {
-        mn.Check();
-
+    for (const CMasternode& mn : *vSnapshot) {
         if (mn.protocolVersion < minProtocol)
             continue;
 
         if (!mn.IsEnabled()) {
-            vecMasternodeScores.push_back(make_pair(9999, mn));
+            vecMasternodeScores.push_back(make_pair(9999, &mn));
             continue;
         }
 
         arith_uint256 n = mn.CalculateScore(nBlockHeight);
         int64_t n2 = n.GetCompact(false);
 
-        vecMasternodeScores.push_back(make_pair(n2, mn));
+        vecMasternodeScores.push_back(make_pair(n2, &mn));
     }
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
+    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(),
+         [](const pair<int64_t, const CMasternode*>& t1, const pair<int64_t, const CMasternode*>& t2) { return t1.first < t2.first; });
 
     int rank = 0;
-    for (PAIRTYPE(int64_t, CMasternode) & s : vecMasternodeScores) {
+    vecMasternodeRanks.reserve(vecMasternodeScores.size());
+    for (const auto& s : vecMasternodeScores) {
         rank++;
-        vecMasternodeRanks.push_back(make_pair(rank, s.second));
+        vecMasternodeRanks.push_back(make_pair(rank, *s.second));
     }
 
     return vecMasternodeRanks;
@@ -712,46 +737,11 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         CMasternodeBroadcast mnb;
         vRecv >> mnb;
 
-        if (mapSeenMasternodeBroadcast.count(mnb.GetHash())) { // seen
-            masternodeSync.AddedMasternodeList(mnb.GetHash());
-            return;
-        }
-        mapSeenMasternodeBroadcast.insert(make_pair(mnb.GetHash(), mnb));
-
-        int nDoS = 0;
-        if (!mnb.CheckAndUpdate(nDoS)) {
-            if (nDoS > 0) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), nDoS);
-            }
-
-            // failed
-            return;
-        }
-
-        // make sure the vout that was signed is related to the transaction that spawned the Masternode
-        //  - this is expensive, so it's only done once per Masternode
-        if (!mnb.IsInputAssociatedWithPubkey()) {
-            LogPrint("masternode", "mnb - Got mismatched pubkey and vin\n");
-            LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), 33);
-            return;
-        }
-
-        // make sure it's still unspent
-        //  - this is checked later by .check() in many places and by ThreadCheckObfuScationPool()
-        if (mnb.CheckInputsAndAdd(nDoS)) {
-            // use this as a peer
-            addrman.Add(CAddress(mnb.addr), pfrom->addr, 2 * 60 * 60);
-            masternodeSync.AddedMasternodeList(mnb.GetHash());
-        } else {
-            LogPrint("masternode", "mnb - Rejected Masternode entry %s\n", mnb.vin.prevout.hash.ToString());
+        ProcessBroadcast(pfrom, mnb);
+    }
 
-            if (nDoS > 0) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), nDoS);
-            }
-        }
+    else if (strCommand == "mnblist") { // Batch of Masternode Broadcasts answering our dseg
+        ProcessBroadcastList(pfrom, vRecv);
     }
 
     else if (strCommand == "mnp") { // Masternode Ping
@@ -787,6 +777,9 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         CTxIn vin;
         vRecv >> vin;
+        bool fBatched = false;
+        if (!vRecv.empty())
+            vRecv >> fBatched;
 
         if (vin == CTxIn()) { // only should ask for this once
             // local network
@@ -810,6 +803,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
 
         int nInvCount = 0;
+        std::vector<CMasternodeBroadcast> vBatch;
 
         for (CMasternode& mn : vMasternodes) {
             if (mn.addr.IsRFC1918())
@@ -820,7 +814,16 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                 if (vin == CTxIn() || vin == mn.vin) {
                     CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
                     uint256 hash = mnb.GetHash();
-                    pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
+                    if (fBatched && vin == CTxIn()) {
+                        // send the broadcasts themselves, sparing the peer a getdata round trip per entry
+                        vBatch.push_back(mnb);
+                        if (vBatch.size() == MASTERNODE_LIST_BATCH_SIZE) {
+                            pfrom->PushMessage("mnblist", vBatch);
+                            vBatch.clear();
+                        }
+                    } else {
+                        pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
+                    }
                     nInvCount++;
 
                     if (!mapSeenMasternodeBroadcast.count(hash))
@@ -835,6 +838,8 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         }
 
         if (vin == CTxIn()) {
+            if (!vBatch.empty())
+                pfrom->PushMessage("mnblist", vBatch);
             pfrom->PushMessage("ssc", MASTERNODE_SYNC_LIST, nInvCount);
             LogPrint("masternode", "dseg - Sent %d Masternode entries to peer %i\n", nInvCount, pfrom->GetId());
         }
@@ -1148,7 +1153,9 @@ void CMasternodeMan::Remove(CTxIn vin)
     while (it != vMasternodes.end()) {
         if ((*it).vin == vin) {
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
+            UnindexCollateral((*it).vin.prevout);
             vMasternodes.erase(it);
+            nListVersion++;
             break;
         }
         ++it;
@@ -1169,14 +1176,116 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         Add(mn);
     } else {
         pmn->UpdateFromNewBroadcast(mnb);
+        nListVersion++;
+    }
+}
+
+void CMasternodeMan::ProcessBroadcastList(CNode* pfrom, CDataStream& vRecv)
+{
+    {
+        LOCK(cs);
+        if (!mWeAskedForMasternodeList.count(pfrom->addr)) {
+            LogPrint("masternode", "mnblist - unrequested list from peer %i\n", pfrom->GetId());
+            return;
+        }
+    }
+
+    std::vector<CMasternodeBroadcast> vMnb;
+    vRecv >> vMnb;
+    if (vMnb.size() > MASTERNODE_LIST_BATCH_SIZE) {
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), 20);
+        return;
     }
+
+    LogPrint("masternode", "mnblist - %u Masternode entries from peer %i\n", vMnb.size(), pfrom->GetId());
+    for (CMasternodeBroadcast& mnb : vMnb)
+        ProcessBroadcast(pfrom, mnb);
+}
+
+void CMasternodeMan::ProcessBroadcast(CNode* pfrom, CMasternodeBroadcast& mnb)
+{
+    if (mapSeenMasternodeBroadcast.count(mnb.GetHash())) { // seen
+        masternodeSync.AddedMasternodeList(mnb.GetHash());
+        return;
+    }
+    mapSeenMasternodeBroadcast.insert(make_pair(mnb.GetHash(), mnb));
+
+    int nDoS = 0;
+    if (!mnb.CheckAndUpdate(nDoS)) {
+        if (nDoS > 0) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+
+        // failed
+        return;
+    }
+
+    // make sure the vout that was signed is related to the transaction that spawned the Masternode
+    //  - this is expensive, so it's only done once per Masternode
+    if (!mnb.IsInputAssociatedWithPubkey()) {
+        LogPrint("masternode", "mnb - Got mismatched pubkey and vin\n");
+        LOCK(cs_main);
+        Misbehaving(pfrom->GetId(), 33);
+        return;
+    }
+
+    // make sure it's still unspent
+    //  - this is checked later by .check() in many places and by ThreadCheckObfuScationPool()
+    if (mnb.CheckInputsAndAdd(nDoS)) {
+        // use this as a peer
+        addrman.Add(CAddress(mnb.addr), pfrom->addr, 2 * 60 * 60);
+        masternodeSync.AddedMasternodeList(mnb.GetHash());
+    } else {
+        LogPrint("masternode", "mnb - Rejected Masternode entry %s\n", mnb.vin.prevout.hash.ToString());
+
+        if (nDoS > 0) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+    }
+}
+
+void CMasternodeMan::PublishSnapshot()
+{
+    AssertLockHeld(cs);
+
+    uint64_t nVersion = nListVersion;
+    Snapshot fresh = std::make_shared<const std::vector<CMasternode>>(vMasternodes);
+
+    LOCK(cs_snapshot);
+    snapshot = fresh;
+    nSnapshotVersion = nVersion;
+    nSnapshotTime = GetTimeMillis();
+}
+
+void CMasternodeMan::UpdateSnapshot()
+{
+    {
+        LOCK(cs_snapshot);
+        if (nSnapshotVersion == nListVersion && GetTimeMillis() - nSnapshotTime < MASTERNODE_SNAPSHOT_MILLIS)
+            return;
+    }
+
+    LOCK(cs);
+    Check();
+    PublishSnapshot();
+}
+
+CMasternodeMan::Snapshot CMasternodeMan::GetSnapshot() const
+{
+    LOCK(cs_snapshot);
+    return snapshot;
 }
 
 std::string CMasternodeMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "Masternodes: " << (int)vMasternodes.size() << ", peers who asked us for Masternode list: " << (int)mAskedUsForMasternodeList.size() << ", peers we asked for Masternode list: " << (int)mWeAskedForMasternodeList.size() << ", entries in Masternode list we asked for: " << (int)mWeAskedForMasternodeListEntry.size() << ", nDsqCount: " << (int)nDsqCount;
+    info << "Masternodes: " << (int)vMasternodes.size() << ", peers who asked us for Masternode list: " << (int)mAskedUsForMasternodeList.size() << ", peers we asked for Masternode list: " << (int)mWeAskedForMasternodeList.size() << ", entries in Masternode list we asked for: " << (int)mWeAskedForMasternodeListEntry.size() << ", nDsqCount: " << (int)nDsqCount
+         << ", seen broadcasts: " << (int)mapSeenMasternodeBroadcast.size() << ", seen pings: " << (int)mapSeenMasternodePing.size()
+         << ", seen maps memory: " << (mapSeenMasternodeBroadcast.DynamicMemoryUsage() + mapSeenMasternodePing.DynamicMemoryUsage()) / 1024 << " KiB";
 
     return info.str();
 }
@@ -1203,6 +1312,8 @@ void ThreadCheckMasternodes()
             // try to sync from all available nodes, one step at a time
             masternodeSync.Process();
 
+            mnodeman.UpdateSnapshot();
+
             if (masternodeSync.IsBlockchainSynced()) {
                 c++;
 
@@ -1214,6 +1325,11 @@ void ThreadCheckMasternodes()
                 if (c % 60 == 0) {
                     mnodeman.CheckAndRemove();
                     masternodePayments.CleanPaymentList();
+                    if (pMasternodeSeenDB) {
+                        mnodeman.WriteSeenChanges(*pMasternodeSeenDB);
+                        masternodePayments.WriteWinnerChanges(*pMasternodeSeenDB);
+                        budget.WriteVoteChanges(*pMasternodeSeenDB);
+                    }
                     CleanTransactionLocksList();
                 }
             }
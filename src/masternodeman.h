@@ -11,17 +11,31 @@
 #include "base58.h"
 #include "key.h"
 #include "main.h"
+#include "masternode-cachefile.h"
 #include "masternode.h"
 #include "net.h"
+#include "seenmessagemap.h"
 #include "sync.h"
 #include "util.h"
 
+#include <atomic>
+#include <memory>
+
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
 
+//! Most masternode broadcasts / pings kept in the seen maps
+static const size_t MAX_SEEN_MASTERNODE_BROADCASTS = 50000;
+static const size_t MAX_SEEN_MASTERNODE_PINGS = 250000;
+//! Most masternode broadcasts sent in one "mnblist" message
+static const unsigned int MASTERNODE_LIST_BATCH_SIZE = 500;
+//! Longest time a published masternode list snapshot is handed out before it is refreshed
+static const int64_t MASTERNODE_SNAPSHOT_MILLIS = 1000;
+
 using namespace std;
 
 class CMasternodeMan;
+class CMasternodeSeenDB;
 class CActiveMasternode;
 
 extern CMasternodeMan mnodeman;
@@ -32,28 +46,21 @@ void DumpMasternodes();
 
 /** Access to the MN database (mncache.dat)
  */
-class CMasternodeDB
+class CMasternodeDB : public CMasternodeCacheFile
 {
-private:
-    boost::filesystem::path pathMN;
-    std::string strMagicMessage;
-
 public:
-    enum ReadResult {
-        Ok,
-        FileError,
-        HashReadError,
-        IncorrectHash,
-        IncorrectMagicMessage,
-        IncorrectMagicNumber,
-        IncorrectFormat
-    };
-
     CMasternodeDB();
     bool Write(const CMasternodeMan& mnodemanToSave);
     ReadResult Read(CMasternodeMan& mnodemanToLoad, bool fDryRun = false);
 };
 
+struct MasternodeBroadcastTime {
+    int64_t operator()(const CMasternodeBroadcast& mnb) const { return mnb.lastPing.sigTime; }
+};
+struct MasternodePingTime {
+    int64_t operator()(const CMasternodePing& mnp) const { return mnp.sigTime; }
+};
+
 class CMasternodeMan
 {
 private:
@@ -72,11 +79,36 @@ private:
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // bumped whenever masternodes are added or removed, so the next snapshot is taken right away
+    std::atomic<uint64_t> nListVersion;
+
+    // protects the published snapshot only, never held while taking cs
+    mutable CCriticalSection cs_snapshot;
+    std::shared_ptr<const std::vector<CMasternode>> snapshot;
+    uint64_t nSnapshotVersion;
+    int64_t nSnapshotTime;
+
+    // copy the list as it is into the published snapshot, cs must be held
+    void PublishSnapshot();
+
+    // collateral outpoints of the listed masternodes and whether a block or mempool
+    // transaction spent them; cs_collaterals is never held while taking another lock
+    mutable CCriticalSection cs_collaterals;
+    std::map<COutPoint, bool> mapCollaterals;
+
+    void IndexCollateral(const COutPoint& outpoint);
+    void UnindexCollateral(const COutPoint& outpoint);
+
+    /// Validate and add a masternode broadcast received from pfrom
+    void ProcessBroadcast(CNode* pfrom, CMasternodeBroadcast& mnb);
+
 public:
-    // Keep track of all broadcasts I've seen
-    map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
+    typedef std::shared_ptr<const std::vector<CMasternode>> Snapshot;
+
+    // Keep track of all broadcasts I've seen, oldest last ping first out
+    seenmessagemap<CMasternodeBroadcast, MasternodeBroadcastTime> mapSeenMasternodeBroadcast;
     // Keep track of all pings I've seen
-    map<uint256, CMasternodePing> mapSeenMasternodePing;
+    seenmessagemap<CMasternodePing, MasternodePingTime> mapSeenMasternodePing;
 
     // keep track of dsq count to prevent masternodes from gaming obfuscation queue
     int64_t nDsqCount;
@@ -88,16 +120,28 @@ public:
     {
         LOCK(cs);
         READWRITE(vMasternodes);
+        if (ser_action.ForRead()) {
+            nListVersion++;
+            LOCK(cs_collaterals);
+            mapCollaterals.clear();
+            for (const CMasternode& mn : vMasternodes)
+                mapCollaterals.emplace(mn.vin.prevout, false);
+        }
         READWRITE(mAskedUsForMasternodeList);
         READWRITE(mWeAskedForMasternodeList);
         READWRITE(mWeAskedForMasternodeListEntry);
         READWRITE(nDsqCount);
 
-        READWRITE(mapSeenMasternodeBroadcast);
-        READWRITE(mapSeenMasternodePing);
+        // The seen maps are kept in CMasternodeSeenDB
+        READWRITE(REF(SeenMapPlaceholder(mapSeenMasternodeBroadcast)));
+        READWRITE(REF(SeenMapPlaceholder(mapSeenMasternodePing)));
     }
 
     CMasternodeMan();
+    /// Add the seen broadcasts and pings stored in db
+    bool LoadSeen(CMasternodeSeenDB& db);
+    /// Write the seen broadcasts and pings added, changed or removed since the last call to db
+    bool WriteSeenChanges(CMasternodeSeenDB& db);
     void Check();
     /// Add an entry
     bool Add(CMasternode& mn);
@@ -105,8 +149,13 @@ public:
     /// Ask (source) node for mnb
     void AskForMN(CNode* pnode, const CTxIn& vin);
 
+    /// Mark the collaterals spent by a connected block or a new mempool transaction
     void CheckSpentCollaterals(const std::vector<CTransaction>& vtx);
-    
+    void CheckSpentCollaterals(const CTransaction& tx);
+    /// Mark the collaterals spent by a disconnected block as unspent again
+    void RestoreSpentCollaterals(const std::vector<CTransaction>& vtx);
+    bool IsCollateralSpent(const COutPoint& outpoint) const;
+
     /// Check all Masternodes and remove inactive
     void CheckAndRemove(bool forceExpiredRemoval = false);
 
@@ -127,14 +176,28 @@ public:
 
     /// Find an entry in the masternode list that is next to be paid
     CMasternode* GetNextMasternodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount);
+    /// Count the masternodes of the published snapshot that GetNextMasternodeInQueueForPayment picks from
+    int CountInQueueForPayment(int nBlockHeight);
 
     /// Get the current winner for this block
     CMasternode* GetCurrentMasterNode(int mod = 1, int64_t nBlockHeight = 0, int minProtocol = 0);
 
-    std::vector<CMasternode> GetFullMasternodeVector()
-    {
-        return vMasternodes;
-    }
+    /**
+     * Immutable copy of the masternode list for readers such as RPC. Readers
+     * never take cs: copies are published by CheckAndRemove and by
+     * UpdateSnapshot from the masternode thread, so they may lag the live
+     * list by about a second.
+     */
+    Snapshot GetSnapshot() const;
+    // changes whenever masternodes are added to or removed from the list
+    uint64_t GetListVersion() const { return nListVersion; }
+
+    /**
+     * Check every masternode and publish a new snapshot if masternodes were
+     * added or removed since the last one, or if it is older than
+     * MASTERNODE_SNAPSHOT_MILLIS. Bursts of updates share one copy.
+     */
+    void UpdateSnapshot();
 
     std::vector<pair<int, CMasternode>> GetMasternodeRanks(int64_t nBlockHeight, int minProtocol = 0);
     int GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
@@ -142,6 +205,9 @@ public:
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
+    /// Process an "mnblist" batch of masternode broadcasts, only accepted from peers we sent a dseg to
+    void ProcessBroadcastList(CNode* pfrom, CDataStream& vRecv);
+
     /// Return the number of (unique) Masternodes
     int size() { return vMasternodes.size(); }
 
@@ -6,10 +6,55 @@
 #include "primitives/block.h"
 
 #include "crypto/common.h"
+#include "crypto/sha256.h"
 #include "hash.h"
 #include "tinyformat.h"
+#include "util/parallel.h"
 #include "utilstrencodings.h"
 
+#include <thread>
+
+namespace
+{
+//! Levels with at least this many pairs are hashed on several threads.
+const size_t MERKLE_PARALLEL_MIN_PAIRS = 4096;
+//! Minimum number of pairs given to each thread.
+const size_t MERKLE_PAIRS_PER_THREAD = 2048;
+const size_t MERKLE_MAX_THREADS = 8;
+
+/**
+ * Hash the nSize nodes of one merkle tree level into the (nSize + 1) / 2
+ * nodes of the next one. Adjacent nodes are contiguous 64-byte inputs, so
+ * full pairs go through the multi-lane SHA256D64 kernel.
+ */
+void ComputeMerkleLevel(const uint256* in, size_t nSize, uint256* out)
+{
+    size_t nPairs = nSize / 2;
+    size_t nThreads = 1;
+    if (nPairs >= MERKLE_PARALLEL_MIN_PAIRS) {
+        nThreads = std::min<size_t>(std::thread::hardware_concurrency(), MERKLE_MAX_THREADS);
+        nThreads = std::max<size_t>(std::min(nThreads, nPairs / MERKLE_PAIRS_PER_THREAD), 1);
+    }
+
+    if (nThreads > 1) {
+        // Split into contiguous ranges of pairs, i.e. into independent subtrees.
+        size_t nPerThread = (nPairs + nThreads - 1) / nThreads;
+        size_t nRanges = (nPairs + nPerThread - 1) / nPerThread;
+        util::ParallelFor(nRanges, nThreads, [&](size_t i) {
+            size_t start = i * nPerThread;
+            SHA256D64(out[start].begin(), in[2 * start].begin(), std::min(nPerThread, nPairs - start));
+        });
+    } else if (nPairs > 0) {
+        SHA256D64(out[0].begin(), in[0].begin(), nPairs);
+    }
+
+    if (nSize & 1) {
+        // The last node of an odd-sized level is paired with itself.
+        out[nPairs] = Hash(in[nSize - 1].begin(), in[nSize - 1].end(), in[nSize - 1].begin(), in[nSize - 1].end());
+    }
+}
+} // namespace
+
 uint256 CBlockHeader::GetHash() const
 {
     return SerializeHash(*this);
@@ -52,22 +97,20 @@ uint256 CBlock::BuildMerkleTree(bool* fMutated) const
        known ways of changing the transactions without affecting the merkle
        root.
     */
-    vMerkleTree.clear();
-    vMerkleTree.reserve(vtx.size() * 2 + 16); // Safe upper bound for the number of total nodes.
-    for (std::vector<CTransaction>::const_iterator it(vtx.begin()); it != vtx.end(); ++it)
-        vMerkleTree.push_back(it->GetHash());
-    int j = 0;
+    size_t nNodes = vtx.size();
+    for (size_t nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2)
+        nNodes += (nSize + 1) / 2;
+    vMerkleTree.resize(nNodes);
+    for (size_t i = 0; i < vtx.size(); i++)
+        vMerkleTree[i] = vtx[i].GetHash();
+    size_t j = 0;
     bool mutated = false;
-    for (int nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2) {
-        for (int i = 0; i < nSize; i += 2) {
-            int i2 = std::min(i + 1, nSize - 1);
-            if (i2 == i + 1 && i2 + 1 == nSize && vMerkleTree[j + i] == vMerkleTree[j + i2]) {
-                // Two identical hashes at the end of the list at a particular level.
-                mutated = true;
-            }
-            vMerkleTree.push_back(Hash(BEGIN(vMerkleTree[j + i]), END(vMerkleTree[j + i]),
-                                       BEGIN(vMerkleTree[j + i2]), END(vMerkleTree[j + i2])));
+    for (size_t nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2) {
+        if (nSize % 2 == 0 && vMerkleTree[j + nSize - 2] == vMerkleTree[j + nSize - 1]) {
+            // Two identical hashes at the end of the list at a particular level.
+            mutated = true;
         }
+        ComputeMerkleLevel(&vMerkleTree[j], nSize, &vMerkleTree[j + nSize]);
         j += nSize;
     }
     if (fMutated) {
@@ -87,6 +87,8 @@ public:
     // memory only
     mutable CScript payee;
     mutable std::vector<uint256> vMerkleTree;
+    //! Set once the Equihash solution, proof of work and merkle root were verified ahead of CheckBlock
+    mutable bool fChecked;
 
     CBlock()
     {
@@ -114,6 +116,7 @@ public:
         vtx.clear();
         payee = CScript();
         vMerkleTree.clear();
+        fChecked = false;
     }
 
     CBlockHeader GetBlockHeader() const
@@ -0,0 +1,99 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "proofcache.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
+#include "random.h"
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+namespace
+{
+
+/** Entries are salted hashes, so any 32 bits of them are a good hash. */
+class ProofCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "ProofCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+class CProofCache
+{
+private:
+    //! Entries are SHA256(nonce || txid || consensus branch ID):
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, ProofCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_proofcache;
+
+public:
+    CProofCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        // Usable before InitProofCache() sizes it properly.
+        setValid.setup(2);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256& txid, uint32_t consensusBranchId)
+    {
+        unsigned char branchId[4];
+        WriteLE32(branchId, consensusBranchId);
+        CSHA256().Write(nonce.begin(), 32).Write(txid.begin(), 32).Write(branchId, sizeof(branchId)).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry, const bool erase)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_proofcache);
+        return setValid.contains(entry, erase);
+    }
+
+    void Set(const uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_proofcache);
+        setValid.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_proofcache);
+        return setValid.setup_bytes(n);
+    }
+};
+
+CProofCache proofCache;
+
+} // namespace
+
+void InitProofCache()
+{
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxproofcachesize", DEFAULT_MAX_PROOF_CACHE_SIZE)), MAX_MAX_PROOF_CACHE_SIZE) * ((size_t)1 << 20);
+    size_t nElems = proofCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for shielded proof cache, able to store %zu elements\n",
+              (nElems * sizeof(uint256)) >> 20, nMaxCacheSize >> 20, nElems);
+}
+
+void ProofCacheAdd(const uint256& txid, uint32_t consensusBranchId)
+{
+    uint256 entry;
+    proofCache.ComputeEntry(entry, txid, consensusBranchId);
+    proofCache.Set(entry);
+}
+
+bool ProofCacheContains(const uint256& txid, uint32_t consensusBranchId, bool erase)
+{
+    uint256 entry;
+    proofCache.ComputeEntry(entry, txid, consensusBranchId);
+    return proofCache.Get(entry, erase);
+}
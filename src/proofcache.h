@@ -0,0 +1,35 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef ZCASH_PROOFCACHE_H
+#define ZCASH_PROOFCACHE_H
+
+#include "uint256.h"
+
+#include <stdint.h>
+
+// Each entry is 32 bytes, so the default holds over 100000 transactions.
+static const int64_t DEFAULT_MAX_PROOF_CACHE_SIZE = 4;
+// Maximum proof cache size allowed, in MiB
+static const int64_t MAX_MAX_PROOF_CACHE_SIZE = 1024;
+
+/**
+ * Cache of transactions whose shielded data (JoinSplit proofs and signature,
+ * Sapling spend and output proofs and binding signature) has been verified
+ * under a given consensus branch ID. The txid commits to all of that data and
+ * the branch ID to the signature hash, so a hit means the checks would pass.
+ *
+ * Entries are added by AcceptToMemoryPool and consulted when the transaction
+ * is validated again as part of a block.
+ */
+void InitProofCache();
+
+//! Add a transaction whose shielded proofs and signatures are valid.
+void ProofCacheAdd(const uint256& txid, uint32_t consensusBranchId);
+
+//! Check whether a transaction's shielded data was already verified. If erase
+//! is set, the entry is marked for eviction as it will not be needed again.
+bool ProofCacheContains(const uint256& txid, uint32_t consensusBranchId, bool erase);
+
+#endif // ZCASH_PROOFCACHE_H
@@ -52,6 +52,11 @@ const char* FINALBUDGET = "fbs";
 const char* FINALBUDGETVOTE = "fbvote";
 const char* SYNCSTATUSCOUNT = "ssc";
 const char* GETMNLIST = "dseg";
+const char* MNBLIST = "mnblist";
+const char* SENDCMPCT = "sendcmpct";
+const char* CMPCTBLOCK = "cmpctblock";
+const char* GETBLOCKTXN = "getblocktxn";
+const char* BLOCKTXN = "blocktxn";
 }; // namespace NetMsgType
 
 /** All known message types. Keep this in the same order as the list of
@@ -89,12 +94,17 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::MNWINNER,
     NetMsgType::GETMNWINNERS,
     NetMsgType::GETMNLIST,
+    NetMsgType::MNBLIST,
     NetMsgType::BUDGETPROPOSAL,
     NetMsgType::BUDGETVOTE,
     NetMsgType::BUDGETVOTESYNC,
     NetMsgType::FINALBUDGET,
     NetMsgType::FINALBUDGETVOTE,
-    NetMsgType::SYNCSTATUSCOUNT
+    NetMsgType::SYNCSTATUSCOUNT,
+    NetMsgType::SENDCMPCT,
+    NetMsgType::CMPCTBLOCK,
+    NetMsgType::GETBLOCKTXN,
+    NetMsgType::BLOCKTXN
 };
 const static std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes + ARRAYLEN(allNetMessageTypes));
 
@@ -116,7 +126,8 @@ static const char* ppszTypeName[] =
         "mn quorum",
         "mn announce",
         "mn ping",
-        "dstx"};
+        "dstx",
+        "cmpct block"};
 
 CMessageHeader::CMessageHeader(const MessageStartChars& pchMessageStartIn)
 {
@@ -181,7 +181,10 @@ enum {
     MSG_MASTERNODE_QUORUM,
     MSG_MASTERNODE_ANNOUNCE,
     MSG_MASTERNODE_PING,
-    MSG_DSTX
+    MSG_DSTX,
+    // Requests a block as a cmpctblock message (BIP 152). Only used in getdata,
+    // and only sent to peers that announced support with sendcmpct.
+    MSG_CMPCT_BLOCK
 };
 
 #endif // BITCOIN_PROTOCOL_H
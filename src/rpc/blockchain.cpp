@@ -15,7 +15,9 @@
 #include "masternode-budget.h"
 #include "primitives/transaction.h"
 #include "pubkey.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/server.h"
+#include "snapshot.h"
 #include "streams.h"
 #include "sync.h"
 #include "util.h"
@@ -230,49 +232,72 @@ UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+/**
+ * Write the JSON description of block. The parts that depend on the active
+ * chain are passed in, so that no lock is held while the output is written.
+ */
+static void blockToJSON(JSONWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails, int confirmations, const CBlockIndex* pnext)
 {
-    UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", block.GetHash().GetHex()));
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    result.push_back(Pair("finalsaplingroot", block.hashFinalSaplingRoot.GetHex()));
-    UniValue txs(UniValue::VARR);
+    writer.BeginObject();
+    writer.KeyValue("hash", block.GetHash().GetHex());
+    writer.KeyValue("confirmations", confirmations);
+    writer.KeyValue("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    writer.KeyValue("height", blockindex->nHeight);
+    writer.KeyValue("version", block.nVersion);
+    writer.KeyValue("merkleroot", block.hashMerkleRoot.GetHex());
+    writer.KeyValue("finalsaplingroot", block.hashFinalSaplingRoot.GetHex());
+    writer.Key("tx");
+    writer.BeginArray();
     for (const CTransaction& tx : block.vtx) {
         if (txDetails) {
             UniValue objTx(UniValue::VOBJ);
             TxToJSON(tx, uint256(), objTx);
-            txs.push_back(objTx);
+            writer.Value(objTx);
         } else
-            txs.push_back(tx.GetHash().GetHex());
+            writer.Value(tx.GetHash().GetHex());
     }
-    result.push_back(Pair("tx", txs));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("nonce", block.nNonce.GetHex()));
-    result.push_back(Pair("solution", HexStr(block.nSolution)));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
-    result.push_back(Pair("anchor", blockindex->hashFinalSproutRoot.GetHex()));
+    writer.EndArray();
+    writer.KeyValue("time", block.GetBlockTime());
+    writer.KeyValue("nonce", block.nNonce.GetHex());
+    writer.KeyValue("solution", HexStr(block.nSolution));
+    writer.KeyValue("bits", strprintf("%08x", block.nBits));
+    writer.KeyValue("difficulty", GetDifficulty(blockindex));
+    writer.KeyValue("chainwork", blockindex->nChainWork.GetHex());
+    writer.KeyValue("anchor", blockindex->hashFinalSproutRoot.GetHex());
 
     UniValue valuePools(UniValue::VARR);
     valuePools.push_back(ValuePoolDesc("sprout", blockindex->nChainSproutValue, blockindex->nSproutValue));
     valuePools.push_back(ValuePoolDesc("sapling", blockindex->nChainSaplingValue, blockindex->nSaplingValue));
-    result.push_back(Pair("valuePools", valuePools));
+    writer.KeyValue("valuePools", valuePools);
 
     if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex* pnext = chainActive.Next(blockindex);
+        writer.KeyValue("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
     if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
-    return result;
+        writer.KeyValue("nextblockhash", pnext->GetBlockHash().GetHex());
+    writer.EndObject();
+}
+
+//! Confirmations of blockindex, -1 if it is not on the main chain. Requires cs_main.
+static int GetBlockConfirmations(const CBlockIndex* blockindex)
+{
+    AssertLockHeld(cs_main);
+    if (!chainActive.Contains(blockindex))
+        return -1;
+    return chainActive.Height() - blockindex->nHeight + 1;
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    int confirmations;
+    const CBlockIndex* pnext;
+    {
+        LOCK(cs_main);
+        confirmations = GetBlockConfirmations(blockindex);
+        pnext = chainActive.Next(blockindex);
+    }
+    JSONValueWriter writer;
+    blockToJSON(writer, block, blockindex, txDetails, confirmations, pnext);
+    return writer.GetValue();
 }
 
 UniValue getblockcount(const UniValue& params, bool fHelp)
@@ -320,26 +345,49 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
     return GetNetworkDifficulty();
 }
 
-UniValue mempoolToJSON(bool fVerbose = false)
+//! What getrawmempool reports about an entry, copied out so that it can be written without holding mempool.cs
+struct MempoolEntryInfo {
+    uint256 hash;
+    unsigned int nSize;
+    CAmount nFee;
+    int64_t nTime;
+    unsigned int nHeight;
+    double dStartingPriority;
+    double dCurrentPriority;
+    std::vector<uint256> vDepends;
+};
+
+void mempoolToJSON(JSONWriter& writer, bool fVerbose)
 {
     if (fVerbose) {
-        LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : mempool.mapTx) {
-            const uint256& hash = e.GetTx().GetHash();
+        std::vector<MempoolEntryInfo> vEntries;
+        {
+            LOCK2(cs_main, mempool.cs);
+            vEntries.reserve(mempool.mapTx.size());
+            for (const CTxMemPoolEntry& e : mempool.mapTx) {
+                const CTransaction& tx = e.GetTx();
+                MempoolEntryInfo entry{tx.GetHash(), (unsigned int)e.GetTxSize(), e.GetFee(), e.GetTime(), e.GetHeight(),
+                                       e.GetPriority(e.GetHeight()), e.GetPriority(chainActive.Height()), {}};
+                for (const CTxIn& txin : tx.vin) {
+                    if (mempool.exists(txin.prevout.hash))
+                        entry.vDepends.push_back(txin.prevout.hash);
+                }
+                vEntries.push_back(std::move(entry));
+            }
+        }
+
+        writer.BeginObject();
+        for (const MempoolEntryInfo& e : vEntries) {
             UniValue info(UniValue::VOBJ);
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            const CTransaction& tx = e.GetTx();
+            info.push_back(Pair("size", (int)e.nSize));
+            info.push_back(Pair("fee", ValueFromAmount(e.nFee)));
+            info.push_back(Pair("time", e.nTime));
+            info.push_back(Pair("height", (int)e.nHeight));
+            info.push_back(Pair("startingpriority", e.dStartingPriority));
+            info.push_back(Pair("currentpriority", e.dCurrentPriority));
             set<string> setDepends;
-            for (const CTxIn& txin : tx.vin) {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
+            for (const uint256& dep : e.vDepends)
+                setDepends.insert(dep.ToString());
 
             UniValue depends(UniValue::VARR);
             for (const string& dep : setDepends) {
@@ -347,22 +395,28 @@ UniValue mempoolToJSON(bool fVerbose = false)
             }
 
             info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
+            writer.KeyValue(e.hash.ToString(), info);
         }
-        return o;
+        writer.EndObject();
     } else {
         vector<uint256> vtxid;
         mempool.queryHashes(vtxid);
 
-        UniValue a(UniValue::VARR);
+        writer.BeginArray();
         for (const uint256& hash : vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+            writer.Value(hash.ToString());
+        writer.EndArray();
     }
 }
 
-UniValue getrawmempool(const UniValue& params, bool fHelp)
+UniValue mempoolToJSON(bool fVerbose = false)
+{
+    JSONValueWriter writer;
+    mempoolToJSON(writer, fVerbose);
+    return writer.GetValue();
+}
+
+static void getrawmempool_streamed(const UniValue& params, bool fHelp, JSONWriter& writer)
 {
     if (fHelp || params.size() > 1)
         throw runtime_error(
@@ -393,13 +447,16 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
                             "\nExamples\n" +
             HelpExampleCli("getrawmempool", "true") + HelpExampleRpc("getrawmempool", "true"));
 
-    LOCK(cs_main);
-
     bool fVerbose = false;
     if (params.size() > 0)
         fVerbose = params[0].get_bool();
 
-    return mempoolToJSON(fVerbose);
+    mempoolToJSON(writer, fVerbose);
+}
+
+UniValue getrawmempool(const UniValue& params, bool fHelp)
+{
+    return RPCStreamToValue(getrawmempool_streamed, params, fHelp);
 }
 
 
@@ -645,7 +702,7 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     return blockheaderToJSON(pblockindex);
 }
 
-UniValue getblock(const UniValue& params, bool fHelp)
+static void getblock_streamed(const UniValue& params, bool fHelp, JSONWriter& writer)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
@@ -689,33 +746,6 @@ UniValue getblock(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getblock", "\"00000000febc373a1da2bd9f887b105ad79ddc26ac26c2b28652d64e5207c5b5\"") + HelpExampleRpc("getblock", "\"00000000febc373a1da2bd9f887b105ad79ddc26ac26c2b28652d64e5207c5b5\"") + HelpExampleCli("getblock", "12800") + HelpExampleRpc("getblock", "12800"));
 
-    LOCK(cs_main);
-
-    std::string strHash = params[0].get_str();
-
-    // If height is supplied, find the hash
-    if (strHash.size() < (2 * sizeof(uint256))) {
-        // std::stoi allows characters, whereas we want to be strict
-        regex r("[[:digit:]]+");
-        if (!regex_match(strHash, r)) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
-        }
-
-        int nHeight = -1;
-        try {
-            nHeight = std::stoi(strHash);
-        } catch (const std::exception& e) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
-        }
-
-        if (nHeight < 0 || nHeight > chainActive.Height()) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
-        }
-        strHash = chainActive[nHeight]->GetBlockHash().GetHex();
-    }
-
-    uint256 hash(uint256S(strHash));
-
     int verbosity = 1;
     if (params.size() > 1) {
         if (params[1].isNum()) {
@@ -729,64 +759,223 @@ UniValue getblock(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbosity must be in range from 0 to 2");
     }
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
+    // Look the block up and read it under cs_main, then write it without
+    // holding the lock, as writing waits for the client to read.
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex;
+    int confirmations;
+    const CBlockIndex* pnext;
+    {
+        LOCK(cs_main);
 
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+        std::string strHash = params[0].get_str();
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        // If height is supplied, find the hash
+        if (strHash.size() < (2 * sizeof(uint256))) {
+            // std::stoi allows characters, whereas we want to be strict
+            regex r("[[:digit:]]+");
+            if (!regex_match(strHash, r)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
+            }
+
+            int nHeight = -1;
+            try {
+                nHeight = std::stoi(strHash);
+            } catch (const std::exception& e) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
+            }
+
+            if (nHeight < 0 || nHeight > chainActive.Height()) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+            }
+            strHash = chainActive[nHeight]->GetBlockHash().GetHex();
+        }
+
+        uint256 hash(uint256S(strHash));
+
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+        pblockindex = mapBlockIndex[hash];
+
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+
+        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+        confirmations = GetBlockConfirmations(pblockindex);
+        pnext = chainActive.Next(pblockindex);
+    }
 
     if (verbosity == 0) {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
         ssBlock << block;
         std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        writer.Value(strHex);
+        return;
     }
 
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    blockToJSON(writer, block, pblockindex, verbosity >= 2, confirmations, pnext);
+}
+
+UniValue getblock(const UniValue& params, bool fHelp)
+{
+    return RPCStreamToValue(getblock_streamed, params, fHelp);
 }
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "The default \"muhash\" statistics are maintained incrementally and return immediately.\n"
+            "Note the \"hash_serialized\" hash type scans the whole set and may take some time.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"      (string, optional, default=\"muhash\") Which UTXO set hash to calculate: \"muhash\" or \"hash_serialized\"\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
             "  \"transactions\": n,      (numeric) The number of transactions\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
-            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"bytes_serialized\": n,  (numeric) The serialized size (hash_serialized only)\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash (hash_serialized only)\n"
+            "  \"muhash\": \"hash\",   (string) The rolling hash of the unspent outputs\n"
+            "  \"total_amount\": x.xxx,         (numeric) The total amount\n"
+            "  \"valuePools\": [                (array) Shielded value pool totals at the best block\n"
+            "     {\n"
+            "       \"id\": \"sprout|sapling\",   (string) name of the pool\n"
+            "       \"monitored\": xx,            (boolean) true if the pool total is tracked\n"
+            "       \"chainValue\": xxxxxx,       (numeric) total amount in the pool\n"
+            "       \"chainValueZat\": xxxxxx,    (numeric) total amount in the pool in zatoshis\n"
+            "     }, ...\n"
+            "  ]\n"
             "}\n"
             "\nExamples:\n" +
-            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleRpc("gettxoutsetinfo", ""));
+            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleCli("gettxoutsetinfo", "\"hash_serialized\"") + HelpExampleRpc("gettxoutsetinfo", ""));
+
+    std::string strHashType = params.size() > 0 ? params[0].get_str() : "muhash";
+    bool fFullScan;
+    if (strHashType == "muhash") {
+        fFullScan = false;
+    } else if (strHashType == "hash_serialized") {
+        fFullScan = true;
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid hash_type, must be \"muhash\" or \"hash_serialized\"");
+    }
 
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (pcoinsTip->GetStats(stats)) {
+    bool fHaveStats;
+    if (fFullScan) {
+        FlushStateToDisk();
+        fHaveStats = pcoinsTip->GetStats(stats);
+    } else {
+        fHaveStats = GetUTXOStats(stats);
+    }
+    if (fHaveStats) {
         ret.push_back(Pair("height", (int64_t)stats.nHeight));
         ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
         ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
         ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
-        ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
-        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+        if (fFullScan) {
+            ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
+            ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+        }
+        ret.push_back(Pair("muhash", stats.GetMuHash().GetHex()));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(stats.hashBlock);
+        if (mi != mapBlockIndex.end()) {
+            UniValue valuePools(UniValue::VARR);
+            valuePools.push_back(ValuePoolDesc("sprout", mi->second->nChainSproutValue, std::nullopt));
+            valuePools.push_back(ValuePoolDesc("sapling", mi->second->nChainSaplingValue, std::nullopt));
+            ret.push_back(Pair("valuePools", valuePools));
+        }
     }
     return ret;
 }
 
+static UniValue SnapshotToJSON(const CSnapshotMetadata& metadata, const uint256& hashSnapshot, uint64_t nEntries, const fs::path& path)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("base_hash", metadata.hashBlock.GetHex()));
+    ret.push_back(Pair("base_height", metadata.nHeight));
+    ret.push_back(Pair("entries", (uint64_t)nEntries));
+    ret.push_back(Pair("snapshot_hash", hashSnapshot.GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the chain state at the current tip to a UTXO snapshot file.\n"
+            "Blocks keep being connected while the file is written.\n"
+            "\nArguments:\n"
+            "1. \"path\"      (string, required) The file to write; relative paths are resolved against the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"base_hash\": \"hex\",       (string) the block the snapshot was taken at\n"
+            "  \"base_height\": n,         (numeric) the height of that block\n"
+            "  \"entries\": n,             (numeric) the number of chain state entries written\n"
+            "  \"snapshot_hash\": \"hex\",   (string) the hash to pass to loadtxoutset\n"
+            "  \"path\": \"path\"           (string) the absolute path of the snapshot\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") + HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+
+    fs::path path = fs::absolute(params[0].get_str(), GetDataDir());
+    CSnapshotMetadata metadata;
+    uint256 hashSnapshot;
+    uint64_t nEntries = 0;
+    std::string strError;
+    if (!DumpUTXOSnapshot(path, metadata, hashSnapshot, nEntries, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return SnapshotToJSON(metadata, hashSnapshot, nEntries, path);
+}
+
+UniValue loadtxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 2)
+        throw runtime_error(
+            "loadtxoutset \"path\" \"snapshot_hash\"\n"
+            "\nReplace the chain state of a freshly started node with a UTXO snapshot written by dumptxoutset.\n"
+            "The node must not have connected any block after genesis, and the snapshot block must be on the\n"
+            "best header chain; start the node with -loadsnapshot to hold off block download until then. Blocks below the snapshot block are never downloaded or validated, so they\n"
+            "cannot be served to peers, rescanned by wallets or indexed; the address index only gets the\n"
+            "snapshot's unspent outputs.\n"
+            "\nArguments:\n"
+            "1. \"path\"            (string, required) The snapshot file; relative paths are resolved against the data directory\n"
+            "2. \"snapshot_hash\"   (string, required) The snapshot_hash reported by dumptxoutset, obtained from a trusted source\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"base_hash\": \"hex\",       (string) the new chain tip\n"
+            "  \"base_height\": n,         (numeric) the height of the new chain tip\n"
+            "  \"entries\": n,             (numeric) the number of chain state entries loaded\n"
+            "  \"snapshot_hash\": \"hex\",   (string) the hash of the snapshot\n"
+            "  \"path\": \"path\"           (string) the absolute path of the snapshot\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("loadtxoutset", "\"utxo.dat\" \"0000000000000000000000000000000000000000000000000000000000000000\"") +
+            HelpExampleRpc("loadtxoutset", "\"utxo.dat\", \"0000000000000000000000000000000000000000000000000000000000000000\""));
+
+    fs::path path = fs::absolute(params[0].get_str(), GetDataDir());
+    uint256 hashExpected = ParseHashV(params[1], "snapshot_hash");
+    CSnapshotMetadata metadata;
+    uint64_t nEntries = 0;
+    std::string strError;
+    if (!LoadUTXOSnapshot(path, hashExpected, metadata, nEntries, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    return SnapshotToJSON(metadata, hashExpected, nEntries, path);
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -1265,15 +1454,17 @@ static const CRPCCommand commands[] =
         {"blockchain", "getblockchaininfo", &getblockchaininfo, true},
         {"blockchain", "getbestblockhash", &getbestblockhash, true},
         {"blockchain", "getblockcount", &getblockcount, true},
-        {"blockchain", "getblock", &getblock, true},
+        {"blockchain", "getblock", &getblock, true, &getblock_streamed},
         {"blockchain", "getblockhash", &getblockhash, true},
         {"blockchain", "getblockheader", &getblockheader, true},
         {"blockchain", "getchaintips", &getchaintips, true},
         {"blockchain", "getdifficulty", &getdifficulty, true},
         {"blockchain", "getmempoolinfo", &getmempoolinfo, true},
-        {"blockchain", "getrawmempool", &getrawmempool, true},
+        {"blockchain", "getrawmempool", &getrawmempool, true, &getrawmempool_streamed},
         {"blockchain", "gettxout", &gettxout, true},
         {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true},
+        {"blockchain", "dumptxoutset", &dumptxoutset, true},
+        {"blockchain", "loadtxoutset", &loadtxoutset, false},
         {"blockchain", "verifychain", &verifychain, true},
 
         /* Not shown in help */
@@ -0,0 +1,146 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonwriter.h"
+
+#include <assert.h>
+
+JSONStreamWriter::JSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn) : sink(sinkIn),
+                                                                              nChunkSize(nChunkSizeIn),
+                                                                              fAfterKey(false),
+                                                                              fStarted(false)
+{
+    strBuffer.reserve(nChunkSize);
+}
+
+void JSONStreamWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vFirst.empty()) {
+        if (!vFirst.back())
+            strBuffer += ',';
+        vFirst.back() = false;
+    }
+}
+
+void JSONStreamWriter::Write(const std::string& str)
+{
+    strBuffer += str;
+    if (strBuffer.size() >= nChunkSize)
+        Flush();
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separate();
+    vFirst.push_back(true);
+    Write("{");
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    vFirst.pop_back();
+    Write("}");
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separate();
+    vFirst.push_back(true);
+    Write("[");
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    vFirst.pop_back();
+    Write("]");
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!fAfterKey);
+    Separate();
+    Write(UniValue(key).write() + ":");
+    fAfterKey = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& val)
+{
+    Separate();
+    Write(val.write());
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+    fStarted = true;
+    sink(strBuffer);
+    strBuffer.clear();
+}
+
+std::string JSONStreamWriter::ReleaseBuffer()
+{
+    std::string strOut;
+    strOut.swap(strBuffer);
+    return strOut;
+}
+
+void JSONValueWriter::Open(UniValue::VType type)
+{
+    vKeys.push_back(strKey);
+    strKey.clear();
+    vStack.push_back(UniValue(type));
+}
+
+void JSONValueWriter::Close()
+{
+    assert(!vStack.empty());
+    UniValue val = vStack.back();
+    vStack.pop_back();
+    strKey = vKeys.back();
+    vKeys.pop_back();
+    Value(val);
+}
+
+void JSONValueWriter::BeginObject()
+{
+    Open(UniValue::VOBJ);
+}
+
+void JSONValueWriter::EndObject()
+{
+    Close();
+}
+
+void JSONValueWriter::BeginArray()
+{
+    Open(UniValue::VARR);
+}
+
+void JSONValueWriter::EndArray()
+{
+    Close();
+}
+
+void JSONValueWriter::Key(const std::string& key)
+{
+    strKey = key;
+}
+
+void JSONValueWriter::Value(const UniValue& val)
+{
+    if (vStack.empty())
+        result = val;
+    else if (vStack.back().isObject())
+        vStack.back().pushKV(strKey, val);
+    else
+        vStack.back().push_back(val);
+    strKey.clear();
+}
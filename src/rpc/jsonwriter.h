@@ -0,0 +1,109 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONWRITER_H
+#define BITCOIN_RPC_JSONWRITER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+//! Size of the chunks a JSONStreamWriter hands to its sink
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Event-style JSON emitter. Containers are opened and closed explicitly and
+ * scalar (or small, prebuilt) values are written with Value, so a large
+ * result never has to exist as a single UniValue tree.
+ */
+class JSONWriter
+{
+public:
+    virtual ~JSONWriter() {}
+
+    virtual void BeginObject() = 0;
+    virtual void EndObject() = 0;
+    virtual void BeginArray() = 0;
+    virtual void EndArray() = 0;
+    //! Name the next value or container of the enclosing object
+    virtual void Key(const std::string& key) = 0;
+    virtual void Value(const UniValue& val) = 0;
+
+    void KeyValue(const std::string& key, const UniValue& val)
+    {
+        Key(key);
+        Value(val);
+    }
+};
+
+/**
+ * Serializes straight to text, handing it to a sink in chunks of about
+ * nChunkSize bytes as it is produced.
+ */
+class JSONStreamWriter : public JSONWriter
+{
+public:
+    typedef std::function<void(const std::string& strChunk)> Sink;
+
+    explicit JSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn = JSON_STREAM_CHUNK_SIZE);
+
+    void BeginObject() override;
+    void EndObject() override;
+    void BeginArray() override;
+    void EndArray() override;
+    void Key(const std::string& key) override;
+    void Value(const UniValue& val) override;
+
+    //! Hand all buffered output to the sink
+    void Flush();
+    //! Return and forget the output that was not handed to the sink yet
+    std::string ReleaseBuffer();
+    //! Whether the sink has been called at least once
+    bool Started() const { return fStarted; }
+
+private:
+    Sink sink;
+    size_t nChunkSize;
+    std::string strBuffer;
+    //! One entry per open container: whether nothing was written into it yet
+    std::vector<bool> vFirst;
+    bool fAfterKey;
+    bool fStarted;
+
+    void Separate();
+    void Write(const std::string& str);
+};
+
+/**
+ * Collects the written document into a UniValue, for callers that need the
+ * result as a value (batches, REST, tests).
+ */
+class JSONValueWriter : public JSONWriter
+{
+public:
+    JSONValueWriter() {}
+
+    void BeginObject() override;
+    void EndObject() override;
+    void BeginArray() override;
+    void EndArray() override;
+    void Key(const std::string& key) override;
+    void Value(const UniValue& val) override;
+
+    const UniValue& GetValue() const { return result; }
+
+private:
+    UniValue result;
+    std::vector<UniValue> vStack;
+    //! Key under which each open container goes into its parent
+    std::vector<std::string> vKeys;
+    std::string strKey;
+
+    void Open(UniValue::VType type);
+    void Close();
+};
+
+#endif // BITCOIN_RPC_JSONWRITER_H
@@ -98,53 +98,52 @@ UniValue listmasternodes(const UniValue& params, bool fHelp)
         std::string strTxHash = s.second.vin.prevout.hash.ToString();
         uint32_t oIdx = s.second.vin.prevout.n;
 
-        CMasternode* mn = mnodeman.Find(s.second.vin);
+        // entries are copies from a snapshot of the list, no need to look them up again
+        CMasternode* mn = &s.second;
 
-        if (mn != NULL) {
-            KeyIO keyIO(Params());
-            if (strFilter != "" && strTxHash.find(strFilter) == string::npos &&
-                mn->Status().find(strFilter) == string::npos &&
-                keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID()).find(strFilter) == string::npos)
-                continue;
-            // LogPrintf("Get masternode info %s", keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID()));
-            std::string strStatus = mn->Status();
-            std::string strHost;
-            int port;
-            SplitHostPort(mn->addr.ToString(), port, strHost);
-            CNetAddr node = CNetAddr(strHost, false);
-            std::string strNetwork = GetNetworkName(node.GetNetwork());
-
-            CTxDestination address = keyIO.DecodeDestination(keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID()));
-            CScript scriptPubKey = GetScriptForDestination(address);
-
-            int nHeight = 0;
-
-            // ver 1 - get from network
-            bool result = GetLastPaymentBlock(s.second.vin, nHeight);
-
-            // ver 2 - get locally
-            // CTxDestination address = keyIO.DecodeDestination(keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID()));
-            // CScript scriptPubKey = GetScriptForDestination(address);
-            // bool result = GetLastPaymentBlock(s.second.vin.prevout.hash, scriptPubKey, nHeight);
-
-            // LogPrintf("Get masternode result %d", result);
-            int unlockHeight = chainActive.Height() > nHeight + Params().GetmnLockBlocks(chainActive.Height()) ? 0 : nHeight + Params().GetmnLockBlocks(chainActive.Height());
-            obj.push_back(Pair("rank", (strStatus == "ENABLED" ? s.first : 0)));
-            obj.push_back(Pair("network", strNetwork));
-            obj.push_back(Pair("ip", strHost));
-            obj.push_back(Pair("txhash", strTxHash));
-            obj.push_back(Pair("outidx", (uint64_t)oIdx));
-            obj.push_back(Pair("status", strStatus == "EXPIRED" ? (result ? "UNLOCKING" : "EXPIRED") : strStatus));
-            obj.push_back(Pair("addr", keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID())));
-            obj.push_back(Pair("version", mn->protocolVersion));
-            obj.push_back(Pair("lastseen", (int64_t)mn->lastPing.sigTime));
-            obj.push_back(Pair("activetime", (int64_t)(mn->lastPing.sigTime - mn->sigTime)));
-            obj.push_back(Pair("lastpaid", (int64_t)mn->GetLastPaid()));
-            obj.push_back(Pair("lastpaidheight", nHeight));
-            obj.push_back(Pair("unlockheight", unlockHeight));
-
-            ret.push_back(obj);
-        }
+        KeyIO keyIO(Params());
+        if (strFilter != "" && strTxHash.find(strFilter) == string::npos &&
+            mn->Status().find(strFilter) == string::npos &&
+            keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID()).find(strFilter) == string::npos)
+            continue;
+        // LogPrintf("Get masternode info %s", keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID()));
+        std::string strStatus = mn->Status();
+        std::string strHost;
+        int port;
+        SplitHostPort(mn->addr.ToString(), port, strHost);
+        CNetAddr node = CNetAddr(strHost, false);
+        std::string strNetwork = GetNetworkName(node.GetNetwork());
+
+        CTxDestination address = keyIO.DecodeDestination(keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID()));
+        CScript scriptPubKey = GetScriptForDestination(address);
+
+        int nHeight = 0;
+
+        // ver 1 - get from network
+        bool result = GetLastPaymentBlock(s.second.vin, nHeight);
+
+        // ver 2 - get locally
+        // CTxDestination address = keyIO.DecodeDestination(keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID()));
+        // CScript scriptPubKey = GetScriptForDestination(address);
+        // bool result = GetLastPaymentBlock(s.second.vin.prevout.hash, scriptPubKey, nHeight);
+
+        // LogPrintf("Get masternode result %d", result);
+        int unlockHeight = chainActive.Height() > nHeight + Params().GetmnLockBlocks(chainActive.Height()) ? 0 : nHeight + Params().GetmnLockBlocks(chainActive.Height());
+        obj.push_back(Pair("rank", (strStatus == "ENABLED" ? s.first : 0)));
+        obj.push_back(Pair("network", strNetwork));
+        obj.push_back(Pair("ip", strHost));
+        obj.push_back(Pair("txhash", strTxHash));
+        obj.push_back(Pair("outidx", (uint64_t)oIdx));
+        obj.push_back(Pair("status", strStatus == "EXPIRED" ? (result ? "UNLOCKING" : "EXPIRED") : strStatus));
+        obj.push_back(Pair("addr", keyIO.EncodeDestination(mn->pubKeyCollateralAddress.GetID())));
+        obj.push_back(Pair("version", mn->protocolVersion));
+        obj.push_back(Pair("lastseen", (int64_t)mn->lastPing.sigTime));
+        obj.push_back(Pair("activetime", (int64_t)(mn->lastPing.sigTime - mn->sigTime)));
+        obj.push_back(Pair("lastpaid", (int64_t)mn->GetLastPaid()));
+        obj.push_back(Pair("lastpaidheight", nHeight));
+        obj.push_back(Pair("unlockheight", unlockHeight));
+
+        ret.push_back(obj);
     }
 
     return ret;
@@ -239,22 +238,33 @@ UniValue getmasternodecount(const UniValue& params, bool fHelp)
             HelpExampleCli("getmasternodecount", "") + HelpExampleRpc("getmasternodecount", ""));
 
     UniValue obj(UniValue::VOBJ);
-    int nCount = 0;
+    int nObfCompat = 0, nEnabled = 0;
     int ipv4 = 0, ipv6 = 0, onion = 0;
 
     int nChainHeight = WITH_LOCK(cs_main, return chainActive.Height());
     if (nChainHeight < 0)
         return "unknown";
 
-    mnodeman.GetNextMasternodeInQueueForPayment(nChainHeight, true, nCount);
+    // count from the published copy of the list, like CountNetworks and stable_size
+    CMasternodeMan::Snapshot vSnapshot = mnodeman.GetSnapshot();
+    const int nActiveProtocol = ActiveProtocol();
+    const int nMinPaymentsProto = masternodePayments.GetMinMasternodePaymentsProto();
+    for (const CMasternode& mn : *vSnapshot) {
+        if (!mn.IsEnabled())
+            continue;
+        if (mn.protocolVersion >= nActiveProtocol)
+            nObfCompat++;
+        if (mn.protocolVersion >= nMinPaymentsProto)
+            nEnabled++;
+    }
 
-    mnodeman.CountNetworks(ActiveProtocol(), ipv4, ipv6, onion);
+    mnodeman.CountNetworks(nActiveProtocol, ipv4, ipv6, onion);
 
-    obj.push_back(Pair("total", mnodeman.size()));
+    obj.push_back(Pair("total", (int)vSnapshot->size()));
     obj.push_back(Pair("stable", mnodeman.stable_size()));
-    obj.push_back(Pair("obfcompat", mnodeman.CountEnabled(ActiveProtocol())));
-    obj.push_back(Pair("enabled", mnodeman.CountEnabled()));
-    obj.push_back(Pair("inqueue", nCount));
+    obj.push_back(Pair("obfcompat", nObfCompat));
+    obj.push_back(Pair("enabled", nEnabled));
+    obj.push_back(Pair("inqueue", mnodeman.CountInQueueForPayment(nChainHeight)));
     obj.push_back(Pair("ipv4", ipv4));
     obj.push_back(Pair("ipv6", ipv6));
     obj.push_back(Pair("onion", onion));
@@ -927,11 +937,11 @@ UniValue getmasternodescores(const UniValue& params, bool fHelp)
 
     UniValue obj(UniValue::VOBJ);
 
-    std::vector<CMasternode> vMasternodes = mnodeman.GetFullMasternodeVector();
+    CMasternodeMan::Snapshot vMasternodes = mnodeman.GetSnapshot();
     for (int nHeight = nChainHeight - nLast; nHeight < nChainHeight + 20; nHeight++) {
         arith_uint256 nHigh = 0;
-        CMasternode* pBestMasternode = NULL;
-        for (CMasternode& mn : vMasternodes) {
+        const CMasternode* pBestMasternode = NULL;
+        for (const CMasternode& mn : *vMasternodes) {
             arith_uint256 n = mn.CalculateScore(nHeight);
             if (n > nHigh) {
                 nHigh = n;
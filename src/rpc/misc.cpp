@@ -12,6 +12,7 @@
 #include "metrics.h"
 #include "net.h"
 #include "netbase.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/server.h"
 #include "spork.h"
 #include "timedata.h"
@@ -978,7 +979,7 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
 {
     return a.second.time < b.second.time;
 }
-UniValue getaddressmempool(const UniValue& params, bool fHelp)
+static void getaddressmempool_streamed(const UniValue& params, bool fHelp, JSONWriter& writer)
 {
     std::string disabledMsg = "";
     if (!(fExperimentalInsightExplorer || fExperimentalLightWalletd)) {
@@ -1032,8 +1033,7 @@ UniValue getaddressmempool(const UniValue& params, bool fHelp)
                   return a.second.time < b.second.time;
               });
 
-    UniValue result(UniValue::VARR);
-
+    writer.BeginArray();
     for (const auto& it : indexes) {
         std::string address;
         if (!getAddressFromIndex(it.first.type, it.first.addressBytes, address)) {
@@ -1049,14 +1049,19 @@ UniValue getaddressmempool(const UniValue& params, bool fHelp)
             delta.pushKV("prevtxid", it.second.prevhash.GetHex());
             delta.pushKV("prevout", (int)it.second.prevout);
         }
-        result.push_back(delta);
+        writer.Value(delta);
     }
-    return result;
+    writer.EndArray();
+}
+
+UniValue getaddressmempool(const UniValue& params, bool fHelp)
+{
+    return RPCStreamToValue(getaddressmempool_streamed, params, fHelp);
 }
 
 
 // insightexplorer
-UniValue getaddressutxos(const UniValue& params, bool fHelp)
+static void getaddressutxos_streamed(const UniValue& params, bool fHelp, JSONWriter& writer)
 {
     std::string disabledMsg = "";
     if (!(fExperimentalInsightExplorer || fExperimentalLightWalletd)) {
@@ -1135,7 +1140,20 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
                   return a.second.blockHeight < b.second.blockHeight;
               });
 
-    UniValue utxos(UniValue::VARR);
+    // Read the tip before writing anything, so that cs_main is not held while the writer waits for the client
+    std::string strTipHash;
+    int nTipHeight = 0;
+    if (includeChainInfo) {
+        LOCK(cs_main); // for chainActive
+        strTipHash = chainActive.Tip()->GetBlockHash().GetHex();
+        nTipHeight = chainActive.Height();
+    }
+
+    if (includeChainInfo) {
+        writer.BeginObject();
+        writer.Key("utxos");
+    }
+    writer.BeginArray();
     for (const auto& it : unspentOutputs) {
         UniValue output(UniValue::VOBJ);
         std::string address;
@@ -1149,23 +1167,25 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         output.pushKV("script", HexStr(it.second.script.begin(), it.second.script.end()));
         output.pushKV("satoshis", it.second.satoshis);
         output.pushKV("height", it.second.blockHeight);
-        utxos.push_back(output);
+        writer.Value(output);
     }
+    writer.EndArray();
 
     if (!includeChainInfo)
-        return utxos;
+        return;
 
-    UniValue result(UniValue::VOBJ);
-    result.pushKV("utxos", utxos);
+    writer.KeyValue("hash", strTipHash);
+    writer.KeyValue("height", nTipHeight);
+    writer.EndObject();
+}
 
-    LOCK(cs_main); // for chainActive
-    result.pushKV("hash", chainActive.Tip()->GetBlockHash().GetHex());
-    result.pushKV("height", (int)chainActive.Height());
-    return result;
+UniValue getaddressutxos(const UniValue& params, bool fHelp)
+{
+    return RPCStreamToValue(getaddressutxos_streamed, params, fHelp);
 }
 
 
-UniValue getaddressdeltas(const UniValue& params, bool fHelp)
+static void getaddressdeltas_streamed(const UniValue& params, bool fHelp, JSONWriter& writer)
 {
     if (fHelp || params.size() != 1 || !params[0].isObject())
         throw runtime_error(
@@ -1239,27 +1259,11 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         }
     }
 
-    UniValue deltas(UniValue::VARR);
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount>>::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
-
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        deltas.push_back(delta);
-    }
-
-    UniValue result(UniValue::VOBJ);
-
-    if (includeChainInfo && start > 0 && end > 0) {
+    // Resolve the chain info first, so that a bad range is reported before any output is written
+    UniValue startInfo(UniValue::VOBJ);
+    UniValue endInfo(UniValue::VOBJ);
+    includeChainInfo = includeChainInfo && start > 0 && end > 0;
+    if (includeChainInfo) {
         LOCK(cs_main);
 
         if (start > chainActive.Height() || end > chainActive.Height()) {
@@ -1269,25 +1273,47 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         CBlockIndex* startIndex = chainActive[start];
         CBlockIndex* endIndex = chainActive[end];
 
-        UniValue startInfo(UniValue::VOBJ);
-        UniValue endInfo(UniValue::VOBJ);
-
         startInfo.push_back(Pair("hash", startIndex->GetBlockHash().GetHex()));
         startInfo.push_back(Pair("height", start));
 
         endInfo.push_back(Pair("hash", endIndex->GetBlockHash().GetHex()));
         endInfo.push_back(Pair("height", end));
+    }
 
-        result.push_back(Pair("deltas", deltas));
-        result.push_back(Pair("start", startInfo));
-        result.push_back(Pair("end", endInfo));
+    if (includeChainInfo) {
+        writer.BeginObject();
+        writer.Key("deltas");
+    }
+    writer.BeginArray();
+    for (std::vector<std::pair<CAddressIndexKey, CAmount>>::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
+        std::string address;
+        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
 
-        return result;
-    } else {
-        return deltas;
+        UniValue delta(UniValue::VOBJ);
+        delta.push_back(Pair("satoshis", it->second));
+        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
+        delta.push_back(Pair("index", (int)it->first.index));
+        delta.push_back(Pair("blockindex", (int)it->first.txindex));
+        delta.push_back(Pair("height", it->first.blockHeight));
+        delta.push_back(Pair("address", address));
+        writer.Value(delta);
+    }
+    writer.EndArray();
+
+    if (includeChainInfo) {
+        writer.KeyValue("start", startInfo);
+        writer.KeyValue("end", endInfo);
+        writer.EndObject();
     }
 }
 
+UniValue getaddressdeltas(const UniValue& params, bool fHelp)
+{
+    return RPCStreamToValue(getaddressdeltas_streamed, params, fHelp);
+}
+
 UniValue getaddressbalance(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -1341,7 +1367,7 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
     return result;
 }
 
-UniValue getaddresstxids(const UniValue& params, bool fHelp)
+static void getaddresstxids_streamed(const UniValue& params, bool fHelp, JSONWriter& writer)
 {
     if (fHelp || params.size() != 1)
         throw runtime_error(
@@ -1397,7 +1423,7 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
     }
 
     std::set<std::pair<int, std::string>> txids;
-    UniValue result(UniValue::VARR);
+    writer.BeginArray();
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount>>::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++) {
         int height = it->first.blockHeight;
@@ -1407,18 +1433,22 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             txids.insert(std::make_pair(height, txid));
         } else {
             if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
+                writer.Value(txid);
             }
         }
     }
 
     if (addresses.size() > 1) {
         for (std::set<std::pair<int, std::string>>::const_iterator it = txids.begin(); it != txids.end(); it++) {
-            result.push_back(it->second);
+            writer.Value(it->second);
         }
     }
+    writer.EndArray();
+}
 
-    return result;
+UniValue getaddresstxids(const UniValue& params, bool fHelp)
+{
+    return RPCStreamToValue(getaddresstxids_streamed, params, fHelp);
 }
 
 UniValue getspentinfo(const UniValue& params, bool fHelp)
@@ -1478,11 +1508,11 @@ static const CRPCCommand commands[] =
         {"util", "createmultisig", &createmultisig, true},
         {"util", "verifymessage", &verifymessage, true},
         /* Address index */
-        {"addressindex", "getaddresstxids", &getaddresstxids, false},     /* insight explorer */
-        {"addressindex", "getaddressbalance", &getaddressbalance, false}, /* insight explorer */
-        {"addressindex", "getaddressdeltas", &getaddressdeltas, false},   /* insight explorer */
-        {"addressindex", "getaddressutxos", &getaddressutxos, false},     /* insight explorer */
-        {"addressindex", "getaddressmempool", &getaddressmempool, true},  /* insight explorer */
+        {"addressindex", "getaddresstxids", &getaddresstxids, false, &getaddresstxids_streamed},       /* insight explorer */
+        {"addressindex", "getaddressbalance", &getaddressbalance, false},                               /* insight explorer */
+        {"addressindex", "getaddressdeltas", &getaddressdeltas, false, &getaddressdeltas_streamed},     /* insight explorer */
+        {"addressindex", "getaddressutxos", &getaddressutxos, false, &getaddressutxos_streamed},        /* insight explorer */
+        {"addressindex", "getaddressmempool", &getaddressmempool, true, &getaddressmempool_streamed},   /* insight explorer */
         {"blockchain", "getspentinfo", &getspentinfo, false},             /* insight explorer */
         /* Not shown in help */
         {"hidden", "setmocktime", &setmocktime, true},
@@ -102,7 +102,9 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"inflight_limit\": n,       (numeric) The number of blocks we ask from this peer at a time, sized from its delivery rate\n"
+            "    \"block_delivery_time\": n,  (numeric) Average time in seconds this peer took to deliver a requested block (0 if none yet)\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -150,6 +152,8 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
                 heights.push_back(height);
             }
             obj.push_back(Pair("inflight", heights));
+            obj.push_back(Pair("inflight_limit", statestats.nBlocksInTransitLimit));
+            obj.push_back(Pair("block_delivery_time", statestats.nBlockDeliveryTime / 1000000.0));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
 
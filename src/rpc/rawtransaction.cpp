@@ -308,6 +308,24 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
     }
 }
 
+// Requires cs_main.
+static void GetTxBlockInfo(const uint256& hashBlock, int& nHeight, int& nConfirmations, int& nBlockTime)
+{
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+    if (mi != mapBlockIndex.end() && (*mi).second) {
+        CBlockIndex* pindex = (*mi).second;
+        if (chainActive.Contains(pindex)) {
+            nHeight = pindex->nHeight;
+            nConfirmations = 1 + chainActive.Height() - pindex->nHeight;
+            nBlockTime = pindex->GetBlockTime();
+        } else {
+            nHeight = -1;
+            nConfirmations = 0;
+            nBlockTime = pindex->GetBlockTime();
+        }
+    }
+}
+
 UniValue getrawtransaction(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -421,19 +439,7 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
         if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true))
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available about transaction");
 
-        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
-        if (mi != mapBlockIndex.end() && (*mi).second) {
-            CBlockIndex* pindex = (*mi).second;
-            if (chainActive.Contains(pindex)) {
-                nHeight = pindex->nHeight;
-                nConfirmations = 1 + chainActive.Height() - pindex->nHeight;
-                nBlockTime = pindex->GetBlockTime();
-            } else {
-                nHeight = -1;
-                nConfirmations = 0;
-                nBlockTime = pindex->GetBlockTime();
-            }
-        }
+        GetTxBlockInfo(hashBlock, nHeight, nConfirmations, nBlockTime);
     }
 
     string strHex = EncodeHexTx(tx);
@@ -448,6 +454,83 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
     return result;
 }
 
+//! Maximum number of txids getrawtransactions accepts in one call
+static const unsigned int MAX_GETRAWTRANSACTIONS = 1000;
+
+UniValue getrawtransactions(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "getrawtransactions [\"txid\",...] ( verbose )\n"
+            "\nReturn the raw transaction data for several transactions, like getrawtransaction does for one.\n"
+            "With -txindex, transactions are read from disk in file order, which is much faster than\n"
+            "calling getrawtransaction for each of them.\n"
+
+            "\nArguments:\n"
+            "1. \"txids\"       (string, required) A json array of at most 1000 transaction ids\n"
+            "    [\n"
+            "      \"txid\"     (string) A transaction id\n"
+            "      ,...\n"
+            "    ]\n"
+            "2. verbose       (numeric, optional, default=0) If 0, return strings, other return json objects\n"
+
+            "\nResult:\n"
+            "[\n"
+            "  \"data\",        (string) The serialized, hex-encoded data, or with verbose the object returned by getrawtransaction,\n"
+            "                 or null if no information is available about the transaction\n"
+            "  ,...\n"
+            "]\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getrawtransactions", "\"[\\\"mytxid\\\",\\\"othertxid\\\"]\" 1") + HelpExampleRpc("getrawtransactions", "[\"mytxid\",\"othertxid\"], 1"));
+
+    UniValue txids = params[0].get_array();
+    if (txids.size() > MAX_GETRAWTRANSACTIONS)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("At most %u txids can be requested at once", MAX_GETRAWTRANSACTIONS));
+    std::vector<uint256> hashes;
+    hashes.reserve(txids.size());
+    for (size_t idx = 0; idx < txids.size(); idx++)
+        hashes.push_back(ParseHashV(txids[idx], "txid"));
+
+    bool fVerbose = false;
+    if (params.size() > 1)
+        fVerbose = (params[1].get_int() != 0);
+
+    std::vector<CTransaction> vtx;
+    std::vector<uint256> hashBlocks;
+    std::vector<bool> vFound;
+    GetTransactions(hashes, vtx, hashBlocks, vFound, Params().GetConsensus(), true);
+
+    UniValue results(UniValue::VARR);
+    for (size_t i = 0; i < hashes.size(); i++) {
+        if (!vFound[i]) {
+            results.push_back(NullUniValue);
+            continue;
+        }
+
+        string strHex = EncodeHexTx(vtx[i]);
+        if (!fVerbose) {
+            results.push_back(strHex);
+            continue;
+        }
+
+        int nHeight = 0;
+        int nConfirmations = 0;
+        int nBlockTime = 0;
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("hex", strHex));
+        {
+            // Taken per transaction so that a large batch does not stall validation
+            LOCK(cs_main);
+            GetTxBlockInfo(hashBlocks[i], nHeight, nConfirmations, nBlockTime);
+            TxToJSONExpanded(vtx[i], hashBlocks[i], result, nHeight, nConfirmations, nBlockTime);
+        }
+        results.push_back(result);
+    }
+
+    return results;
+}
+
 UniValue gettxoutproof(const UniValue& params, bool fHelp)
 {
     if (fHelp || (params.size() != 1 && params.size() != 2))
@@ -1160,6 +1243,7 @@ static const CRPCCommand commands[] =
         //  category              name                      actor (function)         okSafeMode
         //  --------------------- ------------------------  -----------------------  ----------
         {"rawtransactions", "getrawtransaction", &getrawtransaction, true},
+        {"rawtransactions", "getrawtransactions", &getrawtransactions, true},
         {"rawtransactions", "createrawtransaction", &createrawtransaction, true},
         {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true},
         {"rawtransactions", "decodescript", &decodescript, true},
@@ -12,12 +12,17 @@
 #include "key_io.h"
 #include "net.h"
 #include "random.h"
+#include "rpc/jsonwriter.h"
 #include "sync.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <set>
 
 #include <univalue.h>
 
@@ -488,11 +493,95 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const UniValue& vReq)
+/** Calls that only read state, which a batch may execute concurrently */
+static const std::set<std::string> setParallelBatchMethods = {
+    "decoderawtransaction", "decodescript", "getaddressbalance", "getaddressdeltas", "getaddressmempool",
+    "getaddresstxids", "getaddressutxos", "getbestblockhash", "getblock", "getblockcount", "getblockdeltas",
+    "getblockhash", "getblockhashes", "getblockheader", "getbudgetinfo", "getbudgetprojection", "getbudgetvotes",
+    "getmasternodecount", "getmasternodescores", "getmasternodewinners", "getrawmempool", "getrawtransaction",
+    "getrawtransactions", "getspentinfo", "gettxout", "listmasternodes", "masternodecurrent", "validateaddress",
+    "verifymessage",
+};
+
+static bool IsParallelBatchRequest(const UniValue& req)
 {
+    if (!req.isObject())
+        return false;
+    const UniValue& valMethod = find_value(req.get_obj(), "method");
+    return valMethod.isStr() && setParallelBatchMethods.count(valMethod.get_str()) > 0;
+}
+
+/**
+ * A run of batch calls executed by several threads. Each thread claims the
+ * next unclaimed call until none are left; the thread that started the run
+ * takes part as well, so the run completes even if no helper gets to start.
+ */
+class CRPCBatchRun
+{
+private:
+    const UniValue& vReq;
+    std::vector<UniValue>& vResult;
+    const size_t nEnd;
+    std::atomic<size_t> nNext;
+    std::mutex cs;
+    std::condition_variable cond;
+    size_t nDone;
+
+public:
+    CRPCBatchRun(const UniValue& vReqIn, std::vector<UniValue>& vResultIn, size_t nBegin, size_t nEndIn)
+        : vReq(vReqIn), vResult(vResultIn), nEnd(nEndIn), nNext(nBegin), nDone(nBegin) {}
+
+    void Work()
+    {
+        size_t i;
+        while ((i = nNext++) < nEnd) {
+            UniValue result = JSONRPCExecOne(vReq[i]);
+            std::lock_guard<std::mutex> lock(cs);
+            vResult[i] = result;
+            if (++nDone == nEnd)
+                cond.notify_all();
+        }
+    }
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        cond.wait(lock, [this] { return nDone == nEnd; });
+    }
+};
+
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCTaskDispatcher& dispatch, int nThreads)
+{
+    std::vector<UniValue> vResult(vReq.size());
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t nEnd = reqIdx;
+        while (nEnd < vReq.size() && IsParallelBatchRequest(vReq[nEnd]))
+            nEnd++;
+        if (nEnd - reqIdx < 2 || nThreads < 2 || !dispatch) {
+            // A call with side effects, or nothing to spread: run it here.
+            nEnd = std::max(nEnd, reqIdx + 1);
+            for (; reqIdx < nEnd; reqIdx++)
+                vResult[reqIdx] = JSONRPCExecOne(vReq[reqIdx]);
+            continue;
+        }
+
+        // Helpers may only start after the run is over; they then find
+        // nothing left to claim, but must still find the run alive.
+        std::shared_ptr<CRPCBatchRun> run = std::make_shared<CRPCBatchRun>(vReq, vResult, reqIdx, nEnd);
+        size_t nHelpers = std::min<size_t>(nThreads - 1, nEnd - reqIdx - 1);
+        for (size_t i = 0; i < nHelpers; i++) {
+            if (!dispatch([run] { run->Work(); }))
+                break;
+        }
+        run->Work();
+        run->Wait();
+        reqIdx = nEnd;
+    }
+
     UniValue ret(UniValue::VARR);
-    for (size_t reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    for (const UniValue& result : vResult)
+        ret.push_back(result);
 
     return ret.write() + "\n";
 }
@@ -523,6 +612,38 @@ UniValue CRPCTable::execute(const std::string& strMethod, const UniValue& params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+bool CRPCTable::executeStreamed(const std::string& strMethod, const UniValue& params, JSONWriter& writer) const
+{
+    // Return immediately if in warmup
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    const CRPCCommand* pcmd = tableRPC[strMethod];
+    if (!pcmd || !pcmd->streamActor)
+        return false;
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try {
+        pcmd->streamActor(params, false, writer);
+    } catch (const std::exception& e) {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+    return true;
+}
+
+UniValue RPCStreamToValue(rpcstreamfn_type streamActor, const UniValue& params, bool fHelp)
+{
+    JSONValueWriter writer;
+    streamActor(params, fHelp, writer);
+    return writer.GetValue();
+}
+
 std::string HelpExampleCli(const std::string& methodname, const std::string& args)
 {
     return "> gemlink-cli " + methodname + " " + args + "\n";
@@ -16,6 +16,8 @@
 #include <stdint.h>
 #include <string>
 
+#include <functional>
+
 #include <boost/function.hpp>
 
 #include <univalue.h>
@@ -24,6 +26,7 @@ extern bool initWitnessesBuilt;
 
 class AsyncRPCQueue;
 class CRPCCommand;
+class JSONWriter;
 
 namespace RPCServer
 {
@@ -122,6 +125,12 @@ void RPCUnregisterTimerInterface(RPCTimerInterface* iface);
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue (*rpcfn_type)(const UniValue& params, bool fHelp);
+/**
+ * Actor that emits its result through a JSONWriter instead of returning it.
+ * Writing may wait for a slow HTTP client, so no lock may be held while
+ * writing: collect what is needed under the lock first.
+ */
+typedef void (*rpcstreamfn_type)(const UniValue& params, bool fHelp, JSONWriter& writer);
 
 class CRPCCommand
 {
@@ -130,8 +139,13 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
+    //! Optional streamed form of actor, producing the same result
+    rpcstreamfn_type streamActor = nullptr;
 };
 
+/** Run a streamed actor and collect its result as a value, to implement the plain actor */
+UniValue RPCStreamToValue(rpcstreamfn_type streamActor, const UniValue& params, bool fHelp);
+
 /**
  * Bitcoin RPC command dispatcher.
  */
@@ -154,6 +168,13 @@ public:
      */
     UniValue execute(const std::string& method, const UniValue& params) const;
 
+    /**
+     * Execute a method that has a streamed form, writing its result to writer.
+     * @returns false, without executing anything, if the method is not streamable.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    bool executeStreamed(const std::string& method, const UniValue& params, JSONWriter& writer) const;
+
 
     /**
      * Appends a CRPCCommand to the dispatch table.
@@ -360,7 +381,15 @@ extern UniValue z_validatepaymentdisclosure(const UniValue& params, bool fHelp);
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const UniValue& vReq);
+/** Runs a task on another thread. Returns false if it could not be queued. */
+typedef std::function<bool(const std::function<void()>&)> RPCTaskDispatcher;
+/**
+ * Execute a JSON-RPC batch. Consecutive read-only calls are spread over up to
+ * nThreads threads, the calling one included, using dispatch to start helpers.
+ * Any other call runs alone after the calls before it have finished, so the
+ * batch behaves as if executed in order. Results are returned in request order.
+ */
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCTaskDispatcher& dispatch = RPCTaskDispatcher(), int nThreads = 1);
 
 extern std::string experimentalDisabledHelpMsg(const std::string& rpc, const std::string& enableArg);
 
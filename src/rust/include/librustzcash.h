@@ -156,6 +156,56 @@ extern "C" {
     /// `librustzcash_sapling_proving_ctx_init`.
     void librustzcash_sapling_proving_ctx_free(void *);
 
+    /// Constructs a Spend proof like `librustzcash_sapling_spend_proof`,
+    /// but without a proving context. The caller picks the value
+    /// commitment randomness `rcv` (see `librustzcash_sapling_generate_r`)
+    /// and passes it to `librustzcash_sapling_binding_sig_rcv` later, so
+    /// proofs can be created on several threads at once.
+    bool librustzcash_sapling_spend_proof_rcv(
+        const unsigned char *ak,
+        const unsigned char *nsk,
+        const unsigned char *diversifier,
+        const unsigned char *rcm,
+        const unsigned char *ar,
+        const uint64_t value,
+        const unsigned char *anchor,
+        const unsigned char *witness,
+        const unsigned char *rcv,
+        unsigned char *cv,
+        unsigned char *rk,
+        unsigned char *zkproof
+    );
+
+    /// Constructs an Output proof like `librustzcash_sapling_output_proof`,
+    /// but without a proving context, using the value commitment
+    /// randomness `rcv` picked by the caller.
+    bool librustzcash_sapling_output_proof_rcv(
+        const unsigned char *esk,
+        const unsigned char *payment_address,
+        const unsigned char *rcm,
+        const uint64_t value,
+        const unsigned char *rcv,
+        unsigned char *cv,
+        unsigned char *zkproof
+    );
+
+    /// Constructs the binding signature for Spends and Outputs proven
+    /// with the `_rcv` functions above. `spend_rcv` and `spend_cv` each
+    /// hold `spends_len` consecutive 32-byte values, and likewise for the
+    /// Outputs. The value commitments are checked against valueBalance
+    /// before signing.
+    bool librustzcash_sapling_binding_sig_rcv(
+        const unsigned char *spend_rcv,
+        const unsigned char *spend_cv,
+        size_t spends_len,
+        const unsigned char *output_rcv,
+        const unsigned char *output_cv,
+        size_t outputs_len,
+        int64_t valueBalance,
+        const unsigned char *sighash,
+        unsigned char *result
+    );
+
     /// Creates a Sapling verification context. Please free this
     /// when you're done.
     void * librustzcash_sapling_verification_ctx_init();
@@ -19,7 +19,10 @@
 // See https://github.com/rust-lang/rfcs/pull/2585 for more background.
 #![allow(clippy::not_unsafe_ptr_arg_deref)]
 
-use bellman::groth16::{Parameters, PreparedVerifyingKey, Proof};
+use bellman::{
+    gadgets::multipack,
+    groth16::{create_random_proof, verify_proof, Parameters, PreparedVerifyingKey, Proof},
+};
 use blake2s_simd::Params as Blake2sParams;
 use bls12_381::Bls12;
 use group::{cofactor::CofactorGroup, GroupEncoding};
@@ -43,17 +46,22 @@ use std::os::windows::ffi::OsStringExt;
 
 use zcash_primitives::{
     block::equihash,
-    constants::{CRH_IVK_PERSONALIZATION, PROOF_GENERATION_KEY_GENERATOR, SPENDING_KEY_GENERATOR},
+    constants::{
+        CRH_IVK_PERSONALIZATION, PROOF_GENERATION_KEY_GENERATOR, SPENDING_KEY_GENERATOR,
+        VALUE_COMMITMENT_RANDOMNESS_GENERATOR, VALUE_COMMITMENT_VALUE_GENERATOR,
+    },
     merkle_tree::MerklePath,
     note_encryption::sapling_ka_agree,
-    primitives::{Diversifier, Note, PaymentAddress, ProofGenerationKey, Rseed, ViewingKey},
+    primitives::{
+        Diversifier, Note, PaymentAddress, ProofGenerationKey, Rseed, ValueCommitment, ViewingKey,
+    },
     redjubjub::{self, Signature},
     sapling::{merkle_hash, spend_sig},
     transaction::components::Amount,
     zip32,
 };
 use zcash_proofs::{
-    circuit::sapling::TREE_DEPTH as SAPLING_TREE_DEPTH,
+    circuit::sapling::{Output, Spend, TREE_DEPTH as SAPLING_TREE_DEPTH},
     load_parameters,
     sapling::{SaplingProvingContext, SaplingVerificationContext},
     sprout,
@@ -976,6 +984,323 @@ pub extern "C" fn librustzcash_sapling_spend_proof(
     true
 }
 
+/// Constructs a Spend proof like [`librustzcash_sapling_spend_proof`], but
+/// without a proving context. The caller picks the value commitment
+/// randomness `rcv` (see [`librustzcash_sapling_generate_r`]) and hands it to
+/// [`librustzcash_sapling_binding_sig_rcv`] later, so the proofs of a
+/// transaction share no state and can be created on several threads at once.
+#[no_mangle]
+pub extern "C" fn librustzcash_sapling_spend_proof_rcv(
+    ak: *const [c_uchar; 32],
+    nsk: *const [c_uchar; 32],
+    diversifier: *const [c_uchar; 11],
+    rcm: *const [c_uchar; 32],
+    ar: *const [c_uchar; 32],
+    value: u64,
+    anchor: *const [c_uchar; 32],
+    merkle_path: *const [c_uchar; 1 + 33 * SAPLING_TREE_DEPTH + 8],
+    rcv: *const [c_uchar; 32],
+    cv: *mut [c_uchar; 32],
+    rk_out: *mut [c_uchar; 32],
+    zkproof: *mut [c_uchar; GROTH_PROOF_SIZE],
+) -> bool {
+    // Grab `ak` from the caller, which should be a point of prime order.
+    let ak = match de_ct(jubjub::ExtendedPoint::from_bytes(unsafe { &*ak })) {
+        Some(p) => p,
+        None => return false,
+    };
+    let ak = match de_ct(ak.into_subgroup()) {
+        Some(p) => p,
+        None => return false,
+    };
+
+    let nsk = match de_ct(jubjub::Scalar::from_bytes(unsafe { &*nsk })) {
+        Some(p) => p,
+        None => return false,
+    };
+
+    let proof_generation_key = ProofGenerationKey { ak, nsk };
+
+    let diversifier = Diversifier(unsafe { *diversifier });
+    let g_d = match diversifier.g_d() {
+        Some(g_d) => g_d,
+        None => return false,
+    };
+
+    // See librustzcash_sapling_spend_proof about treating rcm as a pre-ZIP 212 note.
+    let rseed = match de_ct(jubjub::Scalar::from_bytes(unsafe { &*rcm })) {
+        Some(p) => Rseed::BeforeZip212(p),
+        None => return false,
+    };
+
+    let ar = match de_ct(jubjub::Scalar::from_bytes(unsafe { &*ar })) {
+        Some(p) => p,
+        None => return false,
+    };
+
+    let anchor = match de_ct(bls12_381::Scalar::from_bytes(unsafe { &*anchor })) {
+        Some(p) => p,
+        None => return false,
+    };
+
+    let merkle_path = match MerklePath::from_slice(unsafe { &(&*merkle_path)[..] }) {
+        Ok(w) => w,
+        Err(_) => return false,
+    };
+
+    let rcv = match de_ct(jubjub::Scalar::from_bytes(unsafe { &*rcv })) {
+        Some(p) => p,
+        None => return false,
+    };
+
+    let value_commitment = ValueCommitment {
+        value,
+        randomness: rcv,
+    };
+
+    let viewing_key = proof_generation_key.to_viewing_key();
+    let payment_address = match viewing_key.to_payment_address(diversifier) {
+        Some(pa) => pa,
+        None => return false,
+    };
+
+    // The re-randomized `ak`, computed for the caller
+    let rk = redjubjub::PublicKey(ak.into()).randomize(ar, SPENDING_KEY_GENERATOR);
+
+    let note = Note {
+        value,
+        g_d,
+        pk_d: *payment_address.pk_d(),
+        rseed,
+    };
+    let nullifier = note.nf(&viewing_key, merkle_path.position);
+
+    let instance = Spend {
+        value_commitment: Some(value_commitment.clone()),
+        proof_generation_key: Some(proof_generation_key),
+        payment_address: Some(payment_address),
+        commitment_randomness: Some(note.rcm()),
+        ar: Some(ar),
+        auth_path: merkle_path
+            .auth_path
+            .iter()
+            .map(|(node, b)| Some(((*node).into(), *b)))
+            .collect(),
+        anchor: Some(anchor),
+    };
+
+    let proof = match create_random_proof(
+        instance,
+        unsafe { SAPLING_SPEND_PARAMS.as_ref() }.unwrap(),
+        &mut OsRng,
+    ) {
+        Ok(p) => p,
+        Err(_) => return false,
+    };
+
+    let value_commitment: jubjub::ExtendedPoint = value_commitment.commitment().into();
+
+    // Check the proof before handing it out, as the proving context does
+    let mut public_input = [bls12_381::Scalar::zero(); 7];
+    {
+        let affine = jubjub::AffinePoint::from(rk.0);
+        public_input[0] = affine.get_u();
+        public_input[1] = affine.get_v();
+    }
+    {
+        let affine = jubjub::AffinePoint::from(value_commitment);
+        public_input[2] = affine.get_u();
+        public_input[3] = affine.get_v();
+    }
+    public_input[4] = anchor;
+    {
+        let nullifier = multipack::bytes_to_bits_le(&nullifier);
+        let nullifier = multipack::compute_multipacking(&nullifier);
+        assert_eq!(nullifier.len(), 2);
+        public_input[5] = nullifier[0];
+        public_input[6] = nullifier[1];
+    }
+    if verify_proof(
+        unsafe { SAPLING_SPEND_VK.as_ref() }.unwrap(),
+        &proof,
+        &public_input[..],
+    )
+    .is_err()
+    {
+        return false;
+    }
+
+    *unsafe { &mut *cv } = value_commitment.to_bytes();
+
+    proof
+        .write(&mut (unsafe { &mut *zkproof })[..])
+        .expect("should be able to serialize a proof");
+
+    rk.write(&mut unsafe { &mut *rk_out }[..])
+        .expect("should be able to write to rk_out");
+
+    true
+}
+
+/// Constructs an Output proof like [`librustzcash_sapling_output_proof`], but
+/// without a proving context, using the value commitment randomness `rcv`
+/// picked by the caller. See [`librustzcash_sapling_spend_proof_rcv`].
+#[no_mangle]
+pub extern "C" fn librustzcash_sapling_output_proof_rcv(
+    esk: *const [c_uchar; 32],
+    payment_address: *const [c_uchar; 43],
+    rcm: *const [c_uchar; 32],
+    value: u64,
+    rcv: *const [c_uchar; 32],
+    cv: *mut [c_uchar; 32],
+    zkproof: *mut [c_uchar; GROTH_PROOF_SIZE],
+) -> bool {
+    let esk = match de_ct(jubjub::Scalar::from_bytes(unsafe { &*esk })) {
+        Some(p) => p,
+        None => return false,
+    };
+
+    let payment_address = match PaymentAddress::from_bytes(unsafe { &*payment_address }) {
+        Some(pa) => pa,
+        None => return false,
+    };
+
+    let rcm = match de_ct(jubjub::Scalar::from_bytes(unsafe { &*rcm })) {
+        Some(p) => p,
+        None => return false,
+    };
+
+    let rcv = match de_ct(jubjub::Scalar::from_bytes(unsafe { &*rcv })) {
+        Some(p) => p,
+        None => return false,
+    };
+
+    let value_commitment = ValueCommitment {
+        value,
+        randomness: rcv,
+    };
+
+    let instance = Output {
+        value_commitment: Some(value_commitment.clone()),
+        payment_address: Some(payment_address),
+        commitment_randomness: Some(rcm),
+        esk: Some(esk),
+    };
+
+    let proof = match create_random_proof(
+        instance,
+        unsafe { SAPLING_OUTPUT_PARAMS.as_ref() }.unwrap(),
+        &mut OsRng,
+    ) {
+        Ok(p) => p,
+        Err(_) => return false,
+    };
+
+    proof
+        .write(&mut (unsafe { &mut *zkproof })[..])
+        .expect("should be able to serialize a proof");
+
+    let value_commitment: jubjub::ExtendedPoint = value_commitment.commitment().into();
+    *unsafe { &mut *cv } = value_commitment.to_bytes();
+
+    true
+}
+
+// Private utility function to view `len` consecutive 32-byte values from C
+fn priv_slice32<'a>(ptr: *const [c_uchar; 32], len: size_t) -> &'a [[c_uchar; 32]] {
+    if len == 0 {
+        &[]
+    } else {
+        unsafe { slice::from_raw_parts(ptr, len) }
+    }
+}
+
+/// Constructs the binding signature for Spends and Outputs proven with
+/// [`librustzcash_sapling_spend_proof_rcv`] and
+/// [`librustzcash_sapling_output_proof_rcv`]. `spend_rcv` and `spend_cv` each
+/// hold `spends_len` consecutive 32-byte values, in the same order, and
+/// likewise for the Outputs. As with [`librustzcash_sapling_binding_sig`],
+/// the value commitments are checked against `value_balance` first.
+#[no_mangle]
+pub extern "C" fn librustzcash_sapling_binding_sig_rcv(
+    spend_rcv: *const [c_uchar; 32],
+    spend_cv: *const [c_uchar; 32],
+    spends_len: size_t,
+    output_rcv: *const [c_uchar; 32],
+    output_cv: *const [c_uchar; 32],
+    outputs_len: size_t,
+    value_balance: i64,
+    sighash: *const [c_uchar; 32],
+    result: *mut [c_uchar; 64],
+) -> bool {
+    if Amount::from_i64(value_balance).is_err() {
+        return false;
+    }
+
+    // bsk is the sum of the Spend randomness minus the sum of the Output
+    // randomness, and cv_sum the same for the value commitments.
+    let mut bsk = jubjub::Scalar::zero();
+    let mut cv_sum = jubjub::ExtendedPoint::identity();
+    for (rcv, cv) in priv_slice32(spend_rcv, spends_len)
+        .iter()
+        .zip(priv_slice32(spend_cv, spends_len))
+    {
+        match (
+            de_ct(jubjub::Scalar::from_bytes(rcv)),
+            de_ct(jubjub::ExtendedPoint::from_bytes(cv)),
+        ) {
+            (Some(rcv), Some(cv)) => {
+                bsk += rcv;
+                cv_sum += cv;
+            }
+            _ => return false,
+        }
+    }
+    for (rcv, cv) in priv_slice32(output_rcv, outputs_len)
+        .iter()
+        .zip(priv_slice32(output_cv, outputs_len))
+    {
+        match (
+            de_ct(jubjub::Scalar::from_bytes(rcv)),
+            de_ct(jubjub::ExtendedPoint::from_bytes(cv)),
+        ) {
+            (Some(rcv), Some(cv)) => {
+                bsk -= rcv;
+                cv_sum -= cv;
+            }
+            _ => return false,
+        }
+    }
+
+    let bsk = redjubjub::PrivateKey(bsk);
+    let bvk = redjubjub::PublicKey::from_private(&bsk, VALUE_COMMITMENT_RANDOMNESS_GENERATOR);
+
+    // The value commitments minus valueBalance must commit to zero with bsk.
+    // Amount::from_i64 has bounded value_balance, so abs cannot overflow.
+    let mut value_balance_point =
+        VALUE_COMMITMENT_VALUE_GENERATOR * jubjub::Scalar::from(value_balance.abs() as u64);
+    if value_balance < 0 {
+        value_balance_point = -value_balance_point;
+    }
+    if bvk.0 != cv_sum - jubjub::ExtendedPoint::from(value_balance_point) {
+        return false;
+    }
+
+    let mut data_to_be_signed = [0u8; 64];
+    data_to_be_signed[0..32].copy_from_slice(&bvk.0.to_bytes());
+    data_to_be_signed[32..64].copy_from_slice(unsafe { &*sighash });
+
+    let sig = bsk.sign(
+        &data_to_be_signed,
+        &mut OsRng,
+        VALUE_COMMITMENT_RANDOMNESS_GENERATOR,
+    );
+    sig.write(&mut (unsafe { &mut *result })[..])
+        .expect("result should be 64 bytes");
+
+    true
+}
+
 /// Creates a Sapling proving context. Please free this when you're done.
 #[no_mangle]
 pub extern "C" fn librustzcash_sapling_proving_ctx_init() -> *mut SaplingProvingContext {
@@ -0,0 +1,258 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef ZCASH_SEENMESSAGEMAP_H
+#define ZCASH_SEENMESSAGEMAP_H
+
+#include "coins.h"
+#include "memusage.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * STL-like map of gossiped messages by hash, holding at most nMaxSize entries.
+ * Next to the hash map, entries are ordered by a timestamp that TimeOf reads
+ * from the message, so expired entries and, when the map is full, the oldest
+ * ones are removed without scanning the whole map. Values must not be changed
+ * in place other than through modify(), which keeps that order up to date.
+ *
+ * Serializes like a std::map<uint256, V>, so existing cache files stay readable.
+ * The hashes added, changed or removed since the last clear_changes() are
+ * remembered, so a copy on disk can be brought up to date incrementally.
+ */
+template <typename V, typename TimeOf>
+class seenmessagemap
+{
+public:
+    typedef uint256 key_type;
+    typedef V mapped_type;
+    typedef std::unordered_map<uint256, V, SaltedTxidHasher> map_type;
+    typedef typename map_type::const_iterator const_iterator;
+    typedef typename map_type::size_type size_type;
+    typedef std::unordered_set<uint256, SaltedTxidHasher> changes_type;
+
+private:
+    map_type map;
+    std::set<std::pair<int64_t, uint256>> setByTime;
+    size_type nMaxSize;
+    changes_type setChanged;
+
+    void EraseFromIndex(const_iterator it)
+    {
+        setByTime.erase(std::make_pair(TimeOf()(it->second), it->first));
+    }
+
+    void Trim()
+    {
+        while (map.size() > nMaxSize && !setByTime.empty()) {
+            auto itOldest = setByTime.begin();
+            setChanged.insert(itOldest->second);
+            map.erase(itOldest->second);
+            setByTime.erase(itOldest);
+        }
+    }
+
+public:
+    explicit seenmessagemap(size_type nMaxSizeIn) : nMaxSize(nMaxSizeIn) {}
+
+    const_iterator begin() const { return map.begin(); }
+    const_iterator end() const { return map.end(); }
+    size_type size() const { return map.size(); }
+    bool empty() const { return map.empty(); }
+    size_type count(const uint256& hash) const { return map.count(hash); }
+    const_iterator find(const uint256& hash) const { return map.find(hash); }
+    //! Throws std::out_of_range if hash is unknown
+    const V& at(const uint256& hash) const { return map.at(hash); }
+
+    //! Add an entry unless its hash is present already. Returns whether it was added.
+    bool insert(const std::pair<uint256, V>& entry)
+    {
+        if (!map.insert(entry).second)
+            return false;
+        setByTime.insert(std::make_pair(TimeOf()(entry.second), entry.first));
+        setChanged.insert(entry.first);
+        Trim();
+        return true;
+    }
+
+    //! Like insert, for entries read back from disk, which do not count as changes
+    bool load(const std::pair<uint256, V>& entry)
+    {
+        if (!insert(entry))
+            return false;
+        if (map.count(entry.first))
+            setChanged.erase(entry.first);
+        return true;
+    }
+
+    //! Add an entry, replacing the value of an existing one
+    void set(const uint256& hash, const V& value)
+    {
+        erase(hash);
+        insert(std::make_pair(hash, value));
+    }
+
+    //! Apply f to the value of hash, if present. Returns whether it was.
+    template <typename F>
+    bool modify(const uint256& hash, F f)
+    {
+        auto it = map.find(hash);
+        if (it == map.end())
+            return false;
+        EraseFromIndex(it);
+        f(it->second);
+        setByTime.insert(std::make_pair(TimeOf()(it->second), hash));
+        setChanged.insert(hash);
+        return true;
+    }
+
+    size_type erase(const uint256& hash)
+    {
+        auto it = map.find(hash);
+        if (it == map.end())
+            return 0;
+        EraseFromIndex(it);
+        map.erase(it);
+        setChanged.insert(hash);
+        return 1;
+    }
+
+    //! Remove the entries timestamped before nTime, oldest first, appending their hashes to pvErased if given
+    size_type erase_older_than(int64_t nTime, std::vector<uint256>* pvErased = nullptr)
+    {
+        size_type nErased = 0;
+        while (!setByTime.empty() && setByTime.begin()->first < nTime) {
+            auto itOldest = setByTime.begin();
+            if (pvErased)
+                pvErased->push_back(itOldest->second);
+            setChanged.insert(itOldest->second);
+            map.erase(itOldest->second);
+            setByTime.erase(itOldest);
+            nErased++;
+        }
+        return nErased;
+    }
+
+    //! Remove the entries whose value satisfies pred, appending their hashes to pvErased if given
+    template <typename Pred>
+    size_type erase_if(Pred pred, std::vector<uint256>* pvErased = nullptr)
+    {
+        size_type nErased = 0;
+        for (auto it = map.begin(); it != map.end();) {
+            if (pred(it->second)) {
+                if (pvErased)
+                    pvErased->push_back(it->first);
+                setChanged.insert(it->first);
+                EraseFromIndex(it);
+                it = map.erase(it);
+                nErased++;
+            } else {
+                ++it;
+            }
+        }
+        return nErased;
+    }
+
+    void clear()
+    {
+        for (const auto& entry : map)
+            setChanged.insert(entry.first);
+        map.clear();
+        setByTime.clear();
+    }
+
+    //! Hashes added, changed or removed since the last clear_changes()
+    const changes_type& changes() const { return setChanged; }
+    void clear_changes() { setChanged.clear(); }
+
+    void max_size(size_type nMaxSizeIn)
+    {
+        nMaxSize = nMaxSizeIn;
+        Trim();
+    }
+    size_type max_size() const { return nMaxSize; }
+
+    //! Approximate memory used by the containers, not counting heap data owned by the values
+    size_t DynamicMemoryUsage() const
+    {
+        // hash map node: the value, the cached hash and the next pointer
+        return memusage::MallocUsage(sizeof(std::pair<const uint256, V>) + 2 * sizeof(void*)) * map.size() +
+               memusage::MallocUsage(sizeof(void*) * map.bucket_count()) +
+               memusage::DynamicUsage(setByTime) +
+               memusage::MallocUsage(sizeof(uint256) + 2 * sizeof(void*)) * setChanged.size() +
+               memusage::MallocUsage(sizeof(void*) * setChanged.bucket_count());
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        // In timestamp order, so that a smaller map reading this back keeps the newest entries
+        WriteCompactSize(s, map.size());
+        for (const auto& entry : setByTime) {
+            ::Serialize(s, entry.second);
+            ::Serialize(s, map.at(entry.second));
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        clear();
+        uint64_t nSize = ReadCompactSize(s);
+        for (uint64_t i = 0; i < nSize; i++) {
+            std::pair<uint256, V> entry;
+            ::Unserialize(s, entry.first);
+            ::Unserialize(s, entry.second);
+            insert(entry);
+        }
+    }
+};
+
+/**
+ * Stands in for a seenmessagemap in the serialization of an object, once the
+ * map is kept on disk by other means: writes an empty map, and adds the
+ * entries of files written before that to the map when reading.
+ */
+template <typename Map>
+class CSeenMapPlaceholder
+{
+private:
+    Map& map;
+
+public:
+    explicit CSeenMapPlaceholder(Map& mapIn) : map(mapIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, 0);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        uint64_t nSize = ReadCompactSize(s);
+        for (uint64_t i = 0; i < nSize; i++) {
+            std::pair<uint256, typename Map::mapped_type> entry;
+            ::Unserialize(s, entry.first);
+            ::Unserialize(s, entry.second);
+            map.insert(entry);
+        }
+    }
+};
+
+template <typename Map>
+CSeenMapPlaceholder<Map> SeenMapPlaceholder(Map& map)
+{
+    return CSeenMapPlaceholder<Map>(map);
+}
+
+#endif // ZCASH_SEENMESSAGEMAP_H
@@ -0,0 +1,401 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "snapshot.h"
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "hash.h"
+#include "init.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "ui_interface.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <functional>
+#include <memory>
+
+namespace
+{
+const unsigned char SNAPSHOT_MAGIC[5] = {'u', 't', 'x', 'o', 0xff};
+const uint16_t SNAPSHOT_VERSION = 1;
+
+//! First bytes of the keys a chain state database may contain
+const std::string CHAINSTATE_PREFIXES = "ABMSUZacmrsz";
+
+//! First byte of the keys of coins entries in the chain state database
+const unsigned char DB_COINS_PREFIX = 'c';
+
+//! Approximate size of the batches chain state entries are written in when loading
+const size_t SNAPSHOT_BATCH_SIZE = 16 << 20;
+
+typedef std::function<bool(std::vector<unsigned char>& key, std::vector<unsigned char>& value)> SnapshotEntryFn;
+
+/** Read the header of the snapshot in filein and check that it is for this network. */
+bool ReadSnapshotHeader(CAutoFile& filein, const fs::path& path, CSnapshotMetadata& metadata, std::string& strError)
+{
+    unsigned char magic[sizeof(SNAPSHOT_MAGIC)];
+    uint16_t nVersion;
+    CMessageHeader::MessageStartChars messageStart;
+    filein >> FLATDATA(magic) >> nVersion >> FLATDATA(messageStart);
+    if (memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+        strError = strprintf("%s is not a UTXO snapshot", path.string());
+        return false;
+    }
+    if (nVersion != SNAPSHOT_VERSION) {
+        strError = strprintf("Unsupported UTXO snapshot version %d", nVersion);
+        return false;
+    }
+    if (memcmp(messageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0) {
+        strError = "The UTXO snapshot is for a different network";
+        return false;
+    }
+    filein >> metadata;
+    return true;
+}
+
+/**
+ * Read the snapshot at path, passing every entry to fn (if set). Fails if the
+ * header is not for this network or the trailing hash does not match the
+ * hash computed over the metadata and entries, which is returned in
+ * hashSnapshot.
+ */
+bool ReadSnapshot(const fs::path& path, CSnapshotMetadata& metadata, uint256& hashSnapshot, uint64_t& nEntries, std::string& strError, const SnapshotEntryFn& fn)
+{
+    CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        strError = strprintf("Cannot open %s", path.string());
+        return false;
+    }
+
+    try {
+        if (!ReadSnapshotHeader(filein, path, metadata, strError))
+            return false;
+
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        hasher << metadata;
+        nEntries = 0;
+        std::vector<unsigned char> key, value;
+        while (true) {
+            if (ShutdownRequested()) {
+                strError = "Shutdown requested";
+                return false;
+            }
+            filein >> key;
+            // An empty key ends the entries.
+            if (key.empty())
+                break;
+            filein >> value;
+            hasher << key << value;
+            nEntries++;
+            if (fn && !fn(key, value))
+                return false;
+        }
+
+        uint256 hashTrailer;
+        filein >> hashTrailer;
+        hashSnapshot = hasher.GetHash();
+        if (hashTrailer != hashSnapshot) {
+            strError = strprintf("%s is corrupt: its hash does not match its contents", path.string());
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Error reading %s: %s", path.string(), e.what());
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+bool ReadUTXOSnapshotMetadata(const fs::path& path, CSnapshotMetadata& metadata, std::string& strError)
+{
+    CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        strError = strprintf("Cannot open %s", path.string());
+        return false;
+    }
+    try {
+        return ReadSnapshotHeader(filein, path, metadata, strError);
+    } catch (const std::exception& e) {
+        strError = strprintf("Error reading %s: %s", path.string(), e.what());
+        return false;
+    }
+}
+
+bool DumpUTXOSnapshot(const fs::path& path, CSnapshotMetadata& metadata, uint256& hashSnapshot, uint64_t& nEntries, std::string& strError)
+{
+    if (fs::exists(path)) {
+        strError = strprintf("%s already exists", path.string());
+        return false;
+    }
+
+    std::unique_ptr<CDBIterator> pcursor;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        if (!pcoinsdbview->WaitForFlush()) {
+            strError = "Failed to flush the chain state to disk";
+            return false;
+        }
+        CBlockIndex* pindex = chainActive.Tip();
+        if (pindex == NULL || pcoinsdbview->GetBestBlock() != pindex->GetBlockHash()) {
+            strError = "The chain state on disk does not match the active chain";
+            return false;
+        }
+        metadata.hashBlock = pindex->GetBlockHash();
+        metadata.nHeight = pindex->nHeight;
+        metadata.nChainTx = pindex->nChainTx;
+        metadata.nChainSproutValue = pindex->nChainSproutValue;
+        metadata.nChainSaplingValue = pindex->nChainSaplingValue;
+        // The iterator reads the database as of this point, so blocks can be
+        // connected again while the snapshot is written out.
+        pcursor.reset(pcoinsdbview->RawCursor());
+    }
+
+    fs::path pathTemp = path.string() + ".incomplete";
+    CAutoFile fileout(fsbridge::fopen(pathTemp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        strError = strprintf("Cannot create %s", pathTemp.string());
+        return false;
+    }
+
+    bool fOk = false;
+    try {
+        fileout << FLATDATA(SNAPSHOT_MAGIC) << SNAPSHOT_VERSION << FLATDATA(Params().MessageStart()) << metadata;
+
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        hasher << metadata;
+        nEntries = 0;
+        for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+            if (ShutdownRequested()) {
+                strError = "Shutdown requested";
+                break;
+            }
+            std::vector<unsigned char> key = pcursor->GetRawKey();
+            std::vector<unsigned char> value = pcursor->GetRawValue();
+            fileout << key << value;
+            hasher << key << value;
+            nEntries++;
+        }
+        if (!pcursor->Valid()) {
+            fileout << std::vector<unsigned char>();
+            hashSnapshot = hasher.GetHash();
+            fileout << hashSnapshot;
+            FileCommit(fileout.Get());
+            fOk = true;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Error writing %s: %s", pathTemp.string(), e.what());
+    }
+    fileout.fclose();
+
+    // Never leave a partial snapshot behind, not even on shutdown.
+    if (!fOk) {
+        boost::system::error_code ec;
+        fs::remove(pathTemp, ec);
+        return false;
+    }
+    if (!RenameOver(pathTemp, path)) {
+        strError = strprintf("Cannot rename %s to %s", pathTemp.string(), path.string());
+        return false;
+    }
+    return true;
+}
+
+bool LoadUTXOSnapshot(const fs::path& path, const uint256& hashExpected, CSnapshotMetadata& metadata, uint64_t& nEntries, std::string& strError)
+{
+    // Check the whole file first, so that a corrupt or unexpected snapshot
+    // never touches the chain state.
+    uint256 hashSnapshot;
+    if (!ReadSnapshot(path, metadata, hashSnapshot, nEntries, strError, SnapshotEntryFn()))
+        return false;
+    if (hashSnapshot != hashExpected) {
+        strError = strprintf("The UTXO snapshot hash %s does not match the expected hash %s", hashSnapshot.GetHex(), hashExpected.GetHex());
+        return false;
+    }
+
+    CBlockIndex* pindexBase;
+    {
+        LOCK(cs_main);
+        if (fTxIndex || fSpentIndex || fTimestampIndex) {
+            strError = "Transaction, spent and timestamp indexes cannot be built from a UTXO snapshot";
+            return false;
+        }
+        if (fLoadingSnapshot) {
+            strError = "A UTXO snapshot is already being loaded";
+            return false;
+        }
+        if (chainActive.Height() != 0) {
+            strError = "A UTXO snapshot can only be loaded into a chain state that has not connected any block after genesis";
+            return false;
+        }
+        BlockMap::iterator mi = mapBlockIndex.find(metadata.hashBlock);
+        if (mi == mapBlockIndex.end()) {
+            strError = strprintf("The snapshot block %s is not known yet; wait for the block headers to synchronize", metadata.hashBlock.GetHex());
+            return false;
+        }
+        pindexBase = mi->second;
+        if (pindexBase->nHeight != metadata.nHeight || (pindexBase->nStatus & BLOCK_FAILED_MASK) ||
+            pindexBestHeader == NULL || pindexBestHeader->GetAncestor(pindexBase->nHeight) != pindexBase) {
+            strError = strprintf("The snapshot block %s is not on the best header chain", metadata.hashBlock.GetHex());
+            return false;
+        }
+
+        FlushStateToDisk();
+        if (!pcoinsdbview->WaitForFlush()) {
+            strError = "Failed to flush the chain state to disk";
+            return false;
+        }
+
+        // An interrupted load leaves a chain state that is neither the old nor the
+        // new one; the flag makes the next start fail until the node is reindexed.
+        if (!pblocktree->WriteFlag("loadingsnapshot", true)) {
+            strError = "Failed to write to the block index database";
+            return false;
+        }
+
+        // The entries are written without cs_main; until the load is done no
+        // block is connected and the coins cache is not flushed.
+        fLoadingSnapshot = true;
+    }
+
+    std::vector<std::pair<std::vector<unsigned char>, std::vector<unsigned char>>> vEntries;
+    std::vector<CAddressUnspentDbEntry> vAddressUnspent;
+    size_t nBatchSize = 0;
+    auto writeBatch = [&](bool fSync) {
+        if (!pcoinsdbview->WriteRawEntries(vEntries, fSync)) {
+            strError = "Failed to write to the chain state database";
+            return false;
+        }
+        if (!vAddressUnspent.empty() && !pblocktree->UpdateAddressUnspentIndex(vAddressUnspent)) {
+            strError = "Failed to write to the address index database";
+            return false;
+        }
+        vEntries.clear();
+        vAddressUnspent.clear();
+        nBatchSize = 0;
+        return true;
+    };
+    CSnapshotMetadata metadataRead;
+    bool fOk = ReadSnapshot(path, metadataRead, hashSnapshot, nEntries, strError, [&](std::vector<unsigned char>& key, std::vector<unsigned char>& value) {
+        if (CHAINSTATE_PREFIXES.find(key[0]) == std::string::npos) {
+            strError = "The UTXO snapshot contains an unexpected database entry";
+            return false;
+        }
+        // The unspent outputs part of the address index, which masternode
+        // collateral checks rely on, follows from the coins.
+        if (fAddressIndex && key[0] == DB_COINS_PREFIX) {
+            CDataStream ssKey(key, SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(value, SER_DISK, CLIENT_VERSION);
+            char chType;
+            uint256 txid;
+            CCoins coins;
+            try {
+                ssKey >> chType >> txid;
+                ssValue >> coins;
+            } catch (const std::exception&) {
+                strError = "The UTXO snapshot contains an unreadable coins entry";
+                return false;
+            }
+            for (unsigned int i = 0; i < coins.vout.size(); i++) {
+                const CTxOut& out = coins.vout[i];
+                if (out.IsNull())
+                    continue;
+                if (out.scriptPubKey.IsPayToScriptHash()) {
+                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin() + 2, out.scriptPubKey.begin() + 22);
+                    vAddressUnspent.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), txid, i), CAddressUnspentValue(out.nValue, out.scriptPubKey, coins.nHeight)));
+                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
+                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin() + 3, out.scriptPubKey.begin() + 23);
+                    vAddressUnspent.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), txid, i), CAddressUnspentValue(out.nValue, out.scriptPubKey, coins.nHeight)));
+                }
+            }
+        }
+        nBatchSize += key.size() + value.size();
+        vEntries.emplace_back(std::move(key), std::move(value));
+        if (nBatchSize >= SNAPSHOT_BATCH_SIZE)
+            return writeBatch(false);
+        return true;
+    });
+    if (fOk && hashSnapshot != hashExpected) {
+        strError = "The UTXO snapshot changed while it was being loaded";
+        fOk = false;
+    }
+    if (fOk)
+        fOk = writeBatch(true);
+
+    {
+        LOCK(cs_main);
+        if (fOk) {
+            pcoinsTip->Reset();
+            if (pcoinsTip->GetBestBlock() != metadata.hashBlock) {
+                strError = "The UTXO snapshot's chain state is not at the snapshot block";
+                fOk = false;
+            }
+        }
+        if (!fOk) {
+            // fLoadingSnapshot stays set: nothing may build on this chain state.
+            strError += "; the chain state is incomplete, restart with -reindex";
+            return false;
+        }
+
+        // Transactions accepted while the chain state was being replaced were
+        // checked against a mix of the old and the new one.
+        mempool.clear();
+        fLoadingSnapshot = false;
+        if (!ActivateUTXOSnapshot(pindexBase, metadata)) {
+            strError = "Failed to activate the UTXO snapshot";
+            return false;
+        }
+        pblocktree->WriteFlag("loadingsnapshot", false);
+    }
+    LogPrintf("%s: loaded %u chain state entries, new tip %s at height %d\n", __func__, nEntries, metadata.hashBlock.GetHex(), metadata.nHeight);
+
+    // Connect the blocks after the snapshot block that arrived meanwhile.
+    CValidationState state;
+    ActivateBestChain(state, Params());
+    return true;
+}
+
+void ThreadLoadUTXOSnapshot(const fs::path& path, const uint256& hashExpected)
+{
+    RenameThread("gemlink-loadsnap");
+
+    CSnapshotMetadata metadata;
+    uint64_t nEntries = 0;
+    std::string strError;
+    bool fOk = ReadUTXOSnapshotMetadata(path, metadata, strError);
+    if (fOk) {
+        // Block download is held off, but headers keep synchronizing; wait
+        // until they reach the snapshot block.
+        LogPrintf("%s: waiting for the block headers to reach the snapshot block %s at height %d\n", __func__, metadata.hashBlock.GetHex(), metadata.nHeight);
+        while (true) {
+            {
+                LOCK(cs_main);
+                BlockMap::iterator mi = mapBlockIndex.find(metadata.hashBlock);
+                if (mi != mapBlockIndex.end() && pindexBestHeader != NULL && pindexBestHeader->GetAncestor(mi->second->nHeight) == mi->second)
+                    break;
+            }
+            MilliSleep(1000);
+        }
+        fOk = LoadUTXOSnapshot(path, hashExpected, metadata, nEntries, strError);
+    }
+
+    if (!fOk) {
+        if (ShutdownRequested())
+            return;
+        // Syncing from genesis instead is not what was asked for.
+        LogPrintf("%s: %s\n", __func__, strError);
+        uiInterface.ThreadSafeMessageBox(strprintf(_("Error loading the UTXO snapshot: %s"), strError), "", CClientUIInterface::MSG_ERROR);
+        StartShutdown();
+        return;
+    }
+
+    {
+        LOCK(cs_main);
+        fAwaitingSnapshot = false;
+    }
+    LogPrintf("%s: loaded %s, resuming block download\n", __func__, path.string());
+}
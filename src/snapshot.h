@@ -0,0 +1,78 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SNAPSHOT_H
+#define BITCOIN_SNAPSHOT_H
+
+#include "amount.h"
+#include "fs.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <optional>
+#include <string>
+
+/**
+ * Describes the block a UTXO snapshot was taken at, along with the chain
+ * totals of that block that cannot be recomputed without its ancestors.
+ */
+class CSnapshotMetadata
+{
+public:
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nChainTx;
+    std::optional<CAmount> nChainSproutValue;
+    std::optional<CAmount> nChainSaplingValue;
+
+    CSnapshotMetadata() : nHeight(0), nChainTx(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(nChainTx);
+        READWRITE(nChainSproutValue);
+        READWRITE(nChainSaplingValue);
+    }
+};
+
+/**
+ * Write the chain state at the current tip (coins, Sprout and Sapling
+ * anchors, nullifiers, history tree nodes and UTXO set statistics) to path.
+ *
+ * The file holds a header with the snapshot metadata, every chain state
+ * database entry in key order, and a trailing hash committing to the
+ * metadata and all entries. Only the flush happens under cs_main; the
+ * entries are read from a consistent database snapshot afterwards.
+ */
+bool DumpUTXOSnapshot(const fs::path& path, CSnapshotMetadata& metadata, uint256& hashSnapshot, uint64_t& nEntries, std::string& strError);
+
+/**
+ * Replace the chain state of a node that has not connected any block beyond
+ * genesis with a snapshot written by DumpUTXOSnapshot, and make the snapshot
+ * block the tip. The snapshot block header must already be on the best
+ * header chain, and the snapshot hash must equal hashExpected; it is checked
+ * over the whole file before the chain state is touched. The entries are
+ * written without holding cs_main, while fLoadingSnapshot keeps blocks from
+ * being connected. With -addressindex the unspent outputs of the address
+ * index are built from the snapshot coins; address history starts at the
+ * snapshot block.
+ */
+bool LoadUTXOSnapshot(const fs::path& path, const uint256& hashExpected, CSnapshotMetadata& metadata, uint64_t& nEntries, std::string& strError);
+
+/** Read the metadata of the snapshot at path without checking the rest of the file. */
+bool ReadUTXOSnapshotMetadata(const fs::path& path, CSnapshotMetadata& metadata, std::string& strError);
+
+/**
+ * Load the snapshot given with -loadsnapshot: wait until the block headers
+ * reach the snapshot block, load it and clear fAwaitingSnapshot so that
+ * block download starts. Shuts the node down if the snapshot cannot be loaded.
+ */
+void ThreadLoadUTXOSnapshot(const fs::path& path, const uint256& hashExpected);
+
+#endif // BITCOIN_SNAPSHOT_H
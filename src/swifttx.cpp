@@ -459,6 +459,12 @@ void CleanTransactionLocksList()
                     mapTxLockVote.erase(v.GetHash());
             }
 
+#ifdef ENABLE_WALLET
+            // An expired lock no longer adds to the depth of a wallet transaction
+            if (pwalletMain)
+                pwalletMain->UpdatedTransaction(it->second.txHash);
+#endif
+
             mapTxLocks.erase(it++);
         } else {
             it++;
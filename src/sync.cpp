@@ -172,4 +172,12 @@ void AssertLockHeldInternal(const char* pszName, const char* pszFile, int nLine,
     abort();
 }
 
+void AssertNoLocksHeldInternal(const char* pszFile, int nLine)
+{
+    if (lockstack.get() == NULL || lockstack->empty())
+        return;
+    fprintf(stderr, "Assertion failed: locks held in %s:%i:\n%s", pszFile, nLine, LocksHeld().c_str());
+    abort();
+}
+
 #endif /* DEBUG_LOCKORDER */
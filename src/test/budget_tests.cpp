@@ -0,0 +1,169 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "masternode-budget.h"
+#include "masternode-seendb.h"
+#include "masternodeman.h"
+#include "streams.h"
+#include "utiltime.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(budget_tests, BasicTestingSetup)
+
+static CTxIn VoterIn(int n)
+{
+    return CTxIn(COutPoint(ArithToUint256(arith_uint256(n + 1)), 0));
+}
+
+static CBudgetVote Vote(const CBudgetProposal& proposal, int nVoter, CBudgetVote::VoteDirection vd, int64_t nTime)
+{
+    CBudgetVote vote(VoterIn(nVoter), proposal.GetHash(), vd);
+    vote.SetTime(nTime);
+    return vote;
+}
+
+static void CheckTally(const CBudgetProposal& proposal, int nYeas, int nNays, int nAbstains)
+{
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), nYeas);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), nNays);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), nAbstains);
+}
+
+BOOST_AUTO_TEST_CASE(vote_tally_follows_votes)
+{
+    const int64_t nNow = GetTime();
+    CBudgetProposal proposal("test", "https://example.com", 0, 100, CScript() << OP_TRUE, 10 * COIN, uint256S("0x01"));
+    std::string strError;
+    CheckTally(proposal, 0, 0, 0);
+
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 0, CBudgetVote::VOTE_YES, nNow - 2 * BUDGET_VOTE_UPDATE_MIN), strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 1, CBudgetVote::VOTE_YES, nNow - 2 * BUDGET_VOTE_UPDATE_MIN), strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 2, CBudgetVote::VOTE_NO, nNow - 2 * BUDGET_VOTE_UPDATE_MIN), strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 3, CBudgetVote::VOTE_ABSTAIN, nNow - 2 * BUDGET_VOTE_UPDATE_MIN), strError));
+    CheckTally(proposal, 2, 1, 1);
+
+    // Changing a vote moves it from one count to the other
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 1, CBudgetVote::VOTE_NO, nNow - BUDGET_VOTE_UPDATE_MIN), strError));
+    CheckTally(proposal, 1, 2, 1);
+
+    // Rejected updates leave the counts alone
+    BOOST_CHECK(!proposal.AddOrUpdateVote(Vote(proposal, 1, CBudgetVote::VOTE_YES, nNow - BUDGET_VOTE_UPDATE_MIN + 1), strError));
+    BOOST_CHECK(!proposal.AddOrUpdateVote(Vote(proposal, 0, CBudgetVote::VOTE_NO, nNow - 3 * BUDGET_VOTE_UPDATE_MIN), strError));
+    BOOST_CHECK(!proposal.AddOrUpdateVote(Vote(proposal, 4, CBudgetVote::VOTE_YES, nNow + 2 * 60 * 60), strError));
+    CheckTally(proposal, 1, 2, 1);
+
+    // An invalid vote is stored but not counted until it becomes valid
+    CBudgetVote invalid = Vote(proposal, 4, CBudgetVote::VOTE_YES, nNow);
+    invalid.SetValid(false);
+    BOOST_CHECK(proposal.AddOrUpdateVote(invalid, strError));
+    CheckTally(proposal, 1, 2, 1);
+}
+
+BOOST_AUTO_TEST_CASE(vote_tally_follows_masternode_list)
+{
+    const int64_t nNow = GetTime();
+    CBudgetProposal proposal("test", "https://example.com", 0, 100, CScript() << OP_TRUE, 10 * COIN, uint256S("0x01"));
+    std::string strError;
+    for (int i = 0; i < 3; i++)
+        BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, i, i == 2 ? CBudgetVote::VOTE_NO : CBudgetVote::VOTE_YES, nNow), strError));
+    CheckTally(proposal, 2, 1, 0);
+
+    // Votes of masternodes that are not in the list stop counting
+    CMasternode mn;
+    mn.vin = VoterIn(0);
+    BOOST_CHECK(mnodeman.Add(mn));
+    BOOST_CHECK(proposal.CleanAndRemove());
+    CheckTally(proposal, 1, 0, 0);
+    BOOST_CHECK(!proposal.CleanAndRemove());
+
+    // and count again once they are back
+    mn.vin = VoterIn(2);
+    BOOST_CHECK(mnodeman.Add(mn));
+    BOOST_CHECK(proposal.CleanAndRemove());
+    CheckTally(proposal, 1, 1, 0);
+
+    mnodeman.Clear();
+    BOOST_CHECK(proposal.CleanAndRemove());
+    CheckTally(proposal, 0, 0, 0);
+}
+
+BOOST_AUTO_TEST_CASE(vote_tally_rebuilt_on_load)
+{
+    const int64_t nNow = GetTime();
+    CBudgetProposal proposal("test", "https://example.com", 0, 100, CScript() << OP_TRUE, 10 * COIN, uint256S("0x01"));
+    std::string strError;
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 0, CBudgetVote::VOTE_YES, nNow), strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 1, CBudgetVote::VOTE_NO, nNow), strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 2, CBudgetVote::VOTE_NO, nNow), strError));
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << proposal;
+    CBudgetProposal loaded;
+    ss >> loaded;
+    CheckTally(loaded, 1, 2, 0);
+
+    CBudgetProposal copy(loaded);
+    CheckTally(copy, 1, 2, 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(votes_kept_in_seen_db, TestingSetup)
+{
+    const int64_t nNow = GetTime();
+    CBudgetProposal proposal("test", "https://example.com", 0, 100, CScript() << OP_TRUE, 10 * COIN, uint256S("0x01"));
+    const uint256 hash = proposal.GetHash();
+    std::string strError;
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 0, CBudgetVote::VOTE_YES, nNow), strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 1, CBudgetVote::VOTE_NO, nNow), strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(Vote(proposal, 2, CBudgetVote::VOTE_NO, nNow), strError));
+
+    // A budget.dat written before the votes moved out carries them inline
+    CDataStream ssOld(SER_DISK, CLIENT_VERSION);
+    for (int i = 0; i < 6; i++)
+        WriteCompactSize(ssOld, 0);
+    std::map<uint256, CBudgetProposal> mapProposals;
+    mapProposals.insert(std::make_pair(hash, proposal));
+    ssOld << mapProposals << std::map<uint256, CFinalizedBudget>();
+    CBudgetManager manager;
+    ssOld >> manager;
+    CheckTally(*manager.FindProposal(hash), 1, 2, 0);
+
+    // they move to the database, and the file is written without them
+    CMasternodeSeenDB db(0, true);
+    BOOST_CHECK(manager.WriteVoteChanges(db));
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << manager;
+    BOOST_CHECK(ss.size() < ssOld.size());
+
+    CBudgetManager reloaded;
+    ss >> reloaded;
+    CheckTally(*reloaded.FindProposal(hash), 0, 0, 0);
+    BOOST_CHECK(reloaded.LoadVotes(db));
+    CheckTally(*reloaded.FindProposal(hash), 1, 2, 0);
+
+    // A replaced vote is written on its own
+    BOOST_CHECK(reloaded.UpdateProposal(Vote(proposal, 1, CBudgetVote::VOTE_YES, nNow + BUDGET_VOTE_UPDATE_MIN), NULL, strError));
+    BOOST_CHECK(reloaded.WriteVoteChanges(db));
+    CDataStream ss2(SER_DISK, CLIENT_VERSION);
+    ss2 << reloaded;
+    CDataStream ss3(ss2);
+    CBudgetManager reloaded2;
+    ss2 >> reloaded2;
+    BOOST_CHECK(reloaded2.LoadVotes(db));
+    CheckTally(*reloaded2.FindProposal(hash), 2, 1, 0);
+
+    // Votes of proposals that are gone are erased
+    CBudgetManager empty;
+    BOOST_CHECK(empty.LoadVotes(db));
+    BOOST_CHECK(empty.WriteVoteChanges(db));
+    CBudgetManager reloaded3;
+    ss3 >> reloaded3;
+    BOOST_CHECK(reloaded3.LoadVotes(db));
+    CheckTally(*reloaded3.FindProposal(hash), 0, 0, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,7 @@
 #include "test/test_bitcoin.h"
 #include "consensus/validation.h"
 #include "main.h"
+#include "txdb.h"
 #include "undo.h"
 #include "primitives/transaction.h"
 #include "pubkey.h"
@@ -1094,4 +1095,131 @@ BOOST_AUTO_TEST_CASE(ccoins_serialization)
     }
 }
 
+BOOST_AUTO_TEST_CASE(coins_stats_apply_block)
+{
+    CCoinsViewTest base;
+    CCoinsViewCache cache(&base);
+
+    CMutableTransaction mtxPrev;
+    mtxPrev.vin.resize(1);
+    mtxPrev.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    mtxPrev.vout.resize(2);
+    mtxPrev.vout[0].nValue = 100;
+    mtxPrev.vout[0].scriptPubKey = CScript() << OP_1;
+    mtxPrev.vout[1].nValue = 200;
+    mtxPrev.vout[1].scriptPubKey = CScript() << OP_2;
+    CTransaction txPrev(mtxPrev);
+    {
+        CCoinsModifier coins = cache.ModifyNewCoins(txPrev.GetHash());
+        coins->FromTx(txPrev, 10);
+    }
+
+    CCoinsStats stats;
+    stats.nTransactions = 1;
+    stats.nTransactionOutputs = 2;
+    stats.nTotalAmount = 300;
+    ApplyCoinHash(stats.muhash, txPrev.GetHash(), 0, 10, false, txPrev.vout[0]);
+    ApplyCoinHash(stats.muhash, txPrev.GetHash(), 1, 10, false, txPrev.vout[1]);
+    CCoinsStats statsBefore = stats;
+
+    CBlock block;
+    block.hashPrevBlock = GetRandHash();
+    stats.hashBlock = block.hashPrevBlock;
+    stats.nHeight = 10;
+
+    CMutableTransaction mtxCoinbase;
+    mtxCoinbase.vin.resize(1);
+    mtxCoinbase.vin[0].scriptSig = CScript() << OP_1;
+    mtxCoinbase.vout.resize(1);
+    mtxCoinbase.vout[0].nValue = 50;
+    mtxCoinbase.vout[0].scriptPubKey = CScript() << OP_1;
+    block.vtx.push_back(CTransaction(mtxCoinbase));
+
+    // Spends an existing output; its own output is spent later in the block.
+    CMutableTransaction mtx1;
+    mtx1.vin.resize(1);
+    mtx1.vin[0].prevout = COutPoint(txPrev.GetHash(), 0);
+    mtx1.vout.resize(1);
+    mtx1.vout[0].nValue = 90;
+    mtx1.vout[0].scriptPubKey = CScript() << OP_1;
+    block.vtx.push_back(CTransaction(mtx1));
+
+    CMutableTransaction mtx2;
+    mtx2.vin.resize(1);
+    mtx2.vin[0].prevout = COutPoint(block.vtx[1].GetHash(), 0);
+    mtx2.vout.resize(1);
+    mtx2.vout[0].nValue = 80;
+    mtx2.vout[0].scriptPubKey = CScript() << OP_1;
+    block.vtx.push_back(CTransaction(mtx2));
+
+    stats.ApplyBlock(block, 11, cache, false);
+    BOOST_CHECK(stats.hashBlock == block.GetHash());
+    BOOST_CHECK_EQUAL(stats.nHeight, 11);
+    BOOST_CHECK_EQUAL(stats.nTransactions, 3);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, 3);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, 330);
+
+    MuHash3072 expected;
+    ApplyCoinHash(expected, txPrev.GetHash(), 1, 10, false, txPrev.vout[1]);
+    ApplyCoinHash(expected, block.vtx[0].GetHash(), 0, 11, true, block.vtx[0].vout[0]);
+    ApplyCoinHash(expected, block.vtx[2].GetHash(), 0, 11, false, block.vtx[2].vout[0]);
+    CCoinsStats statsExpected;
+    statsExpected.muhash = expected;
+    BOOST_CHECK(stats.GetMuHash() == statsExpected.GetMuHash());
+
+    // Disconnecting against the same (pre-block) view restores the old state.
+    stats.ApplyBlock(block, 11, cache, true);
+    BOOST_CHECK(stats.hashBlock == block.hashPrevBlock);
+    BOOST_CHECK_EQUAL(stats.nHeight, 10);
+    BOOST_CHECK_EQUAL(stats.nTransactions, statsBefore.nTransactions);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, statsBefore.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, statsBefore.nTotalAmount);
+    BOOST_CHECK(stats.GetMuHash() == statsBefore.GetMuHash());
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_db_background_flush, TestingSetup)
+{
+    CCoinsViewDB db(1 << 20, true);
+    db.SetBackgroundFlush(true);
+
+    uint256 txid = GetRandHash();
+    uint256 hashBlock = GetRandHash();
+    {
+        CCoinsViewCache cache(&db);
+        {
+            CCoinsModifier coins = cache.ModifyNewCoins(txid);
+            coins->vout.resize(1);
+            coins->vout[0].nValue = 500;
+            coins->vout[0].scriptPubKey = CScript() << OP_1;
+        }
+        cache.SetBestBlock(hashBlock);
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // Lookups are consistent whether or not the write has completed yet.
+    CCoins coins;
+    BOOST_CHECK(db.GetCoins(txid, coins));
+    BOOST_CHECK_EQUAL(coins.vout[0].nValue, 500);
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+
+    BOOST_CHECK(db.WaitForFlush());
+    BOOST_CHECK(db.GetCoins(txid, coins));
+    BOOST_CHECK_EQUAL(coins.vout[0].nValue, 500);
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+
+    // Spending the output and flushing again erases it from the database.
+    uint256 hashBlock2 = GetRandHash();
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyCoins(txid)->Spend(0);
+        cache.SetBestBlock(hashBlock2);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(!db.HaveCoins(txid));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+    BOOST_CHECK(db.WaitForFlush());
+    BOOST_CHECK(!db.HaveCoins(txid));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
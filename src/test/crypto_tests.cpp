@@ -4,10 +4,12 @@
 
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
+#include "hash.h"
 #include "random.h"
 #include "test/test_bitcoin.h"
 #include "test_random.h"
@@ -177,6 +179,22 @@ BOOST_AUTO_TEST_CASE(sha512_testvectors)
                "37de8c3ef5459d76a52cedc02dc499a3c9ed9dedbfb3281afd9653b8a112fafc");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[64 * 32];
+        unsigned char out1[32 * 32], out2[32 * 32];
+        for (int j = 0; j < 64 * i; ++j) {
+            in[j] = insecure_rand() & 0xff;
+        }
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+        }
+        SHA256D64(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(hmac_sha256_testvectors)
 {
     // test cases 1, 2, 3, 4, 6 and 7 of RFC 4231
@@ -259,4 +277,45 @@ BOOST_AUTO_TEST_CASE(hmac_sha512_testvectors)
                    "b6022cac3c4982b10d5eeb55c3e4de15134676fb6de0446065c97440fa8c6a58");
 }
 
+static MuHash3072 FromInt(unsigned char i)
+{
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(tmp, sizeof(tmp));
+}
+
+static uint256 FinalizeMuHash(MuHash3072 muhash)
+{
+    uint256 out;
+    muhash.Finalize(out.begin());
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    // Same test vector as Bitcoin Core's MuHash3072.
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(2);
+    BOOST_CHECK_EQUAL(FinalizeMuHash(acc).GetHex(), "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863");
+
+    // Insertion order does not matter, and removal cancels insertion.
+    unsigned char a[] = {1, 2, 3};
+    unsigned char b[] = {4, 5};
+    MuHash3072 x, y, empty;
+    x.Insert(a, sizeof(a)).Insert(b, sizeof(b));
+    y.Insert(b, sizeof(b)).Insert(a, sizeof(a));
+    BOOST_CHECK(FinalizeMuHash(x) == FinalizeMuHash(y));
+    x.Remove(a, sizeof(a)).Remove(b, sizeof(b));
+    BOOST_CHECK(FinalizeMuHash(x) == FinalizeMuHash(empty));
+    BOOST_CHECK(FinalizeMuHash(y) != FinalizeMuHash(empty));
+
+    // Round trip through the serialized state.
+    unsigned char bytes[MuHash3072::SERIALIZED_SIZE];
+    y.Remove(a, sizeof(a));
+    y.ToBytes(bytes);
+    MuHash3072 z;
+    z.FromBytes(bytes);
+    BOOST_CHECK(FinalizeMuHash(z) == FinalizeMuHash(MuHash3072(b, sizeof(b))));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,144 @@
+// Copyright (c) 2012-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+#include "random.h"
+#include "test/test_bitcoin.h"
+#include "test/test_random.h"
+#include "uint256.h"
+
+#include <cstring>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+/** Test Suite for CuckooCache
+ *
+ * 1) All tests should have a deterministic result (using insecure rand
+ * with deterministic seeds)
+ * 2) Some test methods are templated to allow for easier testing
+ * against new versions / comparing
+ * 3) Results should be treated as a regression test, i.e., did the behavior
+ * change significantly from what was expected. This can be OK, depending on
+ * the nature of the change, but requires updating the tests to reflect the new
+ * expected behavior. For example improving the hit rate may cause some tests
+ * using BOOST_CHECK_CLOSE to fail.
+ *
+ */
+BOOST_FIXTURE_TEST_SUITE(cuckoocache_tests, BasicTestingSetup)
+
+namespace
+{
+/** Hasher taking 32-bit chunks of an already random key, as the signature
+ * cache does. */
+struct RandomHasher {
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+typedef CuckooCache::cache<uint256, RandomHasher> test_cache;
+
+uint256 RandomEntry()
+{
+    uint256 r;
+    for (int i = 0; i < 8; ++i) {
+        uint32_t x = insecure_rand();
+        std::memcpy(r.begin() + 4 * i, &x, 4);
+    }
+    return r;
+}
+
+/** Fill a cache of the given byte size with load * size random entries and
+ * return the fraction that can be found again. */
+double HitRate(double load, size_t megabytes)
+{
+    test_cache set;
+    size_t bytes = megabytes * (1 << 20);
+    set.setup_bytes(bytes);
+    uint32_t n_insert = static_cast<uint32_t>(load * (bytes / sizeof(uint256)));
+    std::vector<uint256> hashes(n_insert);
+    for (uint32_t i = 0; i < n_insert; ++i)
+        hashes[i] = RandomEntry();
+    for (uint32_t i = 0; i < n_insert; ++i)
+        set.insert(hashes[i]);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n_insert; ++i)
+        count += set.contains(hashes[i], false);
+    return double(count) / double(n_insert);
+}
+} // namespace
+
+/* Inserting a small number of entries into a cache that is large enough
+ * must never lose any of them, and must never report unknown entries. */
+BOOST_AUTO_TEST_CASE(cuckoocache_no_fakes)
+{
+    seed_insecure_rand(true);
+    test_cache cc;
+    cc.setup_bytes(32 << 20);
+    for (int x = 0; x < 100000; ++x)
+        cc.insert(RandomEntry());
+    for (int x = 0; x < 100000; ++x)
+        BOOST_CHECK(!cc.contains(RandomEntry(), false));
+}
+
+/* At a load of half the capacity nearly all entries must still be present;
+ * when overfilled the cache keeps as many entries as it has room for. */
+BOOST_AUTO_TEST_CASE(cuckoocache_hit_rate_ok)
+{
+    seed_insecure_rand(true);
+    BOOST_CHECK(HitRate(0.5, 2) > 0.98);
+    BOOST_CHECK(HitRate(2.0, 2) * 2.0 > 0.9);
+}
+
+/* Entries looked up with erase set are replaced first when the cache fills
+ * up, while recently inserted entries survive. */
+BOOST_AUTO_TEST_CASE(cuckoocache_erase_ok)
+{
+    seed_insecure_rand(true);
+    test_cache set;
+    set.setup_bytes(1 << 20);
+    uint32_t n_insert = static_cast<uint32_t>(0.5 * ((1 << 20) / sizeof(uint256)));
+
+    std::vector<uint256> hashes(2 * n_insert);
+    for (uint32_t i = 0; i < 2 * n_insert; ++i)
+        hashes[i] = RandomEntry();
+
+    // Insert the first half and erase half of those.
+    for (uint32_t i = 0; i < n_insert; ++i)
+        set.insert(hashes[i]);
+    for (uint32_t i = 0; i < n_insert / 2; ++i)
+        BOOST_CHECK(set.contains(hashes[i], true));
+
+    // Erased entries stay visible until their slots are reused.
+    for (uint32_t i = 0; i < n_insert / 2; ++i)
+        BOOST_CHECK(set.contains(hashes[i], false));
+
+    // Re-inserting the remaining entries refreshes their epoch so that they
+    // are not aged out by the inserts below.
+    for (uint32_t i = n_insert / 2; i < n_insert; ++i)
+        set.insert(hashes[i]);
+
+    // Filling the cache up again evicts the erased entries first.
+    for (uint32_t i = n_insert; i < 2 * n_insert; ++i)
+        set.insert(hashes[i]);
+
+    uint32_t count_erased = 0, count_kept = 0, count_new = 0;
+    for (uint32_t i = 0; i < n_insert / 2; ++i)
+        count_erased += set.contains(hashes[i], false);
+    for (uint32_t i = n_insert / 2; i < n_insert; ++i)
+        count_kept += set.contains(hashes[i], false);
+    for (uint32_t i = n_insert; i < 2 * n_insert; ++i)
+        count_new += set.contains(hashes[i], false);
+
+    BOOST_CHECK(double(count_kept) / (n_insert / 2) > 0.95);
+    BOOST_CHECK(double(count_new) / n_insert > 0.95);
+    BOOST_CHECK(count_erased < count_kept);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -119,6 +119,39 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_move_prefix)
+{
+    {
+        path ph = temp_directory_path() / unique_path();
+        CDBWrapper src(ph, (1 << 20), true, false);
+        CDBWrapperOptions options(1 << 20);
+        options.fCompression = true;
+        CDBWrapper dest(ph / "dest", options, true, false);
+
+        uint256 in = GetRandHash();
+        uint256 res;
+        for (int i = 0; i < 100; i++) {
+            BOOST_CHECK(src.Write(make_pair('t', i), in));
+        }
+        BOOST_CHECK(src.Write(make_pair('b', 0), in));
+        BOOST_CHECK(src.Write(make_pair('u', 0), in));
+
+        BOOST_CHECK_EQUAL(src.MovePrefixTo(dest, 't'), 100);
+        for (int i = 0; i < 100; i++) {
+            BOOST_CHECK(!src.Exists(make_pair('t', i)));
+            BOOST_CHECK(dest.Read(make_pair('t', i), res));
+            BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+        }
+        // Neighbouring prefixes are left alone
+        BOOST_CHECK(src.Exists(make_pair('b', 0)));
+        BOOST_CHECK(src.Exists(make_pair('u', 0)));
+        BOOST_CHECK(!dest.Exists(make_pair('u', 0)));
+
+        // Moving again is a no-op
+        BOOST_CHECK_EQUAL(src.MovePrefixTo(dest, 't'), 0);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(iterator_ordering)
 {
     path ph = temp_directory_path() / unique_path();
@@ -0,0 +1,97 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonwriter.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+BOOST_FIXTURE_TEST_SUITE(jsonwriter_tests, BasicTestingSetup)
+
+static void WriteDocument(JSONWriter& writer)
+{
+    writer.BeginObject();
+    writer.KeyValue("hash", "00ff");
+    writer.KeyValue("height", 42);
+    writer.Key("tx");
+    writer.BeginArray();
+    for (int i = 0; i < 100; i++) {
+        UniValue tx(UniValue::VOBJ);
+        tx.pushKV("n", i);
+        tx.pushKV("quote\"d", "line\nbreak");
+        writer.Value(tx);
+    }
+    writer.EndArray();
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Key("nested");
+    writer.BeginObject();
+    writer.Key("inner");
+    writer.BeginArray();
+    writer.Value(true);
+    writer.Value(NullUniValue);
+    writer.EndArray();
+    writer.EndObject();
+    writer.EndObject();
+}
+
+BOOST_AUTO_TEST_CASE(value_writer_builds_document)
+{
+    JSONValueWriter writer;
+    WriteDocument(writer);
+    const UniValue& val = writer.GetValue();
+
+    BOOST_CHECK(val.isObject());
+    BOOST_CHECK_EQUAL(find_value(val, "hash").get_str(), "00ff");
+    BOOST_CHECK_EQUAL(find_value(val, "height").get_int(), 42);
+    BOOST_CHECK_EQUAL(find_value(val, "tx").size(), 100U);
+    BOOST_CHECK_EQUAL(find_value(find_value(val, "tx")[7], "n").get_int(), 7);
+    BOOST_CHECK(find_value(val, "empty").isArray());
+    BOOST_CHECK(find_value(find_value(val, "nested"), "inner")[0].isTrue());
+}
+
+BOOST_AUTO_TEST_CASE(stream_writer_matches_value_writer)
+{
+    JSONValueWriter valueWriter;
+    WriteDocument(valueWriter);
+
+    // Single chunk: nothing reaches the sink until it is flushed
+    std::string strSingle;
+    JSONStreamWriter single([&](const std::string& strChunk) { strSingle += strChunk; });
+    WriteDocument(single);
+    BOOST_CHECK(!single.Started());
+    strSingle = single.ReleaseBuffer();
+    BOOST_CHECK_EQUAL(strSingle, valueWriter.GetValue().write());
+
+    // Tiny chunks: the output is split but the same once reassembled
+    std::string strChunked;
+    size_t nChunks = 0;
+    JSONStreamWriter chunked([&](const std::string& strChunk) {
+        BOOST_CHECK(!strChunk.empty());
+        strChunked += strChunk;
+        nChunks++;
+    },
+                             16);
+    WriteDocument(chunked);
+    BOOST_CHECK(chunked.Started());
+    chunked.Flush();
+    BOOST_CHECK(chunked.ReleaseBuffer().empty());
+    BOOST_CHECK(nChunks > 1);
+    BOOST_CHECK_EQUAL(strChunked, strSingle);
+}
+
+BOOST_AUTO_TEST_CASE(stream_writer_scalar_document)
+{
+    std::string strOut;
+    JSONStreamWriter writer([&](const std::string& strChunk) { strOut += strChunk; });
+    writer.Value("deadbeef");
+    writer.Flush();
+    BOOST_CHECK_EQUAL(strOut, "\"deadbeef\"");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
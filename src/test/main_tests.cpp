@@ -2,8 +2,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "arith_uint256.h"
 #include "chainparams.h"
 #include "main.h"
+#include "pow.h"
 
 #include "test/test_bitcoin.h"
 
@@ -101,4 +103,170 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     BOOST_CHECK(Test());
 }
 
+BOOST_AUTO_TEST_CASE(assumevalid_ancestors)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    // Two weeks of blocks plus some, so the oldest ones are buried deep enough
+    const int nBuried = 60 * 60 * 24 * 7 * 2 / params.nPowTargetSpacing;
+    const int nChain = nBuried + 100;
+    const int nForkHeight = 50;
+
+    // A main chain and a fork off it, with enough work to pass the minimum chain work
+    std::vector<CBlockIndex> vChain(nChain), vFork(nChain - nForkHeight);
+    std::vector<uint256> vHashes;
+    vHashes.reserve(vChain.size() + vFork.size());
+    auto link = [&](CBlockIndex& index, CBlockIndex* pprev, int nHeight) {
+        index.nHeight = nHeight;
+        index.pprev = pprev;
+        index.nBits = 0x1e0ffff0;
+        index.nChainWork = (pprev ? pprev->nChainWork : UintToArith256(params.nMinimumChainWork)) + GetBlockProof(index);
+        vHashes.push_back(ArithToUint256(arith_uint256(vHashes.size() + 1) << 128));
+        index.phashBlock = &vHashes.back();
+        index.BuildSkip();
+    };
+    for (int i = 0; i < nChain; i++)
+        link(vChain[i], i ? &vChain[i - 1] : NULL, i);
+    for (size_t i = 0; i < vFork.size(); i++)
+        link(vFork[i], i ? &vFork[i - 1] : &vChain[nForkHeight], nForkHeight + 1 + i);
+
+    LOCK(cs_main);
+    CBlockIndex* pindexBestHeaderOld = pindexBestHeader;
+    uint256 hashAssumeValidOld = hashAssumeValid;
+    for (CBlockIndex& index : vChain)
+        mapBlockIndex[index.GetBlockHash()] = &index;
+    for (CBlockIndex& index : vFork)
+        mapBlockIndex[index.GetBlockHash()] = &index;
+    pindexBestHeader = &vChain.back();
+
+    CBlockIndex* pindexDeep = &vChain[10];
+    CBlockIndex* pindexRecent = &vChain[nChain - 10];
+
+    hashAssumeValid = uint256();
+    BOOST_CHECK(!IsAssumedValid(pindexDeep, params));
+
+    // An assumed valid block we have not seen yet says nothing
+    hashAssumeValid = uint256S("0x01");
+    BOOST_CHECK(!IsAssumedValid(pindexDeep, params));
+
+    hashAssumeValid = vChain.back().GetBlockHash();
+    BOOST_CHECK(IsAssumedValid(pindexDeep, params));
+    BOOST_CHECK(IsAssumedValid(&vChain[nForkHeight], params));
+    // Not buried under two weeks of work
+    BOOST_CHECK(!IsAssumedValid(pindexRecent, params));
+    // Not an ancestor of the assumed valid block
+    BOOST_CHECK(!IsAssumedValid(&vFork[10], params));
+
+    // Assumed valid block on the fork: only the shared blocks are ancestors of both it and the best header
+    hashAssumeValid = vFork.back().GetBlockHash();
+    BOOST_CHECK(IsAssumedValid(pindexDeep, params));
+    BOOST_CHECK(!IsAssumedValid(&vChain[nForkHeight + 11], params));
+    BOOST_CHECK(!IsAssumedValid(&vFork[10], params));
+
+    // The same chain, with less than the minimum chain work in total
+    hashAssumeValid = vChain.back().GetBlockHash();
+    for (CBlockIndex& index : vChain)
+        index.nChainWork -= UintToArith256(params.nMinimumChainWork);
+    BOOST_CHECK(vChain.back().nChainWork < UintToArith256(params.nMinimumChainWork));
+    BOOST_CHECK(!IsAssumedValid(pindexDeep, params));
+
+    for (CBlockIndex& index : vChain)
+        mapBlockIndex.erase(index.GetBlockHash());
+    for (CBlockIndex& index : vFork)
+        mapBlockIndex.erase(index.GetBlockHash());
+    pindexBestHeader = pindexBestHeaderOld;
+    hashAssumeValid = hashAssumeValidOld;
+}
+
+BOOST_AUTO_TEST_CASE(block_download_reassignment)
+{
+    const int64_t nFast = 100000, nSlow = 1000000;
+
+    // Peers that have not delivered anything keep the default window
+    BOOST_CHECK_EQUAL(GetBlocksInTransitLimit(0), DEFAULT_BLOCKS_IN_TRANSIT_PER_PEER);
+    // otherwise it covers BLOCK_DOWNLOAD_QUEUE_TIME seconds of deliveries, within bounds
+    BOOST_CHECK_EQUAL(GetBlocksInTransitLimit(nFast), 1000000 * (int)BLOCK_DOWNLOAD_QUEUE_TIME / nFast);
+    BOOST_CHECK_EQUAL(GetBlocksInTransitLimit(1), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+    BOOST_CHECK_EQUAL(GetBlocksInTransitLimit(60 * nSlow), MIN_BLOCKS_IN_TRANSIT_PER_PEER);
+
+    BOOST_CHECK_EQUAL(UpdateBlockDeliveryTime(0, nSlow), nSlow);
+    BOOST_CHECK_EQUAL(UpdateBlockDeliveryTime(0, 0), 1);
+    BOOST_CHECK_EQUAL(UpdateBlockDeliveryTime(nSlow, nSlow + 8), nSlow + 1);
+
+    // A faster peer takes over a block once it has waited BLOCK_REASSIGN_FACTOR of its deliveries
+    const int64_t nWait = BLOCK_REASSIGN_FACTOR * nFast;
+    BOOST_CHECK(!ShouldReassignBlock(nWait, nFast, nSlow));
+    BOOST_CHECK(ShouldReassignBlock(nWait + 1, nFast, nSlow));
+    BOOST_CHECK(ShouldReassignBlock(nWait + 1, nFast, 0));
+    // but not from a peer that is as fast, nor without having delivered anything itself
+    BOOST_CHECK(!ShouldReassignBlock(nWait + 1, nFast, nFast));
+    BOOST_CHECK(!ShouldReassignBlock(nWait + 1, nSlow, nFast));
+    BOOST_CHECK(!ShouldReassignBlock(100 * nSlow, 0, nSlow));
+
+    // Counting the wait against the slow peer shrinks its window
+    int64_t nStaller = nSlow;
+    int nLimit = GetBlocksInTransitLimit(nStaller);
+    for (int i = 0; i < 10; i++) {
+        nStaller = UpdateBlockDeliveryTime(nStaller, 10 * nSlow);
+        BOOST_CHECK(GetBlocksInTransitLimit(nStaller) <= nLimit);
+        nLimit = GetBlocksInTransitLimit(nStaller);
+    }
+    BOOST_CHECK_EQUAL(nLimit, MIN_BLOCKS_IN_TRANSIT_PER_PEER);
+}
+
+BOOST_AUTO_TEST_CASE(block_import_pipeline_order)
+{
+    const CChainParams& chainparams = Params();
+    const int nBlocks = 200;
+
+    // Some junk before the first block, then block records with a record that does not parse in between
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << FLATDATA("junk");
+    std::vector<uint64_t> vPos;
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < nBlocks; i++) {
+        if (i == nBlocks / 2) {
+            std::vector<unsigned char> vGarbage(100, 0xff);
+            ss << FLATDATA(chainparams.MessageStart()) << (unsigned int)vGarbage.size();
+            ss.write((const char*)vGarbage.data(), vGarbage.size());
+        }
+        CBlock block;
+        block.nVersion = 4;
+        block.nTime = i;
+        block.nNonce = ArithToUint256(arith_uint256(i));
+        ss << FLATDATA(chainparams.MessageStart()) << (unsigned int)::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        vPos.push_back(ss.size());
+        vHashes.push_back(block.GetHash());
+        ss << block;
+    }
+
+    FILE* file = tmpfile();
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(ss.data(), 1, ss.size(), file), ss.size());
+    rewind(file);
+
+    // The workers finish in any order, but the records come out in file order
+    CBlockImportPipeline pipeline(file, chainparams, 4);
+    std::shared_ptr<CImportBlock> record;
+    int nBlock = 0;
+    bool fGarbage = false;
+    while (pipeline.Next(record)) {
+        BOOST_REQUIRE(record->fParsed);
+        BOOST_CHECK(!record->data);
+        if (!record->pblock) {
+            BOOST_CHECK(!fGarbage);
+            BOOST_CHECK_EQUAL(nBlock, nBlocks / 2);
+            fGarbage = true;
+            continue;
+        }
+        BOOST_REQUIRE(nBlock < nBlocks);
+        BOOST_CHECK_EQUAL(record->nPos, vPos[nBlock]);
+        BOOST_CHECK(record->pblock->GetHash() == vHashes[nBlock]);
+        // No valid Equihash solution, so the precheck must not pass
+        BOOST_CHECK(!record->pblock->fChecked);
+        nBlock++;
+    }
+    BOOST_CHECK(fGarbage);
+    BOOST_CHECK_EQUAL(nBlock, nBlocks);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
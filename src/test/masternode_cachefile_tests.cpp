@@ -0,0 +1,86 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-cachefile.h"
+
+#include "test/test_bitcoin.h"
+
+#include <map>
+#include <stdio.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternode_cachefile_tests, TestingSetup)
+
+namespace
+{
+class TestCacheFile : public CMasternodeCacheFile
+{
+public:
+    TestCacheFile(const std::string& strMagic) : CMasternodeCacheFile("testcache.dat", strMagic) {}
+
+    bool Write(const std::map<int, std::string>& mapObj) { return WriteObject(mapObj); }
+
+    ReadResult Read(std::map<int, std::string>& mapObj)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ReadResult result = ReadStream(ss);
+        if (result == Ok)
+            ss >> mapObj;
+        return result;
+    }
+
+    const boost::filesystem::path& GetPath() const { return pathDB; }
+};
+} // namespace
+
+BOOST_AUTO_TEST_CASE(write_verify_read)
+{
+    TestCacheFile db("TestCache");
+    BOOST_CHECK_EQUAL(db.Verify(), CMasternodeCacheFile::FileError);
+
+    std::map<int, std::string> mapIn;
+    for (int i = 0; i < 1000; i++)
+        mapIn[i] = std::string(i % 50, 'x');
+    BOOST_CHECK(db.Write(mapIn));
+    BOOST_CHECK(!boost::filesystem::exists(db.GetPath().string() + ".new"));
+    BOOST_CHECK_EQUAL(db.Verify(), CMasternodeCacheFile::Ok);
+
+    std::map<int, std::string> mapOut;
+    BOOST_CHECK_EQUAL(db.Read(mapOut), CMasternodeCacheFile::Ok);
+    BOOST_CHECK(mapIn == mapOut);
+
+    // The same file under a different magic message is rejected by both paths
+    TestCacheFile dbOther("OtherCache");
+    BOOST_CHECK_EQUAL(dbOther.Verify(), CMasternodeCacheFile::IncorrectMagicMessage);
+    BOOST_CHECK_EQUAL(dbOther.Read(mapOut), CMasternodeCacheFile::IncorrectMagicMessage);
+}
+
+BOOST_AUTO_TEST_CASE(corrupted_file)
+{
+    TestCacheFile db("TestCache");
+    std::map<int, std::string> mapIn;
+    mapIn[1] = "one";
+    mapIn[2] = "two";
+    BOOST_CHECK(db.Write(mapIn));
+
+    // Flip a byte of the payload
+    FILE* file = fopen(db.GetPath().string().c_str(), "r+b");
+    BOOST_REQUIRE(file);
+    fseek(file, 20, SEEK_SET);
+    int c = fgetc(file);
+    fseek(file, 20, SEEK_SET);
+    fputc(c ^ 0xff, file);
+    fclose(file);
+
+    std::map<int, std::string> mapOut;
+    BOOST_CHECK_EQUAL(db.Verify(), CMasternodeCacheFile::IncorrectHash);
+    BOOST_CHECK_EQUAL(db.Read(mapOut), CMasternodeCacheFile::IncorrectHash);
+
+    // A truncated file cannot even provide a checksum
+    boost::filesystem::resize_file(db.GetPath(), 10);
+    BOOST_CHECK_EQUAL(db.Verify(), CMasternodeCacheFile::HashReadError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
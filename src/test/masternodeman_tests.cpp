@@ -0,0 +1,150 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "main.h"
+#include "masternodeman.h"
+#include "net.h"
+#include "primitives/transaction.h"
+#include "streams.h"
+#include "timedata.h"
+#include "version.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternodeman_tests, BasicTestingSetup)
+
+static CTransaction Spending(const COutPoint& outpoint)
+{
+    CMutableTransaction mtx;
+    mtx.vin.push_back(CTxIn(outpoint));
+    return CTransaction(mtx);
+}
+
+BOOST_AUTO_TEST_CASE(collateral_index)
+{
+    CMasternodeMan man;
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(uint256S("0x01"), 0));
+    BOOST_CHECK(man.Add(mn));
+
+    COutPoint other(uint256S("0x01"), 1);
+    man.CheckSpentCollaterals(Spending(other));
+    BOOST_CHECK(!man.IsCollateralSpent(mn.vin.prevout));
+    BOOST_CHECK(!man.IsCollateralSpent(other));
+
+    std::vector<CTransaction> vtx{Spending(other), Spending(mn.vin.prevout)};
+    man.CheckSpentCollaterals(vtx);
+    BOOST_CHECK(man.IsCollateralSpent(mn.vin.prevout));
+
+    // A disconnected block gives the collateral back
+    man.RestoreSpentCollaterals(vtx);
+    BOOST_CHECK(!man.IsCollateralSpent(mn.vin.prevout));
+
+    // Removed masternodes are no longer tracked
+    man.CheckSpentCollaterals(vtx);
+    man.Remove(mn.vin);
+    BOOST_CHECK(!man.IsCollateralSpent(mn.vin.prevout));
+    man.CheckSpentCollaterals(vtx);
+    BOOST_CHECK(!man.IsCollateralSpent(mn.vin.prevout));
+}
+
+BOOST_AUTO_TEST_CASE(published_snapshot)
+{
+    CMasternodeMan man;
+    CMasternodeMan::Snapshot empty = man.GetSnapshot();
+    BOOST_CHECK(empty && empty->empty());
+
+    // Changes only show once the writer side publishes them
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(uint256S("0x01"), 0));
+    BOOST_CHECK(man.Add(mn));
+    BOOST_CHECK(man.GetSnapshot() == empty);
+
+    man.UpdateSnapshot();
+    CMasternodeMan::Snapshot first = man.GetSnapshot();
+    BOOST_CHECK(first != empty);
+    BOOST_CHECK(empty->empty());
+    BOOST_REQUIRE_EQUAL(first->size(), 1U);
+    BOOST_CHECK((*first)[0].vin == mn.vin);
+    // Entries are checked before they are published
+    BOOST_CHECK_EQUAL((*first)[0].activeState, CMasternode::MASTERNODE_REMOVE);
+
+    // An unchanged list is not copied again
+    man.UpdateSnapshot();
+    BOOST_CHECK(man.GetSnapshot() == first);
+
+    // A removal bumps the version, so the next update publishes at once
+    man.Remove(mn.vin);
+    BOOST_CHECK(man.GetSnapshot() == first);
+    man.UpdateSnapshot();
+    CMasternodeMan::Snapshot second = man.GetSnapshot();
+    BOOST_CHECK(second != first);
+    BOOST_CHECK(second->empty());
+    BOOST_CHECK_EQUAL(first->size(), 1U);
+}
+
+static CDataStream BroadcastList(unsigned int nEntries, int64_t nTime, int nProtocolVersion = 0)
+{
+    std::vector<CMasternodeBroadcast> vMnb(nEntries);
+    for (unsigned int i = 0; i < nEntries; i++) {
+        vMnb[i].vin = CTxIn(COutPoint(ArithToUint256(arith_uint256(i + 1)), 0));
+        vMnb[i].sigTime = nTime - i;
+        // Outdated by default, so the entries are dropped without scoring the peer
+        vMnb[i].protocolVersion = nProtocolVersion;
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << vMnb;
+    return ss;
+}
+
+static int Misbehavior(const CNode& node)
+{
+    CNodeStateStats stats;
+    BOOST_REQUIRE(GetNodeStateStats(node.GetId(), stats));
+    return stats.nMisbehavior;
+}
+
+BOOST_FIXTURE_TEST_CASE(broadcast_list, TestingSetup)
+{
+    const int64_t nTime = GetAdjustedTime();
+    CMasternodeMan man;
+    struct in_addr s;
+    s.s_addr = 0xa0b0c001;
+    CNode node(INVALID_SOCKET, CAddress(CService(CNetAddr(s), Params().GetDefaultPort())), "", true);
+    node.nVersion = PROTOCOL_VERSION;
+
+    // Lists we did not ask for are not even read
+    CDataStream unrequested = BroadcastList(3, nTime);
+    man.ProcessBroadcastList(&node, unrequested);
+    BOOST_CHECK_EQUAL(man.mapSeenMasternodeBroadcast.size(), 0U);
+    BOOST_CHECK(!unrequested.empty());
+    BOOST_CHECK_EQUAL(Misbehavior(node), 0);
+
+    man.DsegUpdate(&node);
+
+    // Oversized batches score the peer and are dropped
+    CDataStream oversized = BroadcastList(MASTERNODE_LIST_BATCH_SIZE + 1, nTime);
+    man.ProcessBroadcastList(&node, oversized);
+    BOOST_CHECK_EQUAL(man.mapSeenMasternodeBroadcast.size(), 0U);
+    BOOST_CHECK_EQUAL(Misbehavior(node), 20);
+
+    // Every entry of a full batch goes through the broadcast checks
+    CDataStream full = BroadcastList(MASTERNODE_LIST_BATCH_SIZE, nTime);
+    man.ProcessBroadcastList(&node, full);
+    BOOST_CHECK(full.empty());
+    BOOST_CHECK_EQUAL(man.mapSeenMasternodeBroadcast.size(), MASTERNODE_LIST_BATCH_SIZE);
+    BOOST_CHECK_EQUAL(Misbehavior(node), 20);
+
+    // and entries already seen are skipped when they come again, so their bad signatures are not checked
+    CDataStream again = BroadcastList(MASTERNODE_LIST_BATCH_SIZE, nTime, PROTOCOL_VERSION);
+    man.ProcessBroadcastList(&node, again);
+    BOOST_CHECK_EQUAL(man.mapSeenMasternodeBroadcast.size(), MASTERNODE_LIST_BATCH_SIZE);
+    BOOST_CHECK_EQUAL(Misbehavior(node), 20);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,85 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "hash.h"
+#include "primitives/block.h"
+#include "test/test_bitcoin.h"
+#include "uint256.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(merkle_tests, BasicTestingSetup)
+
+// Older version of the merkle root computation, hashing one pair at a time.
+static uint256 BlockBuildMerkleTree(const CBlock& block, bool* fMutated, std::vector<uint256>& vMerkleTree)
+{
+    vMerkleTree.clear();
+    vMerkleTree.reserve(block.vtx.size() * 2 + 16); // Safe upper bound for the number of total nodes.
+    for (std::vector<CTransaction>::const_iterator it(block.vtx.begin()); it != block.vtx.end(); ++it)
+        vMerkleTree.push_back(it->GetHash());
+    int j = 0;
+    bool mutated = false;
+    for (int nSize = block.vtx.size(); nSize > 1; nSize = (nSize + 1) / 2) {
+        for (int i = 0; i < nSize; i += 2) {
+            int i2 = std::min(i + 1, nSize - 1);
+            if (i2 == i + 1 && i2 + 1 == nSize && vMerkleTree[j + i] == vMerkleTree[j + i2]) {
+                // Two identical hashes at the end of the list at a particular level.
+                mutated = true;
+            }
+            vMerkleTree.push_back(Hash(vMerkleTree[j + i].begin(), vMerkleTree[j + i].end(),
+                                       vMerkleTree[j + i2].begin(), vMerkleTree[j + i2].end()));
+        }
+        j += nSize;
+    }
+    if (fMutated) {
+        *fMutated = mutated;
+    }
+    return (vMerkleTree.empty() ? uint256() : vMerkleTree.back());
+}
+
+BOOST_AUTO_TEST_CASE(merkle_test)
+{
+    // Sizes around the multi-lane kernel widths, and large enough to be split across threads.
+    static const unsigned int nTxCounts[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 100, 4095, 8192, 8193, 20001};
+
+    for (unsigned int nTx : nTxCounts) {
+        for (int mutate = 0; mutate < 3; mutate++) {
+            CBlock block;
+            for (unsigned int j = 0; j < nTx; j++) {
+                CMutableTransaction tx;
+                tx.nLockTime = j; // actual transaction data doesn't matter; just make the nLockTime's unique
+                block.vtx.push_back(CTransaction(tx));
+            }
+            if (mutate == 1 && nTx > 1) {
+                // Duplicate the last transaction at the end: the root is unchanged but must be flagged.
+                if (nTx % 2 == 1)
+                    block.vtx.push_back(block.vtx.back());
+            } else if (mutate == 2 && nTx > 1) {
+                // Duplicate a transaction somewhere else: not a CVE-2012-2459 mutation.
+                block.vtx[0] = block.vtx[nTx / 2];
+            }
+
+            std::vector<uint256> vMerkleTreeOld;
+            bool fMutatedOld = false, fMutatedNew = false;
+            uint256 rootOld = BlockBuildMerkleTree(block, &fMutatedOld, vMerkleTreeOld);
+            uint256 rootNew = block.BuildMerkleTree(&fMutatedNew);
+            BOOST_CHECK(rootOld == rootNew);
+            BOOST_CHECK_EQUAL(fMutatedOld, fMutatedNew);
+            BOOST_CHECK(vMerkleTreeOld == block.vMerkleTree);
+            if (mutate == 1 && nTx > 1 && nTx % 2 == 1) {
+                BOOST_CHECK(fMutatedNew);
+            }
+
+            // Branches taken from the new tree still lead to the root.
+            for (unsigned int i = 0; i < block.vtx.size(); i += 1 + block.vtx.size() / 8) {
+                std::vector<uint256> branch = block.GetMerkleBranch(i);
+                BOOST_CHECK(CBlock::CheckMerkleBranch(block.vtx[i].GetHash(), branch, i) == rootNew);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
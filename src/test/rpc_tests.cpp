@@ -12,6 +12,8 @@
 #include "test/test_bitcoin.h"
 #include "test/test_util.h"
 
+#include <thread>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
 
@@ -312,4 +314,47 @@ BOOST_AUTO_TEST_CASE(rpc_getnetworksolps)
     BOOST_CHECK_NO_THROW(CallRPC("getnetworksolps 120 -1"));
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch_parallel)
+{
+    // Read-only calls around a call that is not, which must run in order
+    UniValue vReq(UniValue::VARR);
+    for (int i = 1; i <= 16; i++) {
+        UniValue req(UniValue::VOBJ);
+        req.push_back(Pair("id", i));
+        if (i == 8) {
+            req.push_back(Pair("method", "nonexistentmethod"));
+        } else {
+            req.push_back(Pair("method", "decodescript"));
+            UniValue params(UniValue::VARR);
+            params.push_back(HexStr(CScript() << i));
+            req.push_back(Pair("params", params));
+        }
+        vReq.push_back(req);
+    }
+
+    std::vector<std::thread> threads;
+    RPCTaskDispatcher dispatch = [&threads](const std::function<void()>& func) {
+        threads.emplace_back(func);
+        return true;
+    };
+    std::string strParallel = JSONRPCExecBatch(vReq, dispatch, 4);
+    for (std::thread& thread : threads)
+        thread.join();
+    BOOST_CHECK(!threads.empty());
+    BOOST_CHECK_EQUAL(strParallel, JSONRPCExecBatch(vReq));
+
+    UniValue results;
+    BOOST_CHECK(results.read(strParallel));
+    BOOST_CHECK_EQUAL(results.size(), 16U);
+    for (int i = 1; i <= 16; i++) {
+        const UniValue& result = results[i - 1];
+        BOOST_CHECK_EQUAL(find_value(result, "id").get_int(), i);
+        if (i == 8) {
+            BOOST_CHECK(!find_value(result, "error").isNull());
+        } else {
+            BOOST_CHECK_EQUAL(find_value(find_value(result, "result"), "asm").get_str(), std::to_string(i));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
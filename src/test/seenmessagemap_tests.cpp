@@ -0,0 +1,285 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "seenmessagemap.h"
+#include "arith_uint256.h"
+#include "masternode-payments.h"
+#include "masternode-seendb.h"
+#include "streams.h"
+#include "version.h"
+
+#include "test/test_bitcoin.h"
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(seenmessagemap_tests, BasicTestingSetup)
+
+namespace
+{
+struct TestMessage {
+    int64_t nTime;
+    int nPayload;
+
+    TestMessage() : nTime(0), nPayload(0) {}
+    TestMessage(int64_t nTimeIn, int nPayloadIn) : nTime(nTimeIn), nPayload(nPayloadIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nTime);
+        READWRITE(nPayload);
+    }
+};
+
+struct TestMessageTime {
+    int64_t operator()(const TestMessage& msg) const { return msg.nTime; }
+};
+
+typedef seenmessagemap<TestMessage, TestMessageTime> TestMap;
+
+uint256 HashOf(int n)
+{
+    return ArithToUint256(arith_uint256(n + 1));
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(insert_and_evict_oldest)
+{
+    TestMap map(3);
+    BOOST_CHECK(map.insert(std::make_pair(HashOf(0), TestMessage(100, 0))));
+    BOOST_CHECK(!map.insert(std::make_pair(HashOf(0), TestMessage(500, 9))));
+    BOOST_CHECK_EQUAL(map.at(HashOf(0)).nPayload, 0);
+
+    map.insert(std::make_pair(HashOf(1), TestMessage(50, 1)));
+    map.insert(std::make_pair(HashOf(2), TestMessage(200, 2)));
+    BOOST_CHECK_EQUAL(map.size(), 3U);
+
+    // Full: the entry with the oldest timestamp goes, not the first inserted
+    map.insert(std::make_pair(HashOf(3), TestMessage(300, 3)));
+    BOOST_CHECK_EQUAL(map.size(), 3U);
+    BOOST_CHECK(!map.count(HashOf(1)));
+    BOOST_CHECK(map.count(HashOf(0)));
+    BOOST_CHECK(map.DynamicMemoryUsage() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(expire_and_modify)
+{
+    TestMap map(100);
+    for (int i = 0; i < 10; i++)
+        map.insert(std::make_pair(HashOf(i), TestMessage(i * 10, i)));
+
+    // Moving an entry forward in time keeps it from expiring
+    BOOST_CHECK(map.modify(HashOf(2), [](TestMessage& msg) { msg.nTime = 1000; }));
+    BOOST_CHECK(!map.modify(HashOf(42), [](TestMessage& msg) { msg.nTime = 1000; }));
+
+    std::vector<uint256> vErased;
+    BOOST_CHECK_EQUAL(map.erase_older_than(50, &vErased), 4U);
+    BOOST_CHECK_EQUAL(vErased.size(), 4U);
+    BOOST_CHECK_EQUAL(map.size(), 6U);
+    BOOST_CHECK(map.count(HashOf(2)));
+    BOOST_CHECK(!map.count(HashOf(4)));
+    BOOST_CHECK(map.count(HashOf(5)));
+
+    BOOST_CHECK_EQUAL(map.erase_if([](const TestMessage& msg) { return msg.nPayload % 2 == 1; }), 3U);
+    BOOST_CHECK_EQUAL(map.size(), 3U);
+
+    // Erased entries are gone from the time index as well
+    BOOST_CHECK_EQUAL(map.erase_older_than(2000), 3U);
+    BOOST_CHECK(map.empty());
+
+    map.set(HashOf(7), TestMessage(10, 7));
+    map.set(HashOf(7), TestMessage(20, 8));
+    BOOST_CHECK_EQUAL(map.size(), 1U);
+    BOOST_CHECK_EQUAL(map.erase_older_than(15), 0U);
+    BOOST_CHECK_EQUAL(map.at(HashOf(7)).nPayload, 8);
+}
+
+BOOST_AUTO_TEST_CASE(serializes_like_std_map)
+{
+    TestMap map(100);
+    std::map<uint256, TestMessage> mapStd;
+    for (int i = 0; i < 10; i++) {
+        map.insert(std::make_pair(HashOf(i), TestMessage(1000 - i, i)));
+        mapStd.insert(std::make_pair(HashOf(i), TestMessage(1000 - i, i)));
+    }
+
+    // Cache files written with a std::map can be read back
+    CDataStream ssStd(SER_DISK, CLIENT_VERSION);
+    ssStd << mapStd;
+    TestMap mapFromStd(100);
+    ssStd >> mapFromStd;
+    BOOST_CHECK_EQUAL(mapFromStd.size(), 10U);
+    BOOST_CHECK_EQUAL(mapFromStd.at(HashOf(3)).nTime, 997);
+
+    // and the other way around
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << map;
+    std::map<uint256, TestMessage> mapRead;
+    ss >> mapRead;
+    BOOST_CHECK_EQUAL(mapRead.size(), 10U);
+    BOOST_CHECK_EQUAL(mapRead[HashOf(3)].nPayload, 3);
+
+    // A smaller map keeps the newest entries
+    CDataStream ss2(SER_DISK, CLIENT_VERSION);
+    ss2 << map;
+    TestMap mapSmall(2);
+    ss2 >> mapSmall;
+    BOOST_CHECK_EQUAL(mapSmall.size(), 2U);
+    BOOST_CHECK(mapSmall.count(HashOf(0)));
+    BOOST_CHECK(mapSmall.count(HashOf(1)));
+}
+
+BOOST_AUTO_TEST_CASE(records_changes)
+{
+    TestMap map(3);
+    for (int i = 0; i < 3; i++)
+        map.load(std::make_pair(HashOf(i), TestMessage(100 + i, i)));
+    BOOST_CHECK_EQUAL(map.size(), 3U);
+    BOOST_CHECK(map.changes().empty());
+
+    // Inserting into a full map records the new entry and the evicted one
+    map.insert(std::make_pair(HashOf(3), TestMessage(200, 3)));
+    BOOST_CHECK_EQUAL(map.changes().size(), 2U);
+    BOOST_CHECK(map.changes().count(HashOf(0)));
+    BOOST_CHECK(map.changes().count(HashOf(3)));
+    map.clear_changes();
+
+    map.modify(HashOf(1), [](TestMessage& msg) { msg.nTime = 300; });
+    map.erase(HashOf(2));
+    map.erase(HashOf(42));
+    BOOST_CHECK_EQUAL(map.changes().size(), 2U);
+    BOOST_CHECK(map.changes().count(HashOf(1)));
+    BOOST_CHECK(map.changes().count(HashOf(2)));
+    map.clear_changes();
+
+    map.erase_older_than(250);
+    BOOST_CHECK_EQUAL(map.changes().size(), 1U);
+    BOOST_CHECK(map.changes().count(HashOf(3)));
+    map.clear_changes();
+
+    map.clear();
+    BOOST_CHECK_EQUAL(map.changes().size(), 1U);
+    BOOST_CHECK(map.changes().count(HashOf(1)));
+}
+
+namespace
+{
+struct TestHolder {
+    TestMap map;
+
+    TestHolder() : map(100) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(REF(SeenMapPlaceholder(map)));
+    }
+};
+} // namespace
+
+BOOST_AUTO_TEST_CASE(placeholder_reads_old_maps)
+{
+    TestHolder holder;
+    holder.map.insert(std::make_pair(HashOf(0), TestMessage(100, 0)));
+
+    // Nothing is written in place of the map
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << holder;
+    std::map<uint256, TestMessage> mapRead;
+    ss >> mapRead;
+    BOOST_CHECK(mapRead.empty());
+
+    // but the entries of a file that still has it are added
+    std::map<uint256, TestMessage> mapOld;
+    mapOld.insert(std::make_pair(HashOf(1), TestMessage(200, 1)));
+    CDataStream ssOld(SER_DISK, CLIENT_VERSION);
+    ssOld << mapOld;
+    ssOld >> holder;
+    BOOST_CHECK_EQUAL(holder.map.size(), 2U);
+    BOOST_CHECK(holder.map.changes().count(HashOf(1)));
+}
+
+BOOST_FIXTURE_TEST_CASE(seen_db_writes_changes, TestingSetup)
+{
+    CMasternodeSeenDB db(0, true);
+    TestMap map(100), other(100);
+    for (int i = 0; i < 5; i++) {
+        map.insert(std::make_pair(HashOf(i), TestMessage(100 + i, i)));
+        other.insert(std::make_pair(HashOf(i), TestMessage(100 + i, 10 + i)));
+    }
+    BOOST_CHECK(db.WriteChanges('a', map));
+    BOOST_CHECK(db.WriteChanges('b', other));
+    BOOST_CHECK(map.changes().empty());
+
+    map.erase(HashOf(0));
+    map.modify(HashOf(1), [](TestMessage& msg) { msg.nPayload = 42; });
+    map.insert(std::make_pair(HashOf(5), TestMessage(105, 5)));
+    BOOST_CHECK(db.WriteChanges('a', map));
+
+    TestMap mapLoaded(100);
+    BOOST_CHECK(db.Load('a', mapLoaded));
+    BOOST_CHECK(mapLoaded.changes().empty());
+    BOOST_CHECK_EQUAL(mapLoaded.size(), 5U);
+    BOOST_CHECK(!mapLoaded.count(HashOf(0)));
+    BOOST_CHECK_EQUAL(mapLoaded.at(HashOf(1)).nPayload, 42);
+    BOOST_CHECK_EQUAL(mapLoaded.at(HashOf(5)).nTime, 105);
+
+    // Other maps are left alone
+    TestMap otherLoaded(100);
+    BOOST_CHECK(db.Load('b', otherLoaded));
+    BOOST_CHECK_EQUAL(otherLoaded.size(), 5U);
+    BOOST_CHECK_EQUAL(otherLoaded.at(HashOf(0)).nPayload, 10);
+}
+
+BOOST_FIXTURE_TEST_CASE(winners_kept_in_seen_db, TestingSetup)
+{
+    const CScript payeeA = CScript() << OP_TRUE;
+    const CScript payeeB = CScript() << OP_FALSE;
+    std::map<uint256, CMasternodePaymentWinner> mapWinners;
+    for (int i = 0; i < 3; i++) {
+        CMasternodePaymentWinner winner(CTxIn(COutPoint(HashOf(i), 0)));
+        winner.nBlockHeight = 100;
+        winner.AddPayee(i < 2 ? payeeA : payeeB);
+        mapWinners.insert(std::make_pair(winner.GetHash(), winner));
+    }
+
+    // An mnpayments.dat written before the winners moved out carries them
+    CDataStream ssOld(SER_DISK, CLIENT_VERSION);
+    ssOld << mapWinners << std::map<int, CMasternodeBlockPayees>();
+    CMasternodePayments payments;
+    ssOld >> payments;
+    CScript payee;
+    BOOST_CHECK(payments.GetBlockPayee(100, payee));
+    BOOST_CHECK(payee == payeeA);
+
+    CMasternodeSeenDB db(0, true);
+    BOOST_CHECK(payments.WriteWinnerChanges(db));
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << payments;
+
+    // The payees per block are recounted from the winners in the database
+    CMasternodePayments reloaded;
+    BOOST_CHECK(reloaded.LoadWinners(db));
+    ss >> reloaded;
+    BOOST_CHECK_EQUAL(reloaded.mapMasternodePayeeVotes.size(), 3U);
+    BOOST_CHECK(reloaded.GetBlockPayee(100, payee));
+    BOOST_CHECK(payee == payeeA);
+    BOOST_CHECK(reloaded.mapMasternodeBlocks[100].HasPayeeWithVotes(payeeA, 2));
+    BOOST_CHECK(!reloaded.mapMasternodeBlocks[100].HasPayeeWithVotes(payeeA, 3));
+
+    // and cleared winners are erased
+    reloaded.Clear();
+    BOOST_CHECK(reloaded.WriteWinnerChanges(db));
+    CMasternodePayments reloaded2;
+    BOOST_CHECK(reloaded2.LoadWinners(db));
+    BOOST_CHECK(reloaded2.mapMasternodePayeeVotes.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "snapshot.h"
+
+#include "main.h"
+#include "random.h"
+#include "script/standard.h"
+#include "test/test_bitcoin.h"
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(snapshot_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(snapshot_dump_and_load)
+{
+    // A coin paying a P2PKH address, in the chain state at genesis
+    uint160 hashAddress = uint160(std::vector<unsigned char>(20, 0x42));
+    CScript script = GetScriptForDestination(CKeyID(hashAddress));
+    uint256 txid = GetRandHash();
+    {
+        LOCK(cs_main);
+        CCoinsModifier coins = pcoinsTip->ModifyCoins(txid);
+        coins->nVersion = 1;
+        coins->nHeight = 0;
+        coins->vout.push_back(CTxOut(5000, script));
+    }
+    FlushStateToDisk();
+
+    fs::path path = pathTemp / "utxo.dat";
+    CSnapshotMetadata metadata;
+    uint256 hashSnapshot;
+    uint64_t nEntries = 0;
+    std::string strError;
+    BOOST_CHECK(DumpUTXOSnapshot(path, metadata, hashSnapshot, nEntries, strError));
+    BOOST_CHECK(fs::exists(path));
+    BOOST_CHECK(!fs::exists(path.string() + ".incomplete"));
+    BOOST_CHECK(metadata.hashBlock == Params().GetConsensus().hashGenesisBlock);
+    BOOST_CHECK_EQUAL(metadata.nHeight, 0);
+    BOOST_CHECK(nEntries > 0);
+
+    // An existing file is never overwritten
+    uint256 hashOther;
+    BOOST_CHECK(!DumpUTXOSnapshot(path, metadata, hashOther, nEntries, strError));
+
+    // Spend the coin, so that only the snapshot has it
+    {
+        LOCK(cs_main);
+        pcoinsTip->ModifyCoins(txid)->Clear();
+    }
+    FlushStateToDisk();
+    BOOST_CHECK(!pcoinsTip->HaveCoins(txid));
+
+    // A snapshot with an unexpected hash leaves the chain state alone
+    CSnapshotMetadata metadataLoaded;
+    uint64_t nLoaded = 0;
+    BOOST_CHECK(!LoadUTXOSnapshot(path, GetRandHash(), metadataLoaded, nLoaded, strError));
+    BOOST_CHECK(!pcoinsTip->HaveCoins(txid));
+
+    BOOST_CHECK(LoadUTXOSnapshot(path, hashSnapshot, metadataLoaded, nLoaded, strError));
+    BOOST_CHECK_EQUAL(nLoaded, nEntries);
+    BOOST_CHECK(metadataLoaded.hashBlock == metadata.hashBlock);
+    BOOST_CHECK(!fLoadingSnapshot);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->HaveCoins(txid));
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == metadata.hashBlock);
+    }
+
+    CSnapshotMetadata metadataBase;
+    BOOST_CHECK(pblocktree->ReadSnapshotBase(metadataBase));
+    BOOST_CHECK(metadataBase.hashBlock == metadata.hashBlock);
+
+    // The address index has the coin as unspent
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspent;
+    BOOST_CHECK(GetAddressUnspent(hashAddress, 1, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), 1);
+    BOOST_CHECK(unspent[0].first.txhash == txid);
+    BOOST_CHECK_EQUAL(unspent[0].first.index, 0);
+    BOOST_CHECK_EQUAL(unspent[0].second.satoshis, 5000);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_corrupt)
+{
+    fs::path path = pathTemp / "utxo.dat";
+    CSnapshotMetadata metadata;
+    uint256 hashSnapshot;
+    uint64_t nEntries = 0;
+    std::string strError;
+    BOOST_CHECK(DumpUTXOSnapshot(path, metadata, hashSnapshot, nEntries, strError));
+
+    // Flip a byte of the last entry
+    {
+        FILE* file = fsbridge::fopen(path, "rb+");
+        BOOST_REQUIRE(file != NULL);
+        BOOST_CHECK_EQUAL(fseek(file, -40, SEEK_END), 0);
+        int ch = fgetc(file);
+        BOOST_CHECK_EQUAL(fseek(file, -40, SEEK_END), 0);
+        fputc(ch ^ 1, file);
+        fclose(file);
+    }
+
+    BOOST_CHECK(!LoadUTXOSnapshot(path, hashSnapshot, metadata, nEntries, strError));
+    BOOST_CHECK(strError.find("corrupt") != std::string::npos);
+    BOOST_CHECK(!fLoadingSnapshot);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,11 +7,14 @@
 #include "test_bitcoin.h"
 
 #include "crypto/common.h"
+#include "crypto/sha256.h"
 #include "key.h"
 #include "main.h"
+#include "proofcache.h"
 #include "random.h"
 #include "rpc/register.h"
 #include "rpc/server.h"
+#include "script/sigcache.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -64,8 +67,11 @@ JoinSplitTestingSetup::~JoinSplitTestingSetup()
 BasicTestingSetup::BasicTestingSetup()
 {
     assert(sodium_init() != -1);
+    SHA256AutoDetect();
     ECC_Start();
     SetupEnvironment();
+    InitSignatureCache();
+    InitProofCache();
     fPrintToDebugLog = false; // don't want to write to debug.log file
     fCheckBlockIndex = true;
     SelectParams(CBaseChainParams::MAIN);
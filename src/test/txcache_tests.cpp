@@ -0,0 +1,106 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txcache.h"
+
+#include "random.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txcache_tests, BasicTestingSetup)
+
+static CTransaction MakeTransaction(uint32_t n)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout.hash = GetRandHash();
+    mtx.vin[0].prevout.n = n;
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = n;
+    return mtx;
+}
+
+BOOST_AUTO_TEST_CASE(txcache_get_add_erase)
+{
+    CTxLookupCache cache(1 << 20);
+    CTransaction tx = MakeTransaction(1);
+    uint256 hashBlock = GetRandHash();
+
+    CTransaction txOut;
+    uint256 hashBlockOut;
+    BOOST_CHECK(!cache.Get(tx.GetHash(), txOut, hashBlockOut));
+
+    cache.Add(tx, hashBlock);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK(cache.Get(tx.GetHash(), txOut, hashBlockOut));
+    BOOST_CHECK(txOut == tx);
+    BOOST_CHECK(hashBlockOut == hashBlock);
+
+    // Adding again replaces the block hash without growing the cache
+    uint256 hashBlock2 = GetRandHash();
+    cache.Add(tx, hashBlock2);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK(cache.Get(tx.GetHash(), txOut, hashBlockOut));
+    BOOST_CHECK(hashBlockOut == hashBlock2);
+
+    cache.Erase(tx.GetHash());
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(!cache.Get(tx.GetHash(), txOut, hashBlockOut));
+}
+
+BOOST_AUTO_TEST_CASE(txcache_lru_eviction)
+{
+    CTxLookupCache cache(1 << 20);
+    std::vector<CTransaction> vtx;
+    for (uint32_t i = 0; i < 3; i++) {
+        vtx.push_back(MakeTransaction(i));
+        cache.Add(vtx.back(), uint256());
+    }
+    size_t nEntryUsage = cache.DynamicMemoryUsage() / 3;
+
+    // Touch the oldest entry, so that the second one is evicted first
+    CTransaction txOut;
+    uint256 hashBlockOut;
+    BOOST_CHECK(cache.Get(vtx[0].GetHash(), txOut, hashBlockOut));
+
+    cache.SetMaxUsage(2 * nEntryUsage);
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+    BOOST_CHECK(cache.Get(vtx[0].GetHash(), txOut, hashBlockOut));
+    BOOST_CHECK(!cache.Get(vtx[1].GetHash(), txOut, hashBlockOut));
+    BOOST_CHECK(cache.Get(vtx[2].GetHash(), txOut, hashBlockOut));
+
+    // A disabled cache stores nothing
+    cache.SetMaxUsage(0);
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    cache.Add(vtx[0], uint256());
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(txcache_disconnect_count)
+{
+    CTxLookupCache cache(1 << 20);
+    CTransaction tx = MakeTransaction(1);
+    CTransaction tx2 = MakeTransaction(2);
+    uint256 hashBlock = GetRandHash();
+
+    // An index read that started before a disconnect is not cached
+    uint64_t nDisconnects = cache.GetDisconnectCount();
+    cache.Add(tx, hashBlock);
+    cache.EraseBlock(std::vector<CTransaction>(1, tx));
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    BOOST_CHECK(!cache.Add(tx2, hashBlock, nDisconnects));
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+
+    // one that started after it is
+    nDisconnects = cache.GetDisconnectCount();
+    BOOST_CHECK(cache.Add(tx2, hashBlock, nDisconnects));
+    CTransaction txOut;
+    uint256 hashBlockOut;
+    BOOST_CHECK(cache.Get(tx2.GetHash(), txOut, hashBlockOut));
+    BOOST_CHECK(hashBlockOut == hashBlock);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,7 @@
 #include "sync.h"
 #include "test/test_bitcoin.h"
 #include "test_random.h"
+#include "util/parallel.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
 
@@ -486,4 +487,25 @@ BOOST_AUTO_TEST_CASE(test_ParseFixedPoint)
     BOOST_CHECK(!ParseFixedPoint("1.", 8, &amount));
 }
 
+BOOST_AUTO_TEST_CASE(test_ParallelFor)
+{
+    // Every job runs exactly once, whatever the thread count
+    for (size_t nThreads : {0, 1, 3, 16}) {
+        std::vector<std::atomic<int>> runs(100);
+        util::ParallelFor(runs.size(), nThreads, [&](size_t i) { runs[i]++; });
+        for (const std::atomic<int>& n : runs)
+            BOOST_CHECK_EQUAL(n, 1);
+    }
+
+    // The first exception comes back to the caller once all threads joined
+    std::atomic<size_t> nRun(0);
+    BOOST_CHECK_THROW(util::ParallelFor(100, 4, [&](size_t i) {
+        nRun++;
+        if (i == 10)
+            throw std::runtime_error("job failed");
+    }), std::runtime_error);
+    BOOST_CHECK(nRun <= 100);
+    BOOST_CHECK(nRun > 10);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
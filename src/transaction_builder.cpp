@@ -9,8 +9,13 @@
 #include "proof_verifier.h"
 #include "rpc/protocol.h"
 #include "script/sign.h"
+#include "util/parallel.h"
 #include "utilmoneystr.h"
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+
 #include <boost/variant.hpp>
 #include <librustzcash.h>
 
@@ -25,7 +30,42 @@ SpendDescriptionInfo::SpendDescriptionInfo(
     librustzcash_sapling_generate_r(alpha.begin());
 }
 
-std::optional<OutputDescription> OutputDescriptionInfo::Build(void* ctx) {
+namespace
+{
+/**
+ * Maximum number of Sapling proofs of one transaction created at once.
+ * bellman already runs the multiexponentiations of every proof on its own
+ * pool of one thread per core; only circuit synthesis runs on the calling
+ * thread, so a few concurrent proofs keep the pool busy and more would only
+ * compete for it.
+ */
+const size_t SAPLING_PROOF_MAX_THREADS = 4;
+
+/**
+ * Run job(0) to job(nJobs - 1) on up to half the cores, at most
+ * SAPLING_PROOF_MAX_THREADS, and return the lowest index of a job that
+ * failed, or nJobs if none did. Jobs not yet started are skipped after a
+ * failure. An exception thrown by a job is rethrown once all threads are done.
+ */
+size_t RunProofJobs(size_t nJobs, const std::function<bool(size_t)>& job)
+{
+    std::atomic<bool> fFailed(false);
+    size_t nFailed = nJobs;
+    std::mutex csFailed;
+
+    size_t nThreads = std::min<size_t>(std::max(GetNumCores() / 2, 1), SAPLING_PROOF_MAX_THREADS);
+    util::ParallelFor(nJobs, nThreads, [&](size_t i) {
+        if (fFailed || job(i))
+            return;
+        std::lock_guard<std::mutex> lock(csFailed);
+        nFailed = std::min(nFailed, i);
+        fFailed = true;
+    });
+    return nFailed;
+}
+} // namespace
+
+std::optional<OutputDescription> OutputDescriptionInfo::Build(const uint256& rcv) {
     auto cmu = this->note.cmu();
     if (!cmu) {
         return std::nullopt;
@@ -47,12 +87,12 @@ std::optional<OutputDescription> OutputDescriptionInfo::Build(void* ctx) {
 
     OutputDescription odesc;
     uint256 rcm = this->note.rcm();
-    if (!librustzcash_sapling_output_proof(
-            ctx,
+    if (!librustzcash_sapling_output_proof_rcv(
             encryptor.get_esk().begin(),
             addressBytes.data(),
             rcm.begin(),
             this->note.value(),
+            rcv.begin(),
             odesc.cv.begin(),
             odesc.zkproof.begin())) {
         return std::nullopt;
@@ -314,26 +354,47 @@ TransactionBuilderResult TransactionBuilder::Build()
     // Sapling spends and outputs
     //
 
-    auto ctx = librustzcash_sapling_proving_ctx_init();
-
-    // Create Sapling SpendDescriptions
-    for (auto spend : spends) {
+    // Check the spends and outputs and pick the randomness of their value
+    // commitments first. The proofs then share no state and are created in
+    // parallel; the binding signature sums up the randomness afterwards.
+    std::vector<SpendDescription> vSpendDescs(spends.size());
+    std::vector<std::vector<unsigned char>> vSpendWitnesses(spends.size());
+    std::vector<uint256> vSpendRcv(spends.size());
+    for (size_t i = 0; i < spends.size(); i++) {
+        const auto& spend = spends[i];
         auto cm = spend.note.cmu();
         auto nf = spend.note.nullifier(
             spend.expsk.full_viewing_key(), spend.witness.position());
         if (!cm || !nf) {
-            librustzcash_sapling_proving_ctx_free(ctx);
             return TransactionBuilderResult("Spend is invalid");
         }
 
         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
         ss << spend.witness.path();
-        std::vector<unsigned char> witness(ss.begin(), ss.end());
+        vSpendWitnesses[i].assign(ss.begin(), ss.end());
+
+        vSpendDescs[i].anchor = spend.anchor;
+        vSpendDescs[i].nullifier = *nf;
+        librustzcash_sapling_generate_r(vSpendRcv[i].begin());
+    }
+
+    std::vector<std::optional<OutputDescription>> vOutputDescs(outputs.size());
+    std::vector<uint256> vOutputRcv(outputs.size());
+    for (size_t i = 0; i < outputs.size(); i++) {
+        // Check this out here as well to provide better logging.
+        if (!outputs[i].note.cmu()) {
+            return TransactionBuilderResult("Output is invalid");
+        }
+        librustzcash_sapling_generate_r(vOutputRcv[i].begin());
+    }
 
-        SpendDescription sdesc;
-        uint256 rcm = spend.note.rcm();
-        if (!librustzcash_sapling_spend_proof(
-                ctx,
+    // Create Sapling SpendDescriptions and OutputDescriptions
+    size_t nFailed = RunProofJobs(spends.size() + outputs.size(), [&](size_t i) {
+        if (i < spends.size()) {
+            const auto& spend = spends[i];
+            SpendDescription& sdesc = vSpendDescs[i];
+            uint256 rcm = spend.note.rcm();
+            return librustzcash_sapling_spend_proof_rcv(
                 spend.expsk.full_viewing_key().ak.begin(),
                 spend.expsk.nsk.begin(),
                 spend.note.d.data(),
@@ -341,34 +402,34 @@ TransactionBuilderResult TransactionBuilder::Build()
                 spend.alpha.begin(),
                 spend.note.value(),
                 spend.anchor.begin(),
-                witness.data(),
+                vSpendWitnesses[i].data(),
+                vSpendRcv[i].begin(),
                 sdesc.cv.begin(),
                 sdesc.rk.begin(),
-                sdesc.zkproof.data())) {
-            librustzcash_sapling_proving_ctx_free(ctx);
-            return TransactionBuilderResult("Spend proof failed");
+                sdesc.zkproof.data());
         }
-
-        sdesc.anchor = spend.anchor;
-        sdesc.nullifier = *nf;
-        mtx.vShieldedSpend.push_back(sdesc);
+        size_t j = i - spends.size();
+        vOutputDescs[j] = outputs[j].Build(vOutputRcv[j]);
+        return (bool)vOutputDescs[j];
+    });
+    if (nFailed < spends.size()) {
+        return TransactionBuilderResult("Spend proof failed");
+    }
+    if (nFailed < spends.size() + outputs.size()) {
+        return TransactionBuilderResult("Failed to create output description");
     }
 
-    // Create Sapling OutputDescriptions
-    for (auto output : outputs) {
-        // Check this out here as well to provide better logging.
-        if (!output.note.cmu()) {
-            librustzcash_sapling_proving_ctx_free(ctx);
-            return TransactionBuilderResult("Output is invalid");
-        }
-
-        auto odesc = output.Build(ctx);
-        if (!odesc) {
-            librustzcash_sapling_proving_ctx_free(ctx);
-            return TransactionBuilderResult("Failed to create output description");
-        }
-
-        mtx.vShieldedOutput.push_back(odesc.value());
+    std::vector<unsigned char> vSpendRcvBytes, vSpendCvBytes;
+    for (size_t i = 0; i < spends.size(); i++) {
+        vSpendRcvBytes.insert(vSpendRcvBytes.end(), vSpendRcv[i].begin(), vSpendRcv[i].end());
+        vSpendCvBytes.insert(vSpendCvBytes.end(), vSpendDescs[i].cv.begin(), vSpendDescs[i].cv.end());
+        mtx.vShieldedSpend.push_back(vSpendDescs[i]);
+    }
+    std::vector<unsigned char> vOutputRcvBytes, vOutputCvBytes;
+    for (size_t i = 0; i < outputs.size(); i++) {
+        vOutputRcvBytes.insert(vOutputRcvBytes.end(), vOutputRcv[i].begin(), vOutputRcv[i].end());
+        vOutputCvBytes.insert(vOutputCvBytes.end(), vOutputDescs[i]->cv.begin(), vOutputDescs[i]->cv.end());
+        mtx.vShieldedOutput.push_back(vOutputDescs[i].value());
     }
 
     //
@@ -383,11 +444,7 @@ TransactionBuilderResult TransactionBuilder::Build()
         try {
             CreateJSDescriptions();
         } catch (JSDescException e) {
-            librustzcash_sapling_proving_ctx_free(ctx);
             return TransactionBuilderResult(e.what());
-        } catch (std::runtime_error e) {
-            librustzcash_sapling_proving_ctx_free(ctx);
-            throw e;
         }
     }
 
@@ -403,7 +460,6 @@ TransactionBuilderResult TransactionBuilder::Build()
     try {
         dataToBeSigned = SignatureHash(scriptCode, mtx, NOT_AN_INPUT, SIGHASH_ALL, 0, consensusBranchId);
     } catch (std::logic_error ex) {
-        librustzcash_sapling_proving_ctx_free(ctx);
         return TransactionBuilderResult("Could not construct signature hash: " + std::string(ex.what()));
     }
 
@@ -415,13 +471,18 @@ TransactionBuilderResult TransactionBuilder::Build()
             dataToBeSigned.begin(),
             mtx.vShieldedSpend[i].spendAuthSig.data());
     }
-    librustzcash_sapling_binding_sig(
-        ctx,
-        mtx.valueBalance,
-        dataToBeSigned.begin(),
-        mtx.bindingSig.data());
-
-    librustzcash_sapling_proving_ctx_free(ctx);
+    if (!librustzcash_sapling_binding_sig_rcv(
+            vSpendRcvBytes.data(),
+            vSpendCvBytes.data(),
+            spends.size(),
+            vOutputRcvBytes.data(),
+            vOutputCvBytes.data(),
+            outputs.size(),
+            mtx.valueBalance,
+            dataToBeSigned.begin(),
+            mtx.bindingSig.data())) {
+        return TransactionBuilderResult("Failed to create Sapling binding signature");
+    }
 
     // Create Sprout joinSplitSig
     if (!ed25519_sign(
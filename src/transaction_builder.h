@@ -44,7 +44,8 @@ struct OutputDescriptionInfo {
         libzcash::SaplingNote note,
         std::array<unsigned char, ZC_MEMO_SIZE> memo) : ovk(ovk), note(note), memo(memo) {}
 
-    std::optional<OutputDescription> Build(void* ctx);
+    //! Encrypt the note and prove the output, committing to its value with randomness rcv
+    std::optional<OutputDescription> Build(const uint256& rcv);
 };
 
 struct TransparentInputInfo {
@@ -0,0 +1,113 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txcache.h"
+
+#include "core_memusage.h"
+#include "memusage.h"
+
+// Estimated overhead of one entry: the list node and the hash map node.
+static const size_t TX_CACHE_ENTRY_OVERHEAD = 4 * sizeof(void*) + sizeof(uint256);
+
+void CTxLookupCache::Trim()
+{
+    while (nUsage > nMaxUsage && !entries.empty()) {
+        const Entry& entry = entries.back();
+        nUsage -= entry.nUsage;
+        mapEntries.erase(entry.tx.GetHash());
+        entries.pop_back();
+    }
+}
+
+void CTxLookupCache::SetMaxUsage(size_t nMaxUsageIn)
+{
+    LOCK(cs);
+    nMaxUsage = nMaxUsageIn;
+    Trim();
+}
+
+bool CTxLookupCache::Get(const uint256& txid, CTransaction& txOut, uint256& hashBlock)
+{
+    LOCK(cs);
+    auto it = mapEntries.find(txid);
+    if (it == mapEntries.end())
+        return false;
+    entries.splice(entries.begin(), entries, it->second);
+    txOut = it->second->tx;
+    hashBlock = it->second->hashBlock;
+    return true;
+}
+
+void CTxLookupCache::Add(const CTransaction& tx, const uint256& hashBlock)
+{
+    LOCK(cs);
+    if (nMaxUsage == 0)
+        return;
+    const uint256& txid = tx.GetHash();
+    auto it = mapEntries.find(txid);
+    if (it != mapEntries.end()) {
+        it->second->hashBlock = hashBlock;
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    Entry entry = {tx, hashBlock, memusage::MallocUsage(sizeof(Entry)) + RecursiveDynamicUsage(tx) + TX_CACHE_ENTRY_OVERHEAD};
+    nUsage += entry.nUsage;
+    entries.push_front(entry);
+    mapEntries.emplace(txid, entries.begin());
+    Trim();
+}
+
+bool CTxLookupCache::Add(const CTransaction& tx, const uint256& hashBlock, uint64_t nDisconnectsBefore)
+{
+    LOCK(cs);
+    if (nDisconnects != nDisconnectsBefore)
+        return false;
+    Add(tx, hashBlock);
+    return true;
+}
+
+void CTxLookupCache::Erase(const uint256& txid)
+{
+    LOCK(cs);
+    auto it = mapEntries.find(txid);
+    if (it == mapEntries.end())
+        return;
+    nUsage -= it->second->nUsage;
+    entries.erase(it->second);
+    mapEntries.erase(it);
+}
+
+void CTxLookupCache::EraseBlock(const std::vector<CTransaction>& vtx)
+{
+    LOCK(cs);
+    nDisconnects++;
+    for (const CTransaction& tx : vtx)
+        Erase(tx.GetHash());
+}
+
+uint64_t CTxLookupCache::GetDisconnectCount() const
+{
+    LOCK(cs);
+    return nDisconnects;
+}
+
+void CTxLookupCache::Clear()
+{
+    LOCK(cs);
+    entries.clear();
+    mapEntries.clear();
+    nUsage = 0;
+}
+
+size_t CTxLookupCache::Size() const
+{
+    LOCK(cs);
+    return entries.size();
+}
+
+size_t CTxLookupCache::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return nUsage;
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef ZCASH_TXCACHE_H
+#define ZCASH_TXCACHE_H
+
+#include "coins.h"
+#include "primitives/transaction.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <stdint.h>
+#include <unordered_map>
+
+//! -txlookupcache default (MiB)
+static const int64_t DEFAULT_TX_LOOKUP_CACHE = 16;
+//! max. -txlookupcache (MiB)
+static const int64_t MAX_TX_LOOKUP_CACHE = 4096;
+
+/**
+ * Least recently used cache of confirmed transactions that GetTransaction read
+ * from the block files, together with the hash of the block containing them.
+ * Entries of a block are erased when it is disconnected, so a hit always names
+ * the block the transaction index would. Readers that look up the index without
+ * cs_main pass the disconnect count taken before the lookup to Add, so a block
+ * disconnected in between cannot leave its transactions behind.
+ */
+class CTxLookupCache
+{
+private:
+    struct Entry {
+        CTransaction tx;
+        uint256 hashBlock;
+        size_t nUsage;
+    };
+    typedef std::list<Entry> EntryList;
+
+    mutable CCriticalSection cs;
+    //! Most recently used entries first
+    EntryList entries;
+    std::unordered_map<uint256, EntryList::iterator, SaltedTxidHasher> mapEntries;
+    size_t nMaxUsage;
+    size_t nUsage;
+    //! Number of EraseBlock calls so far
+    uint64_t nDisconnects;
+
+    void Trim();
+
+public:
+    explicit CTxLookupCache(size_t nMaxUsageIn = 0) : nMaxUsage(nMaxUsageIn), nUsage(0), nDisconnects(0) {}
+
+    //! Set the memory limit in bytes, evicting entries if needed. 0 disables the cache.
+    void SetMaxUsage(size_t nMaxUsageIn);
+    bool Get(const uint256& txid, CTransaction& txOut, uint256& hashBlock);
+    void Add(const CTransaction& tx, const uint256& hashBlock);
+    //! Add unless a block was disconnected since GetDisconnectCount() returned nDisconnectsBefore
+    bool Add(const CTransaction& tx, const uint256& hashBlock, uint64_t nDisconnectsBefore);
+    void Erase(const uint256& txid);
+    //! Erase the transactions of a disconnected block
+    void EraseBlock(const std::vector<CTransaction>& vtx);
+    uint64_t GetDisconnectCount() const;
+    void Clear();
+    size_t Size() const;
+    size_t DynamicMemoryUsage() const;
+};
+
+#endif // ZCASH_TXCACHE_H
@@ -9,6 +9,7 @@
 #include "hash.h"
 #include "main.h"
 #include "pow.h"
+#include "snapshot.h"
 #include "uint256.h"
 
 #include <stdint.h>
@@ -34,6 +35,8 @@ static const char DB_BEST_SAPLING_ANCHOR = 'z';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_UTXO_STATS = 'U';
+static const char DB_SNAPSHOT_BASE = 'N';
 
 static const char DB_MMR_LENGTH = 'M';
 static const char DB_MMR_NODE = 'm';
@@ -46,14 +49,19 @@ static const char DB_SPENTINDEX = 'p';
 static const char DB_TIMESTAMPINDEX = 'T';
 static const char DB_BLOCKHASHINDEX = 'h';
 
-CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / dbName, nCacheSize, fMemory, fWipe), fFlushFailed(false), fBackgroundFlush(false), nUsageForFlush(0)
 {
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe), fFlushFailed(false), fBackgroundFlush(false), nUsageForFlush(0)
 {
 }
 
+CCoinsViewDB::~CCoinsViewDB()
+{
+    WaitForFlush();
+}
+
 
 bool CCoinsViewDB::GetSproutAnchorAt(const uint256& rt, SproutMerkleTree& tree) const
 {
@@ -63,6 +71,19 @@ bool CCoinsViewDB::GetSproutAnchorAt(const uint256& rt, SproutMerkleTree& tree)
         return true;
     }
 
+    {
+        LOCK(cs_flush);
+        if (pendingFlush) {
+            auto it = pendingFlush->mapSproutAnchors.find(rt);
+            if (it != pendingFlush->mapSproutAnchors.end()) {
+                if (!it->second.entered)
+                    return false;
+                tree = it->second.tree;
+                return true;
+            }
+        }
+    }
+
     bool read = db.Read(make_pair(DB_SPROUT_ANCHOR, rt), tree);
 
     return read;
@@ -76,6 +97,19 @@ bool CCoinsViewDB::GetSaplingAnchorAt(const uint256& rt, SaplingMerkleTree& tree
         return true;
     }
 
+    {
+        LOCK(cs_flush);
+        if (pendingFlush) {
+            auto it = pendingFlush->mapSaplingAnchors.find(rt);
+            if (it != pendingFlush->mapSaplingAnchors.end()) {
+                if (!it->second.entered)
+                    return false;
+                tree = it->second.tree;
+                return true;
+            }
+        }
+    }
+
     bool read = db.Read(make_pair(DB_SAPLING_ANCHOR, rt), tree);
 
     return read;
@@ -95,21 +129,55 @@ bool CCoinsViewDB::GetNullifier(const uint256& nf, ShieldedType type) const
     default:
         throw runtime_error("Unknown shielded type");
     }
+    {
+        LOCK(cs_flush);
+        if (pendingFlush) {
+            const CNullifiersMap& mapNullifiers = type == SPROUT ? pendingFlush->mapSproutNullifiers : pendingFlush->mapSaplingNullifiers;
+            auto it = mapNullifiers.find(nf);
+            if (it != mapNullifiers.end())
+                return it->second.entered;
+        }
+    }
     return db.Read(make_pair(dbChar, nf), spent);
 }
 
 bool CCoinsViewDB::GetCoins(const uint256& txid, CCoins& coins) const
 {
+    {
+        LOCK(cs_flush);
+        if (pendingFlush) {
+            CCoinsMap::const_iterator it = pendingFlush->mapCoins.find(txid);
+            if (it != pendingFlush->mapCoins.end()) {
+                if (it->second.coins.IsPruned())
+                    return false;
+                coins = it->second.coins;
+                return true;
+            }
+        }
+    }
     return db.Read(make_pair(DB_COINS, txid), coins);
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256& txid) const
 {
+    {
+        LOCK(cs_flush);
+        if (pendingFlush) {
+            CCoinsMap::const_iterator it = pendingFlush->mapCoins.find(txid);
+            if (it != pendingFlush->mapCoins.end())
+                return !it->second.coins.IsPruned();
+        }
+    }
     return db.Exists(make_pair(DB_COINS, txid));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const
 {
+    {
+        LOCK(cs_flush);
+        if (pendingFlush && !pendingFlush->hashBlock.IsNull())
+            return pendingFlush->hashBlock;
+    }
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -120,6 +188,15 @@ uint256 CCoinsViewDB::GetBestAnchor(ShieldedType type) const
 {
     uint256 hashBestAnchor;
 
+    {
+        LOCK(cs_flush);
+        if (pendingFlush) {
+            const uint256& hashPending = type == SPROUT ? pendingFlush->hashSproutAnchor : pendingFlush->hashSaplingAnchor;
+            if (!hashPending.IsNull())
+                return hashPending;
+        }
+    }
+
     switch (type) {
     case SPROUT:
         if (!db.Read(DB_BEST_SPROUT_ANCHOR, hashBestAnchor))
@@ -138,6 +215,15 @@ uint256 CCoinsViewDB::GetBestAnchor(ShieldedType type) const
 
 HistoryIndex CCoinsViewDB::GetHistoryLength(uint32_t epochId) const
 {
+    {
+        LOCK(cs_flush);
+        if (pendingFlush) {
+            auto it = pendingFlush->historyCacheMap.find(epochId);
+            if (it != pendingFlush->historyCacheMap.end())
+                return it->second.length;
+        }
+    }
+
     HistoryIndex historyLength;
     if (!db.Read(make_pair(DB_MMR_LENGTH, epochId), historyLength)) {
         // Starting new history
@@ -155,6 +241,19 @@ HistoryNode CCoinsViewDB::GetHistoryAt(uint32_t epochId, HistoryIndex index) con
         throw runtime_error("History data inconsistent - reindex?");
     }
 
+    {
+        LOCK(cs_flush);
+        if (pendingFlush) {
+            auto it = pendingFlush->historyCacheMap.find(epochId);
+            if (it != pendingFlush->historyCacheMap.end() && index >= it->second.updateDepth) {
+                auto itNode = it->second.appends.find(index);
+                if (itNode == it->second.appends.end())
+                    throw runtime_error("History data inconsistent (expected node not found) - reindex?");
+                return itNode->second;
+            }
+        }
+    }
+
     // Read mmrNode into tmp std::array
     std::array<unsigned char, NODE_SERIALIZED_LENGTH> tmpMmrNode;
 
@@ -169,6 +268,15 @@ HistoryNode CCoinsViewDB::GetHistoryAt(uint32_t epochId, HistoryIndex index) con
 
 uint256 CCoinsViewDB::GetHistoryRoot(uint32_t epochId) const
 {
+    {
+        LOCK(cs_flush);
+        if (pendingFlush) {
+            auto it = pendingFlush->historyCacheMap.find(epochId);
+            if (it != pendingFlush->historyCacheMap.end())
+                return it->second.root;
+        }
+    }
+
     uint256 root;
     if (!db.Read(make_pair(DB_MMR_ROOT, epochId), root)) {
         root = uint256();
@@ -176,9 +284,9 @@ uint256 CCoinsViewDB::GetHistoryRoot(uint32_t epochId) const
     return root;
 }
 
-void BatchWriteNullifiers(CDBBatch& batch, CNullifiersMap& mapToUse, const char& dbChar)
+void BatchWriteNullifiers(CDBBatch& batch, const CNullifiersMap& mapToUse, const char& dbChar)
 {
-    for (CNullifiersMap::iterator it = mapToUse.begin(); it != mapToUse.end();) {
+    for (CNullifiersMap::const_iterator it = mapToUse.begin(); it != mapToUse.end(); ++it) {
         if (it->second.flags & CNullifiersCacheEntry::DIRTY) {
             if (!it->second.entered)
                 batch.Erase(make_pair(dbChar, it->first));
@@ -186,14 +294,13 @@ void BatchWriteNullifiers(CDBBatch& batch, CNullifiersMap& mapToUse, const char&
                 batch.Write(make_pair(dbChar, it->first), true);
             // TODO: changed++? ... See comment in CCoinsViewDB::BatchWrite. If this is needed we could return an int
         }
-        it = mapToUse.erase(it);
     }
 }
 
 template <typename Map, typename MapIterator, typename MapEntry, typename Tree>
-void BatchWriteAnchors(CDBBatch& batch, Map& mapToUse, const char& dbChar)
+void BatchWriteAnchors(CDBBatch& batch, const Map& mapToUse, const char& dbChar)
 {
-    for (MapIterator it = mapToUse.begin(); it != mapToUse.end();) {
+    for (MapIterator it = mapToUse.begin(); it != mapToUse.end(); ++it) {
         if (it->second.flags & MapEntry::DIRTY) {
             if (!it->second.entered)
                 batch.Erase(make_pair(dbChar, it->first));
@@ -204,14 +311,13 @@ void BatchWriteAnchors(CDBBatch& batch, Map& mapToUse, const char& dbChar)
             }
             // TODO: changed++?
         }
-        it = mapToUse.erase(it);
     }
 }
 
-void BatchWriteHistory(CDBBatch& batch, CHistoryCacheMap& historyCacheMap)
+void BatchWriteHistory(CDBBatch& batch, const CHistoryCacheMap& historyCacheMap)
 {
     for (auto nextHistoryCache = historyCacheMap.begin(); nextHistoryCache != historyCacheMap.end(); nextHistoryCache++) {
-        auto historyCache = nextHistoryCache->second;
+        const auto& historyCache = nextHistoryCache->second;
         auto epochId = nextHistoryCache->first;
 
         // delete old entries since updateDepth
@@ -235,20 +341,12 @@ void BatchWriteHistory(CDBBatch& batch, CHistoryCacheMap& historyCacheMap)
     }
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins,
-                              const uint256& hashBlock,
-                              const uint256& hashSproutAnchor,
-                              const uint256& hashSaplingAnchor,
-                              CAnchorsSproutMap& mapSproutAnchors,
-                              CAnchorsSaplingMap& mapSaplingAnchors,
-                              CNullifiersMap& mapSproutNullifiers,
-                              CNullifiersMap& mapSaplingNullifiers,
-                              CHistoryCacheMap& historyCacheMap)
+bool CCoinsViewDB::WritePendingFlush(const PendingFlush& flush)
 {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = flush.mapCoins.begin(); it != flush.mapCoins.end(); ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             if (it->second.coins.IsPruned())
                 batch.Erase(make_pair(DB_COINS, it->first));
@@ -257,30 +355,149 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins,
             changed++;
         }
         count++;
-        it = mapCoins.erase(it);
     }
 
-    ::BatchWriteAnchors<CAnchorsSproutMap, CAnchorsSproutMap::iterator, CAnchorsSproutCacheEntry, SproutMerkleTree>(batch, mapSproutAnchors, DB_SPROUT_ANCHOR);
-    ::BatchWriteAnchors<CAnchorsSaplingMap, CAnchorsSaplingMap::iterator, CAnchorsSaplingCacheEntry, SaplingMerkleTree>(batch, mapSaplingAnchors, DB_SAPLING_ANCHOR);
+    ::BatchWriteAnchors<CAnchorsSproutMap, CAnchorsSproutMap::const_iterator, CAnchorsSproutCacheEntry, SproutMerkleTree>(batch, flush.mapSproutAnchors, DB_SPROUT_ANCHOR);
+    ::BatchWriteAnchors<CAnchorsSaplingMap, CAnchorsSaplingMap::const_iterator, CAnchorsSaplingCacheEntry, SaplingMerkleTree>(batch, flush.mapSaplingAnchors, DB_SAPLING_ANCHOR);
+
+    ::BatchWriteNullifiers(batch, flush.mapSproutNullifiers, DB_NULLIFIER);
+    ::BatchWriteNullifiers(batch, flush.mapSaplingNullifiers, DB_SAPLING_NULLIFIER);
+
+    ::BatchWriteHistory(batch, flush.historyCacheMap);
+
+    // The best block marker goes into the same batch as the data it describes,
+    // so a crash leaves either the old or the new state on disk, never a mix.
+    if (!flush.hashBlock.IsNull())
+        batch.Write(DB_BEST_BLOCK, flush.hashBlock);
+    if (!flush.hashSproutAnchor.IsNull())
+        batch.Write(DB_BEST_SPROUT_ANCHOR, flush.hashSproutAnchor);
+    if (!flush.hashSaplingAnchor.IsNull())
+        batch.Write(DB_BEST_SAPLING_ANCHOR, flush.hashSaplingAnchor);
+    if (!flush.hashBlock.IsNull()) {
+        if (flush.stats.hashBlock == flush.hashBlock)
+            batch.Write(DB_UTXO_STATS, flush.stats);
+        else
+            batch.Erase(DB_UTXO_STATS);
+    }
 
-    ::BatchWriteNullifiers(batch, mapSproutNullifiers, DB_NULLIFIER);
-    ::BatchWriteNullifiers(batch, mapSaplingNullifiers, DB_SAPLING_NULLIFIER);
+    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    return db.WriteBatch(batch);
+}
 
-    ::BatchWriteHistory(batch, historyCacheMap);
+void CCoinsViewDB::ThreadFlush()
+{
+    RenameThread("gemlink-coinsflush");
+    int64_t nStart = GetTimeMillis();
+    bool fOk = false;
+    try {
+        // pendingFlush is not modified by anyone else until this thread is joined.
+        fOk = WritePendingFlush(*pendingFlush);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: background flush failed: %s\n", __func__, e.what());
+    }
 
-    if (!hashBlock.IsNull())
-        batch.Write(DB_BEST_BLOCK, hashBlock);
-    if (!hashSproutAnchor.IsNull())
-        batch.Write(DB_BEST_SPROUT_ANCHOR, hashSproutAnchor);
-    if (!hashSaplingAnchor.IsNull())
-        batch.Write(DB_BEST_SAPLING_ANCHOR, hashSaplingAnchor);
+    LogPrint("coindb", "Background flush of coin database finished in %dms\n", GetTimeMillis() - nStart);
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
-    return db.WriteBatch(batch);
+    LOCK(cs_flush);
+    if (fOk) {
+        pendingFlush.reset();
+    } else {
+        // Keep serving lookups from the snapshot; the caller will abort on WaitForFlush.
+        fFlushFailed = true;
+    }
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
+bool CCoinsViewDB::WaitForFlush()
 {
+    {
+        LOCK(cs_flushThread);
+        if (flushThread.joinable())
+            flushThread.join();
+    }
+    LOCK(cs_flush);
+    return !fFlushFailed;
+}
+
+size_t CCoinsViewDB::PendingFlushUsage() const
+{
+    LOCK(cs_flush);
+    return pendingFlush ? pendingFlush->nUsage : 0;
+}
+
+bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins,
+                              const uint256& hashBlock,
+                              const uint256& hashSproutAnchor,
+                              const uint256& hashSaplingAnchor,
+                              CAnchorsSproutMap& mapSproutAnchors,
+                              CAnchorsSaplingMap& mapSaplingAnchors,
+                              CNullifiersMap& mapSproutNullifiers,
+                              CNullifiersMap& mapSaplingNullifiers,
+                              CHistoryCacheMap& historyCacheMap)
+{
+    // Only one flush can be in flight; later ones must not overtake it.
+    LOCK(cs_flushThread);
+    if (!WaitForFlush())
+        return false;
+
+    // Take ownership of the cache contents. Swapping the maps is cheap, so
+    // the caller (holding cs_main) is not stalled for the size of the cache.
+    std::unique_ptr<PendingFlush> flush(new PendingFlush());
+    flush->mapCoins.swap(mapCoins);
+    flush->hashBlock = hashBlock;
+    flush->hashSproutAnchor = hashSproutAnchor;
+    flush->hashSaplingAnchor = hashSaplingAnchor;
+    flush->mapSproutAnchors.swap(mapSproutAnchors);
+    flush->mapSaplingAnchors.swap(mapSaplingAnchors);
+    flush->mapSproutNullifiers.swap(mapSproutNullifiers);
+    flush->mapSaplingNullifiers.swap(mapSaplingNullifiers);
+    flush->historyCacheMap.swap(historyCacheMap);
+    flush->stats = statsForFlush;
+    flush->nUsage = nUsageForFlush;
+    nUsageForFlush = 0;
+
+    if (!fBackgroundFlush)
+        return WritePendingFlush(*flush);
+
+    {
+        LOCK(cs_flush);
+        pendingFlush = std::move(flush);
+    }
+    flushThread = boost::thread(boost::bind(&CCoinsViewDB::ThreadFlush, this));
+    return true;
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe, const CBlockTreeIndexOptions& indexOptions) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
+{
+    if (fMemory)
+        return;
+
+    const bool fCompression = indexOptions.fCompression;
+    ptxindex = OpenIndex("txindex", indexOptions.nTxIndexCache, fCompression, fWipe, std::string(1, DB_TXINDEX));
+    paddressindex = OpenIndex("address", indexOptions.nAddressIndexCache, fCompression, fWipe, std::string{DB_ADDRESSINDEX, DB_ADDRESSUNSPENTINDEX});
+    pspentindex = OpenIndex("spent", indexOptions.nSpentIndexCache, fCompression, fWipe, std::string(1, DB_SPENTINDEX));
+    ptimestampindex = OpenIndex("timestamp", indexOptions.nTimestampIndexCache, fCompression, fWipe, std::string{DB_TIMESTAMPINDEX, DB_BLOCKHASHINDEX});
+}
+
+std::unique_ptr<CDBWrapper> CBlockTreeDB::OpenIndex(const std::string& name, size_t nCacheSize, bool fCompression, bool fWipe, const std::string& prefixes)
+{
+    if (nCacheSize == 0)
+        return nullptr;
+
+    // Index writes are mostly appends of fresh keys, so favour the write
+    // buffer over the block cache; reads are point lookups or short scans.
+    CDBWrapperOptions dbOptions(nCacheSize);
+    dbOptions.nBlockCacheSize = nCacheSize / 4;
+    dbOptions.nWriteBufferSize = nCacheSize * 3 / 8;
+    dbOptions.fCompression = fCompression;
+    std::unique_ptr<CDBWrapper> db(new CDBWrapper(GetDataDir() / "indexes" / name, dbOptions, false, fWipe));
+
+    // Older versions kept every index inside blocks/index; move them out once.
+    for (char chPrefix : prefixes) {
+        size_t nMoved = MovePrefixTo(*db, chPrefix);
+        if (nMoved > 0)
+            LogPrintf("Moved %u '%c' entries from the block index database to indexes/%s\n", nMoved, chPrefix, name);
+    }
+    return db;
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo& info)
@@ -307,16 +524,49 @@ bool CBlockTreeDB::ReadLastBlockFile(int& nFile)
     return Read(DB_LAST_BLOCK, nFile);
 }
 
+bool CCoinsViewDB::ReadUTXOStats(CCoinsStats& stats) const
+{
+    {
+        LOCK(cs_flush);
+        if (pendingFlush && !pendingFlush->hashBlock.IsNull()) {
+            if (pendingFlush->stats.hashBlock != pendingFlush->hashBlock)
+                return false;
+            stats = pendingFlush->stats;
+            return true;
+        }
+    }
+    return db.Read(DB_UTXO_STATS, stats);
+}
+
+bool CCoinsViewDB::WriteRawEntries(const std::vector<std::pair<std::vector<unsigned char>, std::vector<unsigned char>>>& entries, bool fSync)
+{
+    CDBBatch batch(db);
+    for (const auto& entry : entries)
+        batch.WriteRaw(entry.first, entry.second);
+    return db.WriteBatch(batch, fSync);
+}
+
 bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 {
+    // The statistics are computed from LevelDB directly, so make sure it has
+    // caught up with any flush still running in the background.
+    if (!const_cast<CCoinsViewDB*>(this)->WaitForFlush())
+        return false;
+
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
+
+    // Read the best block through the iterator too, so that it matches the
+    // coins even if a flush commits while they are scanned.
+    pcursor->Seek(DB_BEST_BLOCK);
+    char chKey;
+    if (!pcursor->Valid() || !pcursor->GetKey(chKey) || chKey != DB_BEST_BLOCK || !pcursor->GetValue(stats.hashBlock))
+        return error("CCoinsViewDB::GetStats() : unable to read the best block");
     pcursor->Seek(DB_COINS);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
     CAmount nTotalAmount = 0;
     while (pcursor->Valid()) {
@@ -333,6 +583,7 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
                         ss << VARINT(i + 1);
                         ss << out;
                         nTotalAmount += out.nValue;
+                        ApplyCoinHash(stats.muhash, key.second, i, coins.nHeight, coins.fCoinBase, out);
                     }
                 }
                 stats.nSerializedSize += 32 + pcursor->GetValueSize();
@@ -356,6 +607,17 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*>>& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo)
 {
+    // The index databases are written without sync as blocks are connected.
+    // Make them durable before the block index records those blocks, as a
+    // sync of the shared log used to do when they lived in this database.
+    for (CDBWrapper* pindexdb : {ptxindex.get(), paddressindex.get(), pspentindex.get(), ptimestampindex.get()}) {
+        if (pindexdb) {
+            CDBBatch empty(*pindexdb);
+            if (!pindexdb->WriteBatch(empty, true))
+                return error("%s: failed to sync an index database", __func__);
+        }
+    }
+
     CDBBatch batch(*this);
     for (std::vector<std::pair<int, const CBlockFileInfo*>>::const_iterator it = fileInfo.begin(); it != fileInfo.end(); it++) {
         batch.Write(make_pair(DB_BLOCK_FILES, it->first), *it->second);
@@ -378,22 +640,24 @@ bool CBlockTreeDB::EraseBatchSync(const std::vector<const CBlockIndex*>& blockin
 
 bool CBlockTreeDB::ReadTxIndex(const uint256& txid, CDiskTxPos& pos)
 {
-    return Read(make_pair(DB_TXINDEX, txid), pos);
+    return TxIndexDB().Read(make_pair(DB_TXINDEX, txid), pos);
 }
 
 bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>>& vect)
 {
-    CDBBatch batch(*this);
+    CDBWrapper& db = TxIndexDB();
+    CDBBatch batch(db);
     for (std::vector<std::pair<uint256, CDiskTxPos>>::const_iterator it = vect.begin(); it != vect.end(); it++)
         batch.Write(make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
+    return db.WriteBatch(batch);
 }
 
 // START insightexplorer
 // https://github.com/bitpay/bitcoin/commit/017f548ea6d89423ef568117447e61dd5707ec42#diff-81e4f16a1b5d5b7ca25351a63d07cb80R183
 bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<CAddressUnspentDbEntry>& vect)
 {
-    CDBBatch batch(*this);
+    CDBWrapper& db = AddressIndexDB();
+    CDBBatch batch(db);
     for (std::vector<CAddressUnspentDbEntry>::const_iterator it = vect.begin(); it != vect.end(); it++) {
         if (it->second.IsNull()) {
             batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
@@ -401,12 +665,12 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<CAddressUnspentDb
             batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
         }
     }
-    return WriteBatch(batch);
+    return db.WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type, std::vector<CAddressUnspentDbEntry>& unspentOutputs)
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    boost::scoped_ptr<CDBIterator> pcursor(AddressIndexDB().NewIterator());
 
     pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
 
@@ -426,18 +690,20 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type, std::v
 
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<CAddressIndexDbEntry>& vect)
 {
-    CDBBatch batch(*this);
+    CDBWrapper& db = AddressIndexDB();
+    CDBBatch batch(db);
     for (std::vector<CAddressIndexDbEntry>::const_iterator it = vect.begin(); it != vect.end(); it++)
         batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+    return db.WriteBatch(batch);
 }
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<CAddressIndexDbEntry>& vect)
 {
-    CDBBatch batch(*this);
+    CDBWrapper& db = AddressIndexDB();
+    CDBBatch batch(db);
     for (std::vector<CAddressIndexDbEntry>::const_iterator it = vect.begin(); it != vect.end(); it++)
         batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
+    return db.WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressIndex(
@@ -447,7 +713,7 @@ bool CBlockTreeDB::ReadAddressIndex(
     int start,
     int end)
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    boost::scoped_ptr<CDBIterator> pcursor(AddressIndexDB().NewIterator());
 
     if (start > 0 && end > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
@@ -478,7 +744,7 @@ bool CBlockTreeDB::ReadAddressIndexMN(
     int start,
     int end)
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    boost::scoped_ptr<CDBIterator> pcursor(AddressIndexDB().NewIterator());
 
     if (start > end) {
         return error("start must be smaller or equal end");
@@ -511,12 +777,13 @@ bool CBlockTreeDB::ReadAddressIndexMN(
 
 bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey& key, CSpentIndexValue& value)
 {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
+    return SpentIndexDB().Read(make_pair(DB_SPENTINDEX, key), value);
 }
 
 bool CBlockTreeDB::UpdateSpentIndex(const std::vector<CSpentIndexDbEntry>& vect)
 {
-    CDBBatch batch(*this);
+    CDBWrapper& db = SpentIndexDB();
+    CDBBatch batch(db);
     for (std::vector<CSpentIndexDbEntry>::const_iterator it = vect.begin(); it != vect.end(); it++) {
         if (it->second.IsNull()) {
             batch.Erase(make_pair(DB_SPENTINDEX, it->first));
@@ -524,19 +791,20 @@ bool CBlockTreeDB::UpdateSpentIndex(const std::vector<CSpentIndexDbEntry>& vect)
             batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
         }
     }
-    return WriteBatch(batch);
+    return db.WriteBatch(batch);
 }
 
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey& timestampIndex)
 {
-    CDBBatch batch(*this);
+    CDBWrapper& db = TimestampIndexDB();
+    CDBBatch batch(db);
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
+    return db.WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadTimestampIndex(unsigned int high, unsigned int low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int>>& hashes)
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    boost::scoped_ptr<CDBIterator> pcursor(TimestampIndexDB().NewIterator());
 
     pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
 
@@ -562,15 +830,16 @@ bool CBlockTreeDB::ReadTimestampIndex(unsigned int high, unsigned int low, const
 bool CBlockTreeDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey& blockhashIndex,
                                             const CTimestampBlockIndexValue& logicalts)
 {
-    CDBBatch batch(*this);
+    CDBWrapper& db = TimestampIndexDB();
+    CDBBatch batch(db);
     batch.Write(make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
-    return WriteBatch(batch);
+    return db.WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256& hash, unsigned int& ltimestamp)
 {
     CTimestampBlockIndexValue lts;
-    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
+    if (!TimestampIndexDB().Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
         return false;
 
     ltimestamp = lts.ltimestamp;
@@ -592,6 +861,16 @@ bool CBlockTreeDB::ReadFlag(const std::string& name, bool& fValue)
     return true;
 }
 
+bool CBlockTreeDB::WriteSnapshotBase(const CSnapshotMetadata& metadata)
+{
+    return Write(DB_SNAPSHOT_BASE, metadata, true);
+}
+
+bool CBlockTreeDB::ReadSnapshotBase(CSnapshotMetadata& metadata)
+{
+    return Read(DB_SNAPSHOT_BASE, metadata);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(
     std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
     const CChainParams& chainParams)
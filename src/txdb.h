@@ -9,16 +9,20 @@
 #include "chain.h"
 #include "coins.h"
 #include "dbwrapper.h"
+#include "sync.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "zcash/History.hpp"
 #include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
 
 class CBlockIndex;
+class CSnapshotMetadata;
 
 // START insightexplorer
 struct CAddressUnspentKey;
@@ -46,6 +50,10 @@ static const int64_t nDefaultDbCache = 450;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! -backgroundflush default
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
+//! max. block index database cache when the tx index lives in its own database (MiB)
+static const int64_t nMaxBlockTreeDBCache = 2;
 
 struct CDiskTxPos : public CDiskBlockPos {
     unsigned int nTxOffset; // after header
@@ -82,8 +90,72 @@ protected:
     CDBWrapper db;
     CCoinsViewDB(std::string dbName, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
+private:
+    /**
+     * Cache contents handed over by BatchWrite. While a background flush is
+     * running, lookups are answered from here first so that the view stays
+     * consistent until LevelDB has the data.
+     */
+    struct PendingFlush {
+        CCoinsMap mapCoins;
+        uint256 hashBlock;
+        uint256 hashSproutAnchor;
+        uint256 hashSaplingAnchor;
+        CAnchorsSproutMap mapSproutAnchors;
+        CAnchorsSaplingMap mapSaplingAnchors;
+        CNullifiersMap mapSproutNullifiers;
+        CNullifiersMap mapSaplingNullifiers;
+        CHistoryCacheMap historyCacheMap;
+        CCoinsStats stats;
+        //! Memory the flushed cache held, still in use until the flush is done
+        size_t nUsage;
+    };
+
+    //! Protects pendingFlush and fFlushFailed
+    mutable CCriticalSection cs_flush;
+    std::unique_ptr<PendingFlush> pendingFlush;
+    bool fFlushFailed;
+    bool fBackgroundFlush;
+    //! Protects flushThread, which WaitForFlush joins from any thread
+    CCriticalSection cs_flushThread;
+    boost::thread flushThread;
+    //! UTXO set statistics to persist with the next BatchWrite
+    CCoinsStats statsForFlush;
+    //! Memory usage of the cache handed to the next BatchWrite
+    size_t nUsageForFlush;
+
+    bool WritePendingFlush(const PendingFlush& flush);
+    void ThreadFlush();
+
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CCoinsViewDB();
+
+    /**
+     * When enabled, BatchWrite hands the flushed cache to a background thread
+     * and returns immediately. The best block marker is written in the same
+     * atomic batch as the coins, so the on-disk state is always consistent.
+     */
+    void SetBackgroundFlush(bool fEnabled) { fBackgroundFlush = fEnabled; }
+    //! Block until any background flush has completed. Returns false if it failed.
+    bool WaitForFlush();
+
+    /**
+     * Set the incrementally maintained UTXO set statistics to write with the
+     * next BatchWrite. They are only written if they describe the same best
+     * block as the flushed coins.
+     */
+    void SetUTXOStats(const CCoinsStats& stats) { statsForFlush = stats; }
+    /**
+     * Set the memory usage of the cache passed to the next BatchWrite. It is
+     * reported by PendingFlushUsage until a background flush has finished,
+     * so that it can be counted against the cache limit.
+     */
+    void SetFlushUsage(size_t nUsage) { nUsageForFlush = nUsage; }
+    //! Memory still held by a background flush in progress.
+    size_t PendingFlushUsage() const;
+    //! Read the UTXO set statistics stored with the current best block.
+    bool ReadUTXOStats(CCoinsStats& stats) const;
 
     bool GetSproutAnchorAt(const uint256& rt, SproutMerkleTree& tree) const;
     bool GetSaplingAnchorAt(const uint256& rt, SaplingMerkleTree& tree) const;
@@ -105,18 +177,47 @@ public:
                     CNullifiersMap& mapSaplingNullifiers,
                     CHistoryCacheMap& historyCacheMap);
     bool GetStats(CCoinsStats& stats) const;
+
+    //! Iterator over every entry of the chain state database, for UTXO snapshots.
+    CDBIterator* RawCursor() { return db.NewIterator(); }
+    //! Write serialized chain state entries read from a UTXO snapshot.
+    bool WriteRawEntries(const std::vector<std::pair<std::vector<unsigned char>, std::vector<unsigned char>>>& entries, bool fSync);
+};
+
+/**
+ * Cache budgets (bytes) for the optional index databases in indexes/.
+ * A budget of 0 keeps that index inside the block tree database.
+ */
+struct CBlockTreeIndexOptions {
+    size_t nTxIndexCache = 0;
+    size_t nAddressIndexCache = 0;
+    size_t nSpentIndexCache = 0;
+    size_t nTimestampIndexCache = 0;
+    bool fCompression = false;
 };
 
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
 public:
-    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, const CBlockTreeIndexOptions& indexOptions = CBlockTreeIndexOptions());
 
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
 
+    //! Optional index databases; a null pointer means the index is kept in this database.
+    std::unique_ptr<CDBWrapper> ptxindex;
+    std::unique_ptr<CDBWrapper> paddressindex;
+    std::unique_ptr<CDBWrapper> pspentindex;
+    std::unique_ptr<CDBWrapper> ptimestampindex;
+
+    std::unique_ptr<CDBWrapper> OpenIndex(const std::string& name, size_t nCacheSize, bool fCompression, bool fWipe, const std::string& prefixes);
+    CDBWrapper& TxIndexDB() { return ptxindex ? *ptxindex : *this; }
+    CDBWrapper& AddressIndexDB() { return paddressindex ? *paddressindex : *this; }
+    CDBWrapper& SpentIndexDB() { return pspentindex ? *pspentindex : *this; }
+    CDBWrapper& TimestampIndexDB() { return ptimestampindex ? *ptimestampindex : *this; }
+
 public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*>>& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool EraseBatchSync(const std::vector<const CBlockIndex*>& blockinfo);
@@ -150,6 +251,8 @@ public:
 
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
+    bool WriteSnapshotBase(const CSnapshotMetadata& metadata);
+    bool ReadSnapshotBase(CSnapshotMetadata& metadata);
     bool LoadBlockIndexGuts(
         std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
         const CChainParams& chainParams);
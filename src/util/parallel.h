@@ -0,0 +1,65 @@
+// Copyright (c) 2021 The SnowGem developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_PARALLEL_H
+#define BITCOIN_UTIL_PARALLEL_H
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace util {
+/**
+ * Run job(0) to job(nJobs - 1) on up to nThreads threads, the calling one
+ * included, and return once every thread is done. Threads take the next job
+ * index as they go, so if the system refuses to start a thread the others
+ * simply run more jobs. After a job throws no further jobs are started, and
+ * the first exception is rethrown once every started thread has joined.
+ */
+inline void ParallelFor(size_t nJobs, size_t nThreads, const std::function<void(size_t)>& job)
+{
+    std::atomic<size_t> nNext(0);
+    std::atomic<bool> fFailed(false);
+    std::exception_ptr error;
+    std::mutex csError;
+    auto worker = [&]() {
+        for (size_t i = nNext++; i < nJobs && !fFailed; i = nNext++) {
+            try {
+                job(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(csError);
+                if (!error)
+                    error = std::current_exception();
+                fFailed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    if (nThreads > nJobs)
+        nThreads = nJobs;
+    if (nThreads > 1)
+        threads.reserve(nThreads - 1);
+    for (size_t i = 1; i < nThreads; i++) {
+        try {
+            threads.emplace_back(worker);
+        } catch (const std::system_error&) {
+            // Out of threads: the ones already started share the remaining jobs
+            break;
+        }
+    }
+    worker();
+    for (std::thread& t : threads)
+        t.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+} // namespace util
+
+#endif // BITCOIN_UTIL_PARALLEL_H
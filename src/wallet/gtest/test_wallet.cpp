@@ -64,6 +64,9 @@ public:
     void MarkAffectedTransactionsDirty(const CTransaction& tx) {
         CWallet::MarkAffectedTransactionsDirty(tx);
     }
+    void EraseSaplingNoteAddresses(const uint256& hash) {
+        CWallet::EraseSaplingNoteAddresses(hash);
+    }
 };
 
 std::vector<SaplingOutPoint> SetSaplingNoteData(CWalletTx& wtx) {
@@ -868,6 +871,135 @@ TEST(WalletTests, NavigateFromSproutNullifierToNote) {
     EXPECT_EQ(1, wallet.mapSproutNullifiersToNotes[nullifier].n);
 }
 
+// GetFilteredNotes indexes the Sapling notes by address; the results must
+// match a plain decryption of every note, call after call and when filtered.
+TEST(WalletTests, GetFilteredSaplingNotes) {
+    auto consensusParams = RegtestActivateSapling();
+
+    TestWallet wallet;
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    // Two Sapling addresses in the wallet
+    auto sk = GetTestMasterSaplingSpendingKey();
+    auto expsk = sk.expsk;
+    auto extfvk = sk.ToXFVK();
+    auto pa = sk.DefaultAddress();
+    auto sk2 = sk.Derive(1);
+    auto pa2 = sk2.DefaultAddress();
+    ASSERT_TRUE(wallet.AddSaplingZKey(sk));
+    ASSERT_TRUE(wallet.AddSaplingZKey(sk2));
+
+    auto testNote = GetTestSaplingNote(pa, 50000);
+
+    // Generate transaction paying both addresses, with change back to pa
+    auto builder = TransactionBuilder(consensusParams, 1);
+    builder.AddSaplingSpend(expsk, testNote.note, testNote.tree.root(), testNote.tree.witness());
+    builder.AddSaplingOutput(extfvk.fvk.ovk, pa2, 20000, {});
+    builder.AddSaplingOutput(extfvk.fvk.ovk, pa, 15000, {});
+    auto tx = builder.Build().GetTxOrThrow();
+    CWalletTx wtx {&wallet, tx};
+
+    // Fake-mine the transaction
+    EXPECT_EQ(-1, chainActive.Height());
+    CBlock block;
+    block.vtx.push_back(wtx);
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    auto blockHash = block.GetHash();
+    CBlockIndex fakeIndex {block};
+    mapBlockIndex.insert(std::make_pair(blockHash, &fakeIndex));
+    chainActive.SetTip(&fakeIndex);
+    EXPECT_TRUE(chainActive.Contains(&fakeIndex));
+
+    wtx.SetMerkleBranch(block);
+    auto saplingNoteData = wallet.FindMySaplingNotes(wtx, chainActive.Height()).first;
+    ASSERT_EQ(3, saplingNoteData.size());
+    wtx.SetSaplingNoteData(saplingNoteData);
+    wallet.AddToWallet(wtx, true, NULL);
+    uint256 hash = wtx.GetHash();
+
+    // Decrypt every note directly, in the order GetFilteredNotes walks them
+    std::vector<SaplingNoteEntry> expected;
+    for (const auto& item : wallet.mapWallet[hash].mapSaplingNoteData) {
+        const SaplingOutPoint& op = item.first;
+        const SaplingNoteData& nd = item.second;
+        auto notePt = libzcash::SaplingNotePlaintext::attempt_sapling_enc_decryption_deserialization(
+            tx.vShieldedOutput[op.n].encCiphertext, nd.ivk, tx.vShieldedOutput[op.n].ephemeralKey);
+        ASSERT_TRUE(notePt);
+        auto addr = nd.ivk.address(notePt->d);
+        ASSERT_TRUE(addr);
+        expected.push_back(SaplingNoteEntry{op, addr.value(), notePt->note(nd.ivk).value(), notePt->memo(), 1});
+    }
+
+    auto checkEntries = [](const std::vector<SaplingNoteEntry>& want, const std::vector<SaplingNoteEntry>& got) {
+        ASSERT_EQ(want.size(), got.size());
+        for (size_t i = 0; i < want.size(); i++) {
+            EXPECT_EQ(want[i].op, got[i].op);
+            EXPECT_EQ(want[i].address, got[i].address);
+            EXPECT_EQ(want[i].note.value(), got[i].note.value());
+            EXPECT_EQ(want[i].note.cmu(), got[i].note.cmu());
+            EXPECT_EQ(want[i].memo, got[i].memo);
+            EXPECT_EQ(want[i].confirmations, got[i].confirmations);
+        }
+    };
+
+    // Notes read from disk are indexed by the first call, the second is served from the index
+    EXPECT_EQ(0, wallet.mapSaplingNoteAddresses.size());
+    for (int i = 0; i < 2; i++) {
+        std::vector<SproutNoteEntry> sproutEntries;
+        std::vector<SaplingNoteEntry> saplingEntries;
+        std::set<libzcash::PaymentAddress> noFilter;
+        wallet.GetFilteredNotes(sproutEntries, saplingEntries, noFilter, 0);
+        EXPECT_EQ(0, sproutEntries.size());
+        checkEntries(expected, saplingEntries);
+        EXPECT_EQ(3, wallet.mapSaplingNoteAddresses.size());
+        EXPECT_EQ(2, wallet.mapSaplingNotesByAddress[pa].size());
+        EXPECT_EQ(1, wallet.mapSaplingNotesByAddress[pa2].size());
+    }
+
+    // Filtering by address only visits the notes indexed under it
+    std::vector<SaplingNoteEntry> expected2;
+    for (const auto& entry : expected) {
+        if (entry.address == pa2)
+            expected2.push_back(entry);
+    }
+    ASSERT_EQ(1, expected2.size());
+    EXPECT_EQ(20000, expected2[0].note.value());
+    {
+        std::vector<SproutNoteEntry> sproutEntries;
+        std::vector<SaplingNoteEntry> saplingEntries;
+        std::set<libzcash::PaymentAddress> filter {pa2};
+        wallet.GetFilteredNotes(sproutEntries, saplingEntries, filter, 0);
+        checkEntries(expected2, saplingEntries);
+    }
+
+    {
+        std::vector<SproutNoteEntry> sproutEntries;
+        std::vector<SaplingNoteEntry> saplingEntries;
+        std::set<libzcash::PaymentAddress> filter {pa, pa2};
+        wallet.GetFilteredNotes(sproutEntries, saplingEntries, filter, 0);
+        checkEntries(expected, saplingEntries);
+    }
+
+    // Removing the transaction drops its notes from the index
+    wallet.EraseSaplingNoteAddresses(hash);
+    EXPECT_EQ(0, wallet.mapSaplingNoteAddresses.size());
+    EXPECT_EQ(0, wallet.mapSaplingNotesByAddress.size());
+    {
+        std::vector<SproutNoteEntry> sproutEntries;
+        std::vector<SaplingNoteEntry> saplingEntries;
+        std::set<libzcash::PaymentAddress> filter {pa2};
+        wallet.GetFilteredNotes(sproutEntries, saplingEntries, filter, 0);
+        EXPECT_EQ(0, saplingEntries.size());
+    }
+
+    // Tear down
+    chainActive.SetTip(NULL);
+    mapBlockIndex.erase(blockHash);
+
+    // Revert to default
+    RegtestDeactivateSapling();
+}
+
 TEST(WalletTests, NavigateFromSaplingNullifierToNote) {
     auto consensusParams = RegtestActivateSapling();
 
@@ -2111,3 +2243,101 @@ TEST(WalletTests, SaplingNoteLocking) {
     EXPECT_FALSE(wallet.IsLockedNote(sop1));
     EXPECT_FALSE(wallet.IsLockedNote(sop2));
 }
+
+TEST(WalletTests, GetBalancesFollowsWalletAndChain) {
+    TestWallet wallet;
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    CKey tsk = AddTestCKeyToKeyStore(wallet);
+    auto scriptPubKey = GetScriptForDestination(tsk.GetPubKey().GetID());
+
+    CMutableTransaction mtx1;
+    mtx1.vout.push_back(CTxOut(1000, scriptPubKey));
+    CWalletTx wtx1 {&wallet, mtx1};
+    CMutableTransaction mtx2;
+    mtx2.vout.push_back(CTxOut(2000, scriptPubKey));
+    CWalletTx wtx2 {&wallet, mtx2};
+
+    // Block 1 confirms wtx1, block 2 confirms wtx2
+    CBlock block1;
+    block1.vtx.push_back(wtx1);
+    block1.hashMerkleRoot = block1.BuildMerkleTree();
+    auto blockHash1 = block1.GetHash();
+    CBlockIndex fakeIndex1 {block1};
+    mapBlockIndex.insert(std::make_pair(blockHash1, &fakeIndex1));
+
+    CBlock block2;
+    block2.vtx.push_back(wtx2);
+    block2.hashMerkleRoot = block2.BuildMerkleTree();
+    block2.hashPrevBlock = blockHash1;
+    auto blockHash2 = block2.GetHash();
+    CBlockIndex fakeIndex2 {block2};
+    fakeIndex2.pprev = &fakeIndex1;
+    fakeIndex2.nHeight = 1;
+
+    chainActive.SetTip(&fakeIndex1);
+    EXPECT_EQ(0, wallet.GetBalances().nTrusted);
+
+    // Adding a confirmed transaction is seen without a new tip
+    wtx1.SetMerkleBranch(block1);
+    wallet.AddToWallet(wtx1, true, NULL);
+    EXPECT_EQ(1000, wallet.GetBalances().nTrusted);
+
+    // wtx2 is neither in the chain nor in the mempool yet
+    wtx2.SetMerkleBranch(block2);
+    wallet.AddToWallet(wtx2, true, NULL);
+    EXPECT_EQ(1000, wallet.GetBalances().nTrusted);
+    EXPECT_EQ(0, wallet.GetBalances().nUntrustedPending);
+
+    // Confirming it only moves the tip, with no wallet event
+    mapBlockIndex.insert(std::make_pair(blockHash2, &fakeIndex2));
+    chainActive.SetTip(&fakeIndex2);
+    EXPECT_EQ(3000, wallet.GetBalances().nTrusted);
+
+    // Reorging block 2 out takes its transaction back out of the balance
+    chainActive.SetTip(&fakeIndex1);
+    EXPECT_EQ(1000, wallet.GetBalances().nTrusted);
+
+    // Tear down
+    chainActive.SetTip(NULL);
+    mapBlockIndex.erase(blockHash1);
+    mapBlockIndex.erase(blockHash2);
+}
+
+TEST(WalletTests, AdvanceNoteWitnessesMatchesSerial) {
+    // Enough notes to be split across threads
+    const size_t nNotes = 64;
+    SaplingMerkleTree tree;
+    std::vector<SaplingNoteData> vParallel(nNotes);
+    for (SaplingNoteData& nd : vParallel) {
+        tree.append(GetRandHash());
+        nd.witnesses.push_front(tree.witness());
+        nd.witnessHeight = 1;
+    }
+    std::vector<SaplingNoteData> vSerial = vParallel;
+
+    std::vector<uint256> vCommitments;
+    for (int i = 0; i < 10; i++)
+        vCommitments.push_back(GetRandHash());
+
+    std::vector<SaplingNoteData*> vNotes;
+    for (SaplingNoteData& nd : vParallel)
+        vNotes.push_back(&nd);
+    AdvanceNoteWitnesses(vNotes, vCommitments, 2);
+
+    for (size_t i = 0; i < nNotes; i++) {
+        SaplingNoteData& nd = vSerial[i];
+        nd.witnesses.push_front(nd.witnesses.front());
+        for (const uint256& cm : vCommitments)
+            nd.witnesses.front().append(cm);
+
+        EXPECT_EQ(2, vParallel[i].witnessHeight);
+        ASSERT_EQ(nd.witnesses.size(), vParallel[i].witnesses.size());
+        auto it = vParallel[i].witnesses.begin();
+        for (const SaplingWitness& witness : nd.witnesses) {
+            EXPECT_EQ(witness.root(), it->root());
+            EXPECT_EQ(witness.position(), it->position());
+            ++it;
+        }
+    }
+}
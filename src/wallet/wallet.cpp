@@ -26,6 +26,7 @@
 #include "spork.h"
 #include "swifttx.h"
 #include "timedata.h"
+#include "util/parallel.h"
 #include "utilmoneystr.h"
 #include "wallet/asyncrpcoperation_saplingmigration.h"
 #include "zcash/Note.hpp"
@@ -1557,6 +1558,40 @@ int CWallet::VerifyAndSetInitialWitness(const CBlockIndex* pindex, bool witnessO
     return nMinimumHeight;
 }
 
+namespace
+{
+//! Witnesses are advanced on several threads once a block has this many notes to advance.
+const size_t WITNESS_PARALLEL_MIN_NOTES = 16;
+//! Minimum number of notes given to each thread.
+const size_t WITNESS_NOTES_PER_THREAD = 8;
+const size_t WITNESS_MAX_THREADS = 8;
+} // namespace
+
+template <typename NoteData>
+void AdvanceNoteWitnesses(const std::vector<NoteData*>& vNotes, const std::vector<uint256>& vCommitments, int nHeight)
+{
+    size_t nThreads = 1;
+    if (!vCommitments.empty() && vNotes.size() >= WITNESS_PARALLEL_MIN_NOTES) {
+        nThreads = std::min<size_t>(std::max(GetNumCores(), 1), WITNESS_MAX_THREADS);
+        nThreads = std::max<size_t>(std::min(nThreads, vNotes.size() / WITNESS_NOTES_PER_THREAD), 1);
+    }
+
+    util::ParallelFor(vNotes.size(), nThreads, [&](size_t i) {
+        NoteData* nd = vNotes[i];
+        nd->witnesses.push_front(nd->witnesses.front());
+        while (nd->witnesses.size() > WITNESS_CACHE_SIZE) {
+            nd->witnesses.pop_back();
+        }
+        for (const uint256& note_commitment : vCommitments) {
+            nd->witnesses.front().append(note_commitment);
+        }
+        nd->witnessHeight = nHeight;
+    });
+}
+
+template void AdvanceNoteWitnesses(const std::vector<SproutNoteData*>&, const std::vector<uint256>&, int);
+template void AdvanceNoteWitnesses(const std::vector<SaplingNoteData*>&, const std::vector<uint256>&, int);
+
 void CWallet::BuildWitnessCache(const CBlockIndex* pindex, bool witnessOnly)
 {
     LOCK2(cs_main, cs_wallet);
@@ -1567,28 +1602,35 @@ void CWallet::BuildWitnessCache(const CBlockIndex* pindex, bool witnessOnly)
         return;
     }
 
-    uint256 sproutRoot;
-    uint256 saplingRoot;
     CBlockIndex* pblockindex = chainActive[startHeight];
     int height = chainActive.Height();
+    std::vector<uint256> vSproutCommitments;
+    std::vector<uint256> vSaplingCommitments;
+    std::vector<SproutNoteData*> vSproutNotes;
+    std::vector<SaplingNoteData*> vSaplingNotes;
 
     while (pblockindex) {
         if (pblockindex->nHeight % 100 == 0 && pblockindex->nHeight < height - 5) {
             LogPrintf("Building Witnesses for block %i %.4f complete\n", pblockindex->nHeight, pblockindex->nHeight / double(height));
         }
 
-        SproutMerkleTree sproutTree;
-        sproutRoot = pblockindex->pprev->hashFinalSproutRoot;
-        pcoinsTip->GetSproutAnchorAt(sproutRoot, sproutTree);
-
-        SaplingMerkleTree saplingTree;
-        saplingRoot = pblockindex->pprev->hashFinalSaplingRoot;
-        pcoinsTip->GetSaplingAnchorAt(saplingRoot, saplingTree);
-
-        // Cycle through blocks and transactions building sapling tree until the commitment needed is reached
+        // Collect the block's note commitments once, for all the notes that need them
         CBlock block;
         ReadBlockFromDisk(block, pblockindex, Params().GetConsensus());
 
+        vSproutCommitments.clear();
+        vSaplingCommitments.clear();
+        for (const CTransaction& tx : block.vtx) {
+            for (const JSDescription& jsdesc : tx.vjoinsplit) {
+                vSproutCommitments.insert(vSproutCommitments.end(), jsdesc.commitments.begin(), jsdesc.commitments.end());
+            }
+            for (const OutputDescription& output : tx.vShieldedOutput) {
+                vSaplingCommitments.push_back(output.cm);
+            }
+        }
+
+        vSproutNotes.clear();
+        vSaplingNotes.clear();
         for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
             if (wtxItem.second.mapSproutNoteData.empty() && wtxItem.second.mapSaplingNoteData.empty())
                 continue;
@@ -1598,21 +1640,7 @@ void CWallet::BuildWitnessCache(const CBlockIndex* pindex, bool witnessOnly)
                 for (mapSproutNoteData_t::value_type& item : wtxItem.second.mapSproutNoteData) {
                     auto* nd = &(item.second);
                     if (nd->nullifier && nd->witnessHeight == pblockindex->nHeight - 1 && GetSproutSpendDepth(*item.second.nullifier) <= WITNESS_CACHE_SIZE) {
-                        nd->witnesses.push_front(nd->witnesses.front());
-                        while (nd->witnesses.size() > WITNESS_CACHE_SIZE) {
-                            nd->witnesses.pop_back();
-                        }
-
-                        for (const CTransaction& tx : block.vtx) {
-                            for (size_t i = 0; i < tx.vjoinsplit.size(); i++) {
-                                const JSDescription& jsdesc = tx.vjoinsplit[i];
-                                for (uint8_t j = 0; j < jsdesc.commitments.size(); j++) {
-                                    const uint256& note_commitment = jsdesc.commitments[j];
-                                    nd->witnesses.front().append(note_commitment);
-                                }
-                            }
-                        }
-                        nd->witnessHeight = pblockindex->nHeight;
+                        vSproutNotes.push_back(nd);
                     }
                 }
 
@@ -1620,23 +1648,15 @@ void CWallet::BuildWitnessCache(const CBlockIndex* pindex, bool witnessOnly)
                 for (mapSaplingNoteData_t::value_type& item : wtxItem.second.mapSaplingNoteData) {
                     auto* nd = &(item.second);
                     if (nd->nullifier && nd->witnessHeight == pblockindex->nHeight - 1 && GetSaplingSpendDepth(*item.second.nullifier) <= WITNESS_CACHE_SIZE) {
-                        nd->witnesses.push_front(nd->witnesses.front());
-                        while (nd->witnesses.size() > WITNESS_CACHE_SIZE) {
-                            nd->witnesses.pop_back();
-                        }
-
-                        for (const CTransaction& tx : block.vtx) {
-                            for (uint32_t i = 0; i < tx.vShieldedOutput.size(); i++) {
-                                const uint256& note_commitment = tx.vShieldedOutput[i].cm;
-                                nd->witnesses.front().append(note_commitment);
-                            }
-                        }
-                        nd->witnessHeight = pblockindex->nHeight;
+                        vSaplingNotes.push_back(nd);
                     }
                 }
             }
         }
 
+        AdvanceNoteWitnesses(vSproutNotes, vSproutCommitments, pblockindex->nHeight);
+        AdvanceNoteWitnesses(vSaplingNotes, vSaplingCommitments, pblockindex->nHeight);
+
         if (pblockindex == pindex)
             break;
 
@@ -1775,6 +1795,7 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (PAIRTYPE(const uint256, CWalletTx) & item : mapWallet)
             item.second.MarkDirty();
+        MarkBalancesDirty();
     }
 }
 
@@ -1956,10 +1977,13 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
     uint256 hash = wtxIn.GetHash();
 
     if (fFromLoadWallet) {
+        MarkBalancesDirty();
         mapWallet[hash] = wtxIn;
         mapWallet[hash].BindWallet(this);
         UpdateNullifierNoteMapWithTx(mapWallet[hash]);
         AddToSpends(hash);
+        if (!wtxIn.mapSaplingNoteData.empty())
+            setSaplingTxsToIndex.insert(hash);
     } else {
         LOCK(cs_wallet);
         // Inserts only if not already there, returns tx inserted or tx found
@@ -2033,6 +2057,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                 fUpdated = true;
             }
         }
+        IndexSaplingNotes(wtx);
 
         //// debug print
         LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
@@ -2044,6 +2069,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
 
         // Break debit/credit balance caches:
         wtx.MarkDirty();
+        MarkBalancesDirty();
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -2164,6 +2190,7 @@ void CWallet::MarkAffectedTransactionsDirty(const CTransaction& tx)
     // If a transaction changes 'conflicted' state, that changes the balance
     // available of the outputs it spends. So force those to be
     // recomputed, also:
+    MarkBalancesDirty();
     for (const CTxIn& txin : tx.vin) {
         if (mapWallet.count(txin.prevout.hash))
             mapWallet[txin.prevout.hash].MarkDirty();
@@ -2192,8 +2219,11 @@ void CWallet::EraseFromWallet(const uint256& hash)
         return;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.erase(hash)) {
+            MarkBalancesDirty();
+            EraseSaplingNoteAddresses(hash);
             CWalletDB(strWalletFile).EraseTx(hash);
+        }
     }
     return;
 }
@@ -3270,14 +3300,63 @@ void CWallet::UpdateWalletTransactionOrder(std::map<std::pair<int, int>, CWallet
 /**
  * Delete transactions from the Wallet
  */
+void CWallet::IndexSaplingNotes(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet); // mapSaplingNoteAddresses, mapSaplingNotesByAddress
+    for (const auto& pair : wtx.mapSaplingNoteData) {
+        const SaplingOutPoint& op = pair.first;
+        const SaplingNoteData& nd = pair.second;
+        if (mapSaplingNoteAddresses.count(op))
+            continue;
+
+        auto optDeserialized = SaplingNotePlaintext::attempt_sapling_enc_decryption_deserialization(wtx.vShieldedOutput[op.n].encCiphertext, nd.ivk, wtx.vShieldedOutput[op.n].ephemeralKey);
+        // The transaction would not have entered the wallet unless
+        // its plaintext had been successfully decrypted previously.
+        assert(optDeserialized != std::nullopt);
+        auto maybe_pa = nd.ivk.address(optDeserialized->d);
+        assert(static_cast<bool>(maybe_pa));
+        mapSaplingNoteAddresses.emplace(op, maybe_pa.value());
+        mapSaplingNotesByAddress[maybe_pa.value()].insert(op);
+    }
+}
+
+void CWallet::IndexLoadedSaplingNotes()
+{
+    AssertLockHeld(cs_wallet); // setSaplingTxsToIndex
+    for (const uint256& hash : setSaplingTxsToIndex) {
+        auto it = mapWallet.find(hash);
+        if (it != mapWallet.end())
+            IndexSaplingNotes(it->second);
+    }
+    setSaplingTxsToIndex.clear();
+}
+
+void CWallet::EraseSaplingNoteAddresses(const uint256& hash)
+{
+    AssertLockHeld(cs_wallet); // mapSaplingNoteAddresses, mapSaplingNotesByAddress
+    auto it = mapSaplingNoteAddresses.lower_bound(SaplingOutPoint(hash, 0));
+    while (it != mapSaplingNoteAddresses.end() && it->first.hash == hash) {
+        auto itAddress = mapSaplingNotesByAddress.find(it->second);
+        if (itAddress != mapSaplingNotesByAddress.end()) {
+            itAddress->second.erase(it->first);
+            if (itAddress->second.empty())
+                mapSaplingNotesByAddress.erase(itAddress);
+        }
+        it = mapSaplingNoteAddresses.erase(it);
+    }
+    setSaplingTxsToIndex.erase(hash);
+}
+
 void CWallet::DeleteTransactions(std::vector<uint256>& removeTxs)
 {
     LOCK(cs_wallet);
 
     CWalletDB walletdb(strWalletFile, "r+", false);
 
+    MarkBalancesDirty();
     for (int i = 0; i < removeTxs.size(); i++) {
         if (mapWallet.erase(removeTxs[i])) {
+            EraseSaplingNoteAddresses(removeTxs[i]);
             walletdb.EraseTx(removeTxs[i]);
             LogPrint("deletetx", "Delete Tx - Deleting tx %s, %i.\n", removeTxs[i].ToString(), i);
         } else {
@@ -3849,19 +3928,43 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime)
  */
 
 
-CAmount CWallet::GetBalance() const
+CWalletBalances CWallet::GetBalances() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
+    LOCK2(cs_main, cs_wallet);
+    uint256 hashTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+    // Toggling SPORK_2 or a large work fork changes the depth of every locked transaction
+    bool fSwiftTX = fEnableSwiftTX && sporkManager.IsSporkActive(SPORK_2_SWIFTTX) &&
+                    !fLargeWorkForkFound && !fLargeWorkInvalidChainFound;
+    if (fBalancesCached && hashBalancesTip == hashTip &&
+        fBalancesSwiftTX == fSwiftTX && nBalancesChanges == nBalanceChanges)
+        return cachedBalances;
+
+    CWalletBalances balances;
+    for (const auto& entry : mapWallet) {
+        const CWalletTx& wtx = entry.second;
+        const bool fTrusted = wtx.IsTrusted();
+        if (fTrusted) {
+            balances.nTrusted += wtx.GetAvailableCredit();
+            balances.nWatchOnlyTrusted += wtx.GetAvailableWatchOnlyCredit();
+        } else if (!CheckFinalTx(wtx) || wtx.GetDepthInMainChain() == 0) {
+            balances.nUntrustedPending += wtx.GetAvailableCredit();
+            balances.nWatchOnlyUntrustedPending += wtx.GetAvailableWatchOnlyCredit();
+        }
+        balances.nImmature += wtx.GetImmatureCredit();
+        balances.nWatchOnlyImmature += wtx.GetImmatureWatchOnlyCredit();
+    }
+
+    cachedBalances = balances;
+    hashBalancesTip = hashTip;
+    fBalancesSwiftTX = fSwiftTX;
+    nBalancesChanges = nBalanceChanges;
+    fBalancesCached = true;
+    return balances;
+}
 
-    return nTotal;
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nTrusted;
 }
 
 CAmount CWallet::GetUnlockedCoins() const
@@ -3912,71 +4015,27 @@ CAmount CWallet::GetLockedCoins() const
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!CheckFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnlyTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!CheckFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchOnlyUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchOnlyImmature;
 }
 
 void CWallet::AvailableCoins(vector<COutput>& vCoins,
@@ -5310,6 +5369,8 @@ bool CWallet::UpdatedTransaction(const uint256& hashTx)
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()) {
+            // A SwiftTX lock changes the depth the balances count the transaction at
+            MarkBalancesDirty();
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -5707,26 +5768,111 @@ void CWallet::GetFilteredNotes(
 {
     LOCK2(cs_main, cs_wallet);
 
-    KeyIO keyIO(Params());
-    for (auto& p : mapWallet) {
-        CWalletTx wtx = p.second;
+    IndexLoadedSaplingNotes();
 
-        // Filter the transactions before checking for notes
+    // Filter the transactions before checking for notes
+    auto checkTx = [&](const CWalletTx& wtx, int& nDepth) {
+        nDepth = wtx.GetDepthInMainChain();
         if (!CheckFinalTx(wtx) ||
-            wtx.GetDepthInMainChain() < minDepth ||
-            wtx.GetDepthInMainChain() > maxDepth) {
-            continue;
+            nDepth < minDepth ||
+            nDepth > maxDepth) {
+            return false;
         }
 
         // Filter coinbase transactions that don't have Sapling outputs
         if (wtx.IsCoinBase() && wtx.mapSaplingNoteData.empty()) {
+            return false;
+        }
+        return true;
+    };
+
+    auto addSaplingNote = [&](const CWalletTx& wtx, int nDepth, const SaplingOutPoint& op, const SaplingNoteData& nd) {
+        // the checks that need no decryption come first, trial decryption is by far the costliest step
+        if (ignoreSpent && nd.nullifier && IsSaplingSpent(*nd.nullifier)) {
+            return;
+        }
+
+        // skip locked notes
+        if (ignoreLocked && IsLockedNote(op)) {
+            return;
+        }
+
+        auto itAddress = mapSaplingNoteAddresses.find(op);
+        if (itAddress == mapSaplingNoteAddresses.end()) {
+            IndexSaplingNotes(wtx);
+            itAddress = mapSaplingNoteAddresses.find(op);
+        }
+        const SaplingPaymentAddress& pa = itAddress->second;
+
+        // skip notes which belong to a different payment address in the wallet
+        if (!(filterAddresses.empty() || filterAddresses.count(pa))) {
+            return;
+        }
+
+        // skip notes which cannot be spent
+        if (requireSpendingKey && !HaveSpendingKeyForPaymentAddress(this)(pa)) {
+            return;
+        }
+
+        auto optDeserialized = SaplingNotePlaintext::attempt_sapling_enc_decryption_deserialization(wtx.vShieldedOutput[op.n].encCiphertext, nd.ivk, wtx.vShieldedOutput[op.n].ephemeralKey);
+
+        // The transaction would not have entered the wallet unless
+        // its plaintext had been successfully decrypted previously.
+        assert(optDeserialized != std::nullopt);
+        auto notePt = optDeserialized.value();
+        auto note = notePt.note(nd.ivk).value();
+        saplingEntries.push_back(SaplingNoteEntry{
+            op, pa, note, notePt.memo(), nDepth});
+    };
+
+    // A filter of Sapling addresses only matches the notes indexed under them. Walk
+    // those in outpoint order, which is the order of the full scan below.
+    bool fSaplingFilter = !filterAddresses.empty();
+    for (const PaymentAddress& addr : filterAddresses) {
+        if (!std::get_if<SaplingPaymentAddress>(&addr))
+            fSaplingFilter = false;
+    }
+    if (fSaplingFilter) {
+        std::set<SaplingOutPoint> ops;
+        for (const PaymentAddress& addr : filterAddresses) {
+            auto it = mapSaplingNotesByAddress.find(std::get<SaplingPaymentAddress>(addr));
+            if (it != mapSaplingNotesByAddress.end())
+                ops.insert(it->second.begin(), it->second.end());
+        }
+
+        const CWalletTx* pwtx = nullptr;
+        bool fTxPasses = false;
+        int nDepth = 0;
+        for (const SaplingOutPoint& op : ops) {
+            if (!pwtx || pwtx->GetHash() != op.hash) {
+                auto itTx = mapWallet.find(op.hash);
+                if (itTx == mapWallet.end())
+                    continue;
+                pwtx = &itTx->second;
+                fTxPasses = checkTx(*pwtx, nDepth);
+            }
+            if (!fTxPasses)
+                continue;
+            auto itNote = pwtx->mapSaplingNoteData.find(op);
+            if (itNote != pwtx->mapSaplingNoteData.end())
+                addSaplingNote(*pwtx, nDepth, op, itNote->second);
+        }
+        return;
+    }
+
+    KeyIO keyIO(Params());
+    for (const auto& p : mapWallet) {
+        const CWalletTx& wtx = p.second;
+
+        int nDepth;
+        if (!checkTx(wtx, nDepth)) {
             continue;
         }
 
-        for (auto& pair : wtx.mapSproutNoteData) {
-            JSOutPoint jsop = pair.first;
-            SproutNoteData nd = pair.second;
-            SproutPaymentAddress pa = nd.address;
+        for (const auto& pair : wtx.mapSproutNoteData) {
+            const JSOutPoint& jsop = pair.first;
+            const SproutNoteData& nd = pair.second;
+            const SproutPaymentAddress& pa = nd.address;
 
             // skip notes which belong to a different payment address in the wallet
             if (!(filterAddresses.empty() || filterAddresses.count(pa))) {
@@ -5772,7 +5918,7 @@ void CWallet::GetFilteredNotes(
                     (unsigned char)j);
 
                 sproutEntries.push_back(SproutNoteEntry{
-                    jsop, pa, plaintext.note(pa), plaintext.memo(), wtx.GetDepthInMainChain()});
+                    jsop, pa, plaintext.note(pa), plaintext.memo(), nDepth});
 
             } catch (const note_decryption_failed& err) {
                 // Couldn't decrypt with this spending key
@@ -5783,43 +5929,8 @@ void CWallet::GetFilteredNotes(
             }
         }
 
-        for (auto& pair : wtx.mapSaplingNoteData) {
-            SaplingOutPoint op = pair.first;
-            SaplingNoteData nd = pair.second;
-
-            auto optDeserialized = SaplingNotePlaintext::attempt_sapling_enc_decryption_deserialization(wtx.vShieldedOutput[op.n].encCiphertext, nd.ivk, wtx.vShieldedOutput[op.n].ephemeralKey);
-
-            // The transaction would not have entered the wallet unless
-            // its plaintext had been successfully decrypted previously.
-            assert(optDeserialized != std::nullopt);
-
-            auto notePt = optDeserialized.value();
-            auto maybe_pa = nd.ivk.address(notePt.d);
-            assert(static_cast<bool>(maybe_pa));
-            auto pa = maybe_pa.value();
-
-            // skip notes which belong to a different payment address in the wallet
-            if (!(filterAddresses.empty() || filterAddresses.count(pa))) {
-                continue;
-            }
-
-            if (ignoreSpent && nd.nullifier && IsSaplingSpent(*nd.nullifier)) {
-                continue;
-            }
-
-            // skip notes which cannot be spent
-            if (requireSpendingKey && !HaveSpendingKeyForPaymentAddress(this)(pa)) {
-                continue;
-            }
-
-            // skip locked notes
-            if (ignoreLocked && IsLockedNote(op)) {
-                continue;
-            }
-
-            auto note = notePt.note(nd.ivk).value();
-            saplingEntries.push_back(SaplingNoteEntry{
-                op, pa, note, notePt.memo(), wtx.GetDepthInMainChain()});
+        for (const auto& pair : wtx.mapSaplingNoteData) {
+            addSaplingNote(wtx, nDepth, pair.first, pair.second);
         }
     }
 }
@@ -356,6 +356,15 @@ public:
 typedef std::map<JSOutPoint, SproutNoteData> mapSproutNoteData_t;
 typedef std::map<SaplingOutPoint, SaplingNoteData> mapSaplingNoteData_t;
 
+/**
+ * Advance the witnesses of vNotes by one block: push a copy of the newest
+ * witness and append the block's note commitments to it. The notes share
+ * nothing but the commitment list, so large wallets split them across threads
+ * while the caller holds cs_main and cs_wallet.
+ */
+template <typename NoteData>
+void AdvanceNoteWitnesses(const std::vector<NoteData*>& vNotes, const std::vector<uint256>& vCommitments, int nHeight);
+
 /** Sprout note, its location in a transaction, and number of confirmations. */
 struct SproutNoteEntry {
     JSOutPoint jsop;
@@ -830,6 +839,19 @@ private:
 };
 
 
+/** Transparent balances of a wallet, split by trust and by ownership */
+struct CWalletBalances {
+    CAmount nTrusted;
+    CAmount nUntrustedPending;
+    CAmount nImmature;
+    CAmount nWatchOnlyTrusted;
+    CAmount nWatchOnlyUntrustedPending;
+    CAmount nWatchOnlyImmature;
+
+    CWalletBalances() : nTrusted(0), nUntrustedPending(0), nImmature(0),
+                        nWatchOnlyTrusted(0), nWatchOnlyUntrustedPending(0), nWatchOnlyImmature(0) {}
+};
+
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -853,6 +875,22 @@ private:
     int nSetChainUpdates;
     bool fBroadcastTransactions;
 
+    /**
+     * Transparent balances from the last pass over mapWallet, reused until the
+     * chain tip, SwiftTX availability or a wallet transaction changes.
+     * nBalanceChanges is bumped whenever a wallet transaction is added, removed,
+     * synced from the mempool or a block, marked dirty, or gains or loses a
+     * SwiftTX lock, so unrelated mempool traffic leaves the cache alone.
+     */
+    uint64_t nBalanceChanges;
+    mutable bool fBalancesCached;
+    mutable uint256 hashBalancesTip;
+    mutable bool fBalancesSwiftTX;
+    mutable uint64_t nBalancesChanges;
+    mutable CWalletBalances cachedBalances;
+
+    void MarkBalancesDirty() { nBalanceChanges++; }
+
     template <class T>
     using TxSpendMap = std::multimap<T, uint256>;
     /**
@@ -964,6 +1002,12 @@ private:
 protected:
     bool UpdatedNoteData(const CWalletTx& wtxIn, CWalletTx& wtx);
     void MarkAffectedTransactionsDirty(const CTransaction& tx);
+    //! Add the Sapling notes of wtx that are not indexed yet to the note address index
+    void IndexSaplingNotes(const CWalletTx& wtx);
+    //! Index the notes of the transactions loaded from disk since the last call
+    void IndexLoadedSaplingNotes();
+    //! Forget the indexed note addresses of a transaction removed from mapWallet
+    void EraseSaplingNoteAddresses(const uint256& hash);
 
     /* the hd chain data model (chain counters) */
     CHDChain hdChain;
@@ -1024,6 +1068,10 @@ public:
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
         nWitnessCacheSize = 0;
+        nBalanceChanges = 0;
+        fBalancesCached = false;
+        fBalancesSwiftTX = false;
+        nBalancesChanges = 0;
     }
 
     /**
@@ -1078,6 +1126,19 @@ public:
 
     std::map<uint256, SaplingOutPoint> mapSaplingNullifiersToNotes;
 
+    /**
+     * Index of the Sapling notes in mapWallet by payment address, so that
+     * GetFilteredNotes only visits the notes of the addresses asked for.
+     * AddToWallet decrypts new notes once to index them; the address of an
+     * output never changes. Notes of transactions read from disk are indexed
+     * on first use instead, so that loading the wallet decrypts nothing.
+     * Entries go when their transaction is removed from the wallet. In memory only.
+     */
+    std::map<SaplingOutPoint, libzcash::SaplingPaymentAddress> mapSaplingNoteAddresses;
+    std::map<libzcash::SaplingPaymentAddress, std::set<SaplingOutPoint>> mapSaplingNotesByAddress;
+    //! Transactions read from disk whose notes are not indexed yet
+    std::set<uint256> setSaplingTxsToIndex;
+
     std::map<uint256, CWalletTx> mapWallet;
 
     int64_t nOrderPosNext;
@@ -1288,6 +1349,7 @@ public:
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime);
+    CWalletBalances GetBalances() const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;